@@ -0,0 +1,1021 @@
+// Minimal Color Picker - pixel kernel microbenchmarks.
+// Build/run: make bench            (writes bench_results.json)
+//            bench/bench_kernels [--quick] [--no-counters] [--threads N] [--json out.json]
+//
+// Sweeps loupe diameters 240..2048 and zoom factors over the kernels in
+// picker_kernels.h and reports ns/pixel, cycles/pixel (TSC reference cycles on
+// x86, omitted elsewhere) and GB/s of bytes read+written. Inputs are synthetic
+// so the benchmark runs on a headless machine.
+//
+// Where hardware counters are readable (picker_perf.h, Linux), the best batch
+// is also counted, adding IPC and instructions, cache misses and branch
+// misses per pixel; elsewhere those columns are n/a and the JSON has nulls.
+//
+// "compose_tiled" is the banded compose on the calling thread alone and
+// "compose_pool" the same bands on the worker pool (picker_pool.h, --threads N,
+// default cores-1); counters only see the calling thread's share of the pool.
+//
+// "downsample" is the gamma-correct zoom-out filter (picker_downsample.h,
+// SSE2 where available) and "downsample_c" its portable version; their
+// diameter is the reduced size, zoom the reduction factor and pixels the
+// source pixels read.
+//
+// "mip_build" reduces a whole 956 px capture into the zoom-out pyramid
+// (picker_mip.h), "mip_update" is the per-frame update when no tile changed
+// (tile hashes only) and "mip_sample" blends two levels into the 239 px loupe
+// source at zoom 1/2.83. A wheel notch over still content costs update plus
+// sample; the JSON compares that with one full-resolution box filter.
+//
+// "damage" hashes a whole d x d frame in 16x16 blocks and compares each with
+// the last frame (picker_damage.h, SSE2 where available); "damage_c" hashes the
+// same blocks with the portable code. Compare both with "hash", one hash of
+// the whole frame. "compose_patch" is a frame in which one 16x16 block of the
+// capture changed: the block hashes of the capture plus the loupe tiles that
+// block magnifies to, per loupe pixel like "compose".
+//
+// "scope" bins a d x d frame into the waveform and vectorscope (picker_scope.h,
+// SSE2 where available) on the calling thread, "scope_pool" tile by tile on
+// the worker pool and "scope_c" with the portable code; "scope_render" draws
+// the panel from the bins (pixels are panel pixels).
+//
+// "fill" measures the same-colour region of a solid 3840x2160 frame from its
+// centre (picker_fill.h, SSE2 where available): every pixel is in the region,
+// the worst case for a measurement. "fill_c" is the portable code and
+// "fill_blobs" a frame of small rectangles in three colours, where the fill
+// stops at many edges. Their diameter is the frame width.
+//
+// "ruler" casts the pixel ruler's four rays from the centre of a solid
+// 7680x4320 frame (picker_ruler.h): every ray runs to the frame's side and
+// the whole column band is transposed, the worst case for a frame.
+// "ruler_c" is the portable code. Pixels are the row plus the column.
+//
+// "compose_onion" is the 960 px compose at zoom 8 with a reference blended
+// over the capture (picker_filter.h) and "compose_diff" with their
+// difference; the JSON gives the blend's cost over the plain compose.
+// "scale_amplify" is the scale pass through the difference amplifier, and
+// "amplify_overhead" its cost over "scale", the plain copy it replaces.
+//
+// The pinned-loupe section times one frame's capture-side and compose work
+// for 1..8 loupes (the cursor loupe plus pins) on a synthetic 1920x1080
+// screen: planning the shared grabs, copying them, hashing each pin and
+// composing the batch. "still" pins sit over unchanged pixels and are not
+// recomposed; "live" pins change every frame.
+//
+// The pool scaling section runs a region analysis over a synthetic 7680x4320
+// frame with pool_run_tiles(): a 4096-bin RGB histogram per tile into one
+// partial per slot, merged at the end. It is timed with 1 up to N participants
+// (N = online cores, or --threads N + 1 if that is more) and reports the
+// speedup over one, the parallel efficiency and the tiles stolen per frame.
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // syscall() for picker_perf.h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "../picker_damage.h"
+#include "../picker_downsample.h"
+#include "../picker_fill.h"
+#include "../picker_filter.h"
+#include "../picker_kernels.h"
+#include "../picker_mip.h"
+#include "../picker_perf.h"
+#include "../picker_pool.h"
+#include "../picker_regions.h"
+#include "../picker_ruler.h"
+#include "../picker_scope.h"
+#include "../picker_watch.h"
+
+typedef struct Result {
+    const char* kernel;
+    int diameter;
+    int zoom;        // 0 when the kernel does not depend on zoom
+    double pixels;   // pixels processed per call
+    double bytes;    // bytes read + written per call
+    double ns;       // best time per call
+    double cycles;   // TSC cycles per call (0 when unavailable)
+    PerfSample perf; // hardware counters over the best batch
+} Result;
+
+static Result g_results[512];
+static int g_resultCount;
+static int g_quick;
+static WorkerPool g_pool;
+static WorkerPool g_serial;  // no workers: bands run on the caller
+static PerfCounters g_perf;
+static volatile uint64_t g_sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void) {
+#if HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int odd(int n) { return (n % 2 == 0) ? n + 1 : n; }
+
+static uint8_t* alloc_pixels(int w, int h) {
+    uint8_t* p = (uint8_t*)malloc((size_t)w * (size_t)h * 4);
+    if (!p) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void fill_noise(uint8_t* px, size_t bytes, uint32_t seed) {
+    uint32_t s = seed * 2654435761u + 1;
+    for (size_t i = 0; i < bytes; i++) {
+        s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+        px[i] = (uint8_t)s;
+    }
+}
+
+typedef void (*KernelFn)(void* ctx);
+
+// Runs `fn` in batches until each batch takes ~10 ms and keeps the best batch.
+static void measure(KernelFn fn, void* ctx, double pixels, double* nsOut, double* cyclesOut, PerfSample* perfOut) {
+    int iters = 1;
+    fn(ctx); // warm caches and page in buffers
+
+    for (;;) {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < iters; i++) fn(ctx);
+        uint64_t dt = now_ns() - t0;
+        if (dt >= 10000000ull || iters >= (1 << 24)) break;
+        iters *= 2;
+    }
+
+    int batches = g_quick ? 2 : 5;
+    double bestNs = 1e300, bestCycles = 0;
+    for (int b = 0; b < batches; b++) {
+        PerfSample ps;
+        memset(&ps, 0, sizeof(ps));
+        perf_start(&g_perf);
+        uint64_t c0 = now_cycles();
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < iters; i++) fn(ctx);
+        uint64_t t1 = now_ns();
+        uint64_t c1 = now_cycles();
+        perf_stop(&g_perf, &ps, pixels * iters);
+        double ns = (double)(t1 - t0) / iters;
+        if (ns < bestNs) {
+            bestNs = ns;
+            bestCycles = (double)(c1 - c0) / iters;
+            *perfOut = ps;
+        }
+    }
+    *nsOut = bestNs;
+    *cyclesOut = bestCycles;
+}
+
+static void record(const char* kernel, int diameter, int zoom, double pixels, double bytes,
+                   KernelFn fn, void* ctx) {
+    if (g_resultCount >= (int)(sizeof(g_results) / sizeof(g_results[0]))) return;
+    Result* r = &g_results[g_resultCount++];
+    r->kernel = kernel;
+    r->diameter = diameter;
+    r->zoom = zoom;
+    r->pixels = pixels;
+    r->bytes = bytes;
+    measure(fn, ctx, pixels, &r->ns, &r->cycles, &r->perf);
+    r->perf.name = kernel;
+
+    printf("%-13s d=%-5d zoom=%-3d %9.3f ns/px", kernel, diameter, zoom, r->ns / pixels);
+    if (HAVE_TSC) printf(" %8.3f cyc/px", r->cycles / pixels);
+    printf(" %8.2f GB/s", bytes / r->ns);
+    if (g_perf.available) {
+        printf("  ipc ");
+        perf_print_value(stdout, perf_ipc(&r->perf), "%5.2f");
+        printf("  cache-m/px ");
+        perf_print_value(stdout, perf_per_pixel(&r->perf, PERF_CACHE_MISSES), "%.5f");
+        printf("  br-m/px ");
+        perf_print_value(stdout, perf_per_pixel(&r->perf, PERF_BRANCH_MISSES), "%.5f");
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// ----------------------
+// Kernel wrappers
+// ----------------------
+
+typedef struct Ctx {
+    uint8_t* cap;
+    int capSize;
+    uint8_t* dst;
+    int radius;
+    int samplePos;
+} Ctx;
+
+static void run_scale(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    scale_nearest_bgra(c->cap, c->capSize, c->capSize, c->capSize * 4, c->dst, d, d, d * 4);
+}
+
+static void run_mask(void* p) {
+    Ctx* c = (Ctx*)p;
+    apply_circle_alpha_mask(c->dst, c->radius, c->radius * 2 * 4);
+}
+
+static void run_blend(void* p) {
+    Ctx* c = (Ctx*)p;
+    blend_circle_border(c->dst, c->radius, c->radius * 2 * 4, 2, 1);
+}
+
+static void run_compose(void* p) {
+    Ctx* c = (Ctx*)p;
+    compose_loupe(c->cap, c->capSize, c->capSize * 4, c->dst, c->radius, c->radius * 2 * 4, 2, 1, 6);
+}
+
+static void run_compose_tiled(void* p) {
+    Ctx* c = (Ctx*)p;
+    compose_loupe_tiled(&g_serial, c->cap, c->capSize, c->capSize * 4, c->dst, c->radius, c->radius * 2 * 4, 2, 1, 6);
+}
+
+static void run_compose_pool(void* p) {
+    Ctx* c = (Ctx*)p;
+    compose_loupe_tiled(&g_pool, c->cap, c->capSize, c->capSize * 4, c->dst, c->radius, c->radius * 2 * 4, 2, 1, 6);
+}
+
+static void run_hash(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    g_sink += hash_bgra(c->dst, d, d, d * 4);
+}
+
+static DamageMap g_damage;
+
+static void run_damage(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    g_sink += (uint64_t)damage_update(&g_damage, c->dst, d, d, d * 4);
+}
+
+static void run_damage_c(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    uint64_t acc = 0;
+    for (int y = 0; y < d; y += DAMAGE_BLOCK) {
+        for (int x = 0; x < d; x += DAMAGE_BLOCK) {
+            int w = d - x < DAMAGE_BLOCK ? d - x : DAMAGE_BLOCK, h = d - y < DAMAGE_BLOCK ? d - y : DAMAGE_BLOCK;
+            acc ^= block_hash_bgra_generic(c->dst + (size_t)y * d * 4 + (size_t)x * 4, w, h, d * 4);
+        }
+    }
+    g_sink += acc;
+}
+
+static DamageMap g_patchDamage;
+
+static void run_compose_patch(void* p) {
+    Ctx* c = (Ctx*)p;
+    int dirty[4];
+    c->cap[(size_t)(c->capSize / 2) * c->capSize * 4 + (size_t)(c->capSize / 2) * 4] ^= 0x55;
+    damage_update(&g_patchDamage, c->cap, c->capSize, c->capSize, c->capSize * 4);
+    g_sink += damage_compose_loupe(&g_patchDamage, c->cap, c->capSize * 4, c->dst, c->radius, c->radius * 2 * 4, 2, 1,
+                                   6, dirty);
+}
+
+static ScopeMap g_scope;
+static uint8_t* g_scopePanel;
+
+static void run_scope(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    scope_run(&g_scope, &g_serial, c->dst, d, d, d * 4);
+}
+
+static void run_scope_pool(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    scope_run(&g_scope, &g_pool, c->dst, d, d, d * 4);
+}
+
+static void run_scope_c(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    memset(&g_scope.slots[0], 0, sizeof(ScopeBins));
+    for (int y = 0; y < d; y++) {
+        scope_bin_row_generic(&g_scope.slots[0], g_scope.colOf, c->dst + (size_t)y * d * 4, 0, d);
+    }
+}
+
+static void run_scope_render(void* p) {
+    (void)p;
+    scope_render_bgra(&g_scope, g_scopePanel, SCOPE_PANEL_W * 4);
+}
+
+static void run_hex(void* p) {
+    Ctx* c = (Ctx*)p;
+    int d = c->radius * 2;
+    const uint32_t* px = (const uint32_t*)c->dst;
+    char hex[8];
+    uint64_t acc = 0;
+    for (int i = 0; i < d * d; i++) {
+        format_hex_color(px[i], hex);
+        acc += (uint8_t)hex[3];
+    }
+    g_sink += acc;
+}
+
+static void run_pick(void* p) {
+    Ctx* c = (Ctx*)p;
+    int n = c->capSize;
+    uint64_t acc = 0;
+    for (int i = 0; i < 64; i++) {
+        int pos = (c->samplePos + i * 7) % (n * n);
+        acc += sample_average_bgra(c->cap, n, n, n * 4, pos % n, pos / n, 2);
+    }
+    c->samplePos++;
+    g_sink += acc;
+}
+
+typedef struct DownCtx {
+    const uint8_t* src;
+    uint8_t* dst;
+    int size;    // reduced size
+    int k;
+    uint32_t* acc;
+} DownCtx;
+
+static void run_downsample(void* p) {
+    DownCtx* c = (DownCtx*)p;
+    downsample_box_bgra(c->src, c->size * c->k * 4, c->dst, c->size, c->size, c->size * 4, c->k, c->acc);
+}
+
+static void run_downsample_generic(void* p) {
+    DownCtx* c = (DownCtx*)p;
+    downsample_box_bgra_generic(c->src, c->size * c->k * 4, c->dst, c->size, c->size, c->size * 4, c->k, c->acc);
+}
+
+// Zoom-out of the default 240 px loupe at 2x, 4x and 8x.
+static double g_zoomOut4Ms = -1.0;
+
+static void bench_downsample(void) {
+    static const int factors[] = { 2, 4, 8 };
+    for (int i = 0; i < (int)(sizeof(factors) / sizeof(factors[0])); i++) {
+        DownCtx c;
+        c.k = factors[i];
+        c.size = 240;
+        int srcSize = c.size * c.k;
+        uint8_t* src = alloc_pixels(srcSize, srcSize);
+        c.dst = alloc_pixels(c.size, c.size);
+        c.acc = (uint32_t*)alloc_pixels(c.size * 4, 1);
+        fill_noise(src, (size_t)srcSize * srcSize * 4, (uint32_t)srcSize);
+        c.src = src;
+        double px = (double)srcSize * srcSize;
+        double bytes = px * 4 + (double)c.size * c.size * 4;
+        record("downsample", c.size, c.k, px, bytes, run_downsample, &c);
+        if (c.k == 4) g_zoomOut4Ms = g_results[g_resultCount - 1].ns / 1e6;
+        record("downsample_c", c.size, c.k, px, bytes, run_downsample_generic, &c);
+        free(src);
+        free(c.dst);
+        free(c.acc);
+    }
+    printf("4x zoom-out, 960x960 source into a 240 px loupe: %.2f ms per frame (%s)\n", g_zoomOut4Ms,
+           DOWNSAMPLE_SSE2 ? "sse2" : "portable");
+}
+
+typedef struct MipCtx {
+    MipPyramid mip;
+    const uint8_t* cap;
+    int srcSize, levels;
+    double scale;
+} MipCtx;
+
+static void run_mip_build(void* p) {
+    MipCtx* c = (MipCtx*)p;
+    c->mip.tilesValid = 0;
+    mip_update(&c->mip, c->cap, (c->srcSize << (c->levels - 1)) * 4, c->srcSize, c->levels);
+}
+
+static void run_mip_update(void* p) {
+    MipCtx* c = (MipCtx*)p;
+    mip_update(&c->mip, c->cap, (c->srcSize << (c->levels - 1)) * 4, c->srcSize, c->levels);
+}
+
+static void run_mip_sample(void* p) {
+    MipCtx* c = (MipCtx*)p;
+    g_sink += mip_sample(&c->mip, c->scale, c->srcSize)[0];
+}
+
+// Wheel zoom on the default loupe between 1/2 and 1/4: three levels over a
+// 956 px capture.
+static double g_mipBuildMs = -1.0;
+static double g_mipWheelMs = -1.0;
+
+static void bench_mip(void) {
+    MipCtx c;
+    memset(&c, 0, sizeof(c));
+    c.srcSize = 239;
+    c.scale = 2.8284271247461903;
+    c.levels = mip_levels_for_scale(c.scale);
+    int size0 = c.srcSize << (c.levels - 1);
+    uint8_t* cap = alloc_pixels(size0, size0);
+    fill_noise(cap, (size_t)size0 * size0 * 4, (uint32_t)size0);
+    c.cap = cap;
+    if (!mip_reserve(&c.mip, c.srcSize, c.levels)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    double px = (double)size0 * size0;
+    double out = (double)c.srcSize * c.srcSize;
+    record("mip_build", c.srcSize, 4, px, px * 4 * 1.25 + px, run_mip_build, &c);
+    g_mipBuildMs = g_results[g_resultCount - 1].ns / 1e6;
+    record("mip_update", c.srcSize, 4, px, px * 4, run_mip_update, &c);
+    double updateMs = g_results[g_resultCount - 1].ns / 1e6;
+    record("mip_sample", c.srcSize, 4, out, out * 4 * 3, run_mip_sample, &c);
+    g_mipWheelMs = updateMs + g_results[g_resultCount - 1].ns / 1e6;
+    printf("wheel notch at zoom 1/2.83, 956 px capture: pyramid build %.2f ms, still-content notch %.3f ms\n",
+           g_mipBuildMs, g_mipWheelMs);
+    mip_free(&c.mip);
+    free(cap);
+}
+
+typedef struct FillCtx {
+    FillMap map;
+    uint8_t* px;
+    int w, h;
+} FillCtx;
+
+static double g_fill4kMs = -1.0;
+
+static void run_fill(void* p) {
+    FillCtx* c = (FillCtx*)p;
+    FillResult r;
+    flood_fill_bgra(&c->map, c->px, c->w, c->h, c->w * 4, c->w / 2, c->h / 2, 0, &r);
+    g_sink += r.area;
+}
+
+static void run_fill_c(void* p) {
+    FillCtx* c = (FillCtx*)p;
+    FillResult r;
+    flood_fill_bgra_generic(&c->map, c->px, c->w, c->h, c->w * 4, c->w / 2, c->h / 2, 0, &r);
+    g_sink += r.area;
+}
+
+static void bench_fill(void) {
+    FillCtx c;
+    memset(&c, 0, sizeof(c));
+    c.w = 3840;
+    c.h = 2160;
+    c.px = alloc_pixels(c.w, c.h);
+    uint32_t* px = (uint32_t*)c.px;
+    for (size_t i = 0; i < (size_t)c.w * c.h; i++) px[i] = 0xFF202428u;
+    if (!fill_reserve(&c.map, c.w, c.h)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    double n = (double)c.w * c.h;
+    record("fill", c.w, 0, n, n * 5, run_fill, &c);
+    g_fill4kMs = g_results[g_resultCount - 1].ns / 1e6;
+    record("fill_c", c.w, 0, n, n * 5, run_fill_c, &c);
+
+    // A 2..9 px hole of another colour in every 16x16 cell: one large region
+    // around about 32,000 holes, so the fill stops at many edges.
+    uint32_t seed = 0xF111;
+    for (int y = 0; y < c.h; y += 16) {
+        for (int x = 0; x < c.w; x += 16) {
+            seed = seed * 1664525u + 1013904223u;
+            int hx = x + (int)((seed >> 8) & 7), hy = y + (int)((seed >> 12) & 7);
+            int hw = 2 + (int)((seed >> 16) & 7), hh = 2 + (int)((seed >> 20) & 7);
+            uint32_t colour = (seed >> 31) ? 0xFF303438u : 0xFF101418u;
+            if (x == c.w / 2 / 16 * 16 && y == c.h / 2 / 16 * 16) continue;  // keep the seed
+            for (int yy = hy; yy < hy + hh && yy < c.h; yy++) {
+                for (int xx = hx; xx < hx + hw && xx < c.w; xx++) px[(size_t)yy * c.w + xx] = colour;
+            }
+        }
+    }
+    record("fill_blobs", c.w, 0, n, n * 5, run_fill, &c);
+    printf("region measurement, solid 3840x2160 frame: %.2f ms\n", g_fill4kMs);
+    fill_free(&c.map);
+    free(c.px);
+}
+
+typedef struct RulerCtx {
+    RulerCache cache;
+    uint8_t* px;
+    int w, h;
+} RulerCtx;
+
+static double g_ruler8kMs = -1.0;
+
+static void run_ruler(void* p) {
+    RulerCtx* c = (RulerCtx*)p;
+    RulerResult r;
+    ruler_measure(&c->cache, c->px, c->w, c->h, c->w * 4, c->w / 2, c->h / 2, 0, &r);
+    g_sink += (uint64_t)r.left + (uint64_t)r.down;
+}
+
+static void run_ruler_c(void* p) {
+    RulerCtx* c = (RulerCtx*)p;
+    RulerResult r;
+    ruler_measure_generic(&c->cache, c->px, c->w, c->h, c->w * 4, c->w / 2, c->h / 2, 0, &r);
+    g_sink += (uint64_t)r.left + (uint64_t)r.down;
+}
+
+static void bench_ruler(void) {
+    RulerCtx c;
+    memset(&c, 0, sizeof(c));
+    c.w = 7680;
+    c.h = 4320;
+    c.px = alloc_pixels(c.w, c.h);
+    uint32_t* px = (uint32_t*)c.px;
+    for (size_t i = 0; i < (size_t)c.w * c.h; i++) px[i] = 0xFF202428u;
+    if (!ruler_reserve(&c.cache, c.h)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    // Read: the row once, the band once and its transposed copy once.
+    double n = (double)c.w + c.h;
+    double bytes = ((double)c.w + (double)c.h * RULER_BAND * 3) * 4;
+    record("ruler", c.w, 0, n, bytes, run_ruler, &c);
+    g_ruler8kMs = g_results[g_resultCount - 1].ns / 1e6;
+    record("ruler_c", c.w, 0, n, bytes, run_ruler_c, &c);
+    printf("pixel ruler, solid 7680x4320 frame: %.3f ms\n", g_ruler8kMs);
+    ruler_free(&c.cache);
+    free(c.px);
+}
+
+typedef struct WatchCtx {
+    WatchSet set;
+    uint8_t* buf;  // the packed regions
+} WatchCtx;
+
+static double g_watch10kUs = -1.0;
+
+static void run_watch(void* p) {
+    WatchCtx* c = (WatchCtx*)p;
+    g_sink += (uint64_t)watch_check(&c->set, c->buf, 8);
+}
+
+static void run_watch_c(void* p) {
+    WatchCtx* c = (WatchCtx*)p;
+    g_sink += (uint64_t)watch_check_generic(&c->set, c->buf, 8);
+}
+
+// 10,000 watchpoints scattered over a 3840x2160 screen: the check alone,
+// per tick, with nothing changing.
+static void bench_watch(void) {
+    enum { N = 10000 };
+    static int xs[N], ys[N];
+    uint32_t seed = 0x3A7C;
+    for (int i = 0; i < N; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        xs[i] = (int)((seed >> 8) % 3840u);
+        seed = seed * 1664525u + 1013904223u;
+        ys[i] = (int)((seed >> 8) % 2160u);
+    }
+    WatchCtx c;
+    memset(&c, 0, sizeof(c));
+    if (!watch_plan(&c.set, xs, ys, N, WATCH_CELL, REGION_GRAB_COST, 0)) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    c.buf = (uint8_t*)malloc(c.set.pixels * 4);
+    if (!c.buf) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    fill_noise(c.buf, c.set.pixels * 4, 3840);
+    watch_check(&c.set, c.buf, 8);  // the baseline
+    // Read: one pixel, its index and its reference per point.
+    record("watch", 0, 0, N, (double)N * 12, run_watch, &c);
+    g_watch10kUs = g_results[g_resultCount - 1].ns / 1e3;
+    record("watch_c", 0, 0, N, (double)N * 12, run_watch_c, &c);
+    printf("pixel watchpoints, %d points in %d regions: %.2f us per check\n", N, c.set.regionCount, g_watch10kUs);
+    watch_free(&c.set);
+    free(c.buf);
+}
+
+typedef struct OnionCtx {
+    Ctx c;
+    LoupeFilter filter;
+} OnionCtx;
+
+static double g_onionOverhead = -1.0;
+static double g_amplifyOverhead = -1.0;
+
+static void run_scale_filtered(void* p) {
+    OnionCtx* o = (OnionCtx*)p;
+    Ctx* c = &o->c;
+    int d = c->radius * 2;
+    filter_scale_rows(&o->filter, c->cap, c->capSize, c->capSize * 4, c->dst, d, d * 4, 0, d);
+}
+
+static void run_compose_onion(void* p) {
+    OnionCtx* o = (OnionCtx*)p;
+    Ctx* c = &o->c;
+    compose_loupe_filtered_rows(&o->filter, c->cap, c->capSize, c->capSize * 4, c->dst, c->radius,
+                                c->radius * 2 * 4, 2, 1, 6, 0, c->radius * 2);
+}
+
+// The 960 px loupe at zoom 8 with the reference blended over it and with
+// their difference, against the plain compose: the filter runs once per
+// capture pixel inside the scale.
+static void bench_onion(void) {
+    OnionCtx o;
+    memset(&o, 0, sizeof(o));
+    int d = 960, z = 8;
+    double px = (double)d * d;
+    o.c.radius = d / 2;
+    o.c.capSize = odd(d / z);
+    o.c.dst = alloc_pixels(d, d);
+    o.c.cap = alloc_pixels(o.c.capSize, o.c.capSize);
+    uint8_t* ref = alloc_pixels(o.c.capSize, o.c.capSize);
+    fill_noise(o.c.cap, (size_t)o.c.capSize * o.c.capSize * 4, 0x0510);
+    fill_noise(ref, (size_t)o.c.capSize * o.c.capSize * 4, 0x0511);
+    double capBytes = (double)o.c.capSize * o.c.capSize * 4;
+    o.filter.ref = ref;
+    o.filter.refStride = o.c.capSize * 4;
+    o.filter.opacity = 64;
+
+    record("compose", d, z, px, px * 4 * 3 + capBytes, run_compose, &o.c);
+    double plain = g_results[g_resultCount - 1].ns;
+    o.filter.mode = LOUPE_FILTER_BLEND;
+    record("compose_onion", d, z, px, px * 4 * 3 + capBytes * 2, run_compose_onion, &o);
+    g_onionOverhead = g_results[g_resultCount - 1].ns / plain;
+    o.filter.mode = LOUPE_FILTER_DIFF;
+    record("compose_diff", d, z, px, px * 4 * 3 + capBytes * 2, run_compose_onion, &o);
+    printf("onion skin at d=%d zoom=%d: %.2fx the plain compose\n", d, z, g_onionOverhead);
+
+    record("scale", d, z, px, px * 4 + capBytes, run_scale, &o.c);
+    double copy = g_results[g_resultCount - 1].ns;
+    filter_amplify(&o.filter, 0xFFFEFEFEu, 8);
+    record("scale_amplify", d, z, px, px * 4 + capBytes, run_scale_filtered, &o);
+    g_amplifyOverhead = g_results[g_resultCount - 1].ns / copy;
+    printf("difference amplifier at d=%d zoom=%d: %.2fx the plain copy\n", d, z, g_amplifyOverhead);
+    free(o.c.dst);
+    free(o.c.cap);
+    free(ref);
+}
+
+// Process CPU time (all threads) for 60 pooled composes of a 2048 px loupe at
+// zoom 8: the share of one core a giant loupe costs at 60 fps.
+static double g_giantCoreFraction = -1.0;
+
+static void measure_giant_loupe(void) {
+    Ctx c;
+    memset(&c, 0, sizeof(c));
+    c.radius = 1024;
+    c.capSize = odd(2048 / 8);
+    c.cap = alloc_pixels(c.capSize, c.capSize);
+    c.dst = alloc_pixels(2048, 2048);
+    fill_noise(c.cap, (size_t)c.capSize * c.capSize * 4, 2048);
+    run_compose_pool(&c);
+
+    double best = 1e300;
+    for (int b = 0; b < (g_quick ? 2 : 5); b++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t0);
+        for (int i = 0; i < 60; i++) run_compose_pool(&c);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t1);
+        double sec = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+        if (sec < best) best = sec;
+    }
+    g_giantCoreFraction = best;
+    printf("2048 px loupe, zoom 8, 60 fps on %d+1 thread(s): %.2f of one core for compose\n",
+           g_pool.threads, g_giantCoreFraction);
+    free(c.cap);
+    free(c.dst);
+}
+
+// Per-frame cost with N loupes, in microseconds.
+#define MULTI_MAX 8
+static double g_multiStill[MULTI_MAX + 1];
+static double g_multiLive[MULTI_MAX + 1];
+
+enum { kScreenW = 1920, kScreenH = 1080, kMultiRadius = 120, kMultiCap = 31 };
+
+typedef struct MultiCtx {
+    const uint8_t* screen;   // kScreenW x kScreenH BGRA
+    uint8_t* shared;         // packed grabs
+    uint8_t* dst[MULTI_MAX];
+    uint64_t drawn[MULTI_MAX];
+    RegionRect squares[MULTI_MAX];
+    int loupes;
+    int live;                // pins move by a pixel every frame
+    int frame;
+} MultiCtx;
+
+static void run_multi_frame(void* p) {
+    MultiCtx* m = (MultiCtx*)p;
+    int half = kMultiCap / 2;
+    // Cursor loupe last, dragging slowly; pins spread over the screen.
+    for (int i = 0; i < m->loupes; i++) {
+        int cursor = i == m->loupes - 1;
+        int cx = cursor ? 400 + m->frame % 200 : 200 + i * 220;
+        int cy = cursor ? 300 : 150 + (i % 3) * 300;
+        if (m->live && !cursor) cx += m->frame & 1;
+        RegionRect r = { cx - half, cy - half, kMultiCap, kMultiCap };
+        m->squares[i] = r;
+    }
+    m->frame++;
+
+    RegionPlan plan;
+    region_plan(&plan, m->squares, m->loupes, REGION_GRAB_COST, (int64_t)kScreenW * kScreenH);
+    for (int g = 0; g < plan.count; g++) {
+        const RegionRect* r = &plan.grabs[g];
+        for (int y = 0; y < r->h; y++) {
+            memcpy(m->shared + (plan.offset[g] + (size_t)y * r->w) * 4,
+                   m->screen + ((size_t)(r->y + y) * kScreenW + r->x) * 4, (size_t)r->w * 4);
+        }
+    }
+
+    LoupeJob jobs[MULTI_MAX];
+    int n = 0;
+    for (int i = 0; i < m->loupes; i++) {
+        int stride;
+        const uint8_t* cap = region_view(&plan, m->shared, m->squares, i, &stride);
+        if (i < m->loupes - 1) {
+            uint64_t h = hash_bgra(cap, kMultiCap, kMultiCap, stride);
+            if (h == m->drawn[i]) continue;
+            m->drawn[i] = h;
+        }
+        jobs[n++] = loupe_job(cap, kMultiCap, stride, m->dst[i], kMultiRadius, kMultiRadius * 8, 2, 1, 6);
+    }
+    compose_loupes_tiled(&g_pool, jobs, n);
+}
+
+static void measure_multi_loupe(void) {
+    MultiCtx m;
+    memset(&m, 0, sizeof(m));
+    uint8_t* screen = alloc_pixels(kScreenW, kScreenH);
+    m.shared = alloc_pixels(kScreenW, kScreenH);
+    fill_noise(screen, (size_t)kScreenW * kScreenH * 4, 1920);
+    m.screen = screen;
+    for (int i = 0; i < MULTI_MAX; i++) m.dst[i] = alloc_pixels(kMultiRadius * 2, kMultiRadius * 2);
+
+    printf("pinned loupes (d=%d, zoom 8, %d+1 thread(s)), us per frame:\n", kMultiRadius * 2, g_pool.threads);
+    for (int n = 1; n <= MULTI_MAX; n++) {
+        double ns, cycles;
+        PerfSample ps;
+        m.loupes = n;
+        m.live = 0;
+        memset(m.drawn, 0, sizeof(m.drawn));
+        measure(run_multi_frame, &m, 1.0, &ns, &cycles, &ps);
+        g_multiStill[n] = ns / 1000.0;
+        m.live = 1;
+        measure(run_multi_frame, &m, 1.0, &ns, &cycles, &ps);
+        g_multiLive[n] = ns / 1000.0;
+        printf("  %d loupe(s): still pins %8.1f   live pins %8.1f\n", n, g_multiStill[n], g_multiLive[n]);
+    }
+    free(screen);
+    free(m.shared);
+    for (int i = 0; i < MULTI_MAX; i++) free(m.dst[i]);
+}
+
+// Full-frame histogram on 1..POOL_MAX_SLOTS participants.
+enum { kFrameW = 7680, kFrameH = 4320, kHistBins = 4096 };
+
+static double g_scaleMs[POOL_MAX_SLOTS + 1];
+static double g_scaleSteals[POOL_MAX_SLOTS + 1];
+static int g_scaleMax;
+
+typedef struct HistCtx {
+    const uint8_t* frame;
+    WorkerPool* pool;
+    uint32_t partial[POOL_MAX_SLOTS][kHistBins];
+    uint32_t hist[kHistBins];
+} HistCtx;
+
+static void hist_tile(void* p, int slot, int x, int y, int w, int h) {
+    HistCtx* c = (HistCtx*)p;
+    uint32_t* bins = c->partial[slot];
+    for (int j = y; j < y + h; j++) {
+        const uint8_t* px = c->frame + ((size_t)j * kFrameW + x) * 4;
+        for (int i = 0; i < w; i++, px += 4) bins[((px[2] >> 4) << 8) | ((px[1] >> 4) << 4) | (px[0] >> 4)]++;
+    }
+}
+
+static void run_histogram(void* p) {
+    HistCtx* c = (HistCtx*)p;
+    int slots = pool_slots(c->pool);
+    memset(c->partial, 0, sizeof(c->partial[0]) * slots);
+    pool_run_tiles(c->pool, hist_tile, c, kFrameW, kFrameH, POOL_TILE);
+    for (int b = 0; b < kHistBins; b++) {
+        uint32_t sum = 0;
+        for (int s = 0; s < slots; s++) sum += c->partial[s][b];
+        c->hist[b] = sum;
+    }
+    g_sink += c->hist[c->hist[0] & (kHistBins - 1)];
+}
+
+static void measure_pool_scaling(void) {
+    HistCtx* c = (HistCtx*)calloc(1, sizeof(HistCtx));
+    uint8_t* frame = alloc_pixels(kFrameW, kFrameH);
+    if (!c || !frame) {
+        free(c);
+        free(frame);
+        return;
+    }
+    fill_noise(frame, (size_t)kFrameW * kFrameH * 4, 8192);
+    c->frame = frame;
+    int most = pool_default_threads() > g_pool.threads ? pool_default_threads() : g_pool.threads;
+    g_scaleMax = most + 1 > POOL_MAX_SLOTS ? POOL_MAX_SLOTS : most + 1;
+    uint64_t tilesPerFrame =
+        (uint64_t)((kFrameW + POOL_TILE - 1) / POOL_TILE) * ((kFrameH + POOL_TILE - 1) / POOL_TILE);
+
+    printf("pool scaling, %dx%d histogram in %d px tiles:\n", kFrameW, kFrameH, POOL_TILE);
+    for (int n = 1; n <= g_scaleMax; n++) {
+        WorkerPool pool;
+        pool_init(&pool, n - 1);
+        c->pool = &pool;
+        double ns, cycles;
+        PerfSample ps;
+        measure(run_histogram, c, (double)kFrameW * kFrameH, &ns, &cycles, &ps);
+        g_scaleMs[n] = ns / 1e6;
+        g_scaleSteals[n] = pool.tiles ? (double)pool.steals * tilesPerFrame / (double)pool.tiles : 0.0;
+        double speedup = g_scaleMs[1] / g_scaleMs[n];
+        printf("  %d thread(s): %8.2f ms/frame  x%.2f  efficiency %3.0f%%  %.1f steals/frame\n", n, g_scaleMs[n],
+               speedup, 100.0 * speedup / n, g_scaleSteals[n]);
+        pool_destroy(&pool);
+    }
+    free(frame);
+    free(c);
+}
+
+// ----------------------
+// Output
+// ----------------------
+
+// Counter-derived values are negative when not counted; JSON gets null.
+static void write_json_number(FILE* fp, const char* key, double v) {
+    if (v < 0.0) fprintf(fp, "\"%s\":null,", key);
+    else fprintf(fp, "\"%s\":%.6f,", key, v);
+}
+
+static int write_json(const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
+    fprintf(fp, "{\n  \"tsc\": %s,\n  \"perf_counters\": %s,\n", HAVE_TSC ? "true" : "false",
+            g_perf.available ? "true" : "false");
+    fprintf(fp, "  \"zoom_out_4x_ms\": %.4f,\n", g_zoomOut4Ms);
+    fprintf(fp, "  \"mip_build_ms\": %.4f,\n  \"mip_wheel_step_ms\": %.4f,\n", g_mipBuildMs, g_mipWheelMs);
+    fprintf(fp, "  \"fill_4k_ms\": %.4f,\n", g_fill4kMs);
+    fprintf(fp, "  \"ruler_8k_ms\": %.4f,\n", g_ruler8kMs);
+    fprintf(fp, "  \"watch_10k_us\": %.3f,\n", g_watch10kUs);
+    fprintf(fp, "  \"onion_overhead\": %.3f,\n", g_onionOverhead);
+    fprintf(fp, "  \"amplify_overhead\": %.3f,\n", g_amplifyOverhead);
+    fprintf(fp, "  \"pool_threads\": %d,\n  \"giant_loupe_core_fraction\": %.4f,\n", g_pool.threads,
+            g_giantCoreFraction);
+    fprintf(fp, "  \"pinned_loupes\": [");
+    for (int n = 1; n <= MULTI_MAX; n++) {
+        fprintf(fp, "{\"loupes\":%d,\"still_us_per_frame\":%.2f,\"live_us_per_frame\":%.2f}%s", n,
+                g_multiStill[n], g_multiLive[n], n < MULTI_MAX ? "," : "");
+    }
+    fprintf(fp, "],\n");
+    fprintf(fp, "  \"pool_scaling\": [");
+    for (int n = 1; n <= g_scaleMax; n++) {
+        fprintf(fp, "{\"threads\":%d,\"ms_per_frame\":%.3f,\"speedup\":%.3f,\"steals_per_frame\":%.1f}%s", n,
+                g_scaleMs[n], g_scaleMs[1] / g_scaleMs[n], g_scaleSteals[n], n < g_scaleMax ? "," : "");
+    }
+    fprintf(fp, "],\n");
+    if (!g_perf.available) fprintf(fp, "  \"perf_counters_reason\": \"%s\",\n", g_perf.reason ? g_perf.reason : "");
+    fprintf(fp, "  \"results\": [\n");
+    for (int i = 0; i < g_resultCount; i++) {
+        const Result* r = &g_results[i];
+        fprintf(fp, "    {\"kernel\":\"%s\",\"diameter\":%d,\"zoom\":%d,\"ns_per_call\":%.1f,"
+                    "\"ns_per_pixel\":%.4f,",
+                r->kernel, r->diameter, r->zoom, r->ns, r->ns / r->pixels);
+        if (HAVE_TSC) fprintf(fp, "\"cycles_per_pixel\":%.4f,", r->cycles / r->pixels);
+        else fprintf(fp, "\"cycles_per_pixel\":null,");
+        fprintf(fp, "\"gb_per_s\":%.3f,", r->bytes / r->ns);
+        write_json_number(fp, "ipc", perf_ipc(&r->perf));
+        write_json_number(fp, "instructions_per_pixel", perf_per_pixel(&r->perf, PERF_INSTRUCTIONS));
+        write_json_number(fp, "cache_misses_per_pixel", perf_per_pixel(&r->perf, PERF_CACHE_MISSES));
+        fprintf(fp, "\"branch_misses_per_pixel\":");
+        if (perf_per_pixel(&r->perf, PERF_BRANCH_MISSES) < 0.0) fprintf(fp, "null");
+        else fprintf(fp, "%.6f", perf_per_pixel(&r->perf, PERF_BRANCH_MISSES));
+        fprintf(fp, "}%s\n", i + 1 < g_resultCount ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = "bench_results.json";
+    int counters = 1;
+    int threads = -1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            g_quick = 1;
+        } else if (strcmp(argv[i], "--no-counters") == 0) {
+            counters = 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--quick] [--no-counters] [--threads N] [--json out.json]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    perf_counters_init(&g_perf);
+    if (counters && !perf_counters_open(&g_perf)) {
+        printf("hardware counters unavailable (%s); reporting wall time only\n", g_perf.reason);
+    }
+    pool_init(&g_serial, 0);
+    pool_init(&g_pool, threads < 0 ? pool_default_threads() : threads);
+    printf("worker pool: %d thread(s) + caller\n", g_pool.threads);
+
+    g_scopePanel = (uint8_t*)malloc((size_t)SCOPE_PANEL_W * SCOPE_PANEL_H * 4);
+    static const int diameters[] = { 240, 480, 960, 1440, 2048 };
+    static const int zooms[] = { 2, 4, 8, 16 };
+    const int nd = g_quick ? 2 : (int)(sizeof(diameters) / sizeof(diameters[0]));
+
+    for (int di = 0; di < nd; di++) {
+        int d = diameters[di];
+        double px = (double)d * d;
+        Ctx c;
+        memset(&c, 0, sizeof(c));
+        c.radius = d / 2;
+        c.dst = alloc_pixels(d, d);
+
+        for (int zi = 0; zi < (int)(sizeof(zooms) / sizeof(zooms[0])); zi++) {
+            int z = zooms[zi];
+            c.capSize = odd(d / z);
+            c.cap = alloc_pixels(c.capSize, c.capSize);
+            fill_noise(c.cap, (size_t)c.capSize * c.capSize * 4, (uint32_t)(d + z));
+            double capBytes = (double)c.capSize * c.capSize * 4;
+
+            record("scale", d, z, px, px * 4 + capBytes, run_scale, &c);
+            record("compose", d, z, px, px * 4 * 3 + capBytes, run_compose, &c);
+            record("compose_tiled", d, z, px, px * 4 * 3 + capBytes, run_compose_tiled, &c);
+            record("compose_pool", d, z, px, px * 4 * 3 + capBytes, run_compose_pool, &c);
+            if (damage_reserve(&g_patchDamage, c.capSize, c.capSize)) {
+                damage_update(&g_patchDamage, c.cap, c.capSize, c.capSize, c.capSize * 4);
+                record("compose_patch", d, z, px, capBytes, run_compose_patch, &c);
+            }
+            record("pick", d, z, 64 * 25, 64 * 25 * 4, run_pick, &c);
+
+            free(c.cap);
+            c.cap = NULL;
+        }
+
+        // Zoom-independent kernels run on a magnified noise frame.
+        fill_noise(c.dst, (size_t)d * d * 4, (uint32_t)d);
+        record("mask", d, 0, px, px * 4 * 2, run_mask, &c);
+        record("blend", d, 0, px, px * 4 * 2, run_blend, &c);
+        record("hash", d, 0, px, px * 4, run_hash, &c);
+        if (damage_reserve(&g_damage, d, d)) {
+            record("damage", d, 0, px, px * 4, run_damage, &c);
+            record("damage_c", d, 0, px, px * 4, run_damage_c, &c);
+        }
+        if (g_scopePanel && scope_reserve(&g_scope, pool_slots(&g_pool), d)) {
+            record("scope", d, 0, px, px * 4, run_scope, &c);
+            record("scope_pool", d, 0, px, px * 4, run_scope_pool, &c);
+            record("scope_c", d, 0, px, px * 4, run_scope_c, &c);
+            double panel = (double)SCOPE_PANEL_W * SCOPE_PANEL_H;
+            record("scope_render", d, 0, panel, panel * 4 + 2.0 * sizeof(uint32_t) * SCOPE_LEVELS * SCOPE_LEVELS,
+                   run_scope_render, &c);
+        }
+        record("hex", d, 0, px, px * 4, run_hex, &c);
+
+        free(c.dst);
+    }
+
+    bench_downsample();
+    bench_mip();
+    bench_fill();
+    bench_ruler();
+    bench_watch();
+    bench_onion();
+    measure_giant_loupe();
+    measure_multi_loupe();
+    measure_pool_scaling();
+    pool_destroy(&g_pool);
+    pool_destroy(&g_serial);
+    damage_free(&g_damage);
+    damage_free(&g_patchDamage);
+    scope_free(&g_scope);
+    free(g_scopePanel);
+    int ok = write_json(jsonPath);
+    perf_counters_close(&g_perf);
+    if (!ok) return 1;
+    printf("Wrote %s\n", jsonPath);
+    return 0;
+}
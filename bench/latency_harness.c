@@ -0,0 +1,451 @@
+// Minimal Color Picker - end-to-end latency harness (X11 / Xvfb).
+// Build/run: make latency     (starts a private Xvfb, see bench/run_latency.sh)
+//            bench/latency_harness --picker ./color_picker_linux [--trials N] [--json out.json]
+//
+// Measures how long it takes until the loupe shows a change, from the moment
+// the X server has applied it:
+// - "screen": the cursor is parked and a marker colour is painted under it.
+// - "cursor": the cursor is warped onto a cell of a uniquely coloured grid.
+// Completion is detected by reading back the loupe window's centre pixel.
+// With a second X screen (XVFB_SCREENS=2 bench/run_latency.sh) two more run:
+// - "cross": the cursor is warped onto the other screen, onto a freshly
+//   painted colour; the loupe window on that screen must show it.
+// - "straddle": the cursor sits 2 px from screen 0's right edge and screen 1's
+//   left edge is repainted; the loupe must show it 4 source pixels right of
+//   centre, i.e. the capture is stitched across the two screens.
+// Both scenarios run against the fixed-tick path and the --event-driven path
+// (with idle parking off), and against the default path with parking on,
+// where a still cursor only sees screen changes at the damage poll.
+//
+// Pointer moves use XWarpPointer, which the server delivers to the picker's
+// pointer grab as ordinary motion (no XTest dependency).
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_TRIALS 2000
+#define TIMEOUT_MS 1000.0
+#define LOUPE_RADIUS 120
+#define LOUPE_ZOOM 8
+#define CELL 16
+#define BAND_ROWS 2
+
+typedef struct Stats {
+    const char* mode;
+    const char* scenario;
+    int samples;
+    int timeouts;
+    double p50, p90, p99, mean, max;
+} Stats;
+
+static Display* g_dpy;
+static int g_screen;
+static Window g_root;
+static Window g_canvas;
+static GC g_gc;
+static int g_sw, g_sh;
+
+// Second screen, when the server has one.
+static Window g_root1;
+static Window g_canvas1;
+static GC g_gc1;
+static int g_sw1, g_sh1;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static void sleep_ms(double ms) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int n, double p) {
+    if (n == 0) return 0.0;
+    int i = (int)(p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+static void fill(unsigned long rgb, int x, int y, int w, int h) {
+    XSetForeground(g_dpy, g_gc, rgb);
+    XFillRectangle(g_dpy, g_canvas, g_gc, x, y, (unsigned)w, (unsigned)h);
+}
+
+static void fill1(unsigned long rgb, int x, int y, int w, int h) {
+    XSetForeground(g_dpy, g_gc1, rgb);
+    XFillRectangle(g_dpy, g_canvas1, g_gc1, x, y, (unsigned)w, (unsigned)h);
+}
+
+// Reading back a loupe window that is not mapped (yet) is a BadMatch; those
+// reads just count as "not there yet".
+static int ignore_x_error(Display* dpy, XErrorEvent* ev) {
+    (void)dpy;
+    (void)ev;
+    return 0;
+}
+
+// Grid cells sit in a thin horizontal band so the loupe (placed 40 px below
+// and right of the cursor) never covers the cell being captured.
+static int band_columns(void) { return (g_sw - 320) / CELL; }
+static int band_top(void) { return g_sh / 2; }
+
+static unsigned long cell_color(int idx) {
+    unsigned r = 0x20 + (unsigned)(idx & 0x3F) * 3;
+    unsigned g = 0x40 + (unsigned)((idx >> 6) & 0x3F) * 3;
+    return (r << 16) | (g << 8) | 0xA0;
+}
+
+static void draw_canvas(void) {
+    fill(0x808080, 0, 0, g_sw, g_sh);
+    int cols = band_columns();
+    for (int row = 0; row < BAND_ROWS; row++) {
+        for (int col = 0; col < cols; col++) {
+            fill(cell_color(row * cols + col), 32 + col * CELL, band_top() + row * CELL, CELL, CELL);
+        }
+    }
+    XSync(g_dpy, False);
+}
+
+static Window find_window_named(Window w, const char* name) {
+    char* wn = NULL;
+    if (XFetchName(g_dpy, w, &wn) && wn) {
+        int match = strcmp(wn, name) == 0;
+        XFree(wn);
+        if (match) return w;
+    }
+    Window rootRet, parent, *children = NULL;
+    unsigned int n = 0;
+    Window found = 0;
+    if (XQueryTree(g_dpy, w, &rootRet, &parent, &children, &n)) {
+        for (unsigned int i = 0; i < n && !found; i++) found = find_window_named(children[i], name);
+        if (children) XFree(children);
+    }
+    return found;
+}
+
+static int loupe_pixel_rgb(Window loupe, int x, unsigned long* rgb) {
+    XImage* img = XGetImage(g_dpy, loupe, x, LOUPE_RADIUS - 1, 1, 1, AllPlanes, ZPixmap);
+    if (!img) return 0;
+    *rgb = XGetPixel(img, 0, 0) & 0xFFFFFF;
+    XDestroyImage(img);
+    return 1;
+}
+
+// Loupe x of the middle of the source pixel `k` columns right of the centre.
+static int loupe_column(int k) {
+    int d = LOUPE_RADIUS * 2;
+    int capSize = (d / LOUPE_ZOOM) | 1;
+    int sx = capSize / 2 + k;
+    int x0 = (sx * d + capSize - 1) / capSize;
+    int x1 = ((sx + 1) * d + capSize - 1) / capSize;
+    return (x0 + x1) / 2;
+}
+
+// Polls loupe column `x` until it shows `want`; returns ms since t0 or -1.
+static double wait_for_pixel(Window loupe, int x, unsigned long want, double t0) {
+    for (;;) {
+        unsigned long got;
+        if (loupe_pixel_rgb(loupe, x, &got) && got == want) return now_ms() - t0;
+        if (now_ms() - t0 > TIMEOUT_MS) return -1.0;
+        sleep_ms(0.1);
+    }
+}
+
+// Inside the centre marker, within the centre source pixel.
+static double wait_for_color(Window loupe, unsigned long want, double t0) {
+    return wait_for_pixel(loupe, LOUPE_RADIUS - 1, want, t0);
+}
+
+static void summarize(Stats* s, double* lat, int n) {
+    qsort(lat, (size_t)n, sizeof(double), cmp_double);
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += lat[i];
+    s->samples = n;
+    s->p50 = percentile(lat, n, 0.50);
+    s->p90 = percentile(lat, n, 0.90);
+    s->p99 = percentile(lat, n, 0.99);
+    s->mean = n ? sum / n : 0.0;
+    s->max = n ? lat[n - 1] : 0.0;
+}
+
+static void jitter(void) {
+    // Random phase relative to the picker's 16 ms tick.
+    sleep_ms(20.0 + (double)(rand() % 2000) / 100.0);
+}
+
+static void run_screen_scenario(Window loupe, int trials, Stats* s) {
+    static double lat[MAX_TRIALS];
+    int n = 0;
+    int px = g_sw / 2, py = g_sh / 4;
+
+    XWarpPointer(g_dpy, None, g_root, 0, 0, 0, 0, px, py);
+    XSync(g_dpy, False);
+    sleep_ms(100);
+
+    for (int i = 0; i < trials; i++) {
+        unsigned long color = (i & 1) ? 0xE01010 + (unsigned long)(i % 200) : 0x10E010 + (unsigned long)(i % 200);
+        jitter();
+        fill(color, px - 32, py - 32, 64, 64);
+        XSync(g_dpy, False);
+        double t0 = now_ms();
+        double ms = wait_for_color(loupe, color, t0);
+        if (ms < 0) s->timeouts++;
+        else lat[n++] = ms;
+    }
+    summarize(s, lat, n);
+}
+
+static void run_cursor_scenario(Window loupe, int trials, Stats* s) {
+    static double lat[MAX_TRIALS];
+    int n = 0;
+    int cols = band_columns();
+    int prev = -1;
+
+    for (int i = 0; i < trials; i++) {
+        int idx;
+        do {
+            idx = rand() % (cols * BAND_ROWS);
+        } while (idx == prev);
+        prev = idx;
+        int x = 32 + (idx % cols) * CELL + CELL / 2;
+        int y = band_top() + (idx / cols) * CELL + CELL / 2;
+
+        jitter();
+        XWarpPointer(g_dpy, None, g_root, 0, 0, 0, 0, x, y);
+        XSync(g_dpy, False);
+        double t0 = now_ms();
+        double ms = wait_for_color(loupe, cell_color(idx), t0);
+        if (ms < 0) s->timeouts++;
+        else lat[n++] = ms;
+    }
+    summarize(s, lat, n);
+}
+
+// Alternates the cursor between the two screens, painting a fresh colour at
+// the destination first so a stale loupe cannot match.
+static void run_cross_scenario(Window loupe0, Window loupe1, int trials, Stats* s) {
+    static double lat[MAX_TRIALS];
+    int n = 0;
+    for (int i = 0; i < trials; i++) {
+        int to1 = !(i & 1);
+        unsigned long color = 0x3060C0 + (unsigned long)(i % 200);
+        jitter();
+        if (to1) fill1(color, g_sw1 / 2 - 32, g_sh1 / 4 - 32, 64, 64);
+        else fill(color, g_sw / 2 - 32, g_sh / 4 - 32, 64, 64);
+        XSync(g_dpy, False);
+        XWarpPointer(g_dpy, None, to1 ? g_root1 : g_root, 0, 0, 0, 0, to1 ? g_sw1 / 2 : g_sw / 2,
+                     to1 ? g_sh1 / 4 : g_sh / 4);
+        XSync(g_dpy, False);
+        double t0 = now_ms();
+        double ms = wait_for_color(to1 ? loupe1 : loupe0, color, t0);
+        if (ms < 0) s->timeouts++;
+        else lat[n++] = ms;
+    }
+    summarize(s, lat, n);
+}
+
+static void run_straddle_scenario(Window loupe0, int trials, Stats* s) {
+    static double lat[MAX_TRIALS];
+    int n = 0;
+    int py = g_sh / 4;
+    XWarpPointer(g_dpy, None, g_root, 0, 0, 0, 0, g_sw - 2, py);
+    XSync(g_dpy, False);
+    sleep_ms(100);
+
+    for (int i = 0; i < trials; i++) {
+        unsigned long color = (i & 1) ? 0xC03060 + (unsigned long)(i % 200) : 0x60C030 + (unsigned long)(i % 200);
+        jitter();
+        fill1(color, 0, py - 32, 64, 64);
+        XSync(g_dpy, False);
+        double t0 = now_ms();
+        double ms = wait_for_pixel(loupe0, loupe_column(4), color, t0);
+        if (ms < 0) s->timeouts++;
+        else lat[n++] = ms;
+    }
+    summarize(s, lat, n);
+}
+
+static pid_t launch_picker(const char* picker, const char* mode) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (strcmp(mode, "event") == 0) execl(picker, picker, "--event-driven", "--no-park", (char*)NULL);
+        else if (strcmp(mode, "tick") == 0) execl(picker, picker, "--no-park", (char*)NULL);
+        else execl(picker, picker, (char*)NULL);
+        perror("exec picker");
+        _exit(127);
+    }
+    return pid;
+}
+
+static Window wait_for_loupe(Window root) {
+    double t0 = now_ms();
+    while (now_ms() - t0 < 5000.0) {
+        Window w = find_window_named(root, "MinimalColorPicker");
+        if (w) return w;
+        sleep_ms(20);
+    }
+    return 0;
+}
+
+static void print_stats(const Stats* s) {
+    printf("%-6s %-7s n=%-4d timeouts=%-3d p50=%7.2f ms  p90=%7.2f ms  p99=%7.2f ms  max=%7.2f ms\n",
+           s->mode, s->scenario, s->samples, s->timeouts, s->p50, s->p90, s->p99, s->max);
+}
+
+static int write_json(const char* path, const Stats* stats, int count) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
+    fprintf(fp, "{\n  \"screen\": \"%dx%d\",\n  \"screens\": %d,\n  \"results\": [\n", g_sw, g_sh,
+            ScreenCount(g_dpy));
+    for (int i = 0; i < count; i++) {
+        const Stats* s = &stats[i];
+        fprintf(fp, "    {\"mode\":\"%s\",\"scenario\":\"%s\",\"samples\":%d,\"timeouts\":%d,"
+                    "\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"mean_ms\":%.3f,\"max_ms\":%.3f}%s\n",
+                s->mode, s->scenario, s->samples, s->timeouts, s->p50, s->p90, s->p99, s->mean, s->max,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* picker = "./color_picker_linux";
+    const char* jsonPath = "latency_results.json";
+    int trials = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--picker") == 0 && i + 1 < argc) {
+            picker = argv[++i];
+        } else if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc) {
+            trials = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--picker PATH] [--trials N] [--json out.json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (trials < 1) trials = 1;
+    if (trials > MAX_TRIALS) trials = MAX_TRIALS;
+
+    // The server may still be starting up.
+    for (int i = 0; i < 100 && !g_dpy; i++) {
+        g_dpy = XOpenDisplay(NULL);
+        if (!g_dpy) sleep_ms(50);
+    }
+    if (!g_dpy) {
+        fprintf(stderr, "Cannot open display\n");
+        return 1;
+    }
+    g_screen = DefaultScreen(g_dpy);
+    g_root = RootWindow(g_dpy, g_screen);
+    g_sw = DisplayWidth(g_dpy, g_screen);
+    g_sh = DisplayHeight(g_dpy, g_screen);
+    srand(12345);
+    XSetErrorHandler(ignore_x_error);
+
+    XSetWindowAttributes attrs;
+    memset(&attrs, 0, sizeof(attrs));
+    attrs.override_redirect = True;
+    g_canvas = XCreateWindow(g_dpy, g_root, 0, 0, (unsigned)g_sw, (unsigned)g_sh, 0, CopyFromParent,
+                             InputOutput, CopyFromParent, CWOverrideRedirect, &attrs);
+    g_gc = XCreateGC(g_dpy, g_canvas, 0, NULL);
+    XMapRaised(g_dpy, g_canvas);
+    int multi = ScreenCount(g_dpy) > 1;
+    if (multi) {
+        g_root1 = RootWindow(g_dpy, 1);
+        g_sw1 = DisplayWidth(g_dpy, 1);
+        g_sh1 = DisplayHeight(g_dpy, 1);
+        g_canvas1 = XCreateWindow(g_dpy, g_root1, 0, 0, (unsigned)g_sw1, (unsigned)g_sh1, 0, CopyFromParent,
+                                  InputOutput, CopyFromParent, CWOverrideRedirect, &attrs);
+        g_gc1 = XCreateGC(g_dpy, g_canvas1, 0, NULL);
+        XMapRaised(g_dpy, g_canvas1);
+    }
+    XSync(g_dpy, False);
+    sleep_ms(50);
+    draw_canvas();
+    if (multi) fill1(0x404040, 0, 0, g_sw1, g_sh1);
+
+    static const char* modes[] = { "tick", "event", "park" };
+    Stats stats[12];
+    memset(stats, 0, sizeof(stats));
+    int count = 0;
+    int failed = 0;
+
+    for (int m = 0; m < 3; m++) {
+        pid_t pid = launch_picker(picker, modes[m]);
+        Window loupe = wait_for_loupe(g_root);
+        if (!loupe) {
+            fprintf(stderr, "Picker window did not appear (%s)\n", modes[m]);
+            kill(pid, SIGTERM);
+            waitpid(pid, NULL, 0);
+            failed = 1;
+            continue;
+        }
+        sleep_ms(200);
+
+        Stats* s = &stats[count++];
+        s->mode = modes[m];
+        s->scenario = "screen";
+        run_screen_scenario(loupe, trials, s);
+        print_stats(s);
+
+        draw_canvas();
+        s = &stats[count++];
+        s->mode = modes[m];
+        s->scenario = "cursor";
+        run_cursor_scenario(loupe, trials, s);
+        print_stats(s);
+
+        if (multi) {
+            // The screen-1 window exists (unmapped) from startup.
+            Window loupe1 = wait_for_loupe(g_root1);
+            s = &stats[count++];
+            s->mode = modes[m];
+            s->scenario = "cross";
+            if (loupe1) run_cross_scenario(loupe, loupe1, trials, s);
+            else failed = 1;
+            print_stats(s);
+
+            s = &stats[count++];
+            s->mode = modes[m];
+            s->scenario = "straddle";
+            run_straddle_scenario(loupe, trials, s);
+            print_stats(s);
+            fill1(0x404040, 0, 0, g_sw1, g_sh1);
+        }
+
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        draw_canvas();
+    }
+
+    if (!write_json(jsonPath, stats, count)) return 1;
+    printf("Wrote %s\n", jsonPath);
+    XCloseDisplay(g_dpy);
+    return failed;
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Runs the allocation-audit build of the Linux picker (color_picker_linux_audit)
+# on a private Xvfb, once per feature set that adds buffers to the frame path:
+# the plain loupe, pins and zoom-out (shared capture, mip pyramid), the ruler,
+# scopes and amplifier on the worker pool, the onion-skin reference, and watch
+# mode. Fails if any run exits with status 3 (a steady-state frame allocated)
+# or otherwise fails.
+# Usage: bench/run_audit.sh
+# Env: XVFB_DISPLAY (default :95), XVFB_SCREEN (default 1920x1080x24),
+#      AUDIT_FRAMES (frames per run, default 300)
+set -eu
+
+XVFB_DISPLAY=${XVFB_DISPLAY:-:95}
+XVFB_SCREEN=${XVFB_SCREEN:-1920x1080x24}
+AUDIT_FRAMES=${AUDIT_FRAMES:-300}
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo "Xvfb not found (install xvfb)" >&2
+    exit 1
+fi
+
+Xvfb "$XVFB_DISPLAY" -screen 0 "$XVFB_SCREEN" -nolisten tcp >/dev/null 2>&1 &
+XVFB_PID=$!
+TMP=$(mktemp -d)
+trap 'kill "$XVFB_PID" 2>/dev/null || true; rm -rf "$TMP"' EXIT INT TERM
+sleep 1
+
+# The reference's tile cache is written next to the PNG, so use a copy.
+cp bench/audit_reference.png "$TMP/reference.png"
+printf '# audit watch points\n10,10\n12,10\n900,500\n1900,1070\n' > "$TMP/points.txt"
+
+FAILED=0
+run() {
+    name=$1
+    shift
+    status=0
+    DISPLAY=$XVFB_DISPLAY ./color_picker_linux_audit --frames "$AUDIT_FRAMES" --no-park "$@" >/dev/null || status=$?
+    if [ "$status" -eq 3 ]; then
+        echo "audit $name: steady-state frames allocated"
+        FAILED=1
+    elif [ "$status" -ne 0 ]; then
+        echo "audit $name: exited with status $status"
+        FAILED=1
+    else
+        echo "audit $name: no allocations after warm-up"
+    fi
+}
+
+run loupe
+run pins --zoom 0.25 --pin 200,200 --pin 1500,800
+run tools --radius 400 --threads 2 --ruler --scope 0 --amplify --flash-damage
+run reference --reference "$TMP/reference.png" --reference-origin 800,400
+run watch --watch "$TMP/points.txt" --watch-rate 240
+
+exit "$FAILED"
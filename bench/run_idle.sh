@@ -0,0 +1,41 @@
+#!/bin/sh
+# Measures the Linux picker's idle cost on a private Xvfb: CPU time, wakeups
+# and context switches per second with the cursor still, once with idle
+# parking off and once with it on (the default).
+# Usage: bench/run_idle.sh [out.json] [seconds]
+# Env: XVFB_DISPLAY (default :96), XVFB_SCREEN (default 1920x1080x24),
+#      IDLE_CPU_TARGET (percent, default 0.5; the parked run must stay below it)
+set -eu
+
+OUT=${1:-idle_results.json}
+SECS=${2:-10}
+XVFB_DISPLAY=${XVFB_DISPLAY:-:96}
+XVFB_SCREEN=${XVFB_SCREEN:-1920x1080x24}
+IDLE_CPU_TARGET=${IDLE_CPU_TARGET:-0.5}
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo "Xvfb not found (install xvfb)" >&2
+    exit 1
+fi
+
+Xvfb "$XVFB_DISPLAY" -screen 0 "$XVFB_SCREEN" -nolisten tcp >/dev/null 2>&1 &
+XVFB_PID=$!
+TMP=$(mktemp -d)
+trap 'kill "$XVFB_PID" 2>/dev/null || true; rm -rf "$TMP"' EXIT INT TERM
+sleep 1
+
+DISPLAY=$XVFB_DISPLAY ./color_picker_linux --no-park --duration "$SECS" --idle-report "$TMP/no_park.json"
+DISPLAY=$XVFB_DISPLAY ./color_picker_linux --duration "$SECS" --idle-report "$TMP/park.json"
+
+{
+    printf '{\n"cpu_target_percent": %s,\n"results": [\n' "$IDLE_CPU_TARGET"
+    cat "$TMP/no_park.json"
+    printf ',\n'
+    cat "$TMP/park.json"
+    printf ']\n}\n'
+} > "$OUT"
+echo "Wrote $OUT"
+
+PARKED_CPU=$(sed -n 's/.*"cpu_percent": \([0-9.]*\).*/\1/p' "$TMP/park.json")
+echo "idle CPU: $(sed -n 's/.*"cpu_percent": \([0-9.]*\).*/\1/p' "$TMP/no_park.json")% ticking, ${PARKED_CPU}% parked (target < ${IDLE_CPU_TARGET}%)"
+awk -v c="$PARKED_CPU" -v t="$IDLE_CPU_TARGET" 'BEGIN { exit !(c < t) }'
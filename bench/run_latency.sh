@@ -0,0 +1,29 @@
+#!/bin/sh
+# Runs bench/latency_harness against the Linux picker on a private Xvfb.
+# Usage: bench/run_latency.sh [harness args...]
+# Env: XVFB_DISPLAY (default :97), XVFB_SCREEN (default 1920x1080x24),
+#      XVFB_SCREENS (default 1; 2 adds the cross-screen and straddle scenarios)
+set -eu
+
+XVFB_DISPLAY=${XVFB_DISPLAY:-:97}
+XVFB_SCREEN=${XVFB_SCREEN:-1920x1080x24}
+XVFB_SCREENS=${XVFB_SCREENS:-1}
+
+SCREEN_ARGS=""
+i=0
+while [ "$i" -lt "$XVFB_SCREENS" ]; do
+    SCREEN_ARGS="$SCREEN_ARGS -screen $i $XVFB_SCREEN"
+    i=$((i + 1))
+done
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo "Xvfb not found (install xvfb)" >&2
+    exit 1
+fi
+
+# shellcheck disable=SC2086
+Xvfb "$XVFB_DISPLAY" $SCREEN_ARGS -nolisten tcp >/dev/null 2>&1 &
+XVFB_PID=$!
+trap 'kill "$XVFB_PID" 2>/dev/null || true' EXIT INT TERM
+
+DISPLAY=$XVFB_DISPLAY ./bench/latency_harness --picker ./color_picker_linux "$@"
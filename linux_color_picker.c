@@ -0,0 +1,2448 @@
+// Minimal Color Picker (Linux/X11, single-file)
+// Build: cc -O2 linux_color_picker.c -lX11 -lXext -lm -lpthread -o color_picker_linux
+// Run: ./color_picker_linux [--trace trace.json] [--event-driven] [--stats]
+//                           [--mem-cap MB] [--control /path/to/socket]
+//                           [--no-park] [--idle-report idle.json] [--duration SEC]
+//                           [--radius PX] [--zoom Z] [--threads N] [--pin X,Y ...]
+//                           [--flash-damage] [--scope N] [--fill-tolerance T]
+//                           [--ruler] [--ruler-tolerance T] [--two-point]
+//                           [--reference PNG] [--reference-origin X,Y]
+//                           [--reference-opacity P] [--amplify] [--amplify-range L]
+//        ./color_picker_linux --watch POINTS [--watch-rate HZ] [--watch-tolerance T]
+//                           [--watch-command CMD] [--duration SEC] [--frames N]
+//                           [--stats]
+// Behavior:
+// - Shows a circular magnifier near the cursor.
+// - Left click or Enter: prints center pixel color as #RRGGBB to stdout and exits.
+//   (X11 selections die with their owner, so pipe into xclip to keep it.)
+// - Arrow keys: nudge cursor by 1px (Shift for 5px). Esc exits.
+// - M: measures the same-colour region under the cursor. The cursor's screen
+//   is grabbed whole and flood-filled from the centre pixel through every
+//   4-connected pixel within --fill-tolerance T (per channel, default 0) of
+//   it (picker_fill.h); its size, origin, pixel area and centroid are printed
+//   to stdout and the picker keeps running.
+// - R (or --ruler to start with it): the pixel ruler. Rays run left, right,
+//   up and down from the cursor pixel to the first pixel differing from it by
+//   more than --ruler-tolerance T per channel (default 8), and the distances
+//   are drawn in the loupe. Each frame grabs only the cursor's row and a band
+//   of 8 columns, transposed tile by tile for the vertical rays
+//   (picker_ruler.h).
+// - T (or --two-point to start with it): two-point measurement. Left click
+//   and Enter mark points instead of picking; the second point prints the
+//   distance, offsets and angle from the first, and the next click starts a
+//   new pair. Each point is taken from the capture square the loupe last
+//   showed (no new grab) and snapped, along its row and its column, to an
+//   edge within 4 px at sub-pixel precision (picker_edge.h); its position
+//   (| and - mark the snapped axes) and colour are printed to stdout.
+// - --reference PNG: onion-skin comparison with a design mock whose top-left
+//   pixel sits at --reference-origin X,Y (default 0,0). The loupe shows the
+//   mock blended over the screen at --reference-opacity P percent (default
+//   50); O switches to the per-channel difference, then off, then back. The
+//   CIEDE2000 difference of the centre pixel is drawn under the marker. The
+//   PNG is decoded once (picker_png.h) into PNG.tiles, a tile cache next to
+//   it that later runs map as it is; each frame copies only the tiles under
+//   the capture square, and the blend or difference is fused into the
+//   loupe's scale pass with SSE2 (picker_onion.h, picker_filter.h). Where the
+//   mock is transparent, or the loupe is zoomed out, the screen shows alone.
+// - A (or --amplify to start with it): the difference amplifier. Each channel
+//   within --amplify-range L levels (default 8) of the centre pixel's is
+//   stretched over the full range around mid grey, so #FEFEFE beside #FFFFFF
+//   shows as two clearly different greys. The tables are rebuilt only when
+//   the centre colour changes, and the map is fused into the loupe's scale
+//   pass with SSE2 like the onion skin (picker_filter.h), which it replaces
+//   while on.
+// - --watch POINTS: headless watch mode, no loupe. POINTS lists screen points,
+//   one "x,y" per line (# starts a comment). They are sampled --watch-rate HZ
+//   times a second (default 10), and each point whose colour moves more than
+//   --watch-tolerance T per channel (default 8) from the colour last reported
+//   for it prints "change X,Y #OLD -> #NEW t=SECONDS" to stdout. With
+//   --watch-command CMD, the changes are also piped to CMD (run with sh -c),
+//   started at the first change and kept running: it reads one line per
+//   change and no tick waits for it to exit. The points are clustered once
+//   into regions (picker_watch.h), each tick grabs only those and checks the
+//   points four at a time with SSE2, so the cost follows the regions, not
+//   the points. Runs until interrupted or --duration SEC.
+// - --radius PX (16..1024, default 120) and --zoom Z (0.125..64, default 8) size
+//   the loupe. The mouse wheel zooms in and out in quarter octaves. Below 1 the
+//   loupe zooms out: the capture is up to 8 times larger and the loupe samples
+//   a mip pyramid of it, reduced 2x2 in linear light and updated only where
+//   tiles changed (picker_mip.h), blending the two nearest levels; picking
+//   still reads the exact pixel. Loupes larger than one cache-sized band are
+//   composed band by band on a worker pool (--threads N, default cores-1; 0
+//   composes on the UI thread).
+// - --pin X,Y (repeatable, up to 7): an extra loupe pinned at X,Y on the first
+//   screen, for side-by-side comparison with the cursor loupe. All loupes
+//   read from one shared capture: their squares are grouped into as few grabs
+//   as pays off (picker_regions.h) and every loupe is composed in one pool
+//   batch. A pinned loupe whose pixels did not change is not redrawn.
+// - Change detection: the cursor's capture square is hashed in 16x16 blocks
+//   every frame (picker_damage.h); idle parking compares those hashes. When
+//   only some blocks changed, only the loupe tiles magnified from them are
+//   recomposed and only their bounding rectangle is sent with XShmPutImage;
+//   with nothing changed nothing is sent. --flash-damage tints the loupe over
+//   blocks that changed, fading out over a quarter second, to show what the
+//   picker sees changing.
+// - --scope N: a waveform and vectorscope of the centre N x N of the loupe's
+//   capture square (0: all of it; zoom out to widen it), docked at the top
+//   right of the cursor's screen. The scopes are binned tile by tile on the
+//   worker pool (picker_scope.h) and redrawn only when the capture changed.
+// - --event-driven: redraw on every pointer motion as well as on the 16 ms tick.
+// - --trace: records frame stages and input events, writes Chrome trace JSON on exit.
+// - --frames N: exit after N frames, or N ticks in watch mode (for measurements).
+// - Multiple X screens (e.g. Xvfb -screen 0 ... -screen 1 ...): every screen has
+//   its own overlay window, loupe and capture buffers and a private capture
+//   connection, created up front, so the loupe follows the cursor across
+//   screens without creating anything. Screens are assumed side by side in
+//   screen order (the server default); a capture square that straddles an
+//   edge is grabbed from both screens in parallel and stitched.
+// - --stats: prints frame pacing, jank, quality-level and memory counters on
+//   exit, plus per-stage hardware counters (IPC, misses/pixel) where
+//   perf_event_open is available.
+// - --mem-cap MB: keeps resident memory under MB by shrinking trace history
+//   and the caches: fewer zoom-out levels, no ruler tiles, no merged pin
+//   grabs, scope bins on one thread. Where even that leaves no room, the
+//   reference overlay, the scope or a region measurement is left out.
+// - --control PATH: Unix socket; a client writes "stats" or "mem" and gets the
+//   same report as --stats.
+// - Idle: with the cursor still and the pixels under it unchanged, the 16 ms
+//   tick parks; pointer/key input or a 250 ms damage poll resumes it.
+//   --no-park keeps ticking.
+// - --idle-report FILE: writes CPU time, wakeups and context switches per
+//   second (getrusage, /proc/self/schedstat) as JSON on exit, measured from
+//   one second after start. --duration SEC exits after SEC seconds.
+// Test build: -DALLOC_AUDIT counts heap calls per frame after warm-up and exits
+// with status 3 if steady-state frames allocate (see picker_alloc_audit.h).
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // syscall() for picker_perf.h
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/shape.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "picker_damage.h"
+#include "picker_downsample.h"
+#include "picker_dpi.h"
+#include "picker_edge.h"
+#include "picker_fill.h"
+#include "picker_filter.h"
+#include "picker_kernels.h"
+#include "picker_mem.h"
+#include "picker_mip.h"
+#include "picker_onion.h"
+#include "picker_pacer.h"
+#include "picker_park.h"
+#include "picker_perf.h"
+#include "picker_png.h"
+#include "picker_pool.h"
+#include "picker_regions.h"
+#include "picker_ruler.h"
+#include "picker_scope.h"
+#include "picker_trace.h"
+#include "picker_watch.h"
+#ifdef ALLOC_AUDIT
+#include "picker_alloc_audit.h"
+#endif
+
+static const int kDefaultRadius = 120;   // circle radius in px
+static const int kMaxRadius = 1024;      // 2048 px loupe
+static const int kMinRadius = 16;
+static const int kDefaultZoom = 8;       // magnification factor
+static const int kMaxZoom = 64;
+static const int kMaxZoomOut = 8;        // --zoom 0.125 (1 << (MIP_MAX_LEVELS - 1))
+static const int kBorderWidth = 2;
+static const int kMarkerSize = 6;        // center marker square in px
+static const int kTickMs = 16;           // ~60fps
+static const int kOffsetX = 40;          // least window offset from cursor
+static const int kGrabMargin = 8;        // window clearance from the capture square it magnifies
+static const int kScopeMargin = 16;      // --scope panel inset from the screen corner
+static const long kRepaintWaitMs = 40;   // for windows under ours to repaint before a screen grab
+static const double kIdleSettleMs = 1000.0;  // idle report skips startup
+static const double kControlTimeoutMs = 1000.0;  // a --control client's command must arrive by then
+
+#define MAX_SCREENS 8
+#define MAX_PINS (REGION_MAX - 1)  // the cursor loupe takes the last slot
+
+// XImage with optional MIT-SHM backing.
+typedef struct ShmImage {
+    Display* dpy;            // connection the image was created on
+    XImage* img;
+    XShmSegmentInfo shm;
+    int shared;
+} ShmImage;
+
+// One X screen. A window cannot move between screens, so each screen has its
+// own overlay window and loupe image; only the one under the cursor is mapped.
+typedef struct ScreenCtx {
+    int index;
+    Window root;
+    int width, height;
+    int left;                // left edge in the side-by-side screen layout
+    Window win;
+    GC gc;
+    Visual* winVisual;
+    int winDepth;
+    ShmImage out;            // g_diameter x g_diameter loupe pixels
+    int winX, winY;
+    Display* capDpy;         // g_dpy with one screen, else a private connection
+    int capShm;              // MIT-SHM usable on capDpy
+    ShmImage cap;            // capture square, grabbed at a clamped origin
+    int grabX, grabY;        // origin of the last grab, in screen coordinates
+    // What `out` holds, so the next frame can patch it (loupe_can_patch()).
+    uint64_t drawnUpdate;    // g_damage.updates it was composed from, 0 = none
+    int drawnCapSize, drawnLevels, drawnAntialias;
+    int presentAll;          // mapped, moved or exposed: the next present sends every pixel
+    Window scopeWin;         // --scope panel, docked in a corner clear of the grabs
+    int scopeX, scopeY;      // its origin
+    GC scopeGc;
+    ShmImage scopeOut;       // SCOPE_PANEL_W x SCOPE_PANEL_H
+    ShmImage rulerRow;       // the cursor's row, for the ruler
+    ShmImage rulerBand;      // RULER_BAND columns around the cursor, full height
+    ShmImage watchBuf;       // --watch regions on this screen, packed
+} ScreenCtx;
+
+static Display* g_dpy;
+static int g_useShm;
+static ScreenCtx g_screens[MAX_SCREENS];
+static int g_screenCount;
+static ScreenCtx* g_shown;   // screen whose overlay window is mapped
+static long g_screenSwitches;
+static long g_stitchedFrames;
+
+// A loupe pinned at a fixed point of the first screen (--pin). Its capture
+// square is a view into the shared capture, not a grab of its own.
+typedef struct PinnedLoupe {
+    int x, y;                // pinned point, on the first screen
+    Window win;
+    GC gc;
+    ShmImage out;            // g_diameter x g_diameter loupe pixels
+    const uint8_t* capData;  // this frame's square inside g_shared, or edge
+    int capStride;
+    uint8_t* edge;           // a square crossing the screen edge, shifted into place
+    int edgeAlloc;           // edge holds a square this wide
+    uint64_t hash;           // of this frame's square
+    uint64_t drawnHash;      // of the square on screen now
+    int drawnAntialias;
+    double drawnZoom;
+    MipPyramid mip;          // zoomed out: pyramid of the square
+    int shown;               // window mapped
+    int dirty;               // composed this frame, needs presenting
+    int winX, winY;          // window origin, clear of the grabs (place_loupe())
+    int repaint;             // window moved: present it even if not composed
+} PinnedLoupe;
+
+static PinnedLoupe g_pins[MAX_PINS];
+static int g_pinCount;
+static ShmImage g_shared;    // packed grabs for all loupes, first-screen sized
+static RegionPlan g_plan;
+static long g_sharedFrames;
+static long g_sharedGrabs;
+static long g_pinComposes;
+static long g_pinSkips;
+
+static int g_radius;         // loupe geometry, fixed after argument parsing
+static LoupeStyle g_style;   // the same, for loupe_geometry()
+static int g_diameter;       // 2*radius
+static double g_zoom;        // loupe pixels per screen pixel; the wheel changes it
+static int g_mipLevels = 1;  // > 1: zoomed out, the loupe samples a mip pyramid
+static int g_capSize;
+static int g_capAlloc;       // capture buffers hold this square; g_capSize may be less
+static int g_srcSize;        // loupe source size: g_capSize >> (g_mipLevels - 1)
+static MipPyramid g_mip;     // cursor loupe's pyramid
+static size_t g_mipBytes;
+static const uint8_t* g_srcData;  // this frame's loupe source
+static int g_srcStride;
+static uint8_t* g_stitch;    // capture square assembled across a screen edge
+static const uint8_t* g_capData;  // this frame's capture square
+static int g_capStride;
+static ScreenCtx* g_capScreen;    // and the cursor position it is centred on
+static int g_capCursorX, g_capCursorY;
+static DamageMap g_damage;   // 16x16 block hashes of the capture square
+static int g_flashDamage;    // --flash-damage
+static int g_scopeRegion = -1;  // --scope N; -1 when off, 0 for the whole capture square
+static ScopeMap g_scope;
+static ScreenCtx* g_scopeScreen;  // screen whose scope panel is mapped
+static uint64_t g_scopeUpdate;    // g_damage.updates of the last run
+static int g_scopeRepaint;        // the panel was exposed
+static size_t g_scopeBytes;
+static int g_sharedSquares;       // --mem-cap left no room for merged pin grabs
+static int g_fillTolerance;       // --fill-tolerance T
+static FillMap g_fill;
+static ShmImage g_fillShot;       // the measured screen, grabbed whole
+static ScreenCtx* g_fillScreen;   // screen g_fillShot was created for
+static int g_ruler;               // R or --ruler
+static int g_rulerTolerance = 8;  // --ruler-tolerance T
+static RulerCache g_rulerCache;
+static RulerResult g_rulerResult; // this frame's distances
+static int g_twoPoint;            // T or --two-point
+static int g_pointCount;          // points marked of the current pair
+static EdgePoint g_pointA;
+static const char* g_watchPath;   // --watch POINTS
+static const char* g_watchCommand;  // --watch-command CMD
+static double g_watchRate = 10.0; // --watch-rate HZ
+static int g_watchTolerance = 8;  // --watch-tolerance T
+static WatchSet g_watch[MAX_SCREENS];  // each screen's points and regions
+static const char* g_refPath;     // --reference PNG
+static int g_refX, g_refY;        // --reference-origin X,Y: where the PNG's top-left pixel sits
+static int g_refOpacity = ONION_OPACITY;     // --reference-opacity P, as a weight of 128
+static int g_refMode = LOUPE_FILTER_BLEND;   // O cycles blend, difference, off
+static OnionRef g_ref;            // the PNG's mapped tile cache
+static uint8_t* g_refSquare;      // the reference under this frame's capture square
+static int g_amplify;             // A or --amplify
+static int g_amplifyRange = 8;    // --amplify-range L: levels either side of the centre
+static long g_amplifyFrames;
+static long g_amplifyBuilds;      // frames whose centre colour rebuilt the tables
+static LoupeFilter g_filter;      // this frame's; LOUPE_FILTER_NONE shows the screen as it is
+
+// Wheel zoom: latency from a wheel event to the first frame presented at the
+// new zoom, and the pyramid's per-frame cost while zoomed out.
+static double g_wheelAtMs;   // first wheel notch not yet presented, 0 when none
+static long g_wheelSteps;
+static long g_wheelFrames;
+static double g_wheelTotalMs;
+static double g_wheelMaxMs;
+static long g_mipFrames;
+static double g_mipUpdateMs;
+static double g_mipSampleMs;
+
+// Process usage at one instant, for the idle report.
+typedef struct UsageSample {
+    double wallMs;
+    double cpuMs;              // user + system
+    long voluntaryCsw;
+    long involuntaryCsw;
+    long long timeslices;      // times scheduled onto a CPU (schedstat), -1 if unknown
+    long loopWakeups;
+    long frames;
+    double parkedMs;
+} UsageSample;
+
+static volatile sig_atomic_t g_quit;
+static int g_eventDriven;
+static long g_maxFrames;     // 0 = run until picked/cancelled
+static long g_frameCount;
+static const char* g_tracePath;
+static int g_stats;
+static FramePacer g_pacer;
+static const char* g_controlPath;
+static int g_controlFd = -1;
+static int g_controlClient = -1;   // accepted, command still arriving
+static double g_controlDeadline;
+static char g_controlCmd[64];
+static size_t g_controlLen;
+static IdleParker g_parker;
+static PerfCounters g_perf;
+static PerfSample g_perfStages[] = {
+    { .name = "scale" }, { .name = "mask" }, { .name = "blend" }, { .name = "compose" }, { .name = "reduce" },
+    { .name = "pick" },
+};
+enum { STAGE_SCALE, STAGE_MASK, STAGE_BLEND, STAGE_COMPOSE, STAGE_REDUCE, STAGE_PICK, STAGE_COUNT };
+static WorkerPool g_pool;
+static WorkerPool g_inlinePool;  // no workers, for compose_pool()
+static int g_threads = -1;   // -1 = pool_default_threads()
+static int g_noPark;
+static const char* g_idleReportPath;
+static double g_durationMs;
+static long g_loopWakeups;
+static long g_framesDrawn;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static int create_image(ShmImage* si, Display* dpy, int useShm, Visual* visual, int depth, int w, int h) {
+    memset(si, 0, sizeof(*si));
+    si->dpy = dpy;
+
+    if (useShm) {
+        si->img = XShmCreateImage(dpy, visual, (unsigned)depth, ZPixmap, NULL, &si->shm, (unsigned)w, (unsigned)h);
+        if (si->img) {
+            si->shm.shmid = shmget(IPC_PRIVATE, (size_t)si->img->bytes_per_line * (size_t)h, IPC_CREAT | 0600);
+            if (si->shm.shmid >= 0) {
+                si->shm.shmaddr = si->img->data = (char*)shmat(si->shm.shmid, NULL, 0);
+                si->shm.readOnly = False;
+                if (si->shm.shmaddr != (char*)-1 && XShmAttach(dpy, &si->shm)) {
+                    XSync(dpy, False);
+                    // Mark for removal now; it goes away once both sides detach.
+                    shmctl(si->shm.shmid, IPC_RMID, NULL);
+                    si->shared = 1;
+                    return 1;
+                }
+                shmctl(si->shm.shmid, IPC_RMID, NULL);
+            }
+            si->img->data = NULL;
+            XDestroyImage(si->img);
+            si->img = NULL;
+        }
+    }
+
+    char* data = (char*)malloc((size_t)w * (size_t)h * 4);
+    if (!data) return 0;
+    si->img = XCreateImage(dpy, visual, (unsigned)depth, ZPixmap, 0, data, (unsigned)w, (unsigned)h, 32, 0);
+    if (!si->img) {
+        free(data);
+        return 0;
+    }
+    return 1;
+}
+
+static void destroy_image(ShmImage* si) {
+    if (!si->img) return;
+    if (si->shared) {
+        XShmDetach(si->dpy, &si->shm);
+        shmdt(si->shm.shmaddr);
+        si->img->data = NULL;
+    }
+    XDestroyImage(si->img); // frees data for the non-shared case
+    si->img = NULL;
+}
+
+// The kernels work on 32-bit BGRA; accept only visuals with that memory layout.
+static int image_is_bgra(const XImage* img) {
+    return img->bits_per_pixel == 32 && img->byte_order == LSBFirst &&
+           img->red_mask == 0xFF0000 && img->green_mask == 0xFF00 && img->blue_mask == 0xFF;
+}
+
+// Says once per call site what --mem-cap turned down.
+static void mem_refused(int* told, const char* what) {
+    if (*told) return;
+    *told = 1;
+    fprintf(stderr, "--mem-cap: no room for %s\n", what);
+}
+
+// Turns --scope off on every screen (no room for its bins under --mem-cap).
+static void scope_off(void) {
+    for (int i = 0; i < g_screenCount; i++) {
+        ScreenCtx* sc = &g_screens[i];
+        destroy_image(&sc->scopeOut);
+        if (sc->scopeWin) XDestroyWindow(g_dpy, sc->scopeWin);
+        sc->scopeWin = 0;
+    }
+    g_scopeScreen = NULL;
+    scope_free(&g_scope);
+    mem_set("scope", 0);
+    g_scopeBytes = 0;
+    g_scopeRegion = -1;
+}
+
+static void ensure_resources(void) {
+    // Use odd capture size so the cursor maps to the exact center pixel. At
+    // low zoom a giant loupe could ask for more than the smallest screen holds.
+    int screenMin = INT_MAX;
+    for (int i = 0; i < g_screenCount; i++) {
+        const ScreenCtx* sc = &g_screens[i];
+        if (sc->width < screenMin) screenMin = sc->width;
+        if (sc->height < screenMin) screenMin = sc->height;
+    }
+    // Zoomed out, the square is also capped so a loupe window fits beside it
+    // on both axes of every screen (place_loupe()): without a compositor a
+    // root grab reads back our own windows. Zooming out stops there, and a
+    // loupe over about a third of a screen does not zoom out at all.
+    int capLimit = screenMin - 2 * (g_diameter + kGrabMargin);
+    if (capLimit < g_diameter) capLimit = g_diameter < screenMin ? g_diameter : screenMin;
+    if (g_zoom < (double)g_diameter / capLimit) g_zoom = (double)g_diameter / capLimit;
+    // X11 has no per-monitor scale, so every screen is sized at DPI_BASE.
+    LoupeGeometry geo = loupe_geometry(&g_style, g_zoom, DPI_BASE, capLimit);
+    // The pyramids are a cache --mem-cap may turn down: then zoom out only as
+    // far as the levels it leaves room for.
+    while (geo.levels > 1) {
+        static int told;
+        size_t want = mip_bytes_for(geo.srcSize, geo.levels) * (size_t)(1 + g_pinCount);
+        if (want <= g_mipBytes || mem_allows(want - g_mipBytes)) break;
+        mem_refused(&told, "every zoom-out level");
+        g_zoom = 1.0 / (1 << (geo.levels - 2));
+        geo = loupe_geometry(&g_style, g_zoom, DPI_BASE, capLimit);
+    }
+    int levels = geo.levels;
+    int desiredCapSize = geo.capSize, srcSize = geo.srcSize;
+
+    // Capture buffers only grow: a wheel notch to a smaller square reuses
+    // them, and grabs write packed rows of the current size.
+    int grow = desiredCapSize > g_capAlloc;
+    int changed = 0;
+    for (int i = 0; i < g_screenCount; i++) {
+        ScreenCtx* sc = &g_screens[i];
+        if (!sc->out.img) {
+            if (!create_image(&sc->out, g_dpy, g_useShm, sc->winVisual, sc->winDepth, g_diameter, g_diameter)) {
+                fprintf(stderr, "Failed to create loupe image\n");
+                exit(1);
+            }
+            sc->drawnUpdate = 0;
+            sc->presentAll = 1;
+            changed = 1;
+        }
+        if (!sc->cap.img || grow) {
+            destroy_image(&sc->cap);
+            if (!create_image(&sc->cap, sc->capDpy, sc->capShm, DefaultVisual(sc->capDpy, sc->index),
+                              DefaultDepth(sc->capDpy, sc->index), desiredCapSize, desiredCapSize)) {
+                fprintf(stderr, "Failed to create capture image\n");
+                exit(1);
+            }
+            if (!image_is_bgra(sc->cap.img)) {
+                fprintf(stderr, "Unsupported screen visual (need 32bpp BGRA)\n");
+                exit(1);
+            }
+            changed = 1;
+        }
+    }
+    if (g_screenCount > 1 && (!g_stitch || grow)) {
+        free(g_stitch);
+        g_stitch = (uint8_t*)malloc((size_t)desiredCapSize * (size_t)desiredCapSize * 4);
+        if (!g_stitch) {
+            fprintf(stderr, "Failed to allocate capture buffer\n");
+            exit(1);
+        }
+    }
+    if (g_ref.tiles && (!g_refSquare || grow)) {
+        // Tiles the loupe has passed over stay resident, so the whole map
+        // counts. Without room for it the loupe shows the live screen alone.
+        static int told;
+        size_t map = onion_cache_size(g_ref.width, g_ref.height);
+        size_t bytes = (size_t)desiredCapSize * (size_t)desiredCapSize * 4 + map, have = mem_get("reference");
+        free(g_refSquare);
+        g_refSquare = NULL;
+        if (bytes > have && !mem_allows(bytes - have)) {
+            mem_refused(&told, "the reference");
+            munmap((void*)(g_ref.tiles - ONION_HEADER), map);
+            memset(&g_ref, 0, sizeof(g_ref));
+            bytes = 0;
+        } else if (!(g_refSquare = (uint8_t*)malloc((size_t)desiredCapSize * (size_t)desiredCapSize * 4))) {
+            fprintf(stderr, "Failed to allocate reference buffer\n");
+            exit(1);
+        }
+        mem_set("reference", bytes);
+    }
+    if (grow) {
+        g_capAlloc = desiredCapSize;
+        if (!damage_reserve(&g_damage, desiredCapSize, desiredCapSize)) {
+            fprintf(stderr, "Failed to allocate block hashes\n");
+            exit(1);
+        }
+        mem_set("damage", damage_bytes(&g_damage));
+    }
+    if (g_scopeRegion >= 0) {
+        for (int i = 0; i < g_screenCount; i++) {
+            ScreenCtx* sc = &g_screens[i];
+            if (sc->scopeOut.img) continue;
+            if (!create_image(&sc->scopeOut, g_dpy, g_useShm, sc->winVisual, sc->winDepth, SCOPE_PANEL_W,
+                              SCOPE_PANEL_H)) {
+                fprintf(stderr, "Failed to create scope image\n");
+                exit(1);
+            }
+        }
+        // The pool starts after the first frame's resources; the partials
+        // grow once when it does. They are a cache --mem-cap may turn down:
+        // then the scope bins on this thread alone (scope_run()), and with no
+        // room even for that it is turned off.
+        static int narrowed, toldNarrowed, toldOff;
+        size_t panels = (size_t)g_screenCount * SCOPE_PANEL_W * SCOPE_PANEL_H * 4;
+        int slots = pool_slots(&g_pool);
+        if (narrowed || slots < g_scope.slotCap) slots = g_scope.slotCap;
+        size_t want = (size_t)slots * sizeof(ScopeBins) + (size_t)g_capAlloc + panels;
+        if (want > g_scopeBytes && slots > 1 && !mem_allows(want - g_scopeBytes)) {
+            mem_refused(&toldNarrowed, "scope bins per thread");
+            narrowed = 1;
+            slots = g_scope.slotCap > 1 ? g_scope.slotCap : 1;
+            want = (size_t)slots * sizeof(ScopeBins) + (size_t)g_capAlloc + panels;
+        }
+        if (want > g_scopeBytes && !mem_allows(want - g_scopeBytes)) {
+            mem_refused(&toldOff, "the scope");
+            scope_off();
+        } else {
+            if (!scope_reserve(&g_scope, slots, g_capAlloc)) {
+                fprintf(stderr, "Failed to allocate scope bins\n");
+                exit(1);
+            }
+            size_t bytes = scope_bytes(&g_scope) + panels;
+            if (bytes != g_scopeBytes) mem_set("scope", bytes);
+            g_scopeBytes = bytes;
+        }
+    }
+    if (g_ruler && !g_screens[0].rulerRow.img) {
+        // The transposed tiles are a cache --mem-cap may turn down: then the
+        // vertical rays read the band in place.
+        static int told;
+        int tallest = 0;
+        for (int i = 0; i < g_screenCount; i++) {
+            if (g_screens[i].height > tallest) tallest = g_screens[i].height;
+        }
+        if (!mem_allows(ruler_bytes_for(tallest))) {
+            mem_refused(&told, "ruler tiles");
+            g_rulerCache.direct = 1;
+        }
+        size_t bytes = 0;
+        for (int i = 0; i < g_screenCount; i++) {
+            ScreenCtx* sc = &g_screens[i];
+            Visual* v = DefaultVisual(sc->capDpy, sc->index);
+            int depth = DefaultDepth(sc->capDpy, sc->index);
+            int bw = sc->width < RULER_BAND ? sc->width : RULER_BAND;
+            if (!create_image(&sc->rulerRow, sc->capDpy, sc->capShm, v, depth, sc->width, 1) ||
+                !create_image(&sc->rulerBand, sc->capDpy, sc->capShm, v, depth, bw, sc->height) ||
+                (!g_rulerCache.direct && !ruler_reserve(&g_rulerCache, sc->height))) {
+                fprintf(stderr, "Failed to create ruler images\n");
+                exit(1);
+            }
+            bytes += ((size_t)sc->width + (size_t)bw * sc->height) * 4;
+        }
+        mem_set("ruler", bytes + ruler_bytes(&g_rulerCache));
+    }
+    if (levels > 1) {
+        int ok = mip_reserve(&g_mip, srcSize, levels);
+        size_t bytes = g_mip.bytes;
+        for (int i = 0; i < g_pinCount; i++) {
+            ok = ok && mip_reserve(&g_pins[i].mip, srcSize, levels);
+            bytes += g_pins[i].mip.bytes;
+        }
+        if (!ok) {
+            fprintf(stderr, "Failed to allocate zoom-out buffers\n");
+            exit(1);
+        }
+        if (bytes != g_mipBytes) mem_set("mip", bytes);
+        g_mipBytes = bytes;
+    }
+    g_capSize = desiredCapSize;
+    g_srcSize = srcSize;
+    g_mipLevels = levels;
+
+    // Pinned loupes draw on the first screen and share one capture image that
+    // can hold any plan (region_plan() never exceeds the screen's area). It is
+    // a cache --mem-cap may turn down: then it holds every square apart and
+    // only squares that overlap share a grab (capture_loupes()).
+    const ScreenCtx* s0 = &g_screens[0];
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        if (!p->out.img) {
+            if (!create_image(&p->out, g_dpy, g_useShm, s0->winVisual, s0->winDepth, g_diameter, g_diameter)) {
+                fprintf(stderr, "Failed to create loupe image\n");
+                exit(1);
+            }
+            changed = 1;
+        }
+        // The pinned point stays where it was asked for. Its square is
+        // grabbed at the nearest on-screen origin, and one that crosses the
+        // edge is shifted into place in its own buffer (capture_loupes()).
+        if (p->x < 0) p->x = 0;
+        if (p->y < 0) p->y = 0;
+        if (p->x > s0->width - 1) p->x = s0->width - 1;
+        if (p->y > s0->height - 1) p->y = s0->height - 1;
+        int half = g_capSize / 2;
+        int crosses = p->x < half || p->y < half || p->x + half >= s0->width || p->y + half >= s0->height;
+        if (crosses && p->edgeAlloc < g_capSize) {
+            free(p->edge);
+            p->edge = (uint8_t*)malloc((size_t)g_capSize * (size_t)g_capSize * 4);
+            if (!p->edge) {
+                fprintf(stderr, "Failed to allocate capture buffer\n");
+                exit(1);
+            }
+            p->edgeAlloc = g_capSize;
+            changed = 1;
+        }
+    }
+    if (g_pinCount && (!g_shared.img || (g_sharedSquares && g_shared.img->width < g_capAlloc))) {
+        static int told;
+        size_t screen = (size_t)s0->width * (size_t)s0->height;
+        if (!g_shared.img && !mem_allows(screen * 4)) {
+            mem_refused(&told, "merged pin grabs");
+            g_sharedSquares = 1;
+        }
+        // Squares that add up to the screen save nothing over it.
+        if ((size_t)g_capAlloc * (size_t)g_capAlloc * (size_t)(g_pinCount + 1) >= screen) g_sharedSquares = 0;
+        destroy_image(&g_shared);
+        if (!create_image(&g_shared, s0->capDpy, s0->capShm, DefaultVisual(s0->capDpy, 0), DefaultDepth(s0->capDpy, 0),
+                          g_sharedSquares ? g_capAlloc : s0->width,
+                          g_sharedSquares ? g_capAlloc * (g_pinCount + 1) : s0->height)) {
+            fprintf(stderr, "Failed to create shared capture image\n");
+            exit(1);
+        }
+        changed = 1;
+    }
+
+    if (changed) {
+        size_t square = (size_t)g_capAlloc * (size_t)g_capAlloc * 4;
+        size_t loupe = 0, capture = g_stitch ? square : 0;
+        for (int i = 0; i < g_screenCount; i++) {
+            loupe += (size_t)g_screens[i].out.img->bytes_per_line * (size_t)g_diameter;
+            capture += square;
+        }
+        for (int i = 0; i < g_pinCount; i++) {
+            loupe += (size_t)g_pins[i].out.img->bytes_per_line * (size_t)g_diameter;
+            capture += (size_t)g_pins[i].edgeAlloc * (size_t)g_pins[i].edgeAlloc * 4;
+        }
+        if (g_shared.img) capture += (size_t)g_shared.img->bytes_per_line * (size_t)g_shared.img->height;
+        mem_set("loupe", loupe);
+        mem_set("capture", capture);
+    }
+}
+
+// Grabs rectangle `r` of `root` into `si` at pixel `offset`, rows packed at
+// r->w pixels. The image header is pointed at that slot for the one request:
+// at 32 bpp the server writes rows unpadded.
+static void grab_rect(Display* dpy, Window root, ShmImage* si, const RegionRect* r, size_t offset) {
+    XImage* img = si->img;
+    XImage saved = *img;
+    img->data = saved.data + offset * 4;
+    img->width = r->w;
+    img->height = r->h;
+    img->bytes_per_line = r->w * 4;
+    if (si->shared) {
+        XShmGetImage(dpy, root, img, r->x, r->y, AllPlanes);
+    } else {
+        XGetSubImage(dpy, root, r->x, r->y, (unsigned)r->w, (unsigned)r->h, AllPlanes, ZPixmap, img, 0, 0);
+    }
+    *img = saved;
+}
+
+// Origin of a `size`-wide span that starts at `o`, moved onto [0, limit).
+static int clamp_origin(int o, int size, int limit) {
+    return o < 0 ? 0 : (o + size > limit ? limit - size : o);
+}
+
+static int rects_overlap(int x, int y, int w, int h, const RegionRect* r) {
+    return x < r->x + r->w && r->x < x + w && y < r->y + r->h && r->y < y + h;
+}
+
+// Our windows unmapped for a screen grab (hide_windows_over()).
+static Window g_hidden[MAX_PINS + 2];
+static int g_hiddenCount;
+
+static void hide_window(Window w) {
+    for (int i = 0; i < g_hiddenCount; i++) {
+        if (g_hidden[i] == w) return;
+    }
+    XUnmapWindow(g_dpy, w);
+    g_hidden[g_hiddenCount++] = w;
+}
+
+// Unmaps our windows on `sc` that cover rectangle `r` of its root, which is
+// about to be grabbed. Frame grabs need none of this, as place_windows()
+// keeps every window clear of them; it is for grabbing the whole screen
+// (measure_region()). The caller syncs and lets the windows under the hole
+// repaint before grabbing.
+static void hide_windows_over(const ScreenCtx* sc, const RegionRect* r) {
+    if (g_shown == sc && rects_overlap(sc->winX, sc->winY, g_diameter, g_diameter, r)) hide_window(sc->win);
+    if (g_scopeScreen == sc && rects_overlap(sc->scopeX, sc->scopeY, SCOPE_PANEL_W, SCOPE_PANEL_H, r)) {
+        hide_window(sc->scopeWin);
+    }
+    if (sc != &g_screens[0]) return;
+    for (int i = 0; i < g_pinCount; i++) {
+        const PinnedLoupe* p = &g_pins[i];
+        if (p->shown && rects_overlap(p->winX, p->winY, g_diameter, g_diameter, r)) hide_window(p->win);
+    }
+}
+
+// Maps again the windows hide_windows_over() took down. Their contents are
+// gone, so each is sent whole with the frame.
+static void restore_windows(void) {
+    if (!g_hiddenCount) return;
+    for (int i = 0; i < g_hiddenCount; i++) XMapRaised(g_dpy, g_hidden[i]);
+    g_hiddenCount = 0;
+    for (int i = 0; i < g_screenCount; i++) g_screens[i].presentAll = 1;
+    for (int i = 0; i < g_pinCount; i++) g_pins[i].repaint = g_pins[i].shown;
+    g_scopeRepaint = 1;
+}
+
+// Screens the current capture square touches; grab_task() runs once per entry.
+static ScreenCtx* g_grabList[MAX_SCREENS];
+static int g_grabCount;
+
+// Grabs the capture square on one screen at its clamped origin (grabX, grabY)
+// through that screen's connection. Runs on the pool when the square
+// straddles screens, so the round trips overlap.
+static void grab_task(void* ctx, int index) {
+    (void)ctx;
+    ScreenCtx* sc = g_grabList[index];
+    RegionRect r = { sc->grabX, sc->grabY, g_capSize, g_capSize };
+    grab_rect(sc->capDpy, sc->root, &sc->cap, &r, 0);
+}
+
+// Captures the square centred on (cx, cy) of screen `cs` into g_capData.
+// Parts on no screen are black.
+static void capture_around(ScreenCtx* cs, int cx, int cy) {
+    int half = g_capSize / 2;
+    int vx = cs->left + cx - half;  // in the side-by-side layout
+    int y = cy - half;
+    int stride = g_capSize * 4;     // grabs are packed at the current size
+
+    // Near an edge, grab the square at the nearest on-screen origin. This
+    // keeps one fixed-size request per screen (XGetSubImage would allocate a
+    // temporary image).
+    g_grabCount = 0;
+    for (int i = 0; i < g_screenCount; i++) {
+        ScreenCtx* sc = &g_screens[i];
+        if (vx >= sc->left + sc->width || vx + g_capSize <= sc->left) continue;
+        sc->grabX = clamp_origin(vx - sc->left, g_capSize, sc->width);
+        sc->grabY = clamp_origin(y, g_capSize, sc->height);
+        g_grabList[g_grabCount++] = sc;
+    }
+    pool_run(&g_pool, grab_task, NULL, g_grabCount);
+
+    if (g_grabCount == 1) {
+        // Shift the grab into place; whatever falls off the screen is black.
+        ScreenCtx* sc = g_grabList[0];
+        shift_bgra((uint8_t*)sc->cap.img->data, g_capSize, g_capSize, stride, vx - sc->left - sc->grabX,
+                   y - sc->grabY);
+        g_capData = (const uint8_t*)sc->cap.img->data;
+        g_capStride = stride;
+        return;
+    }
+
+    // Straddles a screen edge: copy each screen's part into place.
+    g_stitchedFrames++;
+    memset(g_stitch, 0, (size_t)g_capSize * (size_t)stride);
+    for (int i = 0; i < g_grabCount; i++) {
+        const ScreenCtx* sc = g_grabList[i];
+        int x0 = vx > sc->left ? vx : sc->left;
+        int x1 = vx + g_capSize < sc->left + sc->width ? vx + g_capSize : sc->left + sc->width;
+        int y0 = y > 0 ? y : 0;
+        int y1 = y + g_capSize < sc->height ? y + g_capSize : sc->height;
+        for (int row = y0; row < y1; row++) {
+            memcpy(g_stitch + (size_t)(row - y) * stride + (size_t)(x0 - vx) * 4,
+                   sc->cap.img->data + (size_t)(row - sc->grabY) * stride +
+                       (size_t)(x0 - sc->left - sc->grabX) * 4,
+                   (size_t)(x1 - x0) * 4);
+        }
+    }
+    g_capData = g_stitch;
+    g_capStride = stride;
+}
+
+// With pinned loupes: one shared capture for the pins and, when its square
+// lies on the first screen, the cursor loupe. Nearby squares share a grab;
+// each loupe then reads its square straight out of g_shared. A cursor square
+// elsewhere falls back to capture_around().
+static void capture_loupes(ScreenCtx* cs, int cx, int cy) {
+    const ScreenCtx* s0 = &g_screens[0];
+    int half = g_capSize / 2;
+    RegionRect squares[REGION_MAX];
+    int n = 0;
+    for (int i = 0; i < g_pinCount; i++) {
+        RegionRect r = { clamp_origin(g_pins[i].x - half, g_capSize, s0->width),
+                         clamp_origin(g_pins[i].y - half, g_capSize, s0->height), g_capSize, g_capSize };
+        squares[n++] = r;
+    }
+    int cursorShared = cs == s0 && cx - half >= 0 && cy - half >= 0 && cx + half < s0->width && cy + half < s0->height;
+    if (cursorShared) {
+        RegionRect r = { cx - half, cy - half, g_capSize, g_capSize };
+        squares[n++] = r;
+    }
+
+    if (g_sharedSquares) {
+        // No grab cost: squares merge only where that copies no extra pixels.
+        region_plan(&g_plan, squares, n, 0, (int64_t)g_shared.img->width * g_shared.img->height);
+    } else {
+        region_plan(&g_plan, squares, n, REGION_GRAB_COST, (int64_t)s0->width * s0->height);
+    }
+    for (int g = 0; g < g_plan.count; g++) {
+        grab_rect(s0->capDpy, s0->root, &g_shared, &g_plan.grabs[g], g_plan.offset[g]);
+    }
+    g_sharedFrames++;
+    g_sharedGrabs += g_plan.count;
+
+    const uint8_t* base = (const uint8_t*)g_shared.img->data;
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        p->capData = region_view(&g_plan, base, squares, i, &p->capStride);
+        int dx = p->x - half - squares[i].x, dy = p->y - half - squares[i].y;
+        if (dx || dy) {
+            // Off the edge: copy the view out (others may share it) and
+            // shift it into place; whatever falls off the screen is black.
+            int stride = g_capSize * 4;
+            for (int y = 0; y < g_capSize; y++) {
+                memcpy(p->edge + (size_t)y * stride, p->capData + (size_t)y * p->capStride, (size_t)stride);
+            }
+            shift_bgra(p->edge, g_capSize, g_capSize, stride, dx, dy);
+            p->capData = p->edge;
+            p->capStride = stride;
+        }
+        p->hash = hash_bgra(p->capData, g_capSize, g_capSize, p->capStride);
+    }
+    if (cursorShared) {
+        g_capData = region_view(&g_plan, base, squares, n - 1, &g_capStride);
+    } else {
+        capture_around(cs, cx, cy);
+    }
+}
+
+// Grabs the cursor's row and its band of columns on `cs` and measures the
+// ruler's distances into g_rulerResult. Returns their hash: an edge may move
+// outside the capture square, and parking must notice.
+static uint64_t measure_ruler(ScreenCtx* cs, int cx, int cy) {
+    trace_begin("ruler");
+    int bx = ruler_band_x(cx, cs->width), bw = cs->rulerBand.img->width;
+    RegionRect row = { 0, cy, cs->width, 1 }, band = { bx, 0, bw, cs->height };
+    grab_rect(cs->capDpy, cs->root, &cs->rulerRow, &row, 0);
+    grab_rect(cs->capDpy, cs->root, &cs->rulerBand, &band, 0);
+    double t0 = now_ms();
+    // Reserved for every screen in ensure_resources(), so this cannot fail.
+    ruler_measure_cross(&g_rulerCache, (const uint32_t*)cs->rulerRow.img->data, cs->width,
+                        (const uint8_t*)cs->rulerBand.img->data, bw * 4, bw, cs->height, cx, cx - bx, cy,
+                        g_rulerTolerance, &g_rulerResult);
+    ruler_count_ms(&g_rulerCache, now_ms() - t0);
+    trace_end("ruler");
+    return ruler_hash(&g_rulerResult);
+}
+
+// This frame's grabs, which our windows keep clear of (place_windows()): the
+// pins' squares on the first screen, then the cursor square on every screen
+// it reaches and the ruler's row and band, each at its clamped origin.
+typedef struct {
+    const ScreenCtx* sc;
+    RegionRect r;
+} ScreenRect;
+
+static ScreenRect g_grabRects[MAX_SCREENS + MAX_PINS + 2];
+static int g_grabRectCount;
+
+static void add_grab_rect(const ScreenCtx* sc, int x, int y, int w, int h) {
+    ScreenRect* g = &g_grabRects[g_grabRectCount++];
+    g->sc = sc;
+    g->r.x = x;
+    g->r.y = y;
+    g->r.w = w;
+    g->r.h = h;
+}
+
+static int clear_of_grabs(const ScreenCtx* sc, int x, int y, int w, int h) {
+    for (int i = 0; i < g_grabRectCount; i++) {
+        if (g_grabRects[i].sc == sc && rects_overlap(x, y, w, h, &g_grabRects[i].r)) return 0;
+    }
+    return 1;
+}
+
+// Along one axis of a screen `limit` long, where a window `size` long may go
+// to keep clear of the grab [g, g + n) around point p, and at least kOffsetX
+// from p: *after past its end, *before ahead of its start. Returns bit 0 if
+// after fits on the screen, bit 1 if before does.
+static int clear_sides(int p, int g, int n, int size, int limit, int* after, int* before) {
+    *after = g + n + kGrabMargin > p + kOffsetX ? g + n + kGrabMargin : p + kOffsetX;
+    *before = g - kGrabMargin < p - kOffsetX ? g - kGrabMargin - size : p - kOffsetX - size;
+    return (*after + size <= limit) | (*before >= 0) << 1;
+}
+
+// Origin of the loupe window for point (px, py) of `sc`, whose square was
+// grabbed at `own`: at a corner of the square, below right, below left,
+// above right or above left, the first that fits on the screen and covers no
+// other grab. If every corner that fits covers one, the first that fits;
+// ensure_resources() caps the square so that one always does unless the
+// loupe itself is too big.
+static void place_loupe(const ScreenCtx* sc, int px, int py, const RegionRect* own, int* x, int* y) {
+    int xs[2], ys[2];
+    int fitX = clear_sides(px, own->x, own->w, g_diameter, sc->width, &xs[0], &xs[1]);
+    int fitY = clear_sides(py, own->y, own->h, g_diameter, sc->height, &ys[0], &ys[1]);
+    int pick = -1;
+    for (int i = 0; i < 4; i++) {
+        if (!(fitX >> (i & 1) & 1) || !(fitY >> (i >> 1) & 1)) continue;
+        if (pick < 0) pick = i;
+        if (clear_of_grabs(sc, xs[i & 1], ys[i >> 1], g_diameter, g_diameter)) {
+            pick = i;
+            break;
+        }
+    }
+    if (pick >= 0) {
+        *x = xs[pick & 1];
+        *y = ys[pick >> 1];
+        return;
+    }
+    // Only a loupe over about a third of the screen gets here; it covers
+    // part of the grab.
+    *x = xs[0] < sc->width - g_diameter ? xs[0] : sc->width - g_diameter;
+    *y = ys[0] < sc->height - g_diameter ? ys[0] : sc->height - g_diameter;
+    if (*x < 0) *x = 0;
+    if (*y < 0) *y = 0;
+}
+
+// Moves the cursor loupe on `cs`, the pinned loupes and the scope panel
+// clear of this frame's grabs, before they are taken. Without a compositor
+// a root grab reads our own windows back. Zoom changes the squares' size.
+static void place_windows(ScreenCtx* cs, int cx, int cy) {
+    const ScreenCtx* s0 = &g_screens[0];
+    int half = g_capSize / 2;
+    g_grabRectCount = 0;
+    for (int i = 0; i < g_pinCount; i++) {
+        add_grab_rect(s0, clamp_origin(g_pins[i].x - half, g_capSize, s0->width),
+                      clamp_origin(g_pins[i].y - half, g_capSize, s0->height), g_capSize, g_capSize);
+    }
+    int vx = cs->left + cx - half;
+    RegionRect own = { 0, 0, g_capSize, g_capSize };
+    for (int i = 0; i < g_screenCount; i++) {
+        const ScreenCtx* sc = &g_screens[i];
+        if (vx >= sc->left + sc->width || vx + g_capSize <= sc->left) continue;
+        int gx = clamp_origin(vx - sc->left, g_capSize, sc->width);
+        int gy = clamp_origin(cy - half, g_capSize, sc->height);
+        add_grab_rect(sc, gx, gy, g_capSize, g_capSize);
+        if (sc == cs) {
+            own.x = gx;
+            own.y = gy;
+        }
+    }
+    if (g_ruler && cs->rulerRow.img) {
+        add_grab_rect(cs, 0, cy, cs->width, 1);
+        add_grab_rect(cs, ruler_band_x(cx, cs->width), 0, cs->rulerBand.img->width, cs->height);
+    }
+
+    int moved = 0;
+    int x, y;
+    place_loupe(cs, cx, cy, &own, &x, &y);
+    if (x != cs->winX || y != cs->winY) {
+        // Without a compositor a moved window may come back without the
+        // parts that were off screen or covered.
+        XMoveWindow(g_dpy, cs->win, x, y);
+        cs->winX = x;
+        cs->winY = y;
+        cs->presentAll = 1;
+        moved = 1;
+    }
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        place_loupe(s0, p->x, p->y, &g_grabRects[i].r, &x, &y);
+        if (p->shown && (x != p->winX || y != p->winY)) {
+            XMoveWindow(g_dpy, p->win, x, y);
+            p->repaint = 1;
+            moved = 1;
+        }
+        p->winX = x;
+        p->winY = y;
+    }
+    // The scope panel docks in a corner clear of the grabs: where it is if it
+    // can stay, else top right, top left, bottom right or bottom left.
+    if (cs->scopeWin) {
+        int right = cs->width - SCOPE_PANEL_W - kScopeMargin;
+        int bottom = cs->height - SCOPE_PANEL_H - kScopeMargin;
+        const int corners[5][2] = { { cs->scopeX, cs->scopeY }, { right, kScopeMargin }, { kScopeMargin, kScopeMargin },
+                                    { right, bottom }, { kScopeMargin, bottom } };
+        int c = 0;
+        while (c < 5 && !clear_of_grabs(cs, corners[c][0], corners[c][1], SCOPE_PANEL_W, SCOPE_PANEL_H)) c++;
+        if (c > 0 && c < 5) {
+            XMoveWindow(g_dpy, cs->scopeWin, corners[c][0], corners[c][1]);
+            cs->scopeX = corners[c][0];
+            cs->scopeY = corners[c][1];
+            g_scopeRepaint = 1;
+            moved = 1;
+        }
+    }
+    // The grabs go out on other connections with several screens.
+    if (moved && g_screenCount > 1) XSync(g_dpy, False);
+}
+
+// Captures this frame's squares and returns a hash over all of them. The
+// cursor square's is the fold of its block hashes, which also flag the
+// blocks that changed since the last capture.
+static uint64_t capture_frame(ScreenCtx* cs, int cx, int cy) {
+    uint64_t h = 0;
+    if (g_pinCount) {
+        capture_loupes(cs, cx, cy);
+        for (int i = 0; i < g_pinCount; i++) h = (h ^ g_pins[i].hash) * 0x100000001B3ull;
+    } else {
+        capture_around(cs, cx, cy);
+    }
+    g_capScreen = cs;
+    g_capCursorX = cx;
+    g_capCursorY = cy;
+    damage_update(&g_damage, g_capData, g_capSize, g_capSize, g_capStride);
+    if (g_ruler && cs->rulerRow.img) h ^= measure_ruler(cs, cx, cy);
+    return h ^ g_damage.frameHash;
+}
+
+// Cursor position on its screen, and that screen. XQueryPointer returns False
+// when the pointer is on another screen than the window asked about, but still
+// reports that screen's root and the position on it.
+static ScreenCtx* query_cursor(int* x, int* y) {
+    Window rootRet = None, childRet;
+    int wx, wy;
+    unsigned int mask;
+    *x = 0;
+    *y = 0;
+    XQueryPointer(g_dpy, g_screens[0].root, &rootRet, &childRet, x, y, &wx, &wy, &mask);
+    for (int i = 0; i < g_screenCount; i++) {
+        if (g_screens[i].root == rootRet) return &g_screens[i];
+    }
+    return &g_screens[0];
+}
+
+// Shows the loupe on `sc` and hides it elsewhere. Every screen's window and
+// buffers already exist, so crossing screens is a map/unmap pair.
+static void show_on_screen(ScreenCtx* sc) {
+    if (g_shown == sc) return;
+    if (g_shown) {
+        XUnmapWindow(g_dpy, g_shown->win);
+        g_screenSwitches++;
+        trace_instant("screen_switch");
+    }
+    XMapRaised(g_dpy, sc->win);
+    g_shown = sc;
+}
+
+static void copy_color_and_quit(void) {
+    int x, y;
+    ScreenCtx* cs = query_cursor(&x, &y);
+
+    // Re-capture at the current position (an arrow-key nudge may have moved
+    // the cursor since the last frame) and sample the centre pixel.
+    ensure_resources();
+    place_windows(cs, x, y);
+    capture_around(cs, x, y);
+    int center = g_capSize / 2;
+    perf_start(&g_perf);
+    uint32_t c = sample_average_bgra(g_capData, g_capSize, g_capSize, g_capStride, center, center, 0);
+    char hex[8];
+    format_hex_color(c, hex);
+    perf_stop(&g_perf, &g_perfStages[STAGE_PICK], 1.0);
+
+    printf("%s\n", hex);
+    fflush(stdout);
+
+    g_quit = 1;
+}
+
+// Grabs the cursor's screen and prints the same-colour region around the
+// cursor. The screen image is kept for the next measurement on that screen.
+// Our windows on it are unmapped for the grab, and the windows they covered
+// get a moment to repaint, or the loupe would cut into the region.
+static void measure_region(void) {
+    int x, y;
+    ScreenCtx* cs = query_cursor(&x, &y);
+    if (g_fillScreen != cs) {
+        // The screen image and the fill's visited map, a byte per pixel.
+        static int told;
+        size_t want = (size_t)cs->width * (size_t)cs->height * 5, have = mem_get("fill");
+        if (want > have && !mem_allows(want - have)) {
+            mem_refused(&told, "a whole-screen grab; no region measured");
+            return;
+        }
+        destroy_image(&g_fillShot);
+        g_fillScreen = NULL;
+        if (!create_image(&g_fillShot, cs->capDpy, cs->capShm, DefaultVisual(cs->capDpy, cs->index),
+                          DefaultDepth(cs->capDpy, cs->index), cs->width, cs->height) ||
+            !image_is_bgra(g_fillShot.img)) {
+            fprintf(stderr, "Failed to create measurement image\n");
+            destroy_image(&g_fillShot);
+            return;
+        }
+        g_fillScreen = cs;
+    }
+    trace_begin("measure");
+    RegionRect r = { 0, 0, cs->width, cs->height };
+    hide_windows_over(cs, &r);
+    if (g_hiddenCount) {
+        XSync(g_dpy, False);
+        struct timespec ts = { 0, kRepaintWaitMs * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    grab_rect(cs->capDpy, cs->root, &g_fillShot, &r, 0);
+    restore_windows();
+    double t0 = now_ms();
+    FillResult fr;
+    int ok = flood_fill_bgra(&g_fill, (const uint8_t*)g_fillShot.img->data, cs->width, cs->height,
+                             g_fillShot.img->bytes_per_line, x, y, g_fillTolerance, &fr);
+    double ms = now_ms() - t0;
+    trace_end("measure");
+    if (!ok) {
+        fprintf(stderr, "Out of memory measuring the region\n");
+        return;
+    }
+    fill_count_ms(&g_fill, ms);
+    mem_set("fill", fill_bytes(&g_fill) + (size_t)g_fillShot.img->bytes_per_line * (size_t)cs->height);
+    char line[160];
+    fill_format(&fr, ms, line, sizeof(line));
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
+// Marks a point of the two-point measurement where the loupe last showed
+// the cursor, snapped to nearby edges in that frame's capture square. The
+// second point of a pair prints the measurement and starts a new pair.
+static void mark_point(void) {
+    if (!g_capData) return;  // no frame yet
+    int half = g_capSize / 2;
+    EdgePoint p = edge_snap_point(g_capData, g_capSize, g_capStride, half, half,
+                                  g_capScreen->left + g_capCursorX - half, g_capCursorY - half, EDGE_REACH,
+                                  EDGE_MIN_GRADIENT);
+    char point[64];
+    edge_format_point(&p, point, sizeof(point));
+    if (g_pointCount == 0) {
+        g_pointA = p;
+        g_pointCount = 1;
+        printf("A %s\n", point);
+    } else {
+        char line[128];
+        edge_format_pair(&g_pointA, &p, line, sizeof(line));
+        g_pointCount = 0;
+        printf("B %s\n%s\n", point, line);
+    }
+    fflush(stdout);
+}
+
+static void nudge_cursor(int dx, int dy) {
+    XWarpPointer(g_dpy, None, None, 0, 0, 0, 0, dx, dy);
+}
+
+static void handle_key_press(XKeyEvent* ke) {
+    KeySym sym = XLookupKeysym(ke, 0);
+    int step = (ke->state & ShiftMask) ? 5 : 1;
+
+    switch (sym) {
+        case XK_Return:
+        case XK_KP_Enter:
+            if (g_twoPoint) {
+                mark_point();
+            } else {
+                copy_color_and_quit();
+            }
+            break;
+        case XK_Left: nudge_cursor(-step, 0); break;
+        case XK_Right: nudge_cursor(step, 0); break;
+        case XK_Up: nudge_cursor(0, -step); break;
+        case XK_Down: nudge_cursor(0, step); break;
+        case XK_m: measure_region(); break;
+        case XK_r:
+            // The ruler draws over the loupe; the next frame composes it whole.
+            g_ruler = !g_ruler;
+            for (int i = 0; i < g_screenCount; i++) g_screens[i].drawnUpdate = 0;
+            break;
+        case XK_t:
+            g_twoPoint = !g_twoPoint;
+            g_pointCount = 0;
+            break;
+        case XK_o:
+            if (!g_ref.tiles) break;
+            g_refMode = g_refMode == LOUPE_FILTER_BLEND ? LOUPE_FILTER_DIFF
+                      : g_refMode == LOUPE_FILTER_DIFF  ? LOUPE_FILTER_NONE
+                                                         : LOUPE_FILTER_BLEND;
+            for (int i = 0; i < g_screenCount; i++) g_screens[i].drawnUpdate = 0;
+            break;
+        case XK_a:
+            g_amplify = !g_amplify;
+            for (int i = 0; i < g_screenCount; i++) g_screens[i].drawnUpdate = 0;
+            break;
+        case XK_Escape:
+            g_quit = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+// The loupe's source for a capture square: the square itself, or when zoomed
+// out a resample of the square's mip pyramid, brought up to date first.
+static const uint8_t* loupe_source(const uint8_t* cap, int capStride, MipPyramid* mip, int* stride) {
+    if (g_mipLevels == 1) {
+        *stride = capStride;
+        return cap;
+    }
+    double t0 = now_ms();
+    mip_update(mip, cap, capStride, g_srcSize, g_mipLevels);
+    double t1 = now_ms();
+    const uint8_t* src = mip_sample(mip, 1.0 / g_zoom, g_srcSize);
+    g_mipUpdateMs += t1 - t0;
+    g_mipSampleMs += now_ms() - t1;
+    *stride = g_srcSize * 4;
+    return src;
+}
+
+// Wheel up zooms in a quarter octave, wheel down zooms out. The main loop
+// draws at once; the present of that frame ends the latency measured here.
+static void zoom_by_wheel(int notches) {
+    trace_instant("wheel");
+    g_zoom = zoom_wheel_step(g_zoom, notches, 1.0 / kMaxZoomOut, (double)kMaxZoom);
+    g_wheelSteps++;
+    if (g_wheelAtMs == 0.0) g_wheelAtMs = now_ms();
+}
+
+// Compose one loupe in four separate passes (the default size fits in cache
+// whole), so --trace and --stats can show each stage.
+static void draw_loupe_stages(uint8_t* bits, int stride) {
+    // Magnify the capture (every pixel is written, no clear needed)
+    trace_begin("scale");
+    perf_start(&g_perf);
+    scale_nearest_bgra(g_srcData, g_srcSize, g_srcSize, g_srcStride,
+                       bits, g_diameter, g_diameter, stride);
+    perf_stop(&g_perf, &g_perfStages[STAGE_SCALE], (double)g_diameter * g_diameter);
+    trace_end("scale");
+
+    trace_begin("mask");
+    perf_start(&g_perf);
+    apply_circle_alpha_mask(bits, g_radius, stride);
+    perf_stop(&g_perf, &g_perfStages[STAGE_MASK], (double)g_diameter * g_diameter);
+    trace_end("mask");
+
+    // Circle border and center marker
+    trace_begin("border");
+    perf_start(&g_perf);
+    blend_circle_border(bits, g_radius, stride, kBorderWidth, pacer_antialias(&g_pacer));
+    draw_center_marker(bits, g_radius, stride, kMarkerSize);
+    perf_stop(&g_perf, &g_perfStages[STAGE_BLEND], (double)g_diameter * g_diameter);
+    trace_end("border");
+}
+
+// The pool the compose stage runs on. The perf counters follow the calling
+// thread only, so while they are open compose stays on it and is counted
+// whole; --stats says so.
+static WorkerPool* compose_pool(void) {
+    return g_perf.available ? &g_inlinePool : &g_pool;
+}
+
+// Composes the cursor loupe (unless it was patched) and every pinned loupe
+// whose square or quality level changed since it was drawn, as one pool
+// batch. A pin over still content costs one hash per frame.
+static void compose_with_pins(uint8_t* bits, int stride, int cursor) {
+    int aa = pacer_antialias(&g_pacer);
+    LoupeJob jobs[MAX_PINS + 1];
+    int n = 0;
+    if (cursor) {
+        jobs[n++] = loupe_job(g_srcData, g_srcSize, g_srcStride, bits, g_radius, stride, kBorderWidth, aa,
+                              kMarkerSize);
+        jobs[0].filter = &g_filter;
+    }
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        p->dirty = !p->shown || p->hash != p->drawnHash || aa != p->drawnAntialias || g_zoom != p->drawnZoom;
+        if (!p->dirty) {
+            g_pinSkips++;
+            continue;
+        }
+        int srcStride;
+        const uint8_t* src = loupe_source(p->capData, p->capStride, &p->mip, &srcStride);
+        jobs[n++] = loupe_job(src, g_srcSize, srcStride, (uint8_t*)p->out.img->data, g_radius,
+                              p->out.img->bytes_per_line, kBorderWidth, aa, kMarkerSize);
+        p->drawnHash = p->hash;
+        p->drawnAntialias = aa;
+        p->drawnZoom = g_zoom;
+        g_pinComposes++;
+    }
+
+    if (!n) return;
+    trace_begin("compose");
+    perf_start(&g_perf);
+    compose_loupes_tiled(compose_pool(), jobs, n);
+    perf_stop(&g_perf, &g_perfStages[STAGE_COMPOSE], (double)n * g_diameter * g_diameter);
+    trace_end("compose");
+}
+
+// The loupe in cs->out can be patched rather than composed: it was drawn
+// from the previous capture of a square the same size, at the same quality.
+// Zoomed out the loupe samples a pyramid rather than the capture, and the
+// flash diagnostic, the ruler, the onion skin's label and the amplifier
+// (whose map follows the centre pixel) change pixels of their own, so all
+// of them compose in full.
+static int loupe_can_patch(const ScreenCtx* cs, int aa) {
+    return cs->drawnUpdate && cs->drawnUpdate + 1 == g_damage.updates && cs->drawnCapSize == g_capSize &&
+           cs->drawnLevels == 1 && g_mipLevels == 1 && cs->drawnAntialias == aa && !g_flashDamage && !g_ruler &&
+           g_filter.mode == LOUPE_FILTER_NONE;
+}
+
+// Sends rectangle r = { x0, y0, x1, y1 } of the loupe to its window.
+static void put_loupe(ScreenCtx* sc, const int* r) {
+    unsigned w = (unsigned)(r[2] - r[0]), h = (unsigned)(r[3] - r[1]);
+    if (sc->out.shared) {
+        XShmPutImage(g_dpy, sc->win, sc->gc, sc->out.img, r[0], r[1], r[0], r[1], w, h, False);
+    } else {
+        XPutImage(g_dpy, sc->win, sc->gc, sc->out.img, r[0], r[1], r[0], r[1], w, h);
+    }
+}
+
+// Pinned loupes sit next to their point like the cursor loupe does. Only
+// the ones composed or moved this frame are sent; the caller's XSync covers
+// them.
+static void present_pins(void) {
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        if (!p->dirty && !p->repaint) continue;
+        if (p->out.shared) {
+            XShmPutImage(g_dpy, p->win, p->gc, p->out.img, 0, 0, 0, 0, (unsigned)g_diameter, (unsigned)g_diameter, False);
+        } else {
+            XPutImage(g_dpy, p->win, p->gc, p->out.img, 0, 0, 0, 0, (unsigned)g_diameter, (unsigned)g_diameter);
+        }
+        if (!p->shown) {
+            XMoveWindow(g_dpy, p->win, p->winX, p->winY);
+            XMapRaised(g_dpy, p->win);
+            p->shown = 1;
+        }
+        p->dirty = 0;
+        p->repaint = 0;
+    }
+}
+
+// Bins and draws the --scope panel on `cs` and sends it, unless the panel
+// there already shows this capture (no block changed since the last run).
+static void draw_scope(ScreenCtx* cs) {
+    int unchanged = g_damage.updates == g_scopeUpdate + 1 && !g_damage.changedCount;
+    g_scopeUpdate = g_damage.updates;
+    if (unchanged && g_scopeScreen == cs && !g_scopeRepaint) {
+        g_scope.skipped++;
+        return;
+    }
+    trace_begin("scope");
+    double t0 = now_ms();
+    int n;
+    const uint8_t* region = scope_region(g_capData, g_capSize, g_capStride, g_scopeRegion, &n);
+    scope_run(&g_scope, &g_pool, region, n, n, g_capStride);
+    scope_render_bgra(&g_scope, (uint8_t*)cs->scopeOut.img->data, cs->scopeOut.img->bytes_per_line);
+    scope_count_ms(&g_scope, now_ms() - t0);
+    trace_end("scope");
+
+    if (g_scopeScreen != cs) {
+        if (g_scopeScreen) XUnmapWindow(g_dpy, g_scopeScreen->scopeWin);
+        XMapRaised(g_dpy, cs->scopeWin);
+        g_scopeScreen = cs;
+    }
+    g_scopeRepaint = 0;
+    if (cs->scopeOut.shared) {
+        XShmPutImage(g_dpy, cs->scopeWin, cs->scopeGc, cs->scopeOut.img, 0, 0, 0, 0, SCOPE_PANEL_W, SCOPE_PANEL_H,
+                     False);
+    } else {
+        XPutImage(g_dpy, cs->scopeWin, cs->scopeGc, cs->scopeOut.img, 0, 0, 0, 0, SCOPE_PANEL_W, SCOPE_PANEL_H);
+    }
+}
+
+// Sets this frame's loupe filter: the difference amplifier around the
+// centre pixel, or the onion skin over the capture square centred on
+// (cx, cy) of `cs`, with the reference under it read from the mapped tiles.
+// Zoomed out the loupe samples a pyramid of the screen alone, and the onion
+// skin is not shown.
+static void select_filter(const ScreenCtx* cs, int cx, int cy) {
+    g_filter.mode = LOUPE_FILTER_NONE;
+    if (g_amplify) {
+        int half = g_capSize / 2;
+        g_amplifyBuilds += filter_amplify(&g_filter, pixel_row_const(g_capData, g_capStride, half)[half],
+                                          g_amplifyRange);
+        g_amplifyFrames++;
+        return;
+    }
+    if (!g_ref.tiles || g_refMode == LOUPE_FILTER_NONE || g_mipLevels > 1) return;
+    int half = g_capSize / 2;
+    trace_begin("reference");
+    onion_fetch(&g_ref, cs->left + cx - half - g_refX, cy - half - g_refY, g_capSize, g_refSquare, g_capSize * 4);
+    trace_end("reference");
+    g_filter.mode = g_refMode;
+    g_filter.ref = g_refSquare;
+    g_filter.refStride = g_capSize * 4;
+    g_filter.opacity = g_refOpacity;
+}
+
+// Draws the CIEDE2000 difference between the centre pixel and the reference
+// under it, unless the reference is transparent there.
+static void draw_reference_delta(uint8_t* bits, int stride) {
+    int half = g_capSize / 2;
+    uint32_t live = pixel_row_const(g_capData, g_capStride, half)[half];
+    uint32_t ref = pixel_row_const(g_refSquare, g_capSize * 4, half)[half];
+    if (!(ref >> 24)) return;
+    onion_draw_delta_e(bits, g_radius, stride, onion_delta_e(live, ref), kBorderWidth, 2);
+}
+
+static void draw_overlay_frame(void) {
+    trace_begin("frame");
+    ensure_resources();
+
+    int cx, cy;
+    ScreenCtx* cs = query_cursor(&cx, &cy);
+    place_windows(cs, cx, cy);
+
+    // Capture source square around cursor
+    trace_begin("capture");
+    uint64_t capHash = capture_frame(cs, cx, cy);
+    trace_end("capture");
+
+    if (g_mipLevels > 1) {
+        trace_begin("reduce");
+        perf_start(&g_perf);
+        g_srcData = loupe_source(g_capData, g_capStride, &g_mip, &g_srcStride);
+        perf_stop(&g_perf, &g_perfStages[STAGE_REDUCE], (double)g_capSize * g_capSize);
+        trace_end("reduce");
+        g_mipFrames++;
+    } else {
+        g_srcData = g_capData;
+        g_srcStride = g_capStride;
+    }
+    select_filter(cs, cx, cy);
+
+    uint8_t* bits = (uint8_t*)cs->out.img->data;
+    int stride = cs->out.img->bytes_per_line;
+
+    // Only blocks of the capture that changed since the last frame: patch
+    // their tiles of the loupe and present the rectangle they span.
+    int aa = pacer_antialias(&g_pacer);
+    int patch = loupe_can_patch(cs, aa);
+    int dirty[4] = { 0, 0, g_diameter, g_diameter };
+    size_t composed = (size_t)g_diameter * g_diameter;
+    if (patch) {
+        trace_begin("compose");
+        perf_start(&g_perf);
+        composed = damage_compose_loupe(&g_damage, g_srcData, g_srcStride, bits, g_radius, stride, kBorderWidth, aa,
+                                        kMarkerSize, dirty);
+        perf_stop(&g_perf, &g_perfStages[STAGE_COMPOSE], (double)composed);
+        trace_end("compose");
+    }
+    if (g_pinCount) {
+        compose_with_pins(bits, stride, !patch);
+    } else if (patch) {
+        // Patched above.
+    } else if (loupe_band_rows(stride) < g_diameter || g_filter.mode != LOUPE_FILTER_NONE) {
+        // Giant loupe: all four passes band by band on the pool, so each band
+        // stays in cache and the bands run in parallel. The filters are
+        // fused into the scale pass, so they take this path at any size.
+        trace_begin("compose");
+        perf_start(&g_perf);
+        compose_loupe_filtered_tiled(compose_pool(), &g_filter, g_srcData, g_srcSize, g_srcStride,
+                                     bits, g_radius, stride, kBorderWidth, aa, kMarkerSize);
+        perf_stop(&g_perf, &g_perfStages[STAGE_COMPOSE], (double)g_diameter * g_diameter);
+        trace_end("compose");
+    } else {
+        draw_loupe_stages(bits, stride);
+    }
+    // Zoomed out, the blocks are mapped through the capture's size rather
+    // than the pyramid's sampling; close enough for a diagnostic.
+    if (g_flashDamage) damage_flash_bgra(&g_damage, bits, g_diameter, g_diameter, stride);
+    if (g_ruler) ruler_draw_bgra(&g_rulerResult, bits, g_radius, stride, g_capSize, kBorderWidth, 2);
+    if (g_filter.mode == LOUPE_FILTER_BLEND || g_filter.mode == LOUPE_FILTER_DIFF) draw_reference_delta(bits, stride);
+    if (g_scopeRegion >= 0) draw_scope(cs);
+    cs->drawnUpdate = g_damage.updates;
+    cs->drawnCapSize = g_capSize;
+    cs->drawnLevels = g_mipLevels;
+    cs->drawnAntialias = aa;
+
+    trace_begin("present");
+    if (g_shown != cs) cs->presentAll = 1;
+    show_on_screen(cs);
+    if (!patch || cs->presentAll) {
+        dirty[0] = dirty[1] = 0;
+        dirty[2] = dirty[3] = g_diameter;
+    }
+    cs->presentAll = 0;
+    size_t presented = dirty[0] < dirty[2] ? (size_t)(dirty[2] - dirty[0]) * (size_t)(dirty[3] - dirty[1]) : 0;
+    if (presented) put_loupe(cs, dirty);
+    damage_count_frame(&g_damage, patch, composed, presented);
+    present_pins();
+    // Round-trip so the server is done reading the shared image before the
+    // next frame overwrites it.
+    XSync(g_dpy, False);
+    trace_end("present");
+    g_framesDrawn++;
+    if (g_wheelAtMs > 0.0) {
+        double ms = now_ms() - g_wheelAtMs;
+        g_wheelFrames++;
+        g_wheelTotalMs += ms;
+        if (ms > g_wheelMaxMs) g_wheelMaxMs = ms;
+        g_wheelAtMs = 0.0;
+    }
+    if (park_after_frame(&g_parker, cx, cy, capHash, now_ms())) trace_instant("park");
+    trace_end("frame");
+}
+
+// Slow-timer check while parked: re-capture and compare. Returns 1 when the
+// loop should resume.
+static int poll_for_damage(void) {
+    trace_begin("damage_poll");
+    int cx, cy;
+    ScreenCtx* cs = query_cursor(&cx, &cy);
+    uint64_t h = capture_frame(cs, cx, cy);
+    int woke = park_poll(&g_parker, cx, cy, h, now_ms());
+    trace_end("damage_poll");
+    return woke;
+}
+
+static void handle_event(XEvent* ev) {
+    switch (ev->type) {
+        case ButtonPress:
+            if (ev->xbutton.button == Button1) {
+                trace_begin("button_press");
+                if (g_twoPoint) {
+                    mark_point();
+                } else {
+                    copy_color_and_quit();
+                }
+                trace_end("button_press");
+            } else if (ev->xbutton.button == Button4 || ev->xbutton.button == Button5) {
+                zoom_by_wheel(ev->xbutton.button == Button4 ? 1 : -1);
+            }
+            break;
+        case Expose:
+            // Patched frames only send what changed; repaint the whole loupe,
+            // and the scope panel.
+            for (int i = 0; i < g_screenCount; i++) {
+                if (g_screens[i].win == ev->xexpose.window) g_screens[i].presentAll = 1;
+                if (g_screens[i].scopeWin && g_screens[i].scopeWin == ev->xexpose.window) g_scopeRepaint = 1;
+            }
+            break;
+        case KeyPress:
+            trace_begin("key_press");
+            handle_key_press(&ev->xkey);
+            trace_end("key_press");
+            break;
+        default:
+            break;
+    }
+}
+
+// Creates a w x h overlay window on `sc`'s screen and its GC in *gc; a round
+// one for loupes, a rectangle otherwise.
+static Window create_overlay_window(ScreenCtx* sc, GC* gc, int w, int h, int round) {
+    // Prefer a 32-bit ARGB visual so compositors honour the premultiplied alpha;
+    // the shape mask below keeps the loupe round without a compositor.
+    XVisualInfo vi;
+    Colormap cmap;
+    if (XMatchVisualInfo(g_dpy, sc->index, 32, TrueColor, &vi)) {
+        sc->winVisual = vi.visual;
+        sc->winDepth = 32;
+        cmap = XCreateColormap(g_dpy, sc->root, vi.visual, AllocNone);
+    } else {
+        sc->winVisual = DefaultVisual(g_dpy, sc->index);
+        sc->winDepth = DefaultDepth(g_dpy, sc->index);
+        cmap = DefaultColormap(g_dpy, sc->index);
+    }
+
+    XSetWindowAttributes attrs;
+    memset(&attrs, 0, sizeof(attrs));
+    attrs.override_redirect = True;
+    attrs.colormap = cmap;
+    attrs.border_pixel = 0;
+    attrs.background_pixel = 0;
+
+    Window win = XCreateWindow(g_dpy, sc->root, 0, 0, (unsigned)w, (unsigned)h, 0,
+                               sc->winDepth, InputOutput, sc->winVisual,
+                               CWOverrideRedirect | CWColormap | CWBorderPixel | CWBackPixel, &attrs);
+    if (!win) return 0;
+
+    XStoreName(g_dpy, win, "MinimalColorPicker");
+    XClassHint hint = { (char*)"minimal-color-picker", (char*)"MinimalColorPicker" };
+    XSetClassHint(g_dpy, win, &hint);
+
+    // Round bounding shape; empty input shape so the window is click-through.
+    if (round) {
+        Pixmap mask = XCreatePixmap(g_dpy, win, (unsigned)w, (unsigned)h, 1);
+        GC mgc = XCreateGC(g_dpy, mask, 0, NULL);
+        XSetForeground(g_dpy, mgc, 0);
+        XFillRectangle(g_dpy, mask, mgc, 0, 0, (unsigned)w, (unsigned)h);
+        XSetForeground(g_dpy, mgc, 1);
+        XFillArc(g_dpy, mask, mgc, 0, 0, (unsigned)w, (unsigned)h, 0, 360 * 64);
+        XShapeCombineMask(g_dpy, win, ShapeBounding, 0, 0, mask, ShapeSet);
+        XFreeGC(g_dpy, mgc);
+        XFreePixmap(g_dpy, mask);
+    }
+    XShapeCombineRectangles(g_dpy, win, ShapeInput, 0, 0, NULL, 0, ShapeSet, Unsorted);
+
+    XSelectInput(g_dpy, win, ExposureMask);
+    *gc = XCreateGC(g_dpy, win, 0, NULL);
+    return win;
+}
+
+// One ScreenCtx per X screen, laid out left to right in screen order. With
+// several screens each gets a private capture connection so grabs on two
+// screens can run at the same time.
+static int open_screens(void) {
+    g_screenCount = ScreenCount(g_dpy) < MAX_SCREENS ? ScreenCount(g_dpy) : MAX_SCREENS;
+    int left = 0;
+    for (int i = 0; i < g_screenCount; i++) {
+        ScreenCtx* sc = &g_screens[i];
+        sc->index = i;
+        sc->root = RootWindow(g_dpy, i);
+        sc->width = DisplayWidth(g_dpy, i);
+        sc->height = DisplayHeight(g_dpy, i);
+        sc->left = left;
+        left += sc->width;
+        sc->winX = -1;
+        sc->winY = -1;
+        if (g_screenCount == 1) {
+            sc->capDpy = g_dpy;
+            sc->capShm = g_useShm;
+        } else {
+            sc->capDpy = XOpenDisplay(DisplayString(g_dpy));
+            if (!sc->capDpy) {
+                fprintf(stderr, "Cannot open capture connection for screen %d\n", i);
+                return 0;
+            }
+            sc->capShm = XShmQueryExtension(sc->capDpy);
+        }
+        sc->win = create_overlay_window(sc, &sc->gc, g_diameter, g_diameter, 1);
+        if (!sc->win) return 0;
+        if (g_scopeRegion >= 0) {
+            sc->scopeWin = create_overlay_window(sc, &sc->scopeGc, SCOPE_PANEL_W, SCOPE_PANEL_H, 0);
+            if (!sc->scopeWin) return 0;
+            sc->scopeX = sc->width - SCOPE_PANEL_W - kScopeMargin;
+            sc->scopeY = kScopeMargin;
+            XMoveWindow(g_dpy, sc->scopeWin, sc->scopeX, sc->scopeY);
+        }
+    }
+    for (int i = 0; i < g_pinCount; i++) {
+        g_pins[i].win = create_overlay_window(&g_screens[0], &g_pins[i].gc, g_diameter, g_diameter, 1);
+        if (!g_pins[i].win) return 0;
+    }
+    return 1;
+}
+
+static void close_screens(void) {
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        destroy_image(&p->out);
+        if (p->gc) XFreeGC(g_dpy, p->gc);
+        if (p->win) XDestroyWindow(g_dpy, p->win);
+    }
+    destroy_image(&g_shared);  // before its capture connection closes
+    destroy_image(&g_fillShot);
+    for (int i = 0; i < g_screenCount; i++) {
+        ScreenCtx* sc = &g_screens[i];
+        destroy_image(&sc->cap);
+        destroy_image(&sc->out);
+        destroy_image(&sc->scopeOut);
+        destroy_image(&sc->rulerRow);
+        destroy_image(&sc->rulerBand);
+        destroy_image(&sc->watchBuf);
+        watch_free(&g_watch[i]);
+        if (sc->gc) XFreeGC(g_dpy, sc->gc);
+        if (sc->win) XDestroyWindow(g_dpy, sc->win);
+        if (sc->scopeGc) XFreeGC(g_dpy, sc->scopeGc);
+        if (sc->scopeWin) XDestroyWindow(g_dpy, sc->scopeWin);
+        if (sc->capDpy && sc->capDpy != g_dpy) XCloseDisplay(sc->capDpy);
+    }
+    free(g_stitch);
+    g_stitch = NULL;
+    for (int i = 0; i < g_pinCount; i++) {
+        mip_free(&g_pins[i].mip);
+        free(g_pins[i].edge);
+    }
+    mip_free(&g_mip);
+    damage_free(&g_damage);
+    scope_free(&g_scope);
+    fill_free(&g_fill);
+    ruler_free(&g_rulerCache);
+}
+
+static int grab_input(void) {
+    // Another client may hold a grab for a moment (e.g. the launcher); retry briefly.
+    for (int i = 0; i < 50; i++) {
+        int p = XGrabPointer(g_dpy, g_screens[0].root, False, ButtonPressMask | PointerMotionMask,
+                             GrabModeAsync, GrabModeAsync, None, None, CurrentTime);
+        if (p == GrabSuccess) {
+            if (XGrabKeyboard(g_dpy, g_screens[0].root, False, GrabModeAsync, GrabModeAsync, CurrentTime) == GrabSuccess) {
+                return 1;
+            }
+            XUngrabPointer(g_dpy, CurrentTime);
+        }
+        struct timespec ts = { 0, 20 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+static void sample_usage(UsageSample* u) {
+    u->wallMs = now_ms();
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    u->cpuMs = (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+               (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+    u->voluntaryCsw = ru.ru_nvcsw;
+    u->involuntaryCsw = ru.ru_nivcsw;
+
+    // schedstat: "<ns on cpu> <ns waiting> <timeslices>"
+    u->timeslices = -1;
+    FILE* fp = fopen("/proc/self/schedstat", "r");
+    if (fp) {
+        unsigned long long run, wait, slices;
+        if (fscanf(fp, "%llu %llu %llu", &run, &wait, &slices) == 3) u->timeslices = (long long)slices;
+        fclose(fp);
+    }
+    u->loopWakeups = g_loopWakeups;
+    u->frames = g_framesDrawn;
+    u->parkedMs = park_total_ms(&g_parker, u->wallMs);
+}
+
+static void write_idle_report(const UsageSample* a, const UsageSample* b) {
+    FILE* fp = fopen(g_idleReportPath, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open idle report %s\n", g_idleReportPath);
+        return;
+    }
+    double secs = (b->wallMs - a->wallMs) / 1000.0;
+    if (secs <= 0.0) secs = 1e-9;
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"mode\": \"%s\",\n", g_noPark ? "no_park" : "park");
+    fprintf(fp, "  \"event_driven\": %s,\n", g_eventDriven ? "true" : "false");
+    fprintf(fp, "  \"duration_s\": %.3f,\n", secs);
+    fprintf(fp, "  \"cpu_ms_per_s\": %.3f,\n", (b->cpuMs - a->cpuMs) / secs);
+    fprintf(fp, "  \"cpu_percent\": %.3f,\n", (b->cpuMs - a->cpuMs) / secs / 10.0);
+    fprintf(fp, "  \"loop_wakeups_per_s\": %.3f,\n", (double)(b->loopWakeups - a->loopWakeups) / secs);
+    if (a->timeslices >= 0 && b->timeslices >= 0) {
+        fprintf(fp, "  \"sched_timeslices_per_s\": %.3f,\n", (double)(b->timeslices - a->timeslices) / secs);
+    } else {
+        fprintf(fp, "  \"sched_timeslices_per_s\": null,\n");
+    }
+    fprintf(fp, "  \"voluntary_ctx_switches_per_s\": %.3f,\n", (double)(b->voluntaryCsw - a->voluntaryCsw) / secs);
+    fprintf(fp, "  \"involuntary_ctx_switches_per_s\": %.3f,\n", (double)(b->involuntaryCsw - a->involuntaryCsw) / secs);
+    fprintf(fp, "  \"frames_per_s\": %.3f,\n", (double)(b->frames - a->frames) / secs);
+    fprintf(fp, "  \"parked_fraction\": %.3f,\n", (b->parkedMs - a->parkedMs) / 1000.0 / secs);
+    fprintf(fp, "  \"parks\": %llu,\n", (unsigned long long)g_parker.parks);
+    fprintf(fp, "  \"input_wakes\": %llu,\n", (unsigned long long)g_parker.inputWakes);
+    fprintf(fp, "  \"damage_wakes\": %llu,\n", (unsigned long long)g_parker.damageWakes);
+    fprintf(fp, "  \"damage_polls\": %llu\n", (unsigned long long)g_parker.polls);
+    fprintf(fp, "}\n");
+    fclose(fp);
+}
+
+static void handle_signal(int sig) {
+    (void)sig;
+    g_quit = 1;
+}
+
+static void write_trace_file(void) {
+    if (!g_tracePath) return;
+    FILE* fp = fopen(g_tracePath, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open trace file %s\n", g_tracePath);
+        return;
+    }
+    trace_dump_json(fp);
+    fclose(fp);
+}
+
+static void report_stats(FILE* fp) {
+    mem_set("trace", trace_bytes());
+    pacer_report(&g_pacer, fp);
+    perf_report(&g_perf, g_perfStages, STAGE_COUNT, fp);
+    if (g_perf.available && g_pool.threads) {
+        fprintf(fp, "perf counters: compose ran on this thread, not on the %d pool workers\n", g_pool.threads);
+    }
+    pool_report(&g_pool, fp);
+    fprintf(fp, "screens: %d, %ld switches, %ld stitched frames\n", g_screenCount, g_screenSwitches,
+            g_stitchedFrames);
+    if (g_pinCount) {
+        fprintf(fp, "pins: %d pinned loupes, %.2f grabs per frame, %ld pin composes, %ld skipped unchanged\n",
+                g_pinCount, g_sharedFrames ? (double)g_sharedGrabs / (double)g_sharedFrames : 0.0, g_pinComposes,
+                g_pinSkips);
+    }
+    fprintf(fp, "zoom: %.3gx, %ld wheel steps, wheel to present %.2f ms avg, %.2f ms max\n", g_zoom, g_wheelSteps,
+            g_wheelFrames ? g_wheelTotalMs / (double)g_wheelFrames : 0.0, g_wheelMaxMs);
+    if (g_mipFrames) {
+        uint64_t reduced = g_mip.tilesReduced, clean = g_mip.tilesClean;
+        for (int i = 0; i < g_pinCount; i++) {
+            reduced += g_pins[i].mip.tilesReduced;
+            clean += g_pins[i].mip.tilesClean;
+        }
+        fprintf(fp, "mip: %ld zoomed-out frames, %.3f ms update + %.3f ms sample per frame, %llu tiles reduced, "
+                    "%llu unchanged\n",
+                g_mipFrames, g_mipUpdateMs / (double)g_mipFrames, g_mipSampleMs / (double)g_mipFrames,
+                (unsigned long long)reduced, (unsigned long long)clean);
+    }
+    damage_report(&g_damage, fp);
+    scope_report(&g_scope, fp);
+    fill_report(&g_fill, fp);
+    ruler_report(&g_rulerCache, fp);
+    if (g_amplifyFrames) {
+        fprintf(fp, "amplify: %ld frames, %ld table builds\n", g_amplifyFrames, g_amplifyBuilds);
+    }
+    park_report(&g_parker, fp, now_ms());
+    mem_report(fp);
+}
+
+static int open_control_socket(const char* path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Control socket path too long: %s\n", path);
+        return -1;
+    }
+    // Only a socket left by a previous run is replaced, never a file.
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Control path %s exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// One request per connection: the client writes a command line and reads the
+// reply until the socket closes. The command is read as it arrives from the
+// frame loop's poll, so a slow or silent client never stalls a frame; one
+// that sends nothing for kControlTimeoutMs is dropped.
+static void accept_control_client(double now) {
+    int client = accept(g_controlFd, NULL, NULL);
+    if (client < 0) return;
+    fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+    g_controlClient = client;
+    g_controlLen = 0;
+    g_controlDeadline = now + kControlTimeoutMs;
+}
+
+static void close_control_client(void) {
+    close(g_controlClient);
+    g_controlClient = -1;
+}
+
+static void answer_control_client(void) {
+    char* cmd = g_controlCmd;
+    cmd[g_controlLen] = 0;
+    cmd[strcspn(cmd, "\r\n")] = 0;
+
+    FILE* fp = fdopen(g_controlClient, "w");
+    g_controlClient = -1;
+    if (!fp) return;
+    if (strcmp(cmd, "stats") == 0) {
+        report_stats(fp);
+    } else if (strcmp(cmd, "mem") == 0) {
+        mem_set("trace", trace_bytes());
+        mem_report(fp);
+    } else {
+        fprintf(fp, "unknown command '%s' (try: stats, mem)\n", cmd);
+    }
+    fclose(fp);  // EPIPE, not SIGPIPE, if the client already left
+}
+
+static void read_control_client(void) {
+    for (;;) {
+        ssize_t n = read(g_controlClient, g_controlCmd + g_controlLen, sizeof(g_controlCmd) - 1 - g_controlLen);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            close_control_client();
+            return;
+        }
+        g_controlLen += (size_t)n;
+        if (n == 0 || g_controlLen == sizeof(g_controlCmd) - 1 || memchr(g_controlCmd, '\n', g_controlLen)) {
+            answer_control_client();
+            return;
+        }
+    }
+}
+
+// Screen holding layout point (x, y), or -1.
+static int screen_at(int x, int y) {
+    for (int i = 0; i < g_screenCount; i++) {
+        const ScreenCtx* sc = &g_screens[i];
+        if (x >= sc->left && x < sc->left + sc->width && y >= 0 && y < sc->height) return i;
+    }
+    return -1;
+}
+
+// Reads --watch POINTS and plans each screen's regions. Points are in the
+// side-by-side layout; those on no screen are skipped with a warning.
+static int load_watch_points(void) {
+    FILE* fp = fopen(g_watchPath, "r");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", g_watchPath);
+        return 0;
+    }
+    int n = 0, cap = 0, lineNo = 0, ok = 1;
+    int *xs = NULL, *ys = NULL, *screen = NULL;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), fp)) {
+        int x, y;
+        lineNo++;
+        if (!watch_parse_point(line, &x, &y)) continue;
+        int s = screen_at(x, y);
+        if (s < 0) {
+            fprintf(stderr, "%s:%d: %d,%d is on no screen, skipped\n", g_watchPath, lineNo, x, y);
+            continue;
+        }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            int* nx = (int*)realloc(xs, (size_t)cap * sizeof(int));
+            if (nx) xs = nx;
+            int* ny = (int*)realloc(ys, (size_t)cap * sizeof(int));
+            if (ny) ys = ny;
+            int* ns = (int*)realloc(screen, (size_t)cap * sizeof(int));
+            if (ns) screen = ns;
+            ok = nx && ny && ns;
+            if (!ok) break;
+        }
+        xs[n] = x - g_screens[s].left;
+        ys[n] = y;
+        screen[n] = s;
+        n++;
+    }
+    fclose(fp);
+
+    // Each screen's points, moved to the front of the arrays in turn.
+    for (int s = 0; ok && s < g_screenCount; s++) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            if (screen[i] != s) continue;
+            int t = xs[m], u = ys[m], v = screen[m];
+            xs[m] = xs[i];
+            ys[m] = ys[i];
+            screen[m] = s;
+            xs[i] = t;
+            ys[i] = u;
+            screen[i] = v;
+            m++;
+        }
+        ok = watch_plan(&g_watch[s], xs, ys, m, WATCH_CELL, REGION_GRAB_COST, 0);
+    }
+    free(xs);
+    free(ys);
+    free(screen);
+    if (!ok) fprintf(stderr, "Out of memory loading %s\n", g_watchPath);
+    return ok;
+}
+
+// Headless watch mode: samples every screen's regions at --watch-rate and
+// reports the points that changed, until interrupted or --duration.
+static int run_watch(void) {
+    if (!load_watch_points()) return 1;
+    int points = 0, regions = 0;
+    size_t bytes = 0, pixels = 0;
+    for (int s = 0; s < g_screenCount; s++) {
+        ScreenCtx* sc = &g_screens[s];
+        const WatchSet* ws = &g_watch[s];
+        points += ws->count;
+        regions += ws->regionCount;
+        pixels += ws->pixels;
+        bytes += watch_bytes(ws);
+        if (!ws->count) continue;
+        // Any image at least ws->pixels large will do: grab_rect() packs.
+        int rows = (int)((ws->pixels + (size_t)sc->width - 1) / (size_t)sc->width);
+        if (!create_image(&sc->watchBuf, sc->capDpy, sc->capShm, DefaultVisual(sc->capDpy, sc->index),
+                          DefaultDepth(sc->capDpy, sc->index), sc->width, rows) ||
+            !image_is_bgra(sc->watchBuf.img)) {
+            fprintf(stderr, "Failed to create watch image\n");
+            return 1;
+        }
+        bytes += (size_t)sc->watchBuf.img->bytes_per_line * (size_t)rows;
+    }
+    if (!points) {
+        fprintf(stderr, "No points to watch in %s\n", g_watchPath);
+        return 1;
+    }
+    mem_set("watch", bytes);
+    fprintf(stderr, "watching %d points in %d regions (%llu px per tick) at %g Hz\n", points, regions,
+            (unsigned long long)pixels, g_watchRate);
+
+    double period = 1000.0 / g_watchRate;
+    double start = now_ms(), next = start;
+    FILE* cmd = NULL;  // --watch-command, started at the first change
+    while (!g_quit) {
+        double t = now_ms();
+        if (g_durationMs > 0.0 && t - start >= g_durationMs) break;
+        if (t < next) {
+            long ns = (long)((next - t) * 1e6);
+            struct timespec ts = { ns / 1000000000L, ns % 1000000000L };
+            nanosleep(&ts, NULL);  // a signal ends it early, and the loop sees g_quit
+            continue;
+        }
+        next += period;
+        if (next <= t) next = t + period;
+
+        int changed = 0;
+        for (int s = 0; s < g_screenCount; s++) {
+            ScreenCtx* sc = &g_screens[s];
+            WatchSet* ws = &g_watch[s];
+            if (!ws->count) continue;
+            double t0 = now_ms();
+            for (int r = 0; r < ws->regionCount; r++) {
+                grab_rect(sc->capDpy, sc->root, &sc->watchBuf, &ws->regions[r], ws->offset[r]);
+            }
+            double t1 = now_ms();
+            int n = watch_check(ws, (const uint8_t*)sc->watchBuf.img->data, g_watchTolerance);
+            watch_count_ms(ws, t1 - t0, now_ms() - t1);
+            for (int e = 0; e < n; e++) {
+                char line[96];
+                watch_format_event(ws, &ws->events[e], sc->left, 0, t - start, line, sizeof(line));
+                printf("%s\n", line);
+                if (g_watchCommand && !cmd) cmd = popen(g_watchCommand, "w");
+                if (cmd) fprintf(cmd, "%s\n", line);
+            }
+            changed += n;
+        }
+        if (changed) fflush(stdout);
+        // A command that has exited is started again at the next change.
+        if (cmd && changed && fflush(cmd) != 0) {
+            pclose(cmd);
+            cmd = NULL;
+        }
+#ifdef ALLOC_AUDIT
+        alloc_audit_frame();
+#endif
+        if (g_maxFrames && ++g_frameCount >= g_maxFrames) break;
+    }
+    if (cmd) pclose(cmd);
+    if (g_stats) {
+        for (int s = 0; s < g_screenCount; s++) watch_report(&g_watch[s], stderr);
+        mem_report(stderr);
+    }
+    return 0;
+}
+
+// Maps cache file `fd` into g_ref if it holds the tiles of the PNG of this
+// size and modification time. The mapping lasts until exit.
+static int map_reference(int fd, uint64_t pngSize, int64_t pngTime) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < ONION_HEADER) return 0;
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) return 0;
+    if (!onion_attach(&g_ref, (const uint8_t*)map, (size_t)st.st_size, pngSize, pngTime)) {
+        munmap(map, (size_t)st.st_size);
+        return 0;
+    }
+    return 1;
+}
+
+// Opens --reference: maps its tile cache, PNG.tiles next to the PNG, after
+// decoding the PNG into it when the cache is missing, damaged or older than
+// the PNG. The new cache is written to a temporary file beside it and renamed
+// over the old one. Another picker may have the old one mapped, and
+// truncating it in place would fault that picker's reads. A rename also
+// replaces a symlink rather than writing through it. Where the cache cannot
+// be written, it is built in an unnamed temporary file for this run only.
+static int open_reference(void) {
+    struct stat st;
+    if (stat(g_refPath, &st) != 0) {
+        fprintf(stderr, "Cannot read reference %s\n", g_refPath);
+        return 0;
+    }
+    uint64_t pngSize = (uint64_t)st.st_size;
+    int64_t pngTime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    // A path too long for ".tiles" gets no cache file: cut short, it could
+    // name the PNG itself, which the cache would then overwrite.
+    char cachePath[PATH_MAX];
+    int n = snprintf(cachePath, sizeof(cachePath), "%s.tiles", g_refPath);
+    int cacheable = n > 0 && (size_t)n < sizeof(cachePath);
+    int fd = cacheable ? open(cachePath, O_RDONLY) : -1;
+    if (fd >= 0) {
+        int ok = map_reference(fd, pngSize, pngTime);
+        close(fd);
+        if (ok) return 1;
+    }
+
+    double t0 = now_ms();
+    FILE* fp = fopen(g_refPath, "rb");
+    uint8_t* data = (uint8_t*)malloc(pngSize ? (size_t)pngSize : 1);
+    size_t got = fp && data ? fread(data, 1, (size_t)pngSize, fp) : 0;
+    if (fp) fclose(fp);
+    int w = 0, h = 0;
+    uint8_t* px = got == pngSize ? png_decode_bgra(data, (size_t)pngSize, &w, &h) : NULL;
+    free(data);
+    if (!px) {
+        fprintf(stderr, "Cannot decode reference %s (want an 8 or 16-bit, non-interlaced PNG)\n", g_refPath);
+        return 0;
+    }
+    char tmpPath[PATH_MAX];
+    FILE* out = NULL;
+    n = snprintf(tmpPath, sizeof(tmpPath), "%s.XXXXXX", cachePath);
+    if (cacheable && n > 0 && (size_t)n < sizeof(tmpPath)) {
+        // mkstemp() creates it 0600; give it the mode fopen() would have.
+        mode_t mask = umask(0);
+        umask(mask);
+        int tmpFd = mkstemp(tmpPath);
+        if (tmpFd >= 0) fchmod(tmpFd, 0666 & ~mask);
+        if (tmpFd >= 0 && !(out = fdopen(tmpFd, "w+b"))) {
+            close(tmpFd);
+            unlink(tmpPath);
+        }
+    }
+    int named = out != NULL;
+    if (!out) out = tmpfile();
+    int ok = out && onion_cache_write(out, px, w, h, pngSize, pngTime);
+    // Failing to rename only costs the next run a rebuild.
+    if (named && (!ok || rename(tmpPath, cachePath) != 0)) unlink(tmpPath);
+    ok = ok && map_reference(fileno(out), pngSize, pngTime);
+    free(px);
+    if (out) fclose(out);
+    if (!ok) {
+        fprintf(stderr, "Cannot write the tile cache of %s\n", g_refPath);
+        return 0;
+    }
+    if (g_stats) fprintf(stderr, "reference: %dx%d decoded and tiled in %.1f ms\n", w, h, now_ms() - t0);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            g_tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--event-driven") == 0) {
+            g_eventDriven = 1;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            g_maxFrames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            g_stats = 1;
+        } else if (strcmp(argv[i], "--mem-cap") == 0 && i + 1 < argc) {
+            mem_set_cap((size_t)(atof(argv[++i]) * 1048576.0));
+        } else if (strcmp(argv[i], "--control") == 0 && i + 1 < argc) {
+            g_controlPath = argv[++i];
+        } else if (strcmp(argv[i], "--no-park") == 0) {
+            g_noPark = 1;
+        } else if (strcmp(argv[i], "--idle-report") == 0 && i + 1 < argc) {
+            g_idleReportPath = argv[++i];
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            g_durationMs = atof(argv[++i]) * 1000.0;
+        } else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc) {
+            g_radius = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--zoom") == 0 && i + 1 < argc) {
+            g_zoom = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            g_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--flash-damage") == 0) {
+            g_flashDamage = 1;
+        } else if (strcmp(argv[i], "--scope") == 0 && i + 1 < argc) {
+            g_scopeRegion = atoi(argv[++i]);
+            if (g_scopeRegion < 0) g_scopeRegion = 0;
+        } else if (strcmp(argv[i], "--fill-tolerance") == 0 && i + 1 < argc) {
+            g_fillTolerance = atoi(argv[++i]);
+            if (g_fillTolerance < 0) g_fillTolerance = 0;
+            if (g_fillTolerance > 255) g_fillTolerance = 255;
+        } else if (strcmp(argv[i], "--ruler") == 0) {
+            g_ruler = 1;
+        } else if (strcmp(argv[i], "--ruler-tolerance") == 0 && i + 1 < argc) {
+            g_rulerTolerance = atoi(argv[++i]);
+            if (g_rulerTolerance < 0) g_rulerTolerance = 0;
+            if (g_rulerTolerance > 255) g_rulerTolerance = 255;
+        } else if (strcmp(argv[i], "--two-point") == 0) {
+            g_twoPoint = 1;
+        } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            g_watchPath = argv[++i];
+        } else if (strcmp(argv[i], "--watch-rate") == 0 && i + 1 < argc) {
+            g_watchRate = atof(argv[++i]);
+            if (!(g_watchRate >= 0.1)) g_watchRate = 0.1;
+            if (g_watchRate > 1000.0) g_watchRate = 1000.0;
+        } else if (strcmp(argv[i], "--watch-tolerance") == 0 && i + 1 < argc) {
+            g_watchTolerance = atoi(argv[++i]);
+            if (g_watchTolerance < 0) g_watchTolerance = 0;
+            if (g_watchTolerance > 255) g_watchTolerance = 255;
+        } else if (strcmp(argv[i], "--watch-command") == 0 && i + 1 < argc) {
+            g_watchCommand = argv[++i];
+        } else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc) {
+            g_refPath = argv[++i];
+        } else if (strcmp(argv[i], "--reference-origin") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d", &g_refX, &g_refY) != 2) {
+                fprintf(stderr, "Ignoring --reference-origin %s (want X,Y)\n", argv[i]);
+                g_refX = g_refY = 0;
+            }
+        } else if (strcmp(argv[i], "--reference-opacity") == 0 && i + 1 < argc) {
+            int percent = atoi(argv[++i]);
+            if (percent < 0) percent = 0;
+            if (percent > 100) percent = 100;
+            g_refOpacity = (percent * 128 + 50) / 100;
+        } else if (strcmp(argv[i], "--amplify") == 0) {
+            g_amplify = 1;
+        } else if (strcmp(argv[i], "--amplify-range") == 0 && i + 1 < argc) {
+            g_amplifyRange = atoi(argv[++i]);
+            if (g_amplifyRange < 1) g_amplifyRange = 1;
+            if (g_amplifyRange > 128) g_amplifyRange = 128;
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc) {
+            int x, y;
+            if (sscanf(argv[++i], "%d,%d", &x, &y) == 2 && g_pinCount < MAX_PINS) {
+                g_pins[g_pinCount].x = x;
+                g_pins[g_pinCount].y = y;
+                g_pinCount++;
+            } else {
+                fprintf(stderr, "Ignoring --pin %s (want X,Y, at most %d pins)\n", argv[i], MAX_PINS);
+            }
+        }
+    }
+    if (g_radius <= 0) g_radius = kDefaultRadius;
+    if (g_radius < kMinRadius) g_radius = kMinRadius;
+    if (g_radius > kMaxRadius) g_radius = kMaxRadius;
+    g_diameter = g_radius * 2;
+    g_style.radius = g_radius;
+    g_style.maxRadius = kMaxRadius;
+    g_style.borderWidth = kBorderWidth;
+    g_style.markerSize = kMarkerSize;
+    g_style.offset = kOffsetX;
+    if (g_zoom <= 0.0) g_zoom = kDefaultZoom;
+    if (g_zoom > kMaxZoom) g_zoom = kMaxZoom;
+    if (g_zoom < 1.0 / kMaxZoomOut) g_zoom = 1.0 / kMaxZoomOut;
+    srgb_tables();
+    if (g_refPath && !open_reference()) return 1;
+    pacer_init(&g_pacer, (double)kTickMs);
+    perf_counters_init(&g_perf);
+    if (g_stats) perf_counters_open(&g_perf);
+    park_init(&g_parker, !g_noPark);
+
+    // SIGINT/SIGTERM end the loop normally so reports still get written.
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    // A --control client or --watch-command that goes away without reading
+    // must not kill the picker: the write fails with EPIPE instead.
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    // Capture connections for other screens are used from pool threads.
+    XInitThreads();
+    g_dpy = XOpenDisplay(NULL);
+    if (!g_dpy) {
+        fprintf(stderr, "Cannot open display\n");
+        return 1;
+    }
+    g_useShm = XShmQueryExtension(g_dpy);
+
+    if (!open_screens()) return 1;
+    if (g_watchPath) {
+        int status = run_watch();
+        close_screens();
+        XCloseDisplay(g_dpy);
+#ifdef ALLOC_AUDIT
+        if (status == 0 && alloc_audit_report(stderr)) return 3;
+#endif
+        return status;
+    }
+    ensure_resources();
+
+    // Size trace history last, from what the cap leaves once the display
+    // connection and frame buffers are resident.
+    if (g_tracePath) {
+        trace_enable(trace_events_for_bytes(mem_history_budget(TRACE_DEFAULT_EVENTS * sizeof(TraceEvent))));
+        trace_thread_name("ui");
+    }
+    if (g_controlPath) g_controlFd = open_control_socket(g_controlPath);
+    pool_init(&g_pool, g_threads < 0 ? pool_default_threads() : g_threads);
+    pool_init(&g_inlinePool, 0);
+
+    // The first frame places the window near the cursor before mapping it,
+    // to avoid a flash at (0,0).
+    draw_overlay_frame();
+
+    if (!grab_input()) {
+        fprintf(stderr, "Failed to grab pointer/keyboard\n");
+    }
+
+    int fd = ConnectionNumber(g_dpy);
+    double start = now_ms();
+    double next = start;
+    double nextDamagePoll = start;
+    UsageSample idleStart;
+    int idleSettled = 0;
+    sample_usage(&idleStart);
+
+    while (!g_quit) {
+        int motion = 0;
+        int input = 0;
+        while (!g_quit && XPending(g_dpy)) {
+            XEvent ev;
+            XNextEvent(g_dpy, &ev);
+            if (ev.type == MotionNotify) motion = 1;
+            // An exposed loupe needs a present, so it wakes a parked loop too.
+            if (ev.type == MotionNotify || ev.type == KeyPress || ev.type == ButtonPress || ev.type == Expose) {
+                input = 1;
+            }
+            handle_event(&ev);
+        }
+        if (g_quit) break;
+
+        double t = now_ms();
+        if (g_durationMs > 0.0 && t - start >= g_durationMs) break;
+        if (!idleSettled && t - start >= kIdleSettleMs) {
+            sample_usage(&idleStart);
+            idleSettled = 1;
+        }
+
+        if (g_parker.parked) {
+            int resume = 0;
+            if (input) {
+                resume = park_wake(&g_parker, t);
+            } else if (t >= nextDamagePoll) {
+                resume = poll_for_damage();
+                nextDamagePoll = t + PARK_POLL_MS;
+            }
+            if (resume) {
+                trace_instant("unpark");
+                pacer_resume(&g_pacer);
+                next = t; // draw now
+            }
+        }
+
+        int tick = !g_parker.parked && t >= next;
+        if (tick || (!g_parker.parked && ((g_eventDriven && motion) || g_wheelAtMs > 0.0))) {
+            int render = 1;
+            if (tick) {
+                trace_instant("tick");
+                render = pacer_tick(&g_pacer, pacer_now_ms());
+                next += kTickMs;
+                if (next <= t) next = t + kTickMs;
+            }
+            if (render) {
+                pacer_frame_begin(&g_pacer, pacer_now_ms());
+                draw_overlay_frame();
+                pacer_frame_end(&g_pacer, pacer_now_ms());
+#ifdef ALLOC_AUDIT
+                alloc_audit_frame();
+#endif
+                if (g_maxFrames && ++g_frameCount >= g_maxFrames) g_quit = 1;
+                if (g_parker.parked) nextDamagePoll = now_ms() + PARK_POLL_MS;
+            }
+            continue;
+        }
+
+        double wake = g_parker.parked ? nextDamagePoll : next;
+        if (g_controlClient >= 0) {
+            if (t >= g_controlDeadline) {
+                close_control_client();
+            } else if (g_controlDeadline < wake) {
+                wake = g_controlDeadline;
+            }
+        }
+        // The listener waits while a client's command is still arriving.
+        int controlFd = g_controlClient >= 0 ? g_controlClient : g_controlFd;
+        struct pollfd pfds[2] = { { fd, POLLIN, 0 }, { controlFd, POLLIN, 0 } };
+        int nfds = g_controlFd >= 0 ? 2 : 1;
+        if (poll(pfds, (nfds_t)nfds, (int)(wake - t) + 1) > 0 && nfds == 2 && (pfds[1].revents & (POLLIN | POLLHUP))) {
+            if (g_controlClient >= 0) {
+                read_control_client();
+            } else {
+                accept_control_client(now_ms());
+            }
+        }
+        g_loopWakeups++;
+    }
+
+    XUngrabKeyboard(g_dpy, CurrentTime);
+    XUngrabPointer(g_dpy, CurrentTime);
+
+    pool_destroy(&g_pool);
+    pool_destroy(&g_inlinePool);
+    write_trace_file();
+    if (g_stats) report_stats(stderr);
+    perf_counters_close(&g_perf);
+    if (g_idleReportPath) {
+        UsageSample idleEnd;
+        sample_usage(&idleEnd);
+        write_idle_report(&idleStart, &idleEnd);
+    }
+    if (g_controlClient >= 0) close_control_client();
+    if (g_controlFd >= 0) {
+        close(g_controlFd);
+        unlink(g_controlPath);
+    }
+
+    close_screens();
+    XCloseDisplay(g_dpy);
+#ifdef ALLOC_AUDIT
+    if (alloc_audit_report(stderr)) return 3;
+#endif
+    return 0;
+}
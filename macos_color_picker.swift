@@ -9,6 +9,12 @@
 // - Shows a circular magnifier near the cursor.
 // - Left click: copies center pixel color as #RRGGBB to clipboard and exits.
 // - Arrow keys: nudge cursor by 1px (Shift for 5px). Esc exits.
+// - Every display has its own capture stream for the life of the picker, so
+//   crossing between displays is instant and a loupe straddling two displays
+//   is stitched from both.
+// - Retina: streams capture physical pixels and the loupe is backed at the
+//   cursor display's scale, so --zoom counts physical pixels and the only
+//   resample is the magnification itself. --radius stays in points.
 //
 // Notes:
 // - On recent macOS versions, global mouse/key monitoring may require
@@ -18,33 +24,139 @@
 import AppKit
 import CoreGraphics
 import Foundation
+import IOSurface
+import QuartzCore
 import ScreenCaptureKit
 
 // MARK: - StreamOutput for ScreenCaptureKit
 
 final class StreamOutput: NSObject, SCStreamOutput {
-    private let onFrame: (CGImage) -> Void
-    private let ciContext = CIContext()
-    
-    init(onFrame: @escaping (CGImage) -> Void) {
+    private let onFrame: (CVPixelBuffer) -> Void
+
+    init(onFrame: @escaping (CVPixelBuffer) -> Void) {
         self.onFrame = onFrame
         super.init()
     }
-    
+
     func stream(_ stream: SCStream, didOutputSampleBuffer sampleBuffer: CMSampleBuffer, of type: SCStreamOutputType) {
         guard type == .screen,
               let imageBuffer = CMSampleBufferGetImageBuffer(sampleBuffer) else { return }
-        
-        let ciImage = CIImage(cvPixelBuffer: imageBuffer)
-        let rect = CGRect(x: 0, y: 0,
-                          width: CVPixelBufferGetWidth(imageBuffer),
-                          height: CVPixelBufferGetHeight(imageBuffer))
-        
-        guard let cgImage = ciContext.createCGImage(ciImage, from: rect) else { return }
-        onFrame(cgImage)
+
+        // Hand over the stream's own (pooled, IOSurface-backed) buffer; no
+        // per-frame image is created. Holding the latest one keeps a single
+        // pool slot busy, which the stream's queue depth allows for.
+        onFrame(imageBuffer)
     }
 }
 
+// MARK: - Per-display capture
+
+/// One warm ScreenCaptureKit stream per display. Every display keeps its
+/// stream running for the life of the picker, so moving the cursor to another
+/// display never stops or starts a stream; displays away from the loupe just
+/// drop to a low frame rate. Frames are read under `lock`: written on the
+/// stream's queue, read on the main thread.
+final class DisplayCapture {
+    let displayID: CGDirectDisplayID
+    let frame: CGRect              // global Quartz coordinates (origin top-left)
+    let pixelWidth: Int            // native mode, not points
+    let pixelHeight: Int
+    let scale: CGFloat             // pixels per point
+
+    private let display: SCDisplay
+    private var stream: SCStream?
+    private var output: StreamOutput?
+    private var latest: CVPixelBuffer?
+    private let lock = NSLock()
+    private var active = false
+
+    static let activeInterval = CMTime(value: 1, timescale: 60)
+    static let idleInterval = CMTime(value: 1, timescale: 4)
+
+    init(display: SCDisplay) {
+        self.display = display
+        self.displayID = display.displayID
+        self.frame = display.frame
+        let mode = CGDisplayCopyDisplayMode(display.displayID)
+        self.pixelWidth = mode?.pixelWidth ?? display.width
+        self.pixelHeight = mode?.pixelHeight ?? display.height
+        self.scale = CGFloat(pixelWidth) / CGFloat(max(1, display.width))
+    }
+
+    private func configuration(active: Bool) -> SCStreamConfiguration {
+        let config = SCStreamConfiguration()
+        // Physical pixels: a stream sized in points would be scaled down by
+        // the OS and then scaled up again by the loupe.
+        config.width = max(1, pixelWidth)
+        config.height = max(1, pixelHeight)
+        config.pixelFormat = kCVPixelFormatType_32BGRA
+        // Frames are read directly (no CGImage conversion), so ask for sRGB.
+        config.colorSpaceName = CGColorSpace.sRGB
+        config.showsCursor = false
+        config.minimumFrameInterval = active ? DisplayCapture.activeInterval : DisplayCapture.idleInterval
+        return config
+    }
+
+    func start(excluding windows: [SCWindow], active: Bool) async {
+        self.active = active
+        let filter = SCContentFilter(display: display, excludingWindows: windows)
+        let stream = SCStream(filter: filter, configuration: configuration(active: active), delegate: nil)
+        let output = StreamOutput { [weak self] buffer in
+            self?.setLatest(buffer)
+        }
+        self.stream = stream
+        self.output = output
+        do {
+            try stream.addStreamOutput(output, type: .screen, sampleHandlerQueue: .global())
+            try await stream.startCapture()
+        } catch {
+            print("ScreenCaptureKit startCapture error (display \(displayID)): \(error)")
+        }
+    }
+
+    /// Full rate while the loupe is on or near this display, a trickle
+    /// otherwise. Reconfigures the running stream in place.
+    func setActive(_ active: Bool) {
+        guard active != self.active, let stream else { return }
+        self.active = active
+        stream.updateConfiguration(configuration(active: active)) { error in
+            if let error { print("ScreenCaptureKit updateConfiguration error: \(error)") }
+        }
+    }
+
+    func stop() {
+        stream?.stopCapture()
+        stream = nil
+        setLatest(nil)
+    }
+
+    private func setLatest(_ buffer: CVPixelBuffer?) {
+        lock.lock()
+        latest = buffer
+        lock.unlock()
+    }
+
+    func currentFrame() -> CVPixelBuffer? {
+        lock.lock()
+        defer { lock.unlock() }
+        return latest
+    }
+}
+
+/// A locked capture frame placed on the loupe's pixel grid (global points
+/// times the cursor display's scale), for stitching.
+private struct CaptureSource {
+    var base: UnsafeMutableRawPointer
+    var x: Int                     // origin on the grid, when sameScale
+    var y: Int
+    var width: Int                 // in the display's own pixels
+    var height: Int
+    var bytesPerRow: Int
+    var frame: CGRect              // in points
+    var scale: CGFloat
+    var sameScale: Bool            // same pixels per point as the grid
+}
+
 private func eventTapCallback(
     proxy: CGEventTapProxy,
     type: CGEventType,
@@ -73,53 +185,124 @@ private func eventTapCallback(
 }
 
 final class MagnifierView: NSView {
-    var image: CGImage?
     var borderWidth: CGFloat = 2
 
-    override func draw(_ dirtyRect: NSRect) {
-        guard let ctx = NSGraphicsContext.current?.cgContext else { return }
-
-        let bounds = self.bounds
-        let radius = min(bounds.width, bounds.height) / 2
-        let center = CGPoint(x: bounds.midX, y: bounds.midY)
+    // Circle mask, border and centre marker are static layers; only the
+    // magnified pixels change per frame.
+    private let contentLayer = CALayer()
+    private let markerLayer = CALayer()
+
+    // Two IOSurfaces so we never write into the one the compositor is showing.
+    private var surfaces: [IOSurface] = []
+    private var surfacePixels = 0
+    private var frontIndex = 0
+
+    override init(frame frameRect: NSRect) {
+        super.init(frame: frameRect)
+
+        let root = CALayer()
+        layer = root
+        wantsLayer = true
+        root.backgroundColor = NSColor.clear.cgColor
+
+        contentLayer.frame = bounds
+        contentLayer.cornerRadius = min(bounds.width, bounds.height) / 2
+        contentLayer.masksToBounds = true
+        contentLayer.borderColor = NSColor.white.cgColor
+        contentLayer.borderWidth = borderWidth
+        contentLayer.magnificationFilter = .nearest
+        contentLayer.actions = ["contents": NSNull()]
+        root.addSublayer(contentLayer)
 
-        ctx.clear(bounds)
-
-        // Clip to circle
-        ctx.saveGState()
-        let circle = CGPath(ellipseIn: bounds.insetBy(dx: borderWidth / 2, dy: borderWidth / 2), transform: nil)
-        ctx.addPath(circle)
-        ctx.clip()
+        let m: CGFloat = 6
+        markerLayer.frame = CGRect(x: bounds.midX - m/2, y: bounds.midY - m/2, width: m, height: m)
+        markerLayer.borderColor = NSColor.white.cgColor
+        markerLayer.borderWidth = 1
+        root.addSublayer(markerLayer)
+    }
 
-        if let img = image {
-            ctx.interpolationQuality = .none
-            ctx.setShouldAntialias(false)
-            ctx.draw(img, in: bounds)
+    /// Backs the loupe with `pixels` x `pixels` surfaces shown at `scale`
+    /// pixels per point, one surface pixel per display pixel. Reallocates
+    /// only when the cursor moves to a display of another scale. Border and
+    /// marker are layer properties in points and follow by themselves.
+    func setBacking(pixels: Int, scale: CGFloat) {
+        guard pixels != surfacePixels else { return }
+        surfaces.removeAll()
+        for _ in 0..<2 {
+            let props: [IOSurfacePropertyKey: Any] = [
+                .width: pixels,
+                .height: pixels,
+                .bytesPerElement: 4,
+                .pixelFormat: kCVPixelFormatType_32BGRA,
+            ]
+            if let surface = IOSurface(properties: props) {
+                surfaces.append(surface)
+            }
         }
-        ctx.restoreGState()
+        surfacePixels = pixels
+        contentLayer.contentsScale = scale
+    }
 
-        // Border
-        ctx.setShouldAntialias(true)
-        ctx.setStrokeColor(NSColor.white.cgColor)
-        ctx.setLineWidth(borderWidth)
-        ctx.strokeEllipse(in: bounds.insetBy(dx: borderWidth / 2, dy: borderWidth / 2))
+    required init?(coder: NSCoder) {
+        fatalError("init(coder:) is not supported")
+    }
 
-        // Center marker (small square)
-        let m: CGFloat = 6
-        let marker = CGRect(x: center.x - m/2, y: center.y - m/2, width: m, height: m)
-        ctx.setFillColor(NSColor.clear.cgColor)
-        ctx.setStrokeColor(NSColor.white.cgColor)
-        ctx.setLineWidth(1)
-        ctx.stroke(marker)
+    /// Renders into the back surface via `fill(base, bytesPerRow)` and shows it.
+    func present(_ fill: (UnsafeMutableRawPointer, Int) -> Void) {
+        guard surfaces.count == 2 else { return }
+        let back = surfaces[1 - frontIndex]
+        back.lock(options: [], seed: nil)
+        fill(back.baseAddress, back.bytesPerRow)
+        back.unlock(options: [], seed: nil)
 
-        // Optional subtle crosshair? (Not requested) -> omit
-        _ = radius
+        contentLayer.contents = back
+        frontIndex = 1 - frontIndex
     }
 }
 
+/// Integer value of `--name N` on the command line, clamped to `range`.
+private func intArgument(_ name: String, default value: Int, range: ClosedRange<Int>) -> Int {
+    let args = CommandLine.arguments
+    guard let i = args.firstIndex(of: name), i + 1 < args.count, let v = Int(args[i + 1]) else { return value }
+    return min(max(v, range.lowerBound), range.upperBound)
+}
+
+/// Value of `--name X` on the command line, or `value` when absent.
+private func doubleArgument(_ name: String, default value: Double) -> Double {
+    let args = CommandLine.arguments
+    guard let i = args.firstIndex(of: name), i + 1 < args.count, let v = Double(args[i + 1]), v > 0 else { return value }
+    return v
+}
+
+/// sRGB byte -> linear light * 65535, and (linear * 65535) >> 4 -> sRGB byte,
+/// for the zoom-out box filter. Mirrors srgb_tables() in picker_downsample.h.
+private let srgbToLinear: [UInt32] = (0..<256).map { c in
+    let v = Double(c) / 255
+    let l = v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4)
+    return UInt32(l * 65535 + 0.5)
+}
+private let linearToSrgb: [UInt8] = {
+    var t = (0..<4096).map { i -> UInt8 in
+        let l = (Double(i) + 0.5) / 4096
+        let v = (l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1 / 2.4) - 0.055) * 255 + 0.5
+        return UInt8(min(v, 255))
+    }
+    for c in 0..<256 { t[Int(srgbToLinear[c] >> 4)] = UInt8(c) }
+    return t
+}()
+
+/// Destination bytes per band when a giant loupe is scaled in parallel
+/// (POOL_BAND_BYTES in picker_pool.h).
+private let bandBytes = 256 * 1024
+
 final class AppDelegate: NSObject, NSApplicationDelegate {
-    private let radius: CGFloat = 120
-    private let zoom: CGFloat = 8
+    // --radius 16...1024 points and --zoom 1...64 physical pixels per screen
+    // pixel; --zoom 0.5, 0.25 or 0.125 zooms out by box-filtering a 2, 4 or 8
+    // times larger square. The loupe is at most 2048 pixels across.
+    private let radius = CGFloat(intArgument("--radius", default: 120, range: 16...1024))
+    private let zoom = CGFloat(min(max(doubleArgument("--zoom", default: 8).rounded(.down), 1), 64))
+    private let zoomOut = doubleArgument("--zoom", default: 8) < 1
+        ? min(max(Int((1 / doubleArgument("--zoom", default: 8)).rounded()), 2), 8) : 1
     private let tick: TimeInterval = 1.0 / 60.0
     private let offset = CGPoint(x: 40, y: 40)
 
@@ -131,14 +314,18 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
     private var eventTapSource: CFRunLoopSource?
     
     private var scContent: SCShareableContent?
-    private var scStream: SCStream?
-    private var streamOutput: StreamOutput?
-    private var latestFrame: CGImage?
-    private let frameQueue = DispatchQueue(label: "minimalColorPicker.latestFrame")
-    private var captureDisplayFrame: CGRect = .zero
-    private var captureDisplayID: CGDirectDisplayID?
-    private let captureSwitchQueue = DispatchQueue(label: "minimalColorPicker.captureSwitch")
-    private var isSwitchingCapture: Bool = false
+    // One stream per display (see DisplayCapture). Main thread only.
+    private var captures: [DisplayCapture] = []
+    // Frames locked for the current scale, reused so frames don't allocate.
+    private var sources: [CaptureSource] = []
+    private var lockedFrames: [CVPixelBuffer] = []
+    // Zoom-out: the box-filtered square and its per-pixel accumulators.
+    private var reduced: [UInt32] = []
+    private var reduceAcc: [SIMD4<UInt32>] = []
+    private var screens: [NSScreen] = []
+    private var primaryScreenHeight: CGFloat = 0
+    // Pixels per point of the display under the cursor: the loupe's grid.
+    private var gridScale: CGFloat = 1
 
     func applicationDidFinishLaunching(_ notification: Notification) {
         NSApp.setActivationPolicy(.accessory)
@@ -160,10 +347,19 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
         window.ignoresMouseEvents = true
 
         view = MagnifierView(frame: rect)
-        view.wantsLayer = true
-        view.layer?.backgroundColor = NSColor.clear.cgColor
         window.contentView = view
 
+        // NSScreen.screens builds a new array per call; cache it and refresh on changes.
+        refreshScreens()
+        NotificationCenter.default.addObserver(
+            forName: NSApplication.didChangeScreenParametersNotification,
+            object: nil,
+            queue: .main
+        ) { [weak self] _ in
+            self?.refreshScreens()
+            self?.setupScreenCapture()
+        }
+
         // Place the window near the cursor before showing it to avoid a flash at (0,0).
         positionWindowNearCursor()
         window.makeKeyAndOrderFront(nil)
@@ -191,7 +387,7 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
 
     func applicationWillTerminate(_ notification: Notification) {
         timer?.invalidate()
-        scStream?.stopCapture()
+        stopCaptures()
         stopEventTap()
     }
 
@@ -230,20 +426,34 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
         eventTap = nil
     }
     
+    /// Starts one stream per display. Also called when the display layout
+    /// changes, which is the only time streams are torn down.
     private func setupScreenCapture() {
-        Task {
+        Task { @MainActor in
             do {
                 let content = try await SCShareableContent.excludingDesktopWindows(false, onScreenWindowsOnly: true)
                 self.scContent = content
-
-                // Start capturing the display under the cursor.
-                self.switchCaptureDisplayIfNeeded(force: true)
+                self.stopCaptures()
+
+                let cursorQ = self.currentCursorQuartz()
+                let excluded = self.excludedWindowsForCapture()
+                self.captures = content.displays.map { DisplayCapture(display: $0) }
+                self.sources.reserveCapacity(self.captures.count)
+                self.lockedFrames.reserveCapacity(self.captures.count)
+                for capture in self.captures {
+                    await capture.start(excluding: excluded, active: capture.frame.contains(cursorQ))
+                }
             } catch {
                 print("ScreenCaptureKit error: \(error)")
             }
         }
     }
 
+    private func stopCaptures() {
+        for capture in captures { capture.stop() }
+        captures.removeAll()
+    }
+
     private func excludedWindowsForCapture() -> [SCWindow] {
         // When running as a CLI tool, bundleIdentifier may be nil; in that case, don't exclude.
         guard let content = scContent else { return [] }
@@ -251,84 +461,10 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
         return content.windows.filter { $0.owningApplication?.bundleIdentifier == bundleID }
     }
 
-    private func switchCaptureDisplayIfNeeded(force: Bool = false) {
-        guard let content = scContent else { return }
-        let cursorQ = currentCursorQuartz()
-        guard let display = content.displays.first(where: { $0.frame.contains(cursorQ) }) ?? content.displays.first else { return }
-
-        let newID = display.displayID
-        if !force, let currentID = captureDisplayID, currentID == newID {
-            return
-        }
-
-        var shouldStart = false
-        captureSwitchQueue.sync {
-            if !isSwitchingCapture {
-                isSwitchingCapture = true
-                shouldStart = true
-            }
-        }
-        if !shouldStart { return }
-
-        Task {
-            defer {
-                captureSwitchQueue.sync {
-                    isSwitchingCapture = false
-                }
-            }
-
-            // Stop previous stream (best-effort).
-            if let oldStream = scStream {
-                do {
-                    try await oldStream.stopCapture()
-                } catch {
-                    // Ignore stop errors; we'll attempt to start a new stream anyway.
-                }
-            }
-            scStream = nil
-
-            // Clear stale frame so we don't crop against the wrong display.
-            frameQueue.sync {
-                latestFrame = nil
-            }
-
-            captureDisplayFrame = display.frame
-            captureDisplayID = newID
-
-            let filter = SCContentFilter(display: display, excludingWindows: excludedWindowsForCapture())
-            let config = SCStreamConfiguration()
-            config.width = max(1, display.width)
-            config.height = max(1, display.height)
-            config.pixelFormat = kCVPixelFormatType_32BGRA
-            config.showsCursor = false
-            config.minimumFrameInterval = CMTime(value: 1, timescale: 60)
-
-            let stream = SCStream(filter: filter, configuration: config, delegate: nil)
-            scStream = stream
-
-            let output: StreamOutput
-            if let existing = streamOutput {
-                output = existing
-            } else {
-                output = StreamOutput { [weak self] image in
-                    self?.frameQueue.async {
-                        self?.latestFrame = image
-                    }
-                }
-                streamOutput = output
-            }
-
-            do {
-                try stream.addStreamOutput(output, type: .screen, sampleHandlerQueue: .global())
-                try await stream.startCapture()
-            } catch {
-                print("ScreenCaptureKit startCapture error: \(error)")
-            }
-        }
-    }
-
     fileprivate func handleKey(keyCode: Int, flags: CGEventFlags) {
-        let step: CGFloat = flags.contains(.maskShift) ? 5 : 1
+        // One physical pixel per press, so every pixel of a Retina display
+        // can be reached.
+        let step: CGFloat = (flags.contains(.maskShift) ? 5 : 1) / gridScale
         let loc = currentCursorQuartz() // global, origin top-left
 
         var dx: CGFloat = 0
@@ -355,63 +491,85 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
     }
 
     private func currentCursorQuartz() -> CGPoint {
-        CGEvent(source: nil)?.location ?? .zero
+        // Cocoa global coordinates (origin bottom-left of the primary screen) to
+        // Quartz (origin top-left). Unlike CGEvent(source:) this allocates nothing.
+        let p = NSEvent.mouseLocation
+        return CGPoint(x: p.x, y: primaryScreenHeight - p.y)
+    }
+
+    private func refreshScreens() {
+        screens = NSScreen.screens
+        primaryScreenHeight = screens.first?.frame.height ?? 0
     }
 
     private func updateFrame() {
         // Always move the window even if capture/frame isn't ready.
         positionWindowNearCursor()
 
-        // If the cursor moved to another display, switch the capture stream.
-        switchCaptureDisplayIfNeeded()
-
-        let capSize = odd(Int((radius * 2) / zoom))
-        let half = CGFloat(capSize / 2)
-
-        // Get the latest captured frame
-        let fullFrame = frameQueue.sync { latestFrame }
-        
-        guard let fullFrame = fullFrame else { return }
-
-        // Crop in the captured display's logical coordinate system (origin top-left).
+        // Geometry in the physical pixels of the cursor's display; mirrors
+        // loupe_geometry() in picker_dpi.h. At zoom-out the square is an odd
+        // number of zoomOut-wide blocks, so the cursor's pixel falls in the
+        // centre block.
         let cursorQ = currentCursorQuartz()
-        let relX = cursorQ.x - captureDisplayFrame.origin.x
-        let relY = cursorQ.y - captureDisplayFrame.origin.y
-
-        var cropRect = CGRect(x: relX - half, y: relY - half, width: CGFloat(capSize), height: CGFloat(capSize))
-        cropRect = cropRect.integral
-
-        // Clamp to image bounds to avoid nil cropping.
-        let imgBounds = CGRect(x: 0, y: 0, width: fullFrame.width, height: fullFrame.height)
-        let clippedRect = cropRect.intersection(imgBounds)
-        guard !clippedRect.isEmpty, let croppedImage = fullFrame.cropping(to: clippedRect) else { return }
-
-        // Scale up by drawing into a new bitmap at window size.
-        let dstW = Int(radius * 2)
-        let dstH = Int(radius * 2)
-        guard let scaled = scaleNearest(src: croppedImage, dstWidth: dstW, dstHeight: dstH) else { return }
+        let scale = captures.first(where: { $0.frame.contains(cursorQ) })?.scale ?? gridScale
+        gridScale = scale
+        let size = min(Int((radius * scale).rounded()), 1024) * 2
+        let srcSize = zoomOut > 1 ? size - 1 : odd(Int(CGFloat(size) / zoom))
+        let capSize = srcSize * zoomOut
+        let half = capSize / 2
+
+        // The capture square on the grid and in global Quartz points. Displays
+        // it touches feed the loupe; displays within one loupe of it run at
+        // full rate so the cursor can cross onto them without waiting.
+        let originX = Int((cursorQ.x * scale).rounded(.down)) - half
+        let originY = Int((cursorQ.y * scale).rounded(.down)) - half
+        let square = CGRect(x: CGFloat(originX) / scale, y: CGFloat(originY) / scale,
+                            width: CGFloat(capSize) / scale, height: CGFloat(capSize) / scale)
+        let warm = square.insetBy(dx: -radius * 2, dy: -radius * 2)
+
+        sources.removeAll(keepingCapacity: true)
+        lockedFrames.removeAll(keepingCapacity: true)
+        for capture in captures {
+            capture.setActive(capture.frame.intersects(warm))
+            guard capture.frame.intersects(square), let frame = capture.currentFrame() else { continue }
+            CVPixelBufferLockBaseAddress(frame, .readOnly)
+            guard let base = CVPixelBufferGetBaseAddress(frame) else {
+                CVPixelBufferUnlockBaseAddress(frame, .readOnly)
+                continue
+            }
+            lockedFrames.append(frame)
+            sources.append(CaptureSource(
+                base: base,
+                x: Int((capture.frame.minX * scale).rounded()), y: Int((capture.frame.minY * scale).rounded()),
+                width: CVPixelBufferGetWidth(frame), height: CVPixelBufferGetHeight(frame),
+                bytesPerRow: CVPixelBufferGetBytesPerRow(frame),
+                frame: capture.frame, scale: capture.scale, sameScale: capture.scale == scale))
+        }
+        defer {
+            for frame in lockedFrames { CVPixelBufferUnlockBaseAddress(frame, .readOnly) }
+            lockedFrames.removeAll(keepingCapacity: true)
+        }
+        guard !sources.isEmpty else { return }
 
-        view.image = scaled
-        view.needsDisplay = true
+        // Magnify straight from the capture buffers into the view's back surface,
+        // stitching across displays when the square straddles an edge.
+        view.setBacking(pixels: size, scale: scale)
+        if zoomOut > 1 {
+            reduceBox(originX: originX, originY: originY, size: srcSize)
+        }
+        view.present { dst, dstBytesPerRow in
+            scaleNearest(originX: originX, originY: originY, capSize: srcSize,
+                         into: dst, dstBytesPerRow: dstBytesPerRow, size: size)
+        }
     }
 
     fileprivate func pickAndExit() {
         let cursorQ = currentCursorQuartz()
-        let relX = cursorQ.x - captureDisplayFrame.origin.x
-        let relY = cursorQ.y - captureDisplayFrame.origin.y
-
-        let fullFrame = frameQueue.sync { latestFrame }
-
-        guard let fullFrame = fullFrame else {
-            exitCleanly()
-            return
-        }
-
-        let imgBounds = CGRect(x: 0, y: 0, width: fullFrame.width, height: fullFrame.height)
-        let sampleRect = CGRect(x: relX, y: relY, width: 1, height: 1).intersection(imgBounds)
-        guard !sampleRect.isEmpty,
-              let croppedImage = fullFrame.cropping(to: sampleRect),
-              let color = sampleTopLeftPixel(croppedImage) else {
+        guard let capture = captures.first(where: { $0.frame.contains(cursorQ) }),
+              let fullFrame = capture.currentFrame(),
+              let color = readPixel(fullFrame,
+                                    x: Int(((cursorQ.x - capture.frame.minX) * capture.scale).rounded(.down)),
+                                    y: Int(((cursorQ.y - capture.frame.minY) * capture.scale).rounded(.down))) else {
             exitCleanly()
             return
         }
@@ -429,29 +587,117 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
 
     private func exitCleanly() {
         timer?.invalidate(); timer = nil
-        scStream?.stopCapture()
+        stopCaptures()
         stopEventTap()
         NSApp.terminate(nil)
     }
 
     // MARK: - Helpers
 
-    private func scaleNearest(src: CGImage, dstWidth: Int, dstHeight: Int) -> CGImage? {
-        guard let cs = src.colorSpace ?? CGColorSpace(name: CGColorSpace.sRGB) else { return nil }
-        guard let ctx = CGContext(
-            data: nil,
-            width: dstWidth,
-            height: dstHeight,
-            bitsPerComponent: 8,
-            bytesPerRow: 0,
-            space: cs,
-            bitmapInfo: CGImageAlphaInfo.premultipliedLast.rawValue
-        ) else { return nil }
+    /// Nearest-neighbour magnification of the capSize x capSize square at
+    /// grid pixel (originX, originY) into a size x size BGRA destination, reading
+    /// each source pixel from whichever display in `sources` holds it. Pixels
+    /// on no display come out transparent. Mirrors scale_nearest_bgra() in
+    /// picker_kernels.h; loupes larger than one band are split into row bands
+    /// run in parallel, like compose_loupe_tiled().
+    private func scaleNearest(originX: Int, originY: Int, capSize: Int,
+                              into dst: UnsafeMutableRawPointer, dstBytesPerRow: Int, size: Int) {
+        let bandRows = max(8, bandBytes / dstBytesPerRow)
+        if bandRows >= size {
+            scaleRows(0..<size, originX: originX, originY: originY, capSize: capSize,
+                      into: dst, dstBytesPerRow: dstBytesPerRow, size: size)
+            return
+        }
+        let bands = (size + bandRows - 1) / bandRows
+        DispatchQueue.concurrentPerform(iterations: bands) { band in
+            let y0 = band * bandRows
+            scaleRows(y0..<min(size, y0 + bandRows), originX: originX, originY: originY, capSize: capSize,
+                      into: dst, dstBytesPerRow: dstBytesPerRow, size: size)
+        }
+    }
+
+    /// Gamma-correct box filter for zoom-out: `reduced` pixel (x, y) is the
+    /// linear-light mean of the zoomOut x zoomOut block at grid pixel
+    /// (originX + x * zoomOut, originY + y * zoomOut). Mirrors
+    /// downsample_box_bgra() in picker_downsample.h: each block row is summed
+    /// into a SIMD4 lane set per output pixel, then the sums are encoded.
+    private func reduceBox(originX: Int, originY: Int, size: Int) {
+        let k = zoomOut
+        if reduced.count != size * size {
+            reduced = [UInt32](repeating: 0, count: size * size)
+            reduceAcc = [SIMD4<UInt32>](repeating: .zero, count: size)
+        }
+        let inv = 1 / Float(k * k)
+        for y in 0..<size {
+            for x in 0..<size { reduceAcc[x] = .zero }
+            for j in 0..<k {
+                let sy = originY + y * k + j
+                for x in 0..<size {
+                    var sum = SIMD4<UInt32>.zero
+                    for i in 0..<k {
+                        let v = sourcePixel(originX + x * k + i, sy)
+                        sum &+= SIMD4(srgbToLinear[Int(v & 0xFF)], srgbToLinear[Int((v >> 8) & 0xFF)],
+                                      srgbToLinear[Int((v >> 16) & 0xFF)], 0)
+                    }
+                    reduceAcc[x] &+= sum
+                }
+            }
+            for x in 0..<size {
+                let a = reduceAcc[x]
+                let b = UInt32(linearToSrgb[Int(UInt32(Float(a.x) * inv) >> 4)])
+                let g = UInt32(linearToSrgb[Int(UInt32(Float(a.y) * inv) >> 4)])
+                let r = UInt32(linearToSrgb[Int(UInt32(Float(a.z) * inv) >> 4)])
+                reduced[y * size + x] = 0xFF00_0000 | r << 16 | g << 8 | b
+            }
+        }
+    }
+
+    /// Pixel (x, y) of the grid. A display of the grid's scale is a whole
+    /// pixel offset; on one of another scale the grid pixel's centre is
+    /// mapped to that display's own pixel, as dpi_map_pixel() does, so its
+    /// pixels repeat whole instead of being resampled.
+    @inline(__always)
+    private func sourcePixel(_ x: Int, _ y: Int) -> UInt32 {
+        for s in sources {
+            var sx = x - s.x, sy = y - s.y
+            if !s.sameScale {
+                let px = (CGFloat(x) + 0.5) / gridScale, py = (CGFloat(y) + 0.5) / gridScale
+                guard s.frame.contains(CGPoint(x: px, y: py)) else { continue }
+                sx = Int(((px - s.frame.minX) * s.scale).rounded(.down))
+                sy = Int(((py - s.frame.minY) * s.scale).rounded(.down))
+            }
+            if sx >= 0 && sy >= 0 && sx < s.width && sy < s.height {
+                return s.base.load(fromByteOffset: sy * s.bytesPerRow + sx * 4, as: UInt32.self) | 0xFF00_0000
+            }
+        }
+        return 0
+    }
 
-        ctx.interpolationQuality = .none
-        ctx.setShouldAntialias(false)
-        ctx.draw(src, in: CGRect(x: 0, y: 0, width: dstWidth, height: dstHeight))
-        return ctx.makeImage()
+    private func scaleRows(_ rows: Range<Int>, originX: Int, originY: Int, capSize: Int,
+                           into dst: UnsafeMutableRawPointer, dstBytesPerRow: Int, size: Int) {
+        var prevSy = -1
+        for y in rows {
+            let rowPtr = dst + y * dstBytesPerRow
+            let sy = y * capSize / size
+            if sy == prevSy {
+                memcpy(rowPtr, rowPtr - dstBytesPerRow, size * 4)
+                continue
+            }
+            prevSy = sy
+
+            let d = rowPtr.assumingMemoryBound(to: UInt32.self)
+            var x0 = 0
+            for sx in 0..<capSize {
+                let x1 = min(size, ((sx + 1) * size + capSize - 1) / capSize)
+                let v = zoomOut > 1 ? reduced[sy * capSize + sx] : sourcePixel(originX + sx, originY + sy)
+                var x = x0
+                while x < x1 {
+                    d[x] = v
+                    x += 1
+                }
+                x0 = x1
+            }
+        }
     }
 
     private struct RGB {
@@ -460,35 +706,23 @@ final class AppDelegate: NSObject, NSApplicationDelegate {
         let b: UInt8
     }
 
-    private func sampleTopLeftPixel(_ img: CGImage) -> RGB? {
-        // Don't assume channel order (RGBA/BGRA/ARGB...) or byte order.
-        // Normalize by drawing into a 1x1 RGBA8(sRGB) bitmap and read back.
-        guard let cs = CGColorSpace(name: CGColorSpace.sRGB) else { return nil }
-
-        var rgba: [UInt8] = [0, 0, 0, 0]
-        let bitmapInfo = CGBitmapInfo.byteOrder32Big.rawValue | CGImageAlphaInfo.premultipliedLast.rawValue
-        guard let ctx = CGContext(
-            data: &rgba,
-            width: 1,
-            height: 1,
-            bitsPerComponent: 8,
-            bytesPerRow: 4,
-            space: cs,
-            bitmapInfo: bitmapInfo
-        ) else { return nil }
-
-        ctx.interpolationQuality = .none
-        ctx.setShouldAntialias(false)
-        ctx.draw(img, in: CGRect(x: 0, y: 0, width: 1, height: 1))
+    /// Reads one pixel of a BGRA capture buffer (already sRGB, see the stream config).
+    private func readPixel(_ frame: CVPixelBuffer, x: Int, y: Int) -> RGB? {
+        CVPixelBufferLockBaseAddress(frame, .readOnly)
+        defer { CVPixelBufferUnlockBaseAddress(frame, .readOnly) }
+        guard let base = CVPixelBufferGetBaseAddress(frame),
+              x >= 0, y >= 0,
+              x < CVPixelBufferGetWidth(frame), y < CVPixelBufferGetHeight(frame) else { return nil }
 
-        return RGB(r: rgba[0], g: rgba[1], b: rgba[2])
+        let p = (base + y * CVPixelBufferGetBytesPerRow(frame) + x * 4).assumingMemoryBound(to: UInt8.self)
+        return RGB(r: p[2], g: p[1], b: p[0])
     }
 
     private func clampToVisible(desiredOrigin: CGPoint, size: CGSize) -> CGPoint {
         // Clamp to visible frame of the screen containing the cursor if possible.
         let cursor = NSEvent.mouseLocation
-        let screen = NSScreen.screens.first(where: { $0.frame.contains(cursor) }) ?? NSScreen.main
-        let visible = screen?.visibleFrame ?? NSScreen.main?.visibleFrame ?? .zero
+        let screen = screens.first(where: { $0.frame.contains(cursor) }) ?? screens.first
+        let visible = screen?.visibleFrame ?? .zero
 
         var x = desiredOrigin.x
         var y = desiredOrigin.y
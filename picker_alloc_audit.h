@@ -0,0 +1,114 @@
+// Minimal Color Picker - heap allocation audit for test builds (glibc only).
+//
+// Build with -DALLOC_AUDIT and include this header from exactly one translation
+// unit (the pickers and tests are single-TU programs). It defines malloc,
+// calloc, realloc, free and the aligned variants as counting wrappers around
+// glibc's __libc_* entry points, so every heap call in the process is seen:
+// ours, Xlib's and libc's own.
+//
+// The frame loop calls alloc_audit_frame() once per frame; after the warm-up
+// frames, any frame interval that allocated is recorded as a failure.
+
+#ifndef PICKER_ALLOC_AUDIT_H
+#define PICKER_ALLOC_AUDIT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifndef __GLIBC__
+#error "picker_alloc_audit.h interposes glibc's allocator; build it on Linux"
+#endif
+
+extern void* __libc_malloc(size_t n);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t n);
+extern void* __libc_memalign(size_t align, size_t n);
+extern void __libc_free(void* p);
+
+static volatile long g_audit_allocs;
+static volatile long g_audit_frees;
+
+static inline void alloc_audit_bump(volatile long* v) {
+    __atomic_add_fetch(v, 1, __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t n) {
+    alloc_audit_bump(&g_audit_allocs);
+    return __libc_malloc(n);
+}
+
+void* calloc(size_t n, size_t size) {
+    alloc_audit_bump(&g_audit_allocs);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t n) {
+    alloc_audit_bump(&g_audit_allocs);
+    return __libc_realloc(p, n);
+}
+
+void* memalign(size_t align, size_t n) {
+    alloc_audit_bump(&g_audit_allocs);
+    return __libc_memalign(align, n);
+}
+
+void* aligned_alloc(size_t align, size_t n) {
+    alloc_audit_bump(&g_audit_allocs);
+    return __libc_memalign(align, n);
+}
+
+int posix_memalign(void** out, size_t align, size_t n) {
+    alloc_audit_bump(&g_audit_allocs);
+    void* p = __libc_memalign(align, n);
+    if (!p) return 12; // ENOMEM
+    *out = p;
+    return 0;
+}
+
+void free(void* p) {
+    if (p) alloc_audit_bump(&g_audit_frees);
+    __libc_free(p);
+}
+
+typedef struct AllocAudit {
+    int warmupFrames;
+    long frames;
+    long lastAllocs;
+    long lastFrees;
+    long badFrames;       // frames after warm-up that allocated or freed
+    long allocsAfterWarmup;
+    long freesAfterWarmup;
+} AllocAudit;
+
+static AllocAudit g_audit = { 30, 0, 0, 0, 0, 0, 0 };
+
+static inline long alloc_audit_allocs(void) { return __atomic_load_n(&g_audit_allocs, __ATOMIC_RELAXED); }
+static inline long alloc_audit_frees(void) { return __atomic_load_n(&g_audit_frees, __ATOMIC_RELAXED); }
+
+// Call once per frame, at the same point of the loop each time.
+static inline void alloc_audit_frame(void) {
+    long a = alloc_audit_allocs();
+    long f = alloc_audit_frees();
+    if (g_audit.frames > g_audit.warmupFrames) {
+        long da = a - g_audit.lastAllocs;
+        long df = f - g_audit.lastFrees;
+        if (da || df) g_audit.badFrames++;
+        g_audit.allocsAfterWarmup += da;
+        g_audit.freesAfterWarmup += df;
+    }
+    g_audit.lastAllocs = a;
+    g_audit.lastFrees = f;
+    g_audit.frames++;
+}
+
+// Prints a summary; returns 1 when steady state allocated.
+static inline int alloc_audit_report(FILE* fp) {
+    long measured = g_audit.frames - g_audit.warmupFrames - 1;
+    if (measured < 0) measured = 0;
+    fprintf(fp, "alloc audit: %ld frames after %d warm-up, %ld allocations, %ld frees, %ld frames allocating\n",
+            measured, g_audit.warmupFrames, g_audit.allocsAfterWarmup, g_audit.freesAfterWarmup,
+            g_audit.badFrames);
+    return g_audit.badFrames != 0;
+}
+
+#endif // PICKER_ALLOC_AUDIT_H
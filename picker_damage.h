@@ -0,0 +1,359 @@
+// Minimal Color Picker - block-hash change detection (header-only, C99).
+//
+// Tells which parts of a captured region changed since the previous capture
+// without keeping or comparing the previous pixels. The region is split into
+// DAMAGE_BLOCK x DAMAGE_BLOCK blocks and each block gets a 64-bit hash; a
+// frame costs one hash per block and one compare per block.
+//
+// A block row is 16 pixels, 64 bytes: four 128-bit lanes, each holding two
+// 64-bit chains. Every row is XORed into the chains and each chain is then
+// stepped through a bijection (two 32x32->64 multiplies and an xorshift), so
+// a change confined to one row of a block always changes that chain's final
+// state. The lanes map onto SSE2 registers (_mm_mul_epu32 is the multiply);
+// the portable version computes the same hash, bit for bit, with scalar
+// multiplies. The eight chains are folded into the block's hash at the end.
+//
+// The pickers hash the cursor loupe's capture square every frame. The fold of
+// all block hashes replaces the whole-square hash the idle parker compared.
+// When the loupe's geometry is unchanged since the last frame,
+// damage_compose_loupe() recomposes only the loupe tiles magnified from
+// changed blocks (a blinking caret is one or two tiles) and returns the
+// rectangle they span, so the picker presents only that rectangle; with
+// nothing changed it composes and presents nothing. The "flash changed
+// areas" diagnostic (--flash-damage) tints the loupe over each changed block
+// and fades out over DAMAGE_FLASH_FRAMES frames.
+//
+//   damage_reserve(&map, w, h);                    // grows buffers; 0 on failure
+//   int n = damage_update(&map, px, w, h, stride); // blocks changed since last time
+//   damage_compose_loupe(&map, cap, ..., dirty);   // patch last frame's loupe
+//   damage_flash_bgra(&map, loupe, d, d, stride);  // diagnostic tint, then fade
+
+#ifndef PICKER_DAMAGE_H
+#define PICKER_DAMAGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picker_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DAMAGE_SSE2 1
+#else
+#define DAMAGE_SSE2 0
+#endif
+
+#define DAMAGE_BLOCK 16         // block side in pixels; one row is four 128-bit lanes
+#define DAMAGE_FLASH_FRAMES 15  // diagnostic fade, about 250 ms at 60 fps
+#define DAMAGE_MUL 0x9E3779B1u  // odd: multiplying is a bijection mod 2^32
+
+typedef struct DamageMap {
+    int width, height;     // region of the last update
+    int cols, rows;        // blocks across and down
+    uint64_t* hash;        // one per block, from the last update
+    uint8_t* changed;      // 1 where the block differs from the update before
+    uint8_t* flash;        // frames the diagnostic still tints the block
+    size_t blockCap;       // allocated blocks
+    int valid;             // 0 after a resize: every block counts as changed
+    int changedCount;      // changed blocks in the last update
+    int x0, y0, x1, y1;    // pixel bounds of the changed blocks (empty when x0 >= x1)
+    uint64_t frameHash;    // fold of every block hash: equal frames, equal hash
+
+    // Counters (for --stats).
+    uint64_t updates;
+    uint64_t blocksHashed;
+    uint64_t blocksChanged;
+    uint64_t stillUpdates;  // updates in which no block changed
+    uint64_t loupeFrames;   // damage_count_frame() calls
+    uint64_t loupePatched;  // of which patched instead of composed whole
+    uint64_t composedBytes;
+    uint64_t presentedBytes;
+} DamageMap;
+
+static inline uint64_t damage_chain_seed(int i) {
+    return 0x243F6A8885A308D3ull + (uint64_t)i * 0x9E3779B97F4A7C15ull;
+}
+
+// Folds the eight chains and the block size into the block's hash.
+static inline uint64_t damage_fold(const uint64_t* chains, int w, int h) {
+    uint64_t r = ((uint64_t)w << 8) | (uint64_t)h;
+    for (int i = 0; i < 8; i++) r = (r ^ chains[i]) * 0x9E3779B97F4A7C15ull;
+    r ^= r >> 29;
+    r *= 0xBF58476D1CE4E5B9ull;
+    r ^= r >> 32;
+    return r;
+}
+
+// One row step of a chain: low word times K, high word times K added into
+// the upper half, then an xorshift. Each part is invertible.
+static inline uint64_t damage_step(uint64_t v) {
+    uint64_t lo = (uint64_t)(uint32_t)v * DAMAGE_MUL;
+    uint64_t hi = (uint64_t)(uint32_t)(v >> 32) * DAMAGE_MUL;
+    v = lo ^ (hi << 32);
+    return v ^ (v >> 29);
+}
+
+// Hash of the w x h block at `px` (w, h at most DAMAGE_BLOCK). Portable
+// version; block_hash_bgra() picks SSE2 where available.
+static inline uint64_t block_hash_bgra_generic(const uint8_t* px, int w, int h, int stride) {
+    uint64_t c[8];
+    for (int i = 0; i < 8; i++) c[i] = damage_chain_seed(i);
+    uint8_t row[DAMAGE_BLOCK * 4];
+    memset(row, 0, sizeof(row));
+    for (int y = 0; y < h; y++) {
+        const uint8_t* r = px + (size_t)y * stride;
+        if (w < DAMAGE_BLOCK) {
+            memcpy(row, r, (size_t)w * 4);
+            r = row;
+        }
+        for (int i = 0; i < 8; i++) {
+            uint32_t a, b;
+            memcpy(&a, r + i * 8, 4);
+            memcpy(&b, r + i * 8 + 4, 4);
+            c[i] = damage_step(c[i] ^ ((uint64_t)b << 32 | a));
+        }
+    }
+    return damage_fold(c, w, h);
+}
+
+#if DAMAGE_SSE2
+static inline __m128i damage_step_sse2(__m128i v, __m128i k) {
+    __m128i lo = _mm_mul_epu32(v, k);
+    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(v, 32), k);
+    v = _mm_xor_si128(lo, _mm_slli_epi64(hi, 32));
+    return _mm_xor_si128(v, _mm_srli_epi64(v, 29));
+}
+
+static inline uint64_t block_hash_bgra_sse2(const uint8_t* px, int w, int h, int stride) {
+    const __m128i k = _mm_set1_epi32((int)DAMAGE_MUL);
+    __m128i l0 = _mm_set_epi64x((long long)damage_chain_seed(1), (long long)damage_chain_seed(0));
+    __m128i l1 = _mm_set_epi64x((long long)damage_chain_seed(3), (long long)damage_chain_seed(2));
+    __m128i l2 = _mm_set_epi64x((long long)damage_chain_seed(5), (long long)damage_chain_seed(4));
+    __m128i l3 = _mm_set_epi64x((long long)damage_chain_seed(7), (long long)damage_chain_seed(6));
+    uint8_t row[DAMAGE_BLOCK * 4];
+    memset(row, 0, sizeof(row));
+    for (int y = 0; y < h; y++) {
+        const uint8_t* r = px + (size_t)y * stride;
+        if (w < DAMAGE_BLOCK) {
+            memcpy(row, r, (size_t)w * 4);
+            r = row;
+        }
+        l0 = damage_step_sse2(_mm_xor_si128(l0, _mm_loadu_si128((const __m128i*)r)), k);
+        l1 = damage_step_sse2(_mm_xor_si128(l1, _mm_loadu_si128((const __m128i*)(r + 16))), k);
+        l2 = damage_step_sse2(_mm_xor_si128(l2, _mm_loadu_si128((const __m128i*)(r + 32))), k);
+        l3 = damage_step_sse2(_mm_xor_si128(l3, _mm_loadu_si128((const __m128i*)(r + 48))), k);
+    }
+    uint64_t c[8];
+    _mm_storeu_si128((__m128i*)&c[0], l0);
+    _mm_storeu_si128((__m128i*)&c[2], l1);
+    _mm_storeu_si128((__m128i*)&c[4], l2);
+    _mm_storeu_si128((__m128i*)&c[6], l3);
+    return damage_fold(c, w, h);
+}
+#endif
+
+static inline uint64_t block_hash_bgra(const uint8_t* px, int w, int h, int stride) {
+#if DAMAGE_SSE2
+    return block_hash_bgra_sse2(px, w, h, stride);
+#else
+    return block_hash_bgra_generic(px, w, h, stride);
+#endif
+}
+
+static inline int damage_grow(void** p, size_t want, size_t elem) {
+    void* q = realloc(*p, want * elem);
+    if (!q) return 0;
+    *p = q;
+    return 1;
+}
+
+// Makes room for a w x h region. Buffers only grow, so the frame loop
+// allocates once per new extent. Returns 0 when out of memory.
+static inline int damage_reserve(DamageMap* m, int w, int h) {
+    size_t blocks = (size_t)((w + DAMAGE_BLOCK - 1) / DAMAGE_BLOCK) * (size_t)((h + DAMAGE_BLOCK - 1) / DAMAGE_BLOCK);
+    if (blocks <= m->blockCap) return 1;
+    if (!damage_grow((void**)&m->hash, blocks, sizeof(uint64_t)) || !damage_grow((void**)&m->changed, blocks, 1) ||
+        !damage_grow((void**)&m->flash, blocks, 1)) {
+        return 0;
+    }
+    m->blockCap = blocks;
+    m->valid = 0;
+    return 1;
+}
+
+static inline void damage_free(DamageMap* m) {
+    free(m->hash);
+    free(m->changed);
+    free(m->flash);
+    memset(m, 0, sizeof(*m));
+}
+
+// Bytes held, for the memory report.
+static inline size_t damage_bytes(const DamageMap* m) {
+    return m->blockCap * (sizeof(uint64_t) + 2);
+}
+
+// Hashes every block of the w x h region at `px` and flags the ones whose
+// hash differs from the last update; returns how many did. A new region size
+// flags every block. damage_reserve() must have been called for this size.
+static inline int damage_update(DamageMap* m, const uint8_t* px, int w, int h, int stride) {
+    int cols = (w + DAMAGE_BLOCK - 1) / DAMAGE_BLOCK, rows = (h + DAMAGE_BLOCK - 1) / DAMAGE_BLOCK;
+    if (w != m->width || h != m->height) {
+        m->width = w;
+        m->height = h;
+        m->cols = cols;
+        m->rows = rows;
+        m->valid = 0;
+        memset(m->flash, 0, (size_t)cols * rows);
+    }
+    int count = 0, bx0 = cols, by0 = rows, bx1 = 0, by1 = 0;
+    uint64_t frame = 0x84222325CBF29CE4ull;
+    for (int by = 0; by < rows; by++) {
+        int y = by * DAMAGE_BLOCK;
+        int bh = h - y < DAMAGE_BLOCK ? h - y : DAMAGE_BLOCK;
+        for (int bx = 0; bx < cols; bx++) {
+            int x = bx * DAMAGE_BLOCK;
+            int bw = w - x < DAMAGE_BLOCK ? w - x : DAMAGE_BLOCK;
+            int i = by * cols + bx;
+            uint64_t hsh = block_hash_bgra(px + (size_t)y * stride + (size_t)x * 4, bw, bh, stride);
+            int diff = !m->valid || hsh != m->hash[i];
+            m->hash[i] = hsh;
+            m->changed[i] = (uint8_t)diff;
+            frame = (frame ^ hsh) * 0x100000001B3ull;
+            if (!diff) continue;
+            m->flash[i] = DAMAGE_FLASH_FRAMES;
+            count++;
+            if (bx < bx0) bx0 = bx;
+            if (by < by0) by0 = by;
+            if (bx + 1 > bx1) bx1 = bx + 1;
+            if (by + 1 > by1) by1 = by + 1;
+        }
+    }
+    m->valid = 1;
+    m->changedCount = count;
+    m->frameHash = frame;
+    if (count) {
+        m->x0 = bx0 * DAMAGE_BLOCK;
+        m->y0 = by0 * DAMAGE_BLOCK;
+        m->x1 = bx1 * DAMAGE_BLOCK < w ? bx1 * DAMAGE_BLOCK : w;
+        m->y1 = by1 * DAMAGE_BLOCK < h ? by1 * DAMAGE_BLOCK : h;
+    } else {
+        m->x0 = m->y0 = m->x1 = m->y1 = 0;
+    }
+    m->updates++;
+    m->blocksHashed += (uint64_t)cols * rows;
+    m->blocksChanged += (uint64_t)count;
+    if (!count) m->stillUpdates++;
+    return count;
+}
+
+// First destination pixel of source pixel `s` when `srcN` pixels are scaled
+// to `dstN` by scale_nearest_bgra(): runs are [ceil(s*dstN/srcN), ...).
+static inline int damage_scaled_edge(int s, int srcN, int dstN) {
+    return (int)(((int64_t)s * dstN + srcN - 1) / srcN);
+}
+
+// Loupe rectangle r = { x0, y0, x1, y1 } drawn from region pixels
+// [sx0, sx1) x [sy0, sy1) when the region is scaled up to dstW x dstH.
+static inline void damage_scale_rect(const DamageMap* m, int sx0, int sy0, int sx1, int sy1, int dstW, int dstH,
+                                     int* r) {
+    r[0] = damage_scaled_edge(sx0, m->width, dstW);
+    r[1] = damage_scaled_edge(sy0, m->height, dstH);
+    r[2] = damage_scaled_edge(sx1, m->width, dstW);
+    r[3] = damage_scaled_edge(sy1, m->height, dstH);
+}
+
+// Patches `dst`, a loupe composed from the region of the previous update
+// with the same geometry, into the loupe of this update's region `cap`
+// (m->width square): each run of changed blocks in a block row is
+// recomposed as one rectangle. Loupe tiles partition the loupe and each
+// depends only on its own blocks, so the result is byte-identical to a full
+// compose. `dirty` gets the loupe rectangle spanning the changed tiles,
+// empty (x0 >= x1) when nothing changed. Returns the pixels composed.
+static inline size_t damage_compose_loupe(const DamageMap* m, const uint8_t* cap, int capStride, uint8_t* dst,
+                                          int radius, int dstStride, int borderWidth, int antialias,
+                                          int markerSize, int* dirty) {
+    int d = radius * 2;
+    size_t pixels = 0;
+    memset(dirty, 0, 4 * sizeof(int));
+    if (!m->changedCount) return 0;
+    for (int by = 0; by < m->rows; by++) {
+        const uint8_t* changed = m->changed + by * m->cols;
+        for (int bx = 0; bx < m->cols;) {
+            if (!changed[bx]) {
+                bx++;
+                continue;
+            }
+            int run = bx;
+            while (bx < m->cols && changed[bx]) bx++;
+            int sx1 = bx * DAMAGE_BLOCK < m->width ? bx * DAMAGE_BLOCK : m->width;
+            int sy1 = (by + 1) * DAMAGE_BLOCK < m->height ? (by + 1) * DAMAGE_BLOCK : m->height;
+            int r[4];
+            damage_scale_rect(m, run * DAMAGE_BLOCK, by * DAMAGE_BLOCK, sx1, sy1, d, d, r);
+            compose_loupe_rect(cap, m->width, capStride, dst, radius, dstStride, borderWidth, antialias, markerSize,
+                               r[0], r[1], r[2], r[3]);
+            pixels += (size_t)(r[2] - r[0]) * (size_t)(r[3] - r[1]);
+        }
+    }
+    damage_scale_rect(m, m->x0, m->y0, m->x1, m->y1, d, d, dirty);
+    return pixels;
+}
+
+// Counts one loupe frame: patched or composed whole, and the pixels each
+// stage touched.
+static inline void damage_count_frame(DamageMap* m, int patched, size_t composedPx, size_t presentedPx) {
+    m->loupeFrames++;
+    if (patched) m->loupePatched++;
+    m->composedBytes += (uint64_t)composedPx * 4;
+    m->presentedBytes += (uint64_t)presentedPx * 4;
+}
+
+// The "flash changed areas" diagnostic: tints the part of a dstW x dstH
+// loupe (premultiplied BGRA, the region scaled up to it) over every block
+// that changed in the last DAMAGE_FLASH_FRAMES updates, red fading to none,
+// and ages the tints by one frame.
+static inline void damage_flash_bgra(DamageMap* m, uint8_t* dst, int dstW, int dstH, int stride) {
+    if (m->width <= 0 || m->height <= 0) return;
+    for (int by = 0; by < m->rows; by++) {
+        for (int bx = 0; bx < m->cols; bx++) {
+            uint8_t* f = &m->flash[by * m->cols + bx];
+            if (!*f) continue;
+            // Up to half way to opaque red, in premultiplied terms: red moves
+            // towards alpha, green and blue towards zero.
+            uint32_t s = (uint32_t)(*f * 128 / DAMAGE_FLASH_FRAMES);
+            (*f)--;
+            int sx1 = (bx + 1) * DAMAGE_BLOCK < m->width ? (bx + 1) * DAMAGE_BLOCK : m->width;
+            int sy1 = (by + 1) * DAMAGE_BLOCK < m->height ? (by + 1) * DAMAGE_BLOCK : m->height;
+            int r[4];
+            damage_scale_rect(m, bx * DAMAGE_BLOCK, by * DAMAGE_BLOCK, sx1, sy1, dstW, dstH, r);
+            for (int y = r[1]; y < r[3] && y < dstH; y++) {
+                uint32_t* d = (uint32_t*)(dst + (size_t)y * stride);
+                for (int x = r[0]; x < r[2] && x < dstW; x++) {
+                    uint32_t p = d[x];
+                    uint32_t pa = p >> 24, pr = (p >> 16) & 0xFF, pg = (p >> 8) & 0xFF, pb = p & 0xFF;
+                    if (pr < pa) pr += ((pa - pr) * s) >> 8;
+                    pg -= (pg * s) >> 8;
+                    pb -= (pb * s) >> 8;
+                    d[x] = (pa << 24) | (pr << 16) | (pg << 8) | pb;
+                }
+            }
+        }
+    }
+}
+
+static inline void damage_report(const DamageMap* m, FILE* fp) {
+    if (!m->updates) return;
+    fprintf(fp, "damage: %d px blocks, %.1f of %.1f changed per capture, %llu of %llu captures unchanged\n",
+            DAMAGE_BLOCK, (double)m->blocksChanged / (double)m->updates,
+            (double)m->blocksHashed / (double)m->updates, (unsigned long long)m->stillUpdates,
+            (unsigned long long)m->updates);
+    if (!m->loupeFrames) return;
+    fprintf(fp, "loupe: %llu of %llu frames patched, %.1f KB composed and %.1f KB presented per frame\n",
+            (unsigned long long)m->loupePatched, (unsigned long long)m->loupeFrames,
+            (double)m->composedBytes / 1024.0 / (double)m->loupeFrames,
+            (double)m->presentedBytes / 1024.0 / (double)m->loupeFrames);
+}
+
+#endif // PICKER_DAMAGE_H
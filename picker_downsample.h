@@ -0,0 +1,194 @@
+// Minimal Color Picker - gamma-correct box downsampling (header-only, C99).
+//
+// Zoom-out (--zoom below 1) shows a captured region k times wider than the
+// loupe's source, so every source pixel of the loupe stands for a k x k block
+// of the screen. Averaging sRGB bytes directly darkens fine detail: a 1 px
+// black/white checkerboard comes out as sRGB 128 instead of the ~188 the eye
+// sees. Blocks are therefore averaged in linear light: each byte goes through
+// a 256-entry sRGB -> 16-bit linear table, the sums are scaled to the mean and
+// encoded back through a 4096-entry table.
+//
+// The reduction is separable. The horizontal pass adds the k pixels of each
+// block row into one 4-lane (B, G, R, unused) accumulator per output pixel;
+// the vertical pass is the same accumulation repeated over the block's k rows,
+// after which one sweep scales and encodes the accumulators. With SSE2 (every
+// x86-64 build) a lane set is one __m128i; elsewhere the loops are plain C.
+// k = 2, the step of the zoom-out mip pyramid (picker_mip.h), skips the
+// accumulators: each 2x2 block is summed in registers and encoded directly,
+// which gives the same bytes (the mean of four is the sum >> 2, exactly). That
+// row is plain C on every build; with only twelve table loads per block,
+// packing lanes cost more than it saved.
+//
+//   downsample_box_bgra(src, srcStride, dst, dstW, dstH, dstStride, k, acc);
+
+#ifndef PICKER_DOWNSAMPLE_H
+#define PICKER_DOWNSAMPLE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DOWNSAMPLE_SSE2 1
+#else
+#define DOWNSAMPLE_SSE2 0
+#endif
+
+#define DOWNSAMPLE_MAX_FACTOR 16  // k * k * 65535 must stay below 2^24 (exact in float)
+
+typedef struct SrgbTables {
+    uint16_t toLinear[256];  // sRGB byte -> linear light * 65535
+    uint8_t toSrgb[4096];    // (linear * 65535) >> 4 -> sRGB byte
+    int ready;
+} SrgbTables;
+
+static SrgbTables g_srgbTables;
+
+static inline double srgb_decode(double c) {
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static inline double srgb_encode(double l) {
+    return l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+}
+
+// Builds the tables on first use. Call once from the UI thread (the pickers
+// do it at startup) before downsampling on several threads.
+static inline const SrgbTables* srgb_tables(void) {
+    SrgbTables* t = &g_srgbTables;
+    if (t->ready) return t;
+    for (int c = 0; c < 256; c++) t->toLinear[c] = (uint16_t)(srgb_decode(c / 255.0) * 65535.0 + 0.5);
+    for (int i = 0; i < 4096; i++) {
+        double v = srgb_encode((i + 0.5) / 4096.0) * 255.0 + 0.5;
+        t->toSrgb[i] = (uint8_t)(v > 255.0 ? 255.0 : v);
+    }
+    // Consecutive codes are at least 19 linear steps apart, more than one
+    // 16-step bucket, so every code owns its bucket: a flat block comes back
+    // exactly.
+    for (int c = 0; c < 256; c++) t->toSrgb[t->toLinear[c] >> 4] = (uint8_t)c;
+    t->ready = 1;
+    return t;
+}
+
+// Adds one block row (k pixels per output pixel) of `row` into `acc`.
+static inline void downsample_add_row_generic(const SrgbTables* t, const uint8_t* row, int dstW, int k,
+                                              uint32_t* acc) {
+    for (int x = 0; x < dstW; x++) {
+        const uint8_t* p = row + (size_t)x * k * 4;
+        uint32_t b = 0, g = 0, r = 0;
+        for (int i = 0; i < k; i++, p += 4) {
+            b += t->toLinear[p[0]];
+            g += t->toLinear[p[1]];
+            r += t->toLinear[p[2]];
+        }
+        acc[x * 4 + 0] += b;
+        acc[x * 4 + 1] += g;
+        acc[x * 4 + 2] += r;
+    }
+}
+
+// Mean of each accumulator, encoded to opaque sRGB. Float keeps the scale
+// exact for any k (sums stay below 2^24) and matches the SSE2 path bit for bit.
+static inline void downsample_store_generic(const SrgbTables* t, const uint32_t* acc, int dstW, float inv,
+                                            uint8_t* out) {
+    uint32_t* d = (uint32_t*)out;
+    for (int x = 0; x < dstW; x++) {
+        uint32_t b = t->toSrgb[(uint32_t)((float)acc[x * 4 + 0] * inv) >> 4];
+        uint32_t g = t->toSrgb[(uint32_t)((float)acc[x * 4 + 1] * inv) >> 4];
+        uint32_t r = t->toSrgb[(uint32_t)((float)acc[x * 4 + 2] * inv) >> 4];
+        d[x] = 0xFF000000u | (r << 16) | (g << 8) | b;
+    }
+}
+
+// One output row of a 2x2 reduction from source rows `r0` and `r1`.
+static inline void downsample_2x2_row_generic(const SrgbTables* t, const uint8_t* r0, const uint8_t* r1, int dstW,
+                                              uint8_t* out) {
+    uint32_t* d = (uint32_t*)out;
+    for (int x = 0; x < dstW; x++, r0 += 8, r1 += 8) {
+        uint32_t b = t->toLinear[r0[0]] + t->toLinear[r0[4]] + t->toLinear[r1[0]] + t->toLinear[r1[4]];
+        uint32_t g = t->toLinear[r0[1]] + t->toLinear[r0[5]] + t->toLinear[r1[1]] + t->toLinear[r1[5]];
+        uint32_t r = t->toLinear[r0[2]] + t->toLinear[r0[6]] + t->toLinear[r1[2]] + t->toLinear[r1[6]];
+        d[x] = 0xFF000000u | ((uint32_t)t->toSrgb[r >> 6] << 16) | ((uint32_t)t->toSrgb[g >> 6] << 8) |
+               t->toSrgb[b >> 6];
+    }
+}
+
+// Portable version; downsample_box_bgra() picks SSE2 where available.
+static inline void downsample_box_bgra_generic(const uint8_t* src, int srcStride, uint8_t* dst, int dstW, int dstH,
+                                               int dstStride, int k, uint32_t* acc) {
+    const SrgbTables* t = srgb_tables();
+    if (k == 2) {
+        for (int y = 0; y < dstH; y++) {
+            const uint8_t* r0 = src + (size_t)(y * 2) * srcStride;
+            downsample_2x2_row_generic(t, r0, r0 + srcStride, dstW, dst + (size_t)y * dstStride);
+        }
+        return;
+    }
+    float inv = 1.0f / (float)(k * k);
+    for (int y = 0; y < dstH; y++) {
+        memset(acc, 0, (size_t)dstW * 4 * sizeof(uint32_t));
+        for (int j = 0; j < k; j++) {
+            downsample_add_row_generic(t, src + (size_t)(y * k + j) * srcStride, dstW, k, acc);
+        }
+        downsample_store_generic(t, acc, dstW, inv, dst + (size_t)y * dstStride);
+    }
+}
+
+#if DOWNSAMPLE_SSE2
+static inline void downsample_add_row_sse2(const SrgbTables* t, const uint8_t* row, int dstW, int k,
+                                           uint32_t* acc) {
+    for (int x = 0; x < dstW; x++) {
+        const uint8_t* p = row + (size_t)x * k * 4;
+        __m128i s = _mm_setzero_si128();
+        for (int i = 0; i < k; i++, p += 4) {
+            s = _mm_add_epi32(s, _mm_setr_epi32(t->toLinear[p[0]], t->toLinear[p[1]], t->toLinear[p[2]], 0));
+        }
+        __m128i* a = (__m128i*)(acc + x * 4);
+        _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), s));
+    }
+}
+
+static inline void downsample_store_sse2(const SrgbTables* t, const uint32_t* acc, int dstW, float inv,
+                                         uint8_t* out) {
+    uint32_t* d = (uint32_t*)out;
+    __m128 vinv = _mm_set1_ps(inv);
+    for (int x = 0; x < dstW; x++) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(acc + x * 4));
+        __m128i idx = _mm_srli_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a), vinv)), 4);
+        uint32_t b = t->toSrgb[_mm_cvtsi128_si32(idx)];
+        uint32_t g = t->toSrgb[_mm_cvtsi128_si32(_mm_srli_si128(idx, 4))];
+        uint32_t r = t->toSrgb[_mm_cvtsi128_si32(_mm_srli_si128(idx, 8))];
+        d[x] = 0xFF000000u | (r << 16) | (g << 8) | b;
+    }
+}
+#endif
+
+// Box-downsamples the (dstW * k) x (dstH * k) region at `src` by `k` into
+// `dst`, averaging in linear light; output alpha is 255. `acc` is scratch for
+// dstW * 4 uint32_t, owned by the caller so the frame loop does not allocate.
+static inline void downsample_box_bgra(const uint8_t* src, int srcStride, uint8_t* dst, int dstW, int dstH,
+                                       int dstStride, int k, uint32_t* acc) {
+#if DOWNSAMPLE_SSE2
+    const SrgbTables* t = srgb_tables();
+    if (k == 2) {
+        for (int y = 0; y < dstH; y++) {
+            const uint8_t* r0 = src + (size_t)(y * 2) * srcStride;
+            downsample_2x2_row_generic(t, r0, r0 + srcStride, dstW, dst + (size_t)y * dstStride);
+        }
+        return;
+    }
+    float inv = 1.0f / (float)(k * k);
+    for (int y = 0; y < dstH; y++) {
+        memset(acc, 0, (size_t)dstW * 4 * sizeof(uint32_t));
+        for (int j = 0; j < k; j++) {
+            downsample_add_row_sse2(t, src + (size_t)(y * k + j) * srcStride, dstW, k, acc);
+        }
+        downsample_store_sse2(t, acc, dstW, inv, dst + (size_t)y * dstStride);
+    }
+#else
+    downsample_box_bgra_generic(src, srcStride, dst, dstW, dstH, dstStride, k, acc);
+#endif
+}
+
+#endif // PICKER_DOWNSAMPLE_H
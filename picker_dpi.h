@@ -0,0 +1,126 @@
+// Minimal Color Picker - per-monitor DPI loupe geometry (header-only, C99).
+//
+// The loupe's sizes are given in logical units (96 dpi, Windows' 100% and
+// macOS points) and its zoom in physical pixels: at zoom 8 every physical
+// screen pixel becomes 8 physical loupe pixels whatever the monitor's scale.
+// loupe_geometry() turns the logical sizes into physical ones for the monitor
+// under the cursor, so a 120 px radius is 240 physical pixels on a 200%
+// monitor, and the capture square is sized in that monitor's physical pixels.
+// The picker then captures and draws at native resolution: one nearest
+// neighbour scale from capture to loupe and no second resample by the
+// compositor.
+//
+// Mixed-DPI layouts: on macOS the desktop is laid out in points and each
+// display has its own pixels per point. The loupe's capture square lives in
+// the pixel grid of the cursor's display; dpi_map_pixel() finds which display
+// and which of its pixels lies under each square pixel, so a square that
+// straddles a 1x and a 2x display repeats whole 1x pixels rather than
+// resampling either side. On Windows with Per-Monitor V2 awareness the
+// desktop is already in physical pixels and only loupe_geometry() is needed.
+//
+//   LoupeGeometry geo = loupe_geometry(&style, zoom, dpi, capLimit);
+//   int d = dpi_map_pixel(displays, n, dpi0, gx, gy, &px, &py);
+
+#ifndef PICKER_DPI_H
+#define PICKER_DPI_H
+
+#include <math.h>
+#include <stddef.h>
+
+#include "picker_mip.h"
+
+#define DPI_BASE 96  // dpi of one logical unit per physical pixel
+
+// Logical (DPI_BASE) sizes, fixed after argument parsing.
+typedef struct LoupeStyle {
+    int radius;
+    int maxRadius;    // physical radius cap (the kernels' 2048 px loupe)
+    int borderWidth;
+    int markerSize;
+    int offset;       // window offset from the cursor
+} LoupeStyle;
+
+// Physical sizes for one monitor and zoom.
+typedef struct LoupeGeometry {
+    int dpi;
+    int radius, diameter;
+    int borderWidth, markerSize, offset;
+    int levels;       // mip levels, 1 when not zoomed out
+    int capSize;      // captured square, odd, in physical pixels
+    int srcSize;      // loupe source: capSize >> (levels - 1)
+} LoupeGeometry;
+
+// `logical` at `dpi`, rounded to the nearest pixel and never below 1.
+static inline int dpi_scale(int logical, int dpi) {
+    int v = (int)(((long long)logical * dpi + DPI_BASE / 2) / DPI_BASE);
+    return v < 1 ? 1 : v;
+}
+
+// Geometry of a loupe at `zoom` on a monitor of `dpi`. The capture square is
+// odd so the cursor maps to its centre pixel and never wider than `capLimit`
+// (the smallest screen or the desktop).
+static inline LoupeGeometry loupe_geometry(const LoupeStyle* s, double zoom, int dpi, int capLimit) {
+    LoupeGeometry g;
+    g.dpi = dpi > 0 ? dpi : DPI_BASE;
+    g.radius = dpi_scale(s->radius, g.dpi);
+    if (g.radius > s->maxRadius) g.radius = s->maxRadius;
+    g.diameter = g.radius * 2;
+    g.borderWidth = dpi_scale(s->borderWidth, g.dpi);
+    g.markerSize = dpi_scale(s->markerSize, g.dpi);
+    g.offset = dpi_scale(s->offset, g.dpi);
+    g.levels = zoom < 1.0 ? mip_levels_for_scale(1.0 / zoom) : 1;
+    if (g.levels == 1) {
+        g.capSize = (int)(g.diameter / zoom);
+        if (g.capSize > capLimit) g.capSize = capLimit;
+        if ((g.capSize % 2) == 0) g.capSize += g.capSize < capLimit ? 1 : -1;
+        g.srcSize = g.capSize;
+    } else {
+        // Zoomed out: the pyramid's coarsest level is the loupe source, odd
+        // and about one pixel per loupe pixel, so the cursor's pixel falls in
+        // its centre block.
+        int fit = capLimit >> (g.levels - 1);
+        g.srcSize = g.diameter < fit ? g.diameter : fit;
+        if ((g.srcSize % 2) == 0) g.srcSize--;
+        g.capSize = g.srcSize << (g.levels - 1);
+    }
+    return g;
+}
+
+// Bytes one frame reads and writes for a loupe of this geometry: the capture
+// square once and the loupe once.
+static inline size_t loupe_frame_bytes(const LoupeGeometry* g) {
+    return ((size_t)g->capSize * g->capSize + (size_t)g->diameter * g->diameter) * 4;
+}
+
+// A display in a points layout (macOS global coordinates, origin top-left).
+typedef struct DpiDisplay {
+    int x, y, w, h;  // frame in points
+    int dpi;         // DPI_BASE * pixels per point
+} DpiDisplay;
+
+// Display holding the point (px, py), or -1.
+static inline int dpi_display_at(const DpiDisplay* d, int n, double px, double py) {
+    for (int i = 0; i < n; i++) {
+        if (px >= d[i].x && py >= d[i].y && px < d[i].x + d[i].w && py < d[i].y + d[i].h) return i;
+    }
+    return -1;
+}
+
+// Maps pixel (gx, gy) of the global pixel grid at `dpi0` (points * dpi0 /
+// DPI_BASE, the grid of the cursor's display) to the display under its centre
+// and that display's own pixel (*px, *py). Returns the display, or -1 when
+// the pixel is on none. On a display of the same dpi the mapping is a whole
+// pixel offset; on a coarser one each of its pixels covers several grid
+// pixels, repeated as is.
+static inline int dpi_map_pixel(const DpiDisplay* d, int n, int dpi0, int gx, int gy, int* px, int* py) {
+    double toPoints = (double)DPI_BASE / (double)dpi0;
+    double ptx = ((double)gx + 0.5) * toPoints, pty = ((double)gy + 0.5) * toPoints;
+    int i = dpi_display_at(d, n, ptx, pty);
+    if (i < 0) return -1;
+    double toPixels = (double)d[i].dpi / (double)DPI_BASE;
+    *px = (int)floor((ptx - d[i].x) * toPixels);
+    *py = (int)floor((pty - d[i].y) * toPixels);
+    return i;
+}
+
+#endif // PICKER_DPI_H
@@ -0,0 +1,119 @@
+// Minimal Color Picker - two-point measurement with sub-pixel edges (header-only, C99).
+//
+// A marked point snaps to the strongest edge near it, found separately along
+// its row (for x) and its column (for y) of the capture square already in
+// memory, so nothing is read from the screen again. The gradient at the
+// boundary between two neighbouring pixels is the sum of their absolute B, G
+// and R differences. The boundary with the largest gradient within `reach`
+// pixels of the point is taken, and the edge is placed at the centroid of
+// the gradient profile over it and its two neighbours. For a step that the
+// screen box-filters across one pixel (an antialiased edge covering a
+// fraction f of that pixel) the profile has two non-zero boundaries whose
+// centroid lies exactly on the edge, so text and shape outlines snap to
+// where they were drawn, not to the nearest pixel. An axis whose strongest
+// gradient stays under `minGradient` does not snap, and the point keeps the
+// pixel's centre there.
+//
+// Coordinates are in pixel-edge units: pixel i spans [i, i + 1), its centre
+// is i + 0.5.
+//
+//   EdgePoint a = edge_snap_point(cap, size, stride, cx, cy, ox, oy, reach, minGradient);
+//   edge_format_pair(&a, &b, line, sizeof(line));  // distance, dx, dy, angle
+
+#ifndef PICKER_EDGE_H
+#define PICKER_EDGE_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "picker_kernels.h"
+
+#define EDGE_REACH 4           // pixels searched each side of the point
+#define EDGE_MIN_GRADIENT 48   // of 765: weaker boundaries do not snap
+
+typedef struct EdgePoint {
+    double x, y;         // snapped position, pixel centre when that axis did not snap
+    int snappedX, snappedY;
+    uint32_t colour;     // the pixel under the point
+} EdgePoint;
+
+// Gradient across the boundary between pixels a and b.
+static inline int edge_gradient(uint32_t a, uint32_t b) {
+    int g = 0;
+    for (int s = 0; s < 24; s += 8) {
+        int d = (int)((a >> s) & 0xFF) - (int)((b >> s) & 0xFF);
+        g += d < 0 ? -d : d;
+    }
+    return g;
+}
+
+// Position of the strongest edge on a line of n pixels, p[i * step], within
+// `reach` pixels of pixel c, as the centroid of the gradient profile around
+// its strongest boundary. Returns 0 (and leaves *pos) when no boundary's
+// gradient reaches minGradient. Of equally strong boundaries the one nearest
+// the centre of pixel c wins.
+static inline int edge_locate(const uint32_t* p, ptrdiff_t step, int n, int c, int reach, int minGradient,
+                              double* pos) {
+    // Boundary j lies between pixels j - 1 and j, at coordinate j.
+    int j0 = c - reach + 1, j1 = c + reach;
+    if (j0 < 1) j0 = 1;
+    if (j1 > n - 1) j1 = n - 1;
+    int best = -1, bestG = minGradient - 1;
+    double bestDist = 0.0;
+    for (int j = j0; j <= j1; j++) {
+        int g = edge_gradient(p[(j - 1) * step], p[j * step]);
+        double dist = fabs((double)j - ((double)c + 0.5));
+        if (g > bestG || (g == bestG && best >= 0 && dist < bestDist)) {
+            best = j;
+            bestG = g;
+            bestDist = dist;
+        }
+    }
+    if (best < 0) return 0;
+
+    double sum = 0.0, moment = 0.0;
+    for (int j = best - 1; j <= best + 1; j++) {
+        if (j < 1 || j > n - 1) continue;
+        double g = (double)edge_gradient(p[(j - 1) * step], p[j * step]);
+        sum += g;
+        moment += g * (double)j;
+    }
+    *pos = moment / sum;
+    return 1;
+}
+
+// The point at pixel (cx, cy) of a size x size capture square, snapped to
+// the nearest strong edges along its row and column, in the coordinates of
+// the square's origin (ox, oy).
+static inline EdgePoint edge_snap_point(const uint8_t* cap, int size, int stride, int cx, int cy, int ox, int oy,
+                                        int reach, int minGradient) {
+    EdgePoint e;
+    const uint32_t* row = pixel_row_const(cap, stride, cy);
+    double x = (double)cx + 0.5, y = (double)cy + 0.5;
+    e.colour = row[cx] | 0xFF000000u;
+    e.snappedX = edge_locate(row, 1, size, cx, reach, minGradient, &x);
+    e.snappedY = edge_locate(pixel_row_const(cap, stride, 0) + cx, stride / 4, size, cy, reach, minGradient, &y);
+    e.x = (double)ox + x;
+    e.y = (double)oy + y;
+    return e;
+}
+
+// "x,y #RRGGBB" with the snapped axes marked, e.g. "120.37|,40.50 #FFFFFF".
+static inline void edge_format_point(const EdgePoint* e, char* buf, size_t size) {
+    char hex[8];
+    format_hex_color(e->colour, hex);
+    snprintf(buf, size, "%.2f%s,%.2f%s %s", e->x, e->snappedX ? "|" : "", e->y, e->snappedY ? "-" : "", hex);
+}
+
+// Distance, offsets and angle from a to b. The angle is counter-clockwise
+// from the x axis as seen on screen (y grows downwards), in degrees.
+static inline void edge_format_pair(const EdgePoint* a, const EdgePoint* b, char* buf, size_t size) {
+    double dx = b->x - a->x, dy = b->y - a->y;
+    double angle = (dx == 0.0 && dy == 0.0) ? 0.0 : atan2(-dy, dx) * (180.0 / 3.14159265358979323846);
+    snprintf(buf, size, "distance %.2f px  dx %.2f  dy %.2f  angle %.1f deg", sqrt(dx * dx + dy * dy), dx, dy,
+             angle);
+}
+
+#endif // PICKER_EDGE_H
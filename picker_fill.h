@@ -0,0 +1,325 @@
+// Minimal Color Picker - same-colour region measurement (header-only, C99).
+//
+// Flood-fills a captured frame from one pixel through every 4-connected
+// pixel whose B, G and R each lie within `tol` of the seed's, and reports
+// the region's bounding box, pixel area and centroid: how big a button's
+// background or a panel is, in screen pixels.
+//
+// The fill works on spans, after Heckbert's seed fill: a queued entry is a
+// row plus the span of the neighbouring row just filled, and only the pixels
+// under that span are searched. Each run found there is extended left and
+// right, marked in one memset, added to the totals in closed form and queued
+// for the next row on; only the parts that stick out past the parent span are
+// queued back towards it. Every scan (find the next run, extend it either way)
+// tests eight pixels per step with SSE2: a saturating absolute difference
+// against the seed, a saturating subtract of the tolerance and one compare
+// give a match mask, ANDed with the visited marks. The portable version visits
+// the same spans in the same order. A pixel is read about twice, in its own
+// run and from the row that found it, so a solid 4K frame costs a few
+// milliseconds.
+//
+// The visited map is a byte per pixel holding the number of the fill that
+// marked it, so it is cleared only once every 255 fills; it and the span
+// stack are kept between fills, and a second fill of the same size allocates
+// nothing.
+//
+//   FillResult r;
+//   if (flood_fill_bgra(&map, px, w, h, stride, x, y, tol, &r)) ...  // 0: out of memory
+
+#ifndef PICKER_FILL_H
+#define PICKER_FILL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILL_SSE2 1
+#else
+#define FILL_SSE2 0
+#endif
+
+typedef struct FillResult {
+    int x0, y0, x1, y1;  // bounding box, x1 and y1 exclusive
+    uint64_t area;       // pixels
+    double cx, cy;       // centroid, in pixel coordinates (a pixel's centre is +0.5)
+    uint64_t spans;      // runs filled
+} FillResult;
+
+// Row y is to be scanned under (or over) the span [x0, x1) of row y - dy,
+// which was just filled.
+typedef struct FillSpan {
+    int y, x0, x1, dy;
+} FillSpan;
+
+typedef struct FillMap {
+    uint8_t* visited;    // one byte per pixel: == gen when filled by the current fill
+    size_t visitedCap;
+    uint8_t gen;         // current fill's mark, 1..255; the map is cleared when it wraps
+    FillSpan* stack;
+    size_t stackCap;
+
+    // Counters (for --stats).
+    uint64_t fills;
+    uint64_t pixels;     // filled, over all fills
+    double totalMs, maxMs;
+} FillMap;
+
+// Same-colour test shared by both paths: alpha is ignored (X11 grabs leave
+// it undefined) and each colour channel may differ by up to `tol`.
+static inline int fill_match(uint32_t p, uint32_t seed, int tol) {
+    for (int s = 0; s < 24; s += 8) {
+        int d = (int)((p >> s) & 0xFF) - (int)((seed >> s) & 0xFF);
+        if (d > tol || -d > tol) return 0;
+    }
+    return 1;
+}
+
+// The scans below take the row's pixels and visited marks, the seed colour,
+// the tolerance and the current mark; "inside" is matching and not marked.
+
+// First x in [x, end) that is not inside; end when none.
+static inline int fill_run_end_generic(const uint32_t* row, const uint8_t* vis, int x, int end, uint32_t seed,
+                                       int tol, uint8_t gen) {
+    while (x < end && vis[x] != gen && fill_match(row[x], seed, tol)) x++;
+    return x;
+}
+
+// Leftmost l <= x with [l, x] inside, given that x is.
+static inline int fill_run_begin_generic(const uint32_t* row, const uint8_t* vis, int x, uint32_t seed, int tol,
+                                         uint8_t gen) {
+    while (x > 0 && vis[x - 1] != gen && fill_match(row[x - 1], seed, tol)) x--;
+    return x;
+}
+
+// First x in [x, end) that is inside; end when none.
+static inline int fill_next_generic(const uint32_t* row, const uint8_t* vis, int x, int end, uint32_t seed, int tol,
+                                    uint8_t gen) {
+    while (x < end && (vis[x] == gen || !fill_match(row[x], seed, tol))) x++;
+    return x;
+}
+
+#if FILL_SSE2
+typedef struct FillSse2 {
+    __m128i seed, tol, gen;
+} FillSse2;
+
+// The tolerance as a byte per channel; alpha always passes.
+static inline FillSse2 fill_sse2_init(uint32_t seed, int tol, uint8_t gen) {
+    uint32_t t = (uint32_t)(tol > 255 ? 255 : tol);
+    FillSse2 k;
+    k.seed = _mm_set1_epi32((int)seed);
+    k.tol = _mm_set1_epi32((int)(0xFF000000u | (t << 16) | (t << 8) | t));
+    k.gen = _mm_set1_epi32(gen);
+    return k;
+}
+
+// Bit i set when pixel i of the four at `row` is inside.
+static inline int fill_mask4_sse2(const uint32_t* row, const uint8_t* vis, const FillSse2* k) {
+    __m128i p = _mm_loadu_si128((const __m128i*)row);
+    __m128i d = _mm_or_si128(_mm_subs_epu8(p, k->seed), _mm_subs_epu8(k->seed, p));
+    __m128i zero = _mm_setzero_si128();
+    __m128i match = _mm_cmpeq_epi32(_mm_subs_epu8(d, k->tol), zero);
+    uint32_t v;
+    memcpy(&v, vis, 4);
+    __m128i marks = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)v), zero), zero);
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(_mm_cmpeq_epi32(marks, k->gen), match)));
+}
+
+// Eight pixels per step: two masks, one branch.
+static inline int fill_mask8_sse2(const uint32_t* row, const uint8_t* vis, const FillSse2* k) {
+    return fill_mask4_sse2(row, vis, k) | (fill_mask4_sse2(row + 4, vis + 4, k) << 4);
+}
+
+static inline int fill_run_end_sse2(const uint32_t* row, const uint8_t* vis, int x, int end, uint32_t seed, int tol,
+                                    uint8_t gen, const FillSse2* k) {
+    for (; x + 8 <= end; x += 8) {
+        int m = fill_mask8_sse2(row + x, vis + x, k);
+        if (m != 0xFF) {
+            int i = 0;
+            while (m & (1 << i)) i++;
+            return x + i;
+        }
+    }
+    return fill_run_end_generic(row, vis, x, end, seed, tol, gen);
+}
+
+static inline int fill_run_begin_sse2(const uint32_t* row, const uint8_t* vis, int x, uint32_t seed, int tol,
+                                      uint8_t gen, const FillSse2* k) {
+    for (; x >= 8; x -= 8) {
+        int m = fill_mask8_sse2(row + x - 8, vis + x - 8, k);
+        if (m != 0xFF) {
+            int i = 7;
+            while (m & (1 << i)) i--;
+            return x - 7 + i;
+        }
+    }
+    return fill_run_begin_generic(row, vis, x, seed, tol, gen);
+}
+
+static inline int fill_next_sse2(const uint32_t* row, const uint8_t* vis, int x, int end, uint32_t seed, int tol,
+                                 uint8_t gen, const FillSse2* k) {
+    for (; x + 8 <= end; x += 8) {
+        int m = fill_mask8_sse2(row + x, vis + x, k);
+        if (m) {
+            int i = 0;
+            while (!(m & (1 << i))) i++;
+            return x + i;
+        }
+    }
+    return fill_next_generic(row, vis, x, end, seed, tol, gen);
+}
+#endif
+
+// Grows the visited map to a w x h frame. Returns 0 on failure.
+static inline int fill_reserve(FillMap* m, int w, int h) {
+    size_t want = (size_t)w * (size_t)h;
+    if (want <= m->visitedCap) return 1;
+    uint8_t* v = (uint8_t*)realloc(m->visited, want);
+    if (!v) return 0;
+    memset(v, 0, want);
+    m->visited = v;
+    m->visitedCap = want;
+    m->gen = 0;
+    return 1;
+}
+
+static inline void fill_free(FillMap* m) {
+    free(m->visited);
+    free(m->stack);
+    memset(m, 0, sizeof(*m));
+}
+
+// Bytes held, for the memory report.
+static inline size_t fill_bytes(const FillMap* m) {
+    return m->visitedCap + m->stackCap * sizeof(FillSpan);
+}
+
+// Queues row y under the span [x0, x1) of row y - dy, if row y exists.
+static inline int fill_push(FillMap* m, size_t* n, int h, int y, int x0, int x1, int dy) {
+    if (y < 0 || y >= h) return 1;
+    if (*n == m->stackCap) {
+        size_t cap = m->stackCap ? m->stackCap * 2 : 1024;
+        FillSpan* s = (FillSpan*)realloc(m->stack, cap * sizeof(FillSpan));
+        if (!s) return 0;
+        m->stack = s;
+        m->stackCap = cap;
+    }
+    FillSpan* f = &m->stack[(*n)++];
+    f->y = y;
+    f->x0 = x0;
+    f->x1 = x1;
+    f->dy = dy;
+    return 1;
+}
+
+// Marks [l, r) of row y filled and adds it to the totals.
+static inline void fill_span(FillMap* m, uint8_t* vis, int y, int l, int r, FillResult* out, double* sumX,
+                             double* sumY) {
+    memset(vis + l, m->gen, (size_t)(r - l));
+    double len = (double)(r - l);
+    out->area += (uint64_t)(r - l);
+    out->spans++;
+    *sumX += len * (double)(l + r) * 0.5;  // pixel centres l + 0.5 .. r - 0.5
+    *sumY += len * ((double)y + 0.5);
+    if (l < out->x0) out->x0 = l;
+    if (r > out->x1) out->x1 = r;
+    if (y < out->y0) out->y0 = y;
+    if (y + 1 > out->y1) out->y1 = y + 1;
+}
+
+// Span fill (after Heckbert's seed fill) with the SSE2 scans when `simd` is
+// set; flood_fill_bgra() and flood_fill_bgra_generic() are the entry points.
+// A popped row is scanned only under its parent span. Each run found there is
+// extended past the parent's ends, filled, and queued for the next row in the
+// same direction. The parts that stick out past the parent are also queued
+// back towards the parent's row, the only place a run can leak round a
+// corner. A pixel is read about once in its own row plus once per neighbour
+// scan that reaches it.
+static inline int flood_fill_bgra_impl(FillMap* m, const uint8_t* px, int w, int h, int stride, int sx, int sy,
+                                       int tol, FillResult* r, int simd) {
+    memset(r, 0, sizeof(*r));
+    if (sx < 0 || sy < 0 || sx >= w || sy >= h) return 1;
+    if (!fill_reserve(m, w, h)) return 0;
+    if (++m->gen == 0) {
+        memset(m->visited, 0, m->visitedCap);
+        m->gen = 1;
+    }
+    uint8_t gen = m->gen;
+    uint32_t seed = ((const uint32_t*)(px + (size_t)sy * stride))[sx];
+#if FILL_SSE2
+    FillSse2 k = fill_sse2_init(seed, tol, gen);
+#define FILL_SCAN(fn, ...) (simd ? fn##_sse2(__VA_ARGS__, &k) : fn##_generic(__VA_ARGS__))
+#else
+    (void)simd;
+#define FILL_SCAN(fn, ...) fn##_generic(__VA_ARGS__)
+#endif
+    r->x0 = w;
+    r->y0 = h;
+    double sumX = 0.0, sumY = 0.0;
+    size_t n = 0;
+
+    const uint32_t* row = (const uint32_t*)(px + (size_t)sy * stride);
+    uint8_t* vis = m->visited + (size_t)sy * w;
+    int l = FILL_SCAN(fill_run_begin, row, vis, sx, seed, tol, gen);
+    int e = FILL_SCAN(fill_run_end, row, vis, sx + 1, w, seed, tol, gen);
+    fill_span(m, vis, sy, l, e, r, &sumX, &sumY);
+    if (!fill_push(m, &n, h, sy + 1, l, e, 1) || !fill_push(m, &n, h, sy - 1, l, e, -1)) return 0;
+
+    while (n) {
+        FillSpan f = m->stack[--n];
+        row = (const uint32_t*)(px + (size_t)f.y * stride);
+        vis = m->visited + (size_t)f.y * w;
+        int x = FILL_SCAN(fill_next, row, vis, f.x0, f.x1, seed, tol, gen);
+        while (x < f.x1) {
+            l = x == f.x0 ? FILL_SCAN(fill_run_begin, row, vis, x, seed, tol, gen) : x;
+            e = FILL_SCAN(fill_run_end, row, vis, x + 1, w, seed, tol, gen);
+            fill_span(m, vis, f.y, l, e, r, &sumX, &sumY);
+            if (!fill_push(m, &n, h, f.y + f.dy, l, e, f.dy)) return 0;
+            if (l < f.x0 && !fill_push(m, &n, h, f.y - f.dy, l, f.x0, -f.dy)) return 0;
+            if (e > f.x1 && !fill_push(m, &n, h, f.y - f.dy, f.x1, e, -f.dy)) return 0;
+            x = e < f.x1 ? FILL_SCAN(fill_next, row, vis, e, f.x1, seed, tol, gen) : f.x1;
+        }
+    }
+#undef FILL_SCAN
+    r->cx = sumX / (double)r->area;
+    r->cy = sumY / (double)r->area;
+    m->fills++;
+    m->pixels += r->area;
+    return 1;
+}
+
+// Fills the w x h BGRA frame at `px` from (sx, sy) and stores the region in
+// *r (area 0 when the seed is outside the frame). Returns 0 on failure to
+// allocate.
+static inline int flood_fill_bgra(FillMap* m, const uint8_t* px, int w, int h, int stride, int sx, int sy, int tol,
+                                  FillResult* r) {
+    return flood_fill_bgra_impl(m, px, w, h, stride, sx, sy, tol, r, FILL_SSE2);
+}
+
+// Portable version; same spans, same result.
+static inline int flood_fill_bgra_generic(FillMap* m, const uint8_t* px, int w, int h, int stride, int sx, int sy,
+                                          int tol, FillResult* r) {
+    return flood_fill_bgra_impl(m, px, w, h, stride, sx, sy, tol, r, 0);
+}
+
+static inline void fill_count_ms(FillMap* m, double ms) {
+    m->totalMs += ms;
+    if (ms > m->maxMs) m->maxMs = ms;
+}
+
+// One line for a measurement: size, box, area and centroid.
+static inline void fill_format(const FillResult* r, double ms, char* buf, size_t size) {
+    snprintf(buf, size, "%dx%d at %d,%d  %llu px  centroid %.1f,%.1f  (%.2f ms)", r->x1 - r->x0, r->y1 - r->y0,
+             r->x0, r->y0, (unsigned long long)r->area, r->cx, r->cy, ms);
+}
+
+static inline void fill_report(const FillMap* m, FILE* fp) {
+    if (!m->fills) return;
+    fprintf(fp, "fill: %llu measurements, %.0f px each, %.3f ms mean, %.3f ms max\n", (unsigned long long)m->fills,
+            (double)m->pixels / (double)m->fills, m->totalMs / (double)m->fills, m->maxMs);
+}
+
+#endif // PICKER_FILL_H
@@ -0,0 +1,217 @@
+// Minimal Color Picker - loupe source filters fused into the compose (header-only, C99).
+//
+// A filter changes what the loupe shows of each capture pixel: the onion
+// skin blends a reference image over the live screen or shows their
+// per-channel difference (picker_onion.h). It runs inside the compose, not
+// as a pass of its own: for each source row the loupe magnifies, the row is
+// filtered once into a small buffer on the stack, 4 pixels per SSE2 step,
+// and the nearest-neighbour scale expands that buffer as it would the
+// capture row. The filter therefore costs one operation per capture pixel,
+// not per loupe pixel, no filtered copy of the square is written, and the
+// mask, border and marker follow in the same band while it is in cache.
+//
+// The difference amplifier stretches contrast around the centre pixel's
+// colour, so #FEFEFE beside #FFFFFF shows as dark grey beside light grey:
+// each channel maps (v - centre) * gain + 128, clamped, with levels within
+// `range` of the centre spread over the whole 0..255. filter_amplify()
+// rebuilds the per-channel tables only when the centre colour or range
+// changes; the SSE2 rows compute the same map with a saturating multiply,
+// as SSE2 has no byte table lookup.
+//
+// The reference square is aligned with the capture square, pixel for pixel.
+// Its alpha weighs it: where the reference is transparent (off the mock) the
+// loupe shows the live screen in blend mode and no difference in diff mode.
+//
+//   LoupeFilter f = { LOUPE_FILTER_BLEND, ref, refStride, 64 };   // half and half
+//   compose_loupe_filtered_rows(&f, cap, capSize, capStride, dst, ..., y0, y1);
+//
+//   filter_amplify(&f, centre, 8);   // once a frame: +-8 levels to 0..255
+//
+// Every output pixel is the same with and without SSE2.
+
+#ifndef PICKER_FILTER_H
+#define PICKER_FILTER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "picker_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILTER_SSE2 1
+#else
+#define FILTER_SSE2 0
+#endif
+
+#define FILTER_MAX_ROW 4096  // widest capture row a filter takes; wider ones compose unfiltered
+
+enum {
+    LOUPE_FILTER_NONE,
+    LOUPE_FILTER_BLEND,  // reference over live at `opacity`
+    LOUPE_FILTER_DIFF,   // |live - reference| per channel
+    LOUPE_FILTER_AMPLIFY,  // contrast stretched around `centre`; no reference
+};
+
+typedef struct LoupeFilter {
+    int mode;
+    const uint8_t* ref;  // reference square, aligned with the capture square
+    int refStride;
+    int opacity;         // blend weight of an opaque reference pixel, 0..128
+    uint32_t centre;     // amplify: the colour stretched around (alpha clear)
+    int gain;            // amplify: output levels per input level; 0 before the first table
+    uint8_t lut[3][256]; // amplify: blue, green and red maps
+} LoupeFilter;
+
+// Weight of reference pixel r at `opacity`, 0..128: its alpha scaled so that
+// 255 gives exactly `opacity`.
+static inline int filter_weight(uint32_t r, int opacity) {
+    int a = (int)(r >> 24);
+    return (opacity * (a + (a >> 7))) >> 8;
+}
+
+static inline uint32_t filter_pixel(uint32_t s, uint32_t r, int mode, int opacity) {
+    int w = filter_weight(r, mode == LOUPE_FILTER_DIFF ? 128 : opacity);
+    uint32_t out = 0xFF000000u;
+    for (int sh = 0; sh < 24; sh += 8) {
+        int a = (int)((s >> sh) & 0xFF), b = (int)((r >> sh) & 0xFF);
+        int v = (a * (128 - w) + b * w + 64) >> 7;
+        if (mode == LOUPE_FILTER_DIFF) v = a > v ? a - v : v - a;
+        out |= (uint32_t)v << sh;
+    }
+    return out;
+}
+
+// Sets `f` to amplify levels within `range` (1..128) of `centre` to the full
+// 0..255. Returns 1 when the tables were rebuilt, 0 when the centre colour
+// and range are those of the last call.
+static inline int filter_amplify(LoupeFilter* f, uint32_t centre, int range) {
+    if (range < 1) range = 1;
+    if (range > 128) range = 128;
+    int gain = 128 / range;
+    centre &= 0x00FFFFFFu;
+    f->mode = LOUPE_FILTER_AMPLIFY;
+    if (f->gain == gain && f->centre == centre) return 0;
+    f->centre = centre;
+    f->gain = gain;
+    for (int c = 0; c < 3; c++) {
+        int mid = (int)((centre >> (c * 8)) & 0xFF);
+        for (int v = 0; v < 256; v++) {
+            int o = (v - mid) * gain + 128;
+            f->lut[c][v] = (uint8_t)(o < 0 ? 0 : o > 255 ? 255 : o);
+        }
+    }
+    return 1;
+}
+
+static inline uint32_t filter_amplify_pixel(const LoupeFilter* f, uint32_t s) {
+    return 0xFF000000u | (uint32_t)f->lut[2][(s >> 16) & 0xFF] << 16 | (uint32_t)f->lut[1][(s >> 8) & 0xFF] << 8 |
+           f->lut[0][s & 0xFF];
+}
+
+static inline void filter_row_generic(const LoupeFilter* f, const uint32_t* s, const uint32_t* r, uint32_t* out,
+                                      int n) {
+    if (f->mode == LOUPE_FILTER_AMPLIFY) {
+        for (int i = 0; i < n; i++) out[i] = filter_amplify_pixel(f, s[i]);
+        return;
+    }
+    for (int i = 0; i < n; i++) out[i] = filter_pixel(s[i], r[i], f->mode, f->opacity);
+}
+
+#if FILTER_SSE2
+// Two pixels of 16-bit lanes: (live * (128 - w) + ref * w + 64) >> 7, with
+// each pixel's weight spread over its four lanes.
+static inline __m128i filter_lerp2_sse2(__m128i s, __m128i r, __m128i opacity) {
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(r, 0xFF), 0xFF);
+    a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+    __m128i w = _mm_srli_epi16(_mm_mullo_epi16(a, opacity), 8);
+    __m128i v = _mm_add_epi16(_mm_mullo_epi16(s, _mm_sub_epi16(_mm_set1_epi16(128), w)), _mm_mullo_epi16(r, w));
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_set1_epi16(64)), 7);
+}
+
+// (v - centre) * gain + 128 over 16-bit lanes; the saturating add and pack
+// clamp it to 0..255 as the tables do.
+static inline void filter_amplify_row_sse2(const LoupeFilter* f, const uint32_t* s, uint32_t* out, int n) {
+    __m128i zero = _mm_setzero_si128(), opaque = _mm_set1_epi32((int)0xFF000000u);
+    __m128i centre = _mm_unpacklo_epi8(_mm_set1_epi32((int)f->centre), zero);
+    __m128i gain = _mm_set1_epi16((short)f->gain), mid = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i sv = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(sv, zero), centre);
+        __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(sv, zero), centre);
+        lo = _mm_adds_epi16(_mm_mullo_epi16(lo, gain), mid);
+        hi = _mm_adds_epi16(_mm_mullo_epi16(hi, gain), mid);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+    }
+    for (; i < n; i++) out[i] = filter_amplify_pixel(f, s[i]);
+}
+
+static inline void filter_row_sse2(const LoupeFilter* f, const uint32_t* s, const uint32_t* r, uint32_t* out, int n) {
+    if (f->mode == LOUPE_FILTER_AMPLIFY) {
+        filter_amplify_row_sse2(f, s, out, n);
+        return;
+    }
+    int diff = f->mode == LOUPE_FILTER_DIFF;
+    __m128i opacity = _mm_set1_epi16((short)(diff ? 128 : f->opacity));
+    __m128i zero = _mm_setzero_si128(), opaque = _mm_set1_epi32((int)0xFF000000u);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i sv = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i rv = _mm_loadu_si128((const __m128i*)(r + i));
+        __m128i lo = filter_lerp2_sse2(_mm_unpacklo_epi8(sv, zero), _mm_unpacklo_epi8(rv, zero), opacity);
+        __m128i hi = filter_lerp2_sse2(_mm_unpackhi_epi8(sv, zero), _mm_unpackhi_epi8(rv, zero), opacity);
+        __m128i v = _mm_packus_epi16(lo, hi);
+        if (diff) v = _mm_or_si128(_mm_subs_epu8(sv, v), _mm_subs_epu8(v, sv));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(v, opaque));
+    }
+    for (; i < n; i++) out[i] = filter_pixel(s[i], r[i], f->mode, f->opacity);
+}
+#endif
+
+static inline void filter_row(const LoupeFilter* f, const uint32_t* s, const uint32_t* r, uint32_t* out, int n) {
+#if FILTER_SSE2
+    filter_row_sse2(f, s, r, out, n);
+#else
+    filter_row_generic(f, s, r, out, n);
+#endif
+}
+
+// scale_nearest_bgra_rows() of the filtered capture: each run of destination
+// rows that magnify one source row gets that row filtered once.
+static inline void filter_scale_rows(const LoupeFilter* f, const uint8_t* src, int srcSize, int srcStride,
+                                     uint8_t* dst, int dstSize, int dstStride, int y0, int y1) {
+    uint32_t row[FILTER_MAX_ROW];
+    if (y0 < 0) y0 = 0;
+    if (y1 > dstSize) y1 = dstSize;
+    for (int y = y0; y < y1;) {
+        int sy = (int)((int64_t)y * srcSize / dstSize);
+        int ye = (int)(((int64_t)(sy + 1) * dstSize + srcSize - 1) / srcSize);  // first row of source row sy + 1
+        if (ye > y1) ye = y1;
+        const uint32_t* ref = f->mode == LOUPE_FILTER_AMPLIFY ? NULL : pixel_row_const(f->ref, f->refStride, sy);
+        filter_row(f, pixel_row_const(src, srcStride, sy), ref, row, srcSize);
+        scale_nearest_bgra_rows((const uint8_t*)row, srcSize, 1, 0, dst + (size_t)y * (size_t)dstStride, dstSize,
+                                ye - y, dstStride, 0, ye - y);
+        y = ye;
+    }
+}
+
+// compose_loupe_rows() with the capture seen through filter `f` (NULL or
+// LOUPE_FILTER_NONE for none).
+static inline void compose_loupe_filtered_rows(const LoupeFilter* f, const uint8_t* cap, int capSize, int capStride,
+                                               uint8_t* dst, int radius, int dstStride,
+                                               int borderWidth, int antialias, int markerSize,
+                                               int y0, int y1) {
+    if (!f || f->mode == LOUPE_FILTER_NONE || capSize > FILTER_MAX_ROW) {
+        compose_loupe_rows(cap, capSize, capStride, dst, radius, dstStride, borderWidth, antialias, markerSize,
+                           y0, y1);
+        return;
+    }
+    int diameter = radius * 2;
+    filter_scale_rows(f, cap, capSize, capStride, dst, diameter, dstStride, y0, y1);
+    apply_circle_alpha_mask_rows(dst, radius, dstStride, y0, y1);
+    blend_circle_border_rows(dst, radius, dstStride, borderWidth, antialias, y0, y1);
+    draw_center_marker_rows(dst, radius, dstStride, markerSize, y0, y1);
+}
+
+#endif // PICKER_FILTER_H
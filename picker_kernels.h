@@ -0,0 +1,452 @@
+// Minimal Color Picker - portable pixel kernels (header-only, C99).
+//
+// All buffers are 32-bit BGRA, top-down, with an explicit stride in bytes.
+// This matches a 32bpp Windows DIB section, an X11 ZPixmap on little-endian
+// hosts and ScreenCaptureKit's kCVPixelFormatType_32BGRA. Output alpha is
+// premultiplied, as required by UpdateLayeredWindow(ULW_ALPHA).
+//
+// The kernels do not touch any OS API so they can be benchmarked and tested
+// on a headless machine (see bench/ and `make bench`).
+
+#ifndef PICKER_KERNELS_H
+#define PICKER_KERNELS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uint32_t* pixel_row(uint8_t* px, int stride, int y) {
+    return (uint32_t*)(px + (size_t)y * (size_t)stride);
+}
+
+static inline const uint32_t* pixel_row_const(const uint8_t* px, int stride, int y) {
+    return (const uint32_t*)(px + (size_t)y * (size_t)stride);
+}
+
+static inline int isqrt_floor(int v) {
+    if (v <= 0) return 0;
+    int r = (int)sqrt((double)v);
+    while (r * r > v) r--;
+    while ((r + 1) * (r + 1) <= v) r++;
+    return r;
+}
+
+// ----------------------
+// Scale
+// ----------------------
+
+// Nearest-neighbour scale (replacement for StretchBlt with COLORONCOLOR).
+// Destination pixel (x, y) takes source pixel (x*srcW/dstW, y*srcH/dstH), so
+// with an odd source size the centre source pixel covers the centre of the
+// output. Output alpha is forced to 255. Each source pixel is expanded as a
+// run, and destination rows that map to the same source row are copied.
+// The _rows variant writes destination rows [y0, y1) only, so bands of one
+// frame can be produced independently (see picker_pool.h).
+static inline void scale_nearest_bgra_rows(const uint8_t* src, int srcW, int srcH, int srcStride,
+                                           uint8_t* dst, int dstW, int dstH, int dstStride,
+                                           int y0, int y1) {
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) return;
+    if (y0 < 0) y0 = 0;
+    if (y1 > dstH) y1 = dstH;
+
+    int prevSy = -1;
+    const uint32_t* prevRow = NULL;
+
+    for (int y = y0; y < y1; y++) {
+        int sy = (int)((int64_t)y * srcH / dstH);
+        uint32_t* d = pixel_row(dst, dstStride, y);
+
+        if (sy == prevSy) {
+            memcpy(d, prevRow, (size_t)dstW * 4);
+            continue;
+        }
+
+        const uint32_t* s = pixel_row_const(src, srcStride, sy);
+        if (dstW >= srcW) {
+            // Run of source pixel sx is [ceil(sx*dstW/srcW), ceil((sx+1)*dstW/srcW)).
+            int x0 = 0;
+            for (int sx = 0; sx < srcW; sx++) {
+                int x1 = (int)(((int64_t)(sx + 1) * dstW + srcW - 1) / srcW);
+                if (x1 > dstW) x1 = dstW;
+                uint32_t v = s[sx] | 0xFF000000u;
+                for (int x = x0; x < x1; x++) d[x] = v;
+                x0 = x1;
+            }
+        } else {
+            for (int x = 0; x < dstW; x++) {
+                d[x] = s[(int64_t)x * srcW / dstW] | 0xFF000000u;
+            }
+        }
+
+        prevSy = sy;
+        prevRow = d;
+    }
+}
+
+static inline void scale_nearest_bgra(const uint8_t* src, int srcW, int srcH, int srcStride,
+                                      uint8_t* dst, int dstW, int dstH, int dstStride) {
+    scale_nearest_bgra_rows(src, srcW, srcH, srcStride, dst, dstW, dstH, dstStride, 0, dstH);
+}
+
+// The same mapping for the destination rectangle [x0, x1) x [y0, y1) only,
+// for patching part of a frame (see picker_damage.h).
+static inline void scale_nearest_bgra_rect(const uint8_t* src, int srcW, int srcH, int srcStride,
+                                           uint8_t* dst, int dstW, int dstH, int dstStride,
+                                           int x0, int y0, int x1, int y1) {
+    if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0) return;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > dstW) x1 = dstW;
+    if (y1 > dstH) y1 = dstH;
+    if (x0 >= x1) return;
+
+    int prevSy = -1;
+    const uint32_t* prevRow = NULL;
+    for (int y = y0; y < y1; y++) {
+        int sy = (int)((int64_t)y * srcH / dstH);
+        uint32_t* d = pixel_row(dst, dstStride, y);
+        if (sy == prevSy) {
+            memcpy(d + x0, prevRow + x0, (size_t)(x1 - x0) * 4);
+            continue;
+        }
+        const uint32_t* s = pixel_row_const(src, srcStride, sy);
+        int x = x0;
+        for (int sx = (int)((int64_t)x0 * srcW / dstW); x < x1; sx++) {
+            int xe = (int)(((int64_t)(sx + 1) * dstW + srcW - 1) / srcW);
+            if (xe > x1) xe = x1;
+            uint32_t v = s[sx] | 0xFF000000u;
+            for (; x < xe; x++) d[x] = v;
+        }
+        prevSy = sy;
+        prevRow = d;
+    }
+}
+
+// Moves image content in place so that out(x, y) = in(x + dx, y + dy), with
+// zero where the source falls outside the image. Used to turn a capture taken
+// at a clamped (on-screen) origin into one at the requested origin.
+static inline void shift_bgra(uint8_t* px, int w, int h, int stride, int dx, int dy) {
+    if (dx == 0 && dy == 0) return;
+    if (dx <= -w || dx >= w || dy <= -h || dy >= h) {
+        for (int y = 0; y < h; y++) memset(pixel_row(px, stride, y), 0, (size_t)w * 4);
+        return;
+    }
+
+    // Walk rows in the direction that never overwrites unread source rows.
+    int y0 = dy >= 0 ? 0 : h - 1;
+    int step = dy >= 0 ? 1 : -1;
+    int copyW = w - (dx >= 0 ? dx : -dx);
+
+    for (int i = 0; i < h; i++) {
+        int y = y0 + i * step;
+        uint32_t* d = pixel_row(px, stride, y);
+        int sy = y + dy;
+        if (sy < 0 || sy >= h) {
+            memset(d, 0, (size_t)w * 4);
+            continue;
+        }
+        const uint32_t* s = pixel_row(px, stride, sy);
+        if (dx >= 0) {
+            memmove(d, s + dx, (size_t)copyW * 4);
+            memset(d + copyW, 0, (size_t)dx * 4);
+        } else {
+            memmove(d - dx, s, (size_t)copyW * 4);
+            memset(d, 0, (size_t)(-dx) * 4);
+        }
+    }
+}
+
+// ----------------------
+// Mask
+// ----------------------
+
+// Keeps the disc (x-r)^2 + (y-r)^2 <= r^2 opaque and clears everything else in
+// a (2r x 2r) buffer. Works per row on the [r-w, r+w] span instead of testing
+// every pixel.
+static inline void apply_circle_alpha_mask_rows(uint8_t* px, int radius, int stride, int y0, int y1) {
+    int diameter = radius * 2;
+    int r2 = radius * radius;
+    if (y0 < 0) y0 = 0;
+    if (y1 > diameter) y1 = diameter;
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t* row = pixel_row(px, stride, y);
+        int dy = y - radius;
+        int w = isqrt_floor(r2 - dy * dy);
+        int x0 = radius - w;
+        int x1 = radius + w;  // inclusive
+        if (x0 < 0) x0 = 0;
+        if (x1 > diameter - 1) x1 = diameter - 1;
+
+        memset(row, 0, (size_t)x0 * 4);
+        for (int x = x0; x <= x1; x++) row[x] |= 0xFF000000u;
+        if (x1 + 1 < diameter) memset(row + x1 + 1, 0, (size_t)(diameter - x1 - 1) * 4);
+    }
+}
+
+static inline void apply_circle_alpha_mask(uint8_t* px, int radius, int stride) {
+    apply_circle_alpha_mask_rows(px, radius, stride, 0, radius * 2);
+}
+
+// The mask for [x0, x1) x [y0, y1) only.
+static inline void apply_circle_alpha_mask_rect(uint8_t* px, int radius, int stride, int x0, int y0, int x1, int y1) {
+    int diameter = radius * 2;
+    int r2 = radius * radius;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > diameter) x1 = diameter;
+    if (y1 > diameter) y1 = diameter;
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t* row = pixel_row(px, stride, y);
+        int dy = y - radius;
+        int w = isqrt_floor(r2 - dy * dy);
+        int in0 = radius - w, in1 = radius + w;  // inclusive, as in the _rows version
+        for (int x = x0; x < x1; x++) {
+            if (x >= in0 && x <= in1) row[x] |= 0xFF000000u;
+            else row[x] = 0;
+        }
+    }
+}
+
+// ----------------------
+// Blend
+// ----------------------
+
+// Premultiplied source-over of white with coverage `a` (0..256).
+static inline uint32_t blend_white_over(uint32_t dst, int a) {
+    uint32_t inv = (uint32_t)(256 - a);
+    uint32_t add = (uint32_t)((255 * a) >> 8);
+    uint32_t rb = ((dst & 0x00FF00FFu) * inv >> 8) & 0x00FF00FFu;
+    uint32_t ag = ((dst >> 8) & 0x00FF00FFu) * inv & 0xFF00FF00u;
+    return (rb | ag) + (add * 0x01010101u);
+}
+
+// Draws the white circle outline of the loupe: distance from the centre in
+// [radius - width, radius]. With `antialias` the edges get fractional coverage,
+// including the one-pixel fringe just outside the mask. The _rect variant
+// draws columns [x0, x1) of rows [y0, y1) only.
+static inline void blend_circle_border_rect(uint8_t* px, int radius, int stride, int width, int antialias,
+                                            int x0, int y0, int x1, int y1) {
+    int diameter = radius * 2;
+    float outer = (float)radius;
+    float inner = (float)(radius - width);
+    int reachOut = radius + 1;
+    int reachIn = radius - width - 1;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > diameter) x1 = diameter;
+    if (y1 > diameter) y1 = diameter;
+
+    for (int y = y0; y < y1; y++) {
+        uint32_t* row = pixel_row(px, stride, y);
+        int dy = y - radius;
+        int wo = isqrt_floor(reachOut * reachOut - dy * dy) + 1;
+        int wi = (reachIn > 0 && dy * dy < reachIn * reachIn) ? isqrt_floor(reachIn * reachIn - dy * dy) : -1;
+
+        // Pixels within wi of the centre column are well inside the ring's
+        // inner edge; the row is then split into a left and a right arc.
+        int spans[2][2] = { { radius - wo, radius - wi - 1 }, { radius + wi + 1, radius + wo } };
+        int spanCount = 2;
+        if (wi < 0) {
+            spans[0][1] = radius + wo;
+            spanCount = 1;
+        }
+
+        for (int s = 0; s < spanCount; s++) {
+            int xa = spans[s][0] < x0 ? x0 : spans[s][0];
+            int xb = spans[s][1] > x1 - 1 ? x1 - 1 : spans[s][1];
+
+            for (int x = xa; x <= xb; x++) {
+                int dx = x - radius;
+                float d = sqrtf((float)(dx * dx + dy * dy));
+                int a;
+                if (antialias) {
+                    float c = fminf(d - inner, outer - d) + 0.5f;
+                    if (c <= 0.0f) continue;
+                    a = c >= 1.0f ? 256 : (int)(c * 256.0f);
+                } else {
+                    if (d < inner || d > outer) continue;
+                    a = 256;
+                }
+                row[x] = blend_white_over(row[x], a);
+            }
+        }
+    }
+}
+
+static inline void blend_circle_border_rows(uint8_t* px, int radius, int stride, int width, int antialias,
+                                            int y0, int y1) {
+    blend_circle_border_rect(px, radius, stride, width, antialias, 0, y0, radius * 2, y1);
+}
+
+static inline void blend_circle_border(uint8_t* px, int radius, int stride, int width, int antialias) {
+    blend_circle_border_rows(px, radius, stride, width, antialias, 0, radius * 2);
+}
+
+// Draws the square outline marking the picked pixel, centred on (radius, radius),
+// clipped to rows [rowBegin, rowEnd).
+static inline void draw_center_marker_rows(uint8_t* px, int radius, int stride, int size,
+                                           int rowBegin, int rowEnd) {
+    int x0 = radius - size / 2;
+    int y0 = radius - size / 2;
+    int x1 = x0 + size - 1;
+    int y1 = y0 + size - 1;
+    const uint32_t white = 0xFFFFFFFFu;
+
+    for (int y = y0 < rowBegin ? rowBegin : y0; y <= y1 && y < rowEnd; y++) {
+        uint32_t* row = pixel_row(px, stride, y);
+        if (y == y0 || y == y1) {
+            for (int x = x0; x <= x1; x++) row[x] = white;
+        } else {
+            row[x0] = white;
+            row[x1] = white;
+        }
+    }
+}
+
+// The marker clipped to [colBegin, colEnd) x [rowBegin, rowEnd).
+static inline void draw_center_marker_rect(uint8_t* px, int radius, int stride, int size,
+                                           int colBegin, int rowBegin, int colEnd, int rowEnd) {
+    int x0 = radius - size / 2;
+    int y0 = radius - size / 2;
+    int x1 = x0 + size - 1;
+    int y1 = y0 + size - 1;
+    const uint32_t white = 0xFFFFFFFFu;
+
+    for (int y = y0 < rowBegin ? rowBegin : y0; y <= y1 && y < rowEnd; y++) {
+        uint32_t* row = pixel_row(px, stride, y);
+        int edge = y == y0 || y == y1;
+        for (int x = x0 < colBegin ? colBegin : x0; x <= x1 && x < colEnd; x++) {
+            if (edge || x == x0 || x == x1) row[x] = white;
+        }
+    }
+}
+
+static inline void draw_center_marker(uint8_t* px, int radius, int stride, int size) {
+    draw_center_marker_rows(px, radius, stride, size, 0, radius * 2);
+}
+
+// Loupe compose for output rows [y0, y1): magnified capture, circular mask,
+// border and marker. Bands are independent, so a frame can be split across
+// threads; each band stays in cache through all four passes.
+static inline void compose_loupe_rows(const uint8_t* cap, int capSize, int capStride,
+                                      uint8_t* dst, int radius, int dstStride,
+                                      int borderWidth, int antialias, int markerSize,
+                                      int y0, int y1) {
+    int diameter = radius * 2;
+    scale_nearest_bgra_rows(cap, capSize, capSize, capStride, dst, diameter, diameter, dstStride, y0, y1);
+    apply_circle_alpha_mask_rows(dst, radius, dstStride, y0, y1);
+    blend_circle_border_rows(dst, radius, dstStride, borderWidth, antialias, y0, y1);
+    draw_center_marker_rows(dst, radius, dstStride, markerSize, y0, y1);
+}
+
+// Loupe compose for the rectangle [x0, x1) x [y0, y1) only; the rest of
+// `dst` is left as it is. The pixels come out as the full compose draws them,
+// so a frame can be patched where its source changed.
+static inline void compose_loupe_rect(const uint8_t* cap, int capSize, int capStride,
+                                      uint8_t* dst, int radius, int dstStride,
+                                      int borderWidth, int antialias, int markerSize,
+                                      int x0, int y0, int x1, int y1) {
+    int diameter = radius * 2;
+    scale_nearest_bgra_rect(cap, capSize, capSize, capStride, dst, diameter, diameter, dstStride, x0, y0, x1, y1);
+    apply_circle_alpha_mask_rect(dst, radius, dstStride, x0, y0, x1, y1);
+    blend_circle_border_rect(dst, radius, dstStride, borderWidth, antialias, x0, y0, x1, y1);
+    draw_center_marker_rect(dst, radius, dstStride, markerSize, x0, y0, x1, y1);
+}
+
+// Full loupe compose: magnified capture, circular mask, border and marker.
+static inline void compose_loupe(const uint8_t* cap, int capSize, int capStride,
+                                 uint8_t* dst, int radius, int dstStride,
+                                 int borderWidth, int antialias, int markerSize) {
+    compose_loupe_rows(cap, capSize, capStride, dst, radius, dstStride, borderWidth, antialias, markerSize,
+                       0, radius * 2);
+}
+
+// ----------------------
+// Hash
+// ----------------------
+
+// 64-bit content hash of a BGRA region (not cryptographic). Four independent
+// lanes per row keep the multiply chains short.
+static inline uint64_t hash_bgra(const uint8_t* px, int w, int h, int stride) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h0 = 0x243F6A8885A308D3ull, h1 = 0x13198A2E03707344ull;
+    uint64_t h2 = 0xA4093822299F31D0ull, h3 = 0x082EFA98EC4E6C89ull;
+    size_t rowBytes = (size_t)w * 4;
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = px + (size_t)y * (size_t)stride;
+        size_t i = 0;
+        for (; i + 32 <= rowBytes; i += 32) {
+            uint64_t a, b, c, d;
+            memcpy(&a, row + i, 8);
+            memcpy(&b, row + i + 8, 8);
+            memcpy(&c, row + i + 16, 8);
+            memcpy(&d, row + i + 24, 8);
+            h0 = (h0 ^ a) * k;
+            h1 = (h1 ^ b) * k;
+            h2 = (h2 ^ c) * k;
+            h3 = (h3 ^ d) * k;
+        }
+        for (; i + 8 <= rowBytes; i += 8) {
+            uint64_t a;
+            memcpy(&a, row + i, 8);
+            h0 = (h0 ^ a) * k;
+        }
+        for (; i < rowBytes; i++) h1 = (h1 ^ row[i]) * k;
+        h2 ^= (uint64_t)y;
+    }
+
+    uint64_t r = h0 ^ (h1 >> 17 | h1 << 47) ^ (h2 >> 31 | h2 << 33) ^ (h3 >> 43 | h3 << 21);
+    r ^= r >> 29;
+    r *= 0xBF58476D1CE4E5B9ull;
+    r ^= r >> 32;
+    return r;
+}
+
+// ----------------------
+// Colour conversion and picking
+// ----------------------
+
+// Formats a BGRA pixel as "#RRGGBB" (8 bytes including the terminator).
+static inline void format_hex_color(uint32_t bgra, char out[8]) {
+    static const char digits[] = "0123456789ABCDEF";
+    unsigned r = (bgra >> 16) & 0xFF;
+    unsigned g = (bgra >> 8) & 0xFF;
+    unsigned b = bgra & 0xFF;
+    out[0] = '#';
+    out[1] = digits[r >> 4]; out[2] = digits[r & 15];
+    out[3] = digits[g >> 4]; out[4] = digits[g & 15];
+    out[5] = digits[b >> 4]; out[6] = digits[b & 15];
+    out[7] = 0;
+}
+
+// Average colour of the (2*sampleRadius+1)^2 window around (cx, cy), clipped
+// to the image. sampleRadius 0 reads a single pixel. Returns opaque BGRA.
+static inline uint32_t sample_average_bgra(const uint8_t* px, int w, int h, int stride,
+                                           int cx, int cy, int sampleRadius) {
+    int x0 = cx - sampleRadius, x1 = cx + sampleRadius;
+    int y0 = cy - sampleRadius, y1 = cy + sampleRadius;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > w - 1) x1 = w - 1;
+    if (y1 > h - 1) y1 = h - 1;
+    if (x0 > x1 || y0 > y1) return 0xFF000000u;
+
+    uint32_t sb = 0, sg = 0, sr = 0, n = 0;
+    for (int y = y0; y <= y1; y++) {
+        const uint32_t* row = pixel_row_const(px, stride, y);
+        for (int x = x0; x <= x1; x++) {
+            uint32_t v = row[x];
+            sb += v & 0xFF;
+            sg += (v >> 8) & 0xFF;
+            sr += (v >> 16) & 0xFF;
+            n++;
+        }
+    }
+    uint32_t half = n / 2;
+    return 0xFF000000u | (((sr + half) / n) << 16) | (((sg + half) / n) << 8) | ((sb + half) / n);
+}
+
+#endif // PICKER_KERNELS_H
@@ -0,0 +1,145 @@
+// Minimal Color Picker - memory accounting and cap (header-only, C99).
+//
+// Every buffer the picker owns is reported under a short name with
+// mem_set("capture", bytes) whenever it is (re)allocated or freed; the
+// accounting keeps current and peak bytes per buffer and in total. Reporting
+// only happens on allocation, so frames pay nothing.
+//
+// With a cap (--mem-cap MB), buffers whose size is a matter of policy rather
+// than correctness (trace history, caches) ask mem_history_budget() how much
+// they may use: whatever is left of the cap after the process's current
+// resident set and the buffers reported here, less a safety margin, so
+// resident memory stays under the cap. A cache that gets less than it asked
+// for is left out or made smaller, and its feature runs slower without it.
+
+#ifndef PICKER_MEM_H
+#define PICKER_MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#define MEM_MAX_ACCOUNTS 24
+
+typedef struct MemAccount {
+    const char* name;   // must point to a string literal (not copied)
+    size_t current;
+    size_t peak;
+} MemAccount;
+
+static MemAccount g_mem_accounts[MEM_MAX_ACCOUNTS];
+static int g_mem_account_count;
+static size_t g_mem_total;
+static size_t g_mem_total_peak;
+static size_t g_mem_cap;  // bytes, 0 = no cap
+
+static inline MemAccount* mem_find(const char* name) {
+    for (int i = 0; i < g_mem_account_count; i++) {
+        if (strcmp(g_mem_accounts[i].name, name) == 0) return &g_mem_accounts[i];
+    }
+    if (g_mem_account_count == MEM_MAX_ACCOUNTS) return NULL;
+    MemAccount* a = &g_mem_accounts[g_mem_account_count++];
+    a->name = name;
+    a->current = 0;
+    a->peak = 0;
+    return a;
+}
+
+// Records that buffer `name` now holds `bytes` (0 after freeing it).
+static inline void mem_set(const char* name, size_t bytes) {
+    MemAccount* a = mem_find(name);
+    if (!a) return;
+    g_mem_total = g_mem_total - a->current + bytes;
+    a->current = bytes;
+    if (bytes > a->peak) a->peak = bytes;
+    if (g_mem_total > g_mem_total_peak) g_mem_total_peak = g_mem_total;
+}
+
+static inline size_t mem_get(const char* name) {
+    for (int i = 0; i < g_mem_account_count; i++) {
+        if (strcmp(g_mem_accounts[i].name, name) == 0) return g_mem_accounts[i].current;
+    }
+    return 0;
+}
+
+static inline void mem_set_cap(size_t bytes) { g_mem_cap = bytes; }
+
+// Resident set size of the whole process (current and peak), 0 if unknown.
+static inline void mem_process_rss(size_t* current, size_t* peak) {
+    *current = 0;
+    *peak = 0;
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        *current = pmc.WorkingSetSize;
+        *peak = pmc.PeakWorkingSetSize;
+    }
+#else
+    // open/read rather than stdio so this can run inside an audited frame.
+    char buf[128];
+    int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd >= 0) {
+        ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        if (n > 0) {
+            buf[n] = 0;
+            const char* s = buf;
+            while (*s && *s != ' ') s++;  // skip total size
+            size_t pages = 0;
+            while (*s == ' ') s++;
+            while (*s >= '0' && *s <= '9') pages = pages * 10 + (size_t)(*s++ - '0');
+            *current = pages * (size_t)sysconf(_SC_PAGESIZE);
+        }
+    }
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) *peak = (size_t)ru.ru_maxrss * 1024;  // KiB on Linux
+#endif
+}
+
+// How many of `wanted` bytes an optional buffer may take. Without a cap that
+// is all of them; with one it is the headroom left under the cap, keeping an
+// eighth of the cap in reserve for the allocator, libraries and the stack.
+// Reported buffers count in full on top of the resident set: one allocated a
+// moment ago has no resident pages yet, but will once frames touch it.
+static inline size_t mem_history_budget(size_t wanted) {
+    if (!g_mem_cap) return wanted;
+    size_t rss, peak;
+    mem_process_rss(&rss, &peak);
+    size_t used = rss + g_mem_total + g_mem_cap / 8;
+    if (used >= g_mem_cap) return 0;
+    size_t room = g_mem_cap - used;
+    return room < wanted ? room : wanted;
+}
+
+// For caches that are all or nothing: 1 when all `bytes` fit the budget.
+static inline int mem_allows(size_t bytes) {
+    return mem_history_budget(bytes) == bytes;
+}
+
+static inline void mem_report(FILE* fp) {
+    size_t rss, peak;
+    mem_process_rss(&rss, &peak);
+    fprintf(fp, "memory: owned %.1f KiB (peak %.1f KiB), process RSS %.1f MiB (peak %.1f MiB)",
+            g_mem_total / 1024.0, g_mem_total_peak / 1024.0, rss / 1048576.0, peak / 1048576.0);
+    if (g_mem_cap) fprintf(fp, ", cap %.1f MiB", g_mem_cap / 1048576.0);
+    fprintf(fp, "\n");
+    for (int i = 0; i < g_mem_account_count; i++) {
+        const MemAccount* a = &g_mem_accounts[i];
+        fprintf(fp, "  %-12s %10.1f KiB (peak %.1f KiB)\n", a->name, a->current / 1024.0, a->peak / 1024.0);
+    }
+}
+
+#endif // PICKER_MEM_H
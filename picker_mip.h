@@ -0,0 +1,223 @@
+// Minimal Color Picker - mip pyramid for continuous zoom-out (header-only, C99).
+//
+// Wheel zoom lands on any scale, not only 1/2, 1/4 and 1/8, and box-filtering
+// the full-resolution capture again on every wheel tick would cost a full
+// pass per tick. Instead each loupe keeps a pyramid of its capture: level 0
+// is the capture itself and level k is level k-1 reduced 2x2 in linear light
+// (downsample_box_bgra() with k = 2, SSE2 where available). A loupe showing
+// `scale` screen pixels per source pixel samples the two levels around
+// log2(scale) and blends them in linear light, like trilinear filtering; at
+// an exact power of two it copies one level unchanged.
+//
+// The pyramid is kept up to date incrementally. Level 0 is split into
+// MIP_TILE x MIP_TILE tiles with a hash each, and only tiles whose pixels
+// changed are reduced again, through every level. A wheel tick over still
+// content costs the hashes and one resample, not a rebuild.
+//
+//   levels = mip_levels_for_scale(scale);   // capture is srcSize << (levels - 1)
+//   mip_reserve(&mip, srcSize, levels);      // grows buffers; 0 on failure
+//   (mip_bytes_for(srcSize, levels) is what that holds, for a memory budget)
+//   mip_update(&mip, cap, capStride, srcSize, levels);
+//   src = mip_sample(&mip, scale, srcSize);  // srcSize x srcSize, stride srcSize * 4
+
+#ifndef PICKER_MIP_H
+#define PICKER_MIP_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picker_downsample.h"
+#include "picker_kernels.h"
+
+#define MIP_MAX_LEVELS 4   // the capture plus 2x, 4x and 8x reductions (zoom 1/8)
+#define MIP_TILE 64        // level-0 tile side, a multiple of 1 << (MIP_MAX_LEVELS - 1)
+#define MIP_WHEEL_STEPS 4  // wheel notches per doubling of the zoom
+
+typedef struct MipPyramid {
+    int levels;                            // in use, level 0 included
+    int size[MIP_MAX_LEVELS];              // side of each level in pixels
+    const uint8_t* level[MIP_MAX_LEVELS];  // level 0 is the caller's capture
+    int stride[MIP_MAX_LEVELS];
+    uint8_t* buf[MIP_MAX_LEVELS];          // storage for levels 1..
+    uint64_t* tileHash;                    // one per level-0 tile
+    int tilesValid;                        // 0 after a resize: every tile is dirty
+    uint32_t acc[MIP_TILE / 2 * 4];        // downsample_box_bgra() scratch, one tile row
+    int* index;                            // mip_sample() lookups, two levels
+    uint8_t* view;                         // mip_sample() output
+    // Allocated elements of each buffer above.
+    size_t bufCap[MIP_MAX_LEVELS], tileCap, indexCap, viewCap;
+    size_t bytes;                          // heap held, for the memory report
+
+    // Counters (for --stats).
+    uint64_t updates;
+    uint64_t tilesReduced;
+    uint64_t tilesClean;
+} MipPyramid;
+
+// Levels needed to show `scale` screen pixels per source pixel: the coarsest
+// one is at least as coarse as the scale, so blending never extrapolates.
+static inline int mip_levels_for_scale(double scale) {
+    int levels = 1;
+    while (levels < MIP_MAX_LEVELS && (double)(1 << (levels - 1)) < scale - 1e-9) levels++;
+    return levels;
+}
+
+// Zoom after `notches` wheel notches (positive zooms in): zooms land on
+// quarter octaves, so four notches always return to the same power of two.
+static inline double zoom_wheel_step(double zoom, int notches, double minZoom, double maxZoom) {
+    double step = floor(log2(zoom) * MIP_WHEEL_STEPS + 0.5) + notches;
+    double z = exp2(step / MIP_WHEEL_STEPS);
+    return z < minZoom ? minZoom : (z > maxZoom ? maxZoom : z);
+}
+
+static inline int mip_grow(void** p, size_t* have, size_t want, size_t elem) {
+    if (want <= *have) return 1;
+    void* q = realloc(*p, want * elem);
+    if (!q) return 0;
+    *p = q;
+    *have = want;
+    return 1;
+}
+
+// Bytes mip_reserve() needs for these sizes, as m->bytes will count them.
+static inline size_t mip_bytes_for(int srcSize, int levels) {
+    size_t size0 = (size_t)srcSize << (levels - 1);
+    size_t tiles = (size0 + MIP_TILE - 1) / MIP_TILE;
+    size_t bytes = tiles * tiles * sizeof(uint64_t) + (size_t)srcSize * 2 * sizeof(int) + (size_t)srcSize * srcSize * 4;
+    for (int k = 1; k < levels; k++) bytes += (size0 >> k) * (size0 >> k) * 4;
+    return bytes;
+}
+
+// Makes room for a pyramid over a (srcSize << (levels - 1)) capture. Buffers
+// only grow, so zooming back and forth allocates once per new extent.
+// Returns 0 when out of memory.
+static inline int mip_reserve(MipPyramid* m, int srcSize, int levels) {
+    size_t size0 = (size_t)srcSize << (levels - 1);
+    size_t tiles = (size0 + MIP_TILE - 1) / MIP_TILE;
+    for (int k = 1; k < levels; k++) {
+        if (!mip_grow((void**)&m->buf[k], &m->bufCap[k], (size0 >> k) * (size0 >> k), 4)) return 0;
+    }
+    if (!mip_grow((void**)&m->tileHash, &m->tileCap, tiles * tiles, sizeof(uint64_t)) ||
+        !mip_grow((void**)&m->index, &m->indexCap, (size_t)srcSize * 2, sizeof(int)) ||
+        !mip_grow((void**)&m->view, &m->viewCap, (size_t)srcSize * srcSize, 4)) {
+        return 0;
+    }
+    m->bytes = m->tileCap * sizeof(uint64_t) + m->indexCap * sizeof(int) + m->viewCap * 4;
+    for (int k = 1; k < MIP_MAX_LEVELS; k++) m->bytes += m->bufCap[k] * 4;
+    return 1;
+}
+
+static inline void mip_free(MipPyramid* m) {
+    for (int k = 0; k < MIP_MAX_LEVELS; k++) free(m->buf[k]);
+    free(m->tileHash);
+    free(m->index);
+    free(m->view);
+    memset(m, 0, sizeof(*m));
+}
+
+// Brings the pyramid up to date with this frame's capture, a
+// (srcSize << (levels - 1)) square at `cap`. Tiles whose hash matches the
+// last update keep their reduced pixels; the rest are reduced again level by
+// level. mip_reserve() must have been called for these sizes.
+static inline void mip_update(MipPyramid* m, const uint8_t* cap, int capStride, int srcSize, int levels) {
+    int size0 = srcSize << (levels - 1);
+    if (levels != m->levels || size0 != m->size[0]) {
+        m->levels = levels;
+        for (int k = 0; k < levels; k++) {
+            m->size[k] = size0 >> k;
+            m->stride[k] = m->size[k] * 4;
+        }
+        m->tilesValid = 0;
+    }
+    for (int k = 1; k < levels; k++) m->level[k] = m->buf[k];
+    m->level[0] = cap;
+    m->stride[0] = capStride;
+    m->updates++;
+
+    int tiles = (size0 + MIP_TILE - 1) / MIP_TILE;
+    for (int ty = 0; ty < tiles; ty++) {
+        for (int tx = 0; tx < tiles; tx++) {
+            int x0 = tx * MIP_TILE, y0 = ty * MIP_TILE;
+            int x1 = x0 + MIP_TILE < size0 ? x0 + MIP_TILE : size0;
+            int y1 = y0 + MIP_TILE < size0 ? y0 + MIP_TILE : size0;
+            uint64_t h = hash_bgra(cap + (size_t)y0 * capStride + (size_t)x0 * 4, x1 - x0, y1 - y0, capStride);
+            uint64_t* slot = &m->tileHash[ty * tiles + tx];
+            if (m->tilesValid && *slot == h) {
+                m->tilesClean++;
+                continue;
+            }
+            *slot = h;
+            m->tilesReduced++;
+            // Tile edges are multiples of 1 << (levels - 1), so each level's
+            // part of the tile is whole 2x2 blocks of the level above.
+            for (int k = 1; k < levels; k++) {
+                int xs = x0 >> k, ys = y0 >> k;
+                const uint8_t* src = m->level[k - 1] + (size_t)(ys * 2) * m->stride[k - 1] + (size_t)xs * 8;
+                uint8_t* dst = m->buf[k] + (size_t)ys * m->stride[k] + (size_t)xs * 4;
+                downsample_box_bgra(src, m->stride[k - 1], dst, (x1 >> k) - xs, (y1 >> k) - ys, m->stride[k], 2,
+                                    m->acc);
+            }
+        }
+    }
+    m->tilesValid = 1;
+}
+
+// Source pixel of level `k` under each of `n` loupe source pixels, centred on
+// the capture's centre pixel (the cursor) and `scale` screen pixels apart.
+// Rows and columns use the same lookup: the view is square and centred.
+static inline void mip_index(const MipPyramid* m, int k, double scale, int n, int* out) {
+    double centre = (double)(m->size[0] / 2) + 0.5;
+    double inv = 1.0 / (double)(1 << k);
+    int last = m->size[k] - 1;
+    for (int u = 0; u < n; u++) {
+        int i = (int)floor((centre + (double)(u - n / 2) * scale) * inv);
+        out[u] = i < 0 ? 0 : (i > last ? last : i);
+    }
+}
+
+// Resamples the pyramid into an n x n loupe source at `scale` (1 up to
+// 1 << (levels - 1)) and returns it; its stride is n * 4. Between two levels
+// the nearest pixel of each is blended in linear light by where log2(scale)
+// falls between them.
+static inline const uint8_t* mip_sample(MipPyramid* m, double scale, int n) {
+    double f = log2(scale);
+    if (f < 0.0) f = 0.0;
+    if (f > (double)(m->levels - 1)) f = (double)(m->levels - 1);
+    int l0 = (int)f;
+    int w = (int)((f - l0) * 256.0 + 0.5);
+    if (w == 256) {
+        l0++;
+        w = 0;
+    }
+    int l1 = w ? l0 + 1 : l0;
+    int* i0 = m->index;
+    int* i1 = m->index + n;
+    mip_index(m, l0, scale, n, i0);
+    mip_index(m, l1, scale, n, i1);
+
+    const SrgbTables* t = srgb_tables();
+    const uint16_t* lin = t->toLinear;
+    uint32_t wa = (uint32_t)(256 - w), wb = (uint32_t)w;
+    for (int v = 0; v < n; v++) {
+        const uint32_t* r0 = (const uint32_t*)(m->level[l0] + (size_t)i0[v] * m->stride[l0]);
+        const uint32_t* r1 = (const uint32_t*)(m->level[l1] + (size_t)i1[v] * m->stride[l1]);
+        uint32_t* d = (uint32_t*)(m->view + (size_t)v * n * 4);
+        if (!w) {
+            for (int u = 0; u < n; u++) d[u] = r0[i0[u]] | 0xFF000000u;
+            continue;
+        }
+        for (int u = 0; u < n; u++) {
+            const uint8_t* a = (const uint8_t*)&r0[i0[u]];
+            const uint8_t* b = (const uint8_t*)&r1[i1[u]];
+            uint32_t cb = t->toSrgb[(lin[a[0]] * wa + lin[b[0]] * wb) >> 12];
+            uint32_t cg = t->toSrgb[(lin[a[1]] * wa + lin[b[1]] * wb) >> 12];
+            uint32_t cr = t->toSrgb[(lin[a[2]] * wa + lin[b[2]] * wb) >> 12];
+            d[u] = 0xFF000000u | (cr << 16) | (cg << 8) | cb;
+        }
+    }
+    return m->view;
+}
+
+#endif // PICKER_MIP_H
@@ -0,0 +1,239 @@
+// Minimal Color Picker - onion-skin reference comparison (header-only, C99).
+//
+// A design mock (a PNG, decoded by picker_png.h) is placed on the screen at
+// a chosen origin, and the loupe shows it blended over the live pixels or as
+// their difference (picker_filter.h), with the CIEDE2000 colour difference
+// of the centre pixel drawn under the marker.
+//
+// Decoding a full-screen PNG takes far longer than a frame, so it is done
+// once and kept next to the PNG as a cache file: a 4 KB header, then the
+// image cut into ONION_TILE x ONION_TILE tiles of BGRA, each 16 KB and page
+// aligned, in row-major tile order (edge tiles padded with transparent
+// pixels). The pickers map the file read-only. A frame reads only the tiles
+// under the capture square, so only their pages are ever faulted in, and a
+// second run starts without decoding anything. The header records the PNG's
+// size and modification time; a cache that does not match them is rebuilt.
+//
+//   onion_cache_write(fp, bgra, w, h, pngSize, pngTime);        // once per PNG
+//   onion_attach(&ref, map, mapSize, pngSize, pngTime);         // 0: stale or damaged
+//   onion_fetch(&ref, x - originX, y - originY, n, square, n * 4);  // per frame
+//   double de = onion_delta_e(live, reference);
+
+#ifndef PICKER_ONION_H
+#define PICKER_ONION_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "picker_downsample.h"
+#include "picker_kernels.h"
+#include "picker_ruler.h"
+
+#define ONION_TILE 64
+#define ONION_HEADER 4096  // tiles start on a page boundary
+#define ONION_TILE_BYTES ((size_t)ONION_TILE * ONION_TILE * 4)
+#define ONION_OPACITY 64   // default blend weight, of 128
+
+typedef struct OnionHeader {
+    char magic[8];
+    uint32_t width, height;
+    uint32_t tile, reserved;
+    uint64_t sourceSize;  // of the PNG the tiles were decoded from
+    int64_t sourceTime;
+} OnionHeader;
+
+typedef struct OnionRef {
+    int width, height;
+    int tilesX, tilesY;
+    const uint8_t* tiles;
+} OnionRef;
+
+static const char kOnionMagic[8] = { 'P', 'K', 'O', 'N', 'I', 'O', 'N', '1' };
+
+static inline size_t onion_cache_size(int w, int h) {
+    size_t tx = (size_t)(w + ONION_TILE - 1) / ONION_TILE, ty = (size_t)(h + ONION_TILE - 1) / ONION_TILE;
+    return ONION_HEADER + tx * ty * ONION_TILE_BYTES;
+}
+
+// Writes the cache of a w x h BGRA image (rows of w * 4 bytes). Returns 0
+// on a write error.
+static inline int onion_cache_write(FILE* fp, const uint8_t* bgra, int w, int h, uint64_t sourceSize,
+                                    int64_t sourceTime) {
+    uint8_t header[ONION_HEADER];
+    OnionHeader hd;
+    memset(&hd, 0, sizeof(hd));
+    memcpy(hd.magic, kOnionMagic, sizeof(hd.magic));
+    hd.width = (uint32_t)w;
+    hd.height = (uint32_t)h;
+    hd.tile = ONION_TILE;
+    hd.sourceSize = sourceSize;
+    hd.sourceTime = sourceTime;
+    memset(header, 0, sizeof(header));
+    memcpy(header, &hd, sizeof(hd));
+    if (fwrite(header, 1, sizeof(header), fp) != sizeof(header)) return 0;
+
+    uint8_t tile[ONION_TILE_BYTES];
+    for (int ty = 0; ty < h; ty += ONION_TILE) {
+        for (int tx = 0; tx < w; tx += ONION_TILE) {
+            int tw = w - tx < ONION_TILE ? w - tx : ONION_TILE;
+            memset(tile, 0, sizeof(tile));
+            for (int y = 0; y < ONION_TILE && ty + y < h; y++) {
+                memcpy(tile + (size_t)y * ONION_TILE * 4, bgra + ((size_t)(ty + y) * w + tx) * 4, (size_t)tw * 4);
+            }
+            if (fwrite(tile, 1, sizeof(tile), fp) != sizeof(tile)) return 0;
+        }
+    }
+    return fflush(fp) == 0;
+}
+
+// Points `r` at the tiles of a mapped cache file, if it is whole and was
+// made from the PNG of this size and modification time.
+static inline int onion_attach(OnionRef* r, const uint8_t* map, size_t size, uint64_t sourceSize,
+                               int64_t sourceTime) {
+    OnionHeader hd;
+    if (size < ONION_HEADER) return 0;
+    memcpy(&hd, map, sizeof(hd));
+    if (memcmp(hd.magic, kOnionMagic, sizeof(hd.magic)) || hd.tile != ONION_TILE || !hd.width || !hd.height ||
+        hd.width > 32768 || hd.height > 32768 || hd.sourceSize != sourceSize || hd.sourceTime != sourceTime) {
+        return 0;
+    }
+    if (size != onion_cache_size((int)hd.width, (int)hd.height)) return 0;
+    r->width = (int)hd.width;
+    r->height = (int)hd.height;
+    r->tilesX = (r->width + ONION_TILE - 1) / ONION_TILE;
+    r->tilesY = (r->height + ONION_TILE - 1) / ONION_TILE;
+    r->tiles = map + ONION_HEADER;
+    return 1;
+}
+
+// Copies the n x n square of the reference at (x0, y0), in image
+// coordinates, to dst; pixels off the image are transparent. Each row is a
+// copy per tile it crosses.
+static inline void onion_fetch(const OnionRef* r, int x0, int y0, int n, uint8_t* dst, int dstStride) {
+    int xa = x0 < 0 ? 0 : x0, xb = x0 + n > r->width ? r->width : x0 + n;
+    for (int y = 0; y < n; y++) {
+        uint8_t* d = dst + (size_t)y * (size_t)dstStride;
+        int iy = y0 + y;
+        if (iy < 0 || iy >= r->height || xa >= xb) {
+            memset(d, 0, (size_t)n * 4);
+            continue;
+        }
+        if (xa > x0) memset(d, 0, (size_t)(xa - x0) * 4);
+        const uint8_t* tileRow = r->tiles + (size_t)(iy / ONION_TILE) * r->tilesX * ONION_TILE_BYTES +
+                                 (size_t)(iy % ONION_TILE) * ONION_TILE * 4;
+        for (int x = xa; x < xb;) {
+            int end = (x / ONION_TILE + 1) * ONION_TILE;
+            if (end > xb) end = xb;
+            memcpy(d + (size_t)(x - x0) * 4,
+                   tileRow + (size_t)(x / ONION_TILE) * ONION_TILE_BYTES + (size_t)(x % ONION_TILE) * 4,
+                   (size_t)(end - x) * 4);
+            x = end;
+        }
+        if (xb < x0 + n) memset(d + (size_t)(xb - x0) * 4, 0, (size_t)(x0 + n - xb) * 4);
+    }
+}
+
+// ----------------------
+// Colour difference
+// ----------------------
+
+// CIELAB (D65) of an sRGB pixel.
+static inline void onion_lab(uint32_t bgra, double lab[3]) {
+    double r = srgb_decode(((bgra >> 16) & 0xFF) / 255.0);
+    double g = srgb_decode(((bgra >> 8) & 0xFF) / 255.0);
+    double b = srgb_decode((bgra & 0xFF) / 255.0);
+    double xyz[3] = {
+        (0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / 0.95047,
+        0.2126729 * r + 0.7151522 * g + 0.0721750 * b,
+        (0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / 1.08883,
+    };
+    double f[3];
+    for (int i = 0; i < 3; i++) {
+        f[i] = xyz[i] > 216.0 / 24389.0 ? cbrt(xyz[i]) : (24389.0 / 27.0 * xyz[i] + 16.0) / 116.0;
+    }
+    lab[0] = 116.0 * f[1] - 16.0;
+    lab[1] = 500.0 * (f[0] - f[1]);
+    lab[2] = 200.0 * (f[1] - f[2]);
+}
+
+// CIEDE2000 difference of two CIELAB colours (kL = kC = kH = 1).
+static inline double onion_delta_e2000(const double* lab1, const double* lab2) {
+    const double deg = 3.14159265358979323846 / 180.0, pow25 = 6103515625.0;  // 25^7
+    double c1 = hypot(lab1[1], lab1[2]), c2 = hypot(lab2[1], lab2[2]);
+    double cb7 = pow((c1 + c2) / 2.0, 7.0);
+    double g = 0.5 * (1.0 - sqrt(cb7 / (cb7 + pow25)));
+    double a1 = (1.0 + g) * lab1[1], a2 = (1.0 + g) * lab2[1];
+    double cp1 = hypot(a1, lab1[2]), cp2 = hypot(a2, lab2[2]);
+    double h1 = (a1 == 0.0 && lab1[2] == 0.0) ? 0.0 : atan2(lab1[2], a1) / deg;
+    double h2 = (a2 == 0.0 && lab2[2] == 0.0) ? 0.0 : atan2(lab2[2], a2) / deg;
+    if (h1 < 0.0) h1 += 360.0;
+    if (h2 < 0.0) h2 += 360.0;
+
+    double dl = lab2[0] - lab1[0], dc = cp2 - cp1, dh = 0.0;
+    if (cp1 * cp2 != 0.0) {
+        dh = h2 - h1;
+        if (dh > 180.0) dh -= 360.0;
+        else if (dh < -180.0) dh += 360.0;
+    }
+    double dH = 2.0 * sqrt(cp1 * cp2) * sin(dh / 2.0 * deg);
+
+    double lb = (lab1[0] + lab2[0]) / 2.0, cpb = (cp1 + cp2) / 2.0, hb = h1 + h2;
+    if (cp1 * cp2 != 0.0) {
+        if (fabs(h1 - h2) <= 180.0) hb /= 2.0;
+        else hb = hb < 360.0 ? (hb + 360.0) / 2.0 : (hb - 360.0) / 2.0;
+    }
+    double t = 1.0 - 0.17 * cos((hb - 30.0) * deg) + 0.24 * cos(2.0 * hb * deg) + 0.32 * cos((3.0 * hb + 6.0) * deg) -
+               0.20 * cos((4.0 * hb - 63.0) * deg);
+    double theta = 30.0 * exp(-((hb - 275.0) / 25.0) * ((hb - 275.0) / 25.0));
+    double cpb7 = pow(cpb, 7.0);
+    double rc = 2.0 * sqrt(cpb7 / (cpb7 + pow25));
+    double l50 = (lb - 50.0) * (lb - 50.0);
+    double sl = 1.0 + 0.015 * l50 / sqrt(20.0 + l50), sc = 1.0 + 0.045 * cpb, sh = 1.0 + 0.015 * cpb * t;
+    double rt = -sin(2.0 * theta * deg) * rc;
+    double tl = dl / sl, tc = dc / sc, th = dH / sh;
+    return sqrt(tl * tl + tc * tc + th * th + rt * tc * th);
+}
+
+// CIEDE2000 difference of two sRGB pixels (alpha ignored).
+static inline double onion_delta_e(uint32_t a, uint32_t b) {
+    double la[3], lb[3];
+    onion_lab(a, la);
+    onion_lab(b, lb);
+    return onion_delta_e2000(la, lb);
+}
+
+// ----------------------
+// Loupe overlay
+// ----------------------
+
+// Draws `de` with one decimal ("2.4") in the ruler's digits, `glyph` loupe
+// pixels per dot, centred between the marker and the bottom of the loupe
+// inside the border of width `inset`.
+static inline void onion_draw_delta_e(uint8_t* px, int radius, int stride, double de, int inset, int glyph) {
+    int d = radius * 2, g = glyph < 1 ? 1 : glyph;
+    char s[16];
+    int n = snprintf(s, sizeof(s), "%.1f", de > 999.9 ? 999.9 : de);
+    int tw = 0;
+    for (int i = 0; i < n; i++) tw += (s[i] == '.' ? 2 : 4) * g;
+    tw -= g;
+    int th = 5 * g, x = radius - tw / 2, y0 = radius + (radius - inset) / 2 - th / 2;
+    ruler_fill(px, d, stride, x - g, y0 - g, x + tw + g, y0 + th + g, RULER_LABEL_BG);
+    for (int i = 0; i < n; i++) {
+        if (s[i] == '.') {
+            ruler_fill(px, d, stride, x, y0 + 4 * g, x + g, y0 + th, 0xFFFFFFFFu);
+            x += 2 * g;
+            continue;
+        }
+        uint16_t bits = kRulerDigits[s[i] - '0'];
+        for (int b = 0; b < 15; b++) {
+            if (!(bits & (1 << (14 - b)))) continue;
+            int gx = x + (b % 3) * g, gy = y0 + (b / 3) * g;
+            ruler_fill(px, d, stride, gx, gy, gx + g, gy + g, 0xFFFFFFFFu);
+        }
+        x += 4 * g;
+    }
+}
+
+#endif // PICKER_ONION_H
@@ -0,0 +1,174 @@
+// Minimal Color Picker - frame pacing, jank detection and adaptive quality
+// (header-only, C99).
+//
+// The platform loop reports every timer tick and brackets the frame work:
+//
+//   if (pacer_tick(&p, pacer_now_ms())) {       // 0 = skip this tick
+//       pacer_frame_begin(&p, pacer_now_ms());
+//       ... render at pacer_antialias(&p) ...
+//       pacer_frame_end(&p, pacer_now_ms());
+//   }
+//
+// Two kinds of jank are counted: a frame whose work exceeded the budget, and
+// a tick that arrived late (the timer bunched up or dropped ticks because the
+// machine was busy). Either one marks the frame as behind. After a few frames
+// behind in a row the pacer steps down one quality level; after a long run
+// with plenty of headroom it steps back up.
+//
+// Levels, cheapest last:
+//   PACER_FULL       anti-aliased border, every tick
+//   PACER_NO_AA      hard-edged border, every tick
+//   PACER_HALF_RATE  hard-edged border, every other tick
+//
+// Times are plain milliseconds so the pacer can be driven by synthetic clocks
+// in tests; pacer_now_ms() reads the same clock as picker_trace.h.
+
+#ifndef PICKER_PACER_H
+#define PICKER_PACER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "picker_trace.h"
+
+enum {
+    PACER_FULL = 0,
+    PACER_NO_AA = 1,
+    PACER_HALF_RATE = 2,
+    PACER_LEVELS = 3
+};
+
+#define PACER_BEHIND_FRAMES 3       // consecutive frames behind before stepping down
+#define PACER_HEADROOM_FRAMES 120   // consecutive relaxed frames before stepping up (~2 s)
+#define PACER_LATE_FACTOR 2.5       // tick interval > budget * this is a late tick
+                                    // (above 2 to tolerate 15.6 ms timer granularity)
+#define PACER_SLOW_FACTOR 0.75      // work > budget * this counts as behind
+#define PACER_RELAXED_FACTOR 0.40   // work < budget * this counts as headroom
+
+typedef struct FramePacer {
+    double budgetMs;
+    int level;
+    int behindStreak;
+    int relaxedStreak;
+    int tickParity;
+    int tickLate;            // the tick that started this frame was late
+    double lastTickMs;       // < 0 before the first tick
+    double frameStartMs;
+
+    // Counters (for --stats).
+    uint64_t ticks;
+    uint64_t frames;
+    uint64_t framesAtLevel[PACER_LEVELS];
+    uint64_t skippedTicks;   // ticks skipped by PACER_HALF_RATE
+    uint64_t slowFrames;     // work exceeded the budget
+    uint64_t lateTicks;      // tick interval exceeded budget * PACER_LATE_FACTOR
+    uint64_t missedTicks;    // estimated ticks lost inside late intervals
+    uint64_t stepsDown;
+    uint64_t stepsUp;
+    double worstWorkMs;
+    double worstIntervalMs;
+    double totalWorkMs;
+} FramePacer;
+
+static inline double pacer_now_ms(void) {
+    return (double)trace_now_ticks() / (trace_ticks_per_us() * 1000.0);
+}
+
+static inline void pacer_init(FramePacer* p, double budgetMs) {
+    FramePacer zero = { 0 };
+    *p = zero;
+    p->budgetMs = budgetMs;
+    p->lastTickMs = -1.0;
+}
+
+static inline int pacer_antialias(const FramePacer* p) { return p->level == PACER_FULL; }
+
+// Call on every timer tick. Returns 0 when the current level skips this tick.
+static inline int pacer_tick(FramePacer* p, double nowMs) {
+    p->ticks++;
+    p->tickLate = 0;
+    if (p->lastTickMs >= 0.0) {
+        double interval = nowMs - p->lastTickMs;
+        if (interval > p->worstIntervalMs) p->worstIntervalMs = interval;
+        if (interval > p->budgetMs * PACER_LATE_FACTOR) {
+            p->lateTicks++;
+            p->missedTicks += (uint64_t)(interval / p->budgetMs + 0.5) - 1;
+            p->tickLate = 1;
+            trace_instant("jank_late_tick");
+        }
+    }
+    p->lastTickMs = nowMs;
+
+    if (p->level == PACER_HALF_RATE) {
+        p->tickParity ^= 1;
+        if (p->tickParity && !p->tickLate) {
+            p->skippedTicks++;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Call when the loop restarts its tick after a deliberate pause (idle
+// parking), so the gap is not counted as a late tick.
+static inline void pacer_resume(FramePacer* p) {
+    p->lastTickMs = -1.0;
+    p->tickParity = 0;
+}
+
+static inline void pacer_frame_begin(FramePacer* p, double nowMs) {
+    p->frameStartMs = nowMs;
+}
+
+static inline void pacer_frame_end(FramePacer* p, double nowMs) {
+    double work = nowMs - p->frameStartMs;
+    p->frames++;
+    p->framesAtLevel[p->level]++;
+    p->totalWorkMs += work;
+    if (work > p->worstWorkMs) p->worstWorkMs = work;
+
+    int slow = work > p->budgetMs;
+    if (slow) {
+        p->slowFrames++;
+        trace_instant("jank_slow_frame");
+    }
+
+    int behind = p->tickLate || work > p->budgetMs * PACER_SLOW_FACTOR;
+    int relaxed = !p->tickLate && work < p->budgetMs * PACER_RELAXED_FACTOR;
+    p->tickLate = 0;
+
+    p->behindStreak = behind ? p->behindStreak + 1 : 0;
+    p->relaxedStreak = relaxed ? p->relaxedStreak + 1 : 0;
+
+    if (p->behindStreak >= PACER_BEHIND_FRAMES && p->level < PACER_LEVELS - 1) {
+        p->level++;
+        p->stepsDown++;
+        p->behindStreak = 0;
+        p->relaxedStreak = 0;
+        trace_instant("quality_down");
+    } else if (p->relaxedStreak >= PACER_HEADROOM_FRAMES && p->level > PACER_FULL) {
+        p->level--;
+        p->stepsUp++;
+        p->behindStreak = 0;
+        p->relaxedStreak = 0;
+        trace_instant("quality_up");
+    }
+}
+
+static inline void pacer_report(const FramePacer* p, FILE* fp) {
+    static const char* const kNames[PACER_LEVELS] = { "full", "no_aa", "half_rate" };
+    fprintf(fp, "frames %llu, ticks %llu (skipped %llu), budget %.1f ms\n",
+            (unsigned long long)p->frames, (unsigned long long)p->ticks,
+            (unsigned long long)p->skippedTicks, p->budgetMs);
+    fprintf(fp, "jank: %llu slow frames (worst %.2f ms), %llu late ticks (worst interval %.2f ms, ~%llu ticks lost)\n",
+            (unsigned long long)p->slowFrames, p->worstWorkMs, (unsigned long long)p->lateTicks,
+            p->worstIntervalMs, (unsigned long long)p->missedTicks);
+    fprintf(fp, "quality: level %s now, %llu steps down, %llu steps up; frames per level:",
+            kNames[p->level], (unsigned long long)p->stepsDown, (unsigned long long)p->stepsUp);
+    for (int i = 0; i < PACER_LEVELS; i++) {
+        fprintf(fp, " %s=%llu", kNames[i], (unsigned long long)p->framesAtLevel[i]);
+    }
+    fprintf(fp, "\nmean frame work %.3f ms\n", p->frames ? p->totalWorkMs / (double)p->frames : 0.0);
+}
+
+#endif // PICKER_PACER_H
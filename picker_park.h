@@ -0,0 +1,109 @@
+// Minimal Color Picker - idle parking (header-only, C99).
+//
+// While the cursor is still and the captured pixels do not change, rendering
+// the same loupe 60 times a second is pure waste. The frame loop reports the
+// cursor position and a hash of each capture; after PARK_STILL_FRAMES
+// identical frames the parker asks the loop to stop its fast tick. While
+// parked, the loop wakes only for input or for a slow damage poll every
+// PARK_POLL_MS that captures and hashes again (there is no portable damage
+// notification on all three platforms), and resumes on any change.
+//
+//   after each frame:   if (park_after_frame(&p, x, y, hash, now)) -> slow timer
+//   on input:           if (park_wake(&p, now))                     -> fast timer
+//   on the slow timer:  if (park_poll(&p, x, y, hash, now))         -> fast timer
+
+#ifndef PICKER_PARK_H
+#define PICKER_PARK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PARK_STILL_FRAMES 30   // ~0.5 s of identical frames before parking
+#define PARK_POLL_MS 250       // damage poll interval while parked
+
+typedef struct IdleParker {
+    int enabled;
+    int parked;
+    int stillFrames;
+    int haveLast;
+    int lastX, lastY;
+    uint64_t lastHash;
+    double parkedSinceMs;
+
+    // Counters (for --stats and idle reports).
+    uint64_t parks;
+    uint64_t inputWakes;
+    uint64_t damageWakes;
+    uint64_t polls;
+    double parkedMs;
+} IdleParker;
+
+static inline void park_init(IdleParker* p, int enabled) {
+    IdleParker zero = { 0 };
+    *p = zero;
+    p->enabled = enabled;
+}
+
+static inline int park_same(const IdleParker* p, int x, int y, uint64_t hash) {
+    return p->haveLast && x == p->lastX && y == p->lastY && hash == p->lastHash;
+}
+
+static inline void park_remember(IdleParker* p, int x, int y, uint64_t hash) {
+    p->haveLast = 1;
+    p->lastX = x;
+    p->lastY = y;
+    p->lastHash = hash;
+}
+
+static inline void park_leave(IdleParker* p, double nowMs) {
+    p->parked = 0;
+    p->stillFrames = 0;
+    p->parkedMs += nowMs - p->parkedSinceMs;
+}
+
+// Call after every rendered frame. Returns 1 when the loop should park now.
+static inline int park_after_frame(IdleParker* p, int x, int y, uint64_t hash, double nowMs) {
+    if (!p->enabled || p->parked) return 0;
+    p->stillFrames = park_same(p, x, y, hash) ? p->stillFrames + 1 : 0;
+    park_remember(p, x, y, hash);
+    if (p->stillFrames < PARK_STILL_FRAMES) return 0;
+    p->parked = 1;
+    p->parkedSinceMs = nowMs;
+    p->parks++;
+    return 1;
+}
+
+// Call on user input. Returns 1 when this woke a parked loop.
+static inline int park_wake(IdleParker* p, double nowMs) {
+    if (!p->parked) return 0;
+    p->inputWakes++;
+    park_leave(p, nowMs);
+    return 1;
+}
+
+// Call on the slow timer while parked. Returns 1 when the cursor moved or the
+// pixels under it changed and the loop should resume.
+static inline int park_poll(IdleParker* p, int x, int y, uint64_t hash, double nowMs) {
+    if (!p->parked) return 0;
+    p->polls++;
+    if (park_same(p, x, y, hash)) return 0;
+    park_remember(p, x, y, hash);
+    p->damageWakes++;
+    park_leave(p, nowMs);
+    return 1;
+}
+
+// Time spent parked so far, including the current stretch.
+static inline double park_total_ms(const IdleParker* p, double nowMs) {
+    return p->parkedMs + (p->parked ? nowMs - p->parkedSinceMs : 0.0);
+}
+
+static inline void park_report(const IdleParker* p, FILE* fp, double nowMs) {
+    fprintf(fp, "idle: %s, parked %llu times for %.1f s total; woke %llu times on input, %llu on damage (%llu polls)\n",
+            p->enabled ? (p->parked ? "parked now" : "active") : "parking off",
+            (unsigned long long)p->parks, park_total_ms(p, nowMs) / 1000.0,
+            (unsigned long long)p->inputWakes, (unsigned long long)p->damageWakes,
+            (unsigned long long)p->polls);
+}
+
+#endif // PICKER_PARK_H
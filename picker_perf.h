@@ -0,0 +1,210 @@
+// Minimal Color Picker - optional hardware performance counters (header-only).
+//
+// On Linux, perf_counters_open() opens one perf_event_open group counting
+// cycles, instructions, cache misses and branch misses for the calling thread
+// in user space (which works with the default perf_event_paranoid=2). Each
+// start/stop pair is one read() of the whole group; the deltas accumulate
+// into a PerfSample per kernel or frame stage.
+//
+// Counters are often missing: VMs without a virtual PMU, containers with
+// perf_event blocked, other OSes. Then perf_counters_open() returns 0 with a
+// reason, start/stop become no-ops and reports print "n/a", so callers never
+// need a second code path. Individual events can also be missing (e.g. no
+// cache-miss event); those report as n/a while the rest still count.
+//
+// Files that also define _POSIX_C_SOURCE must define _DEFAULT_SOURCE too, or
+// <unistd.h> does not declare syscall().
+
+#ifndef PICKER_PERF_H
+#define PICKER_PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_SUPPORTED 1
+#else
+#define PERF_SUPPORTED 0
+#endif
+
+enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS = 1,
+    PERF_CACHE_MISSES = 2,
+    PERF_BRANCH_MISSES = 3,
+    PERF_EVENT_COUNT = 4
+};
+
+typedef struct PerfCounters {
+    int available;
+    int fds[PERF_EVENT_COUNT];     // -1 when that event could not be opened
+    int slot[PERF_EVENT_COUNT];    // position in the group read, -1 if absent
+    int nr;                        // events in the group
+    uint64_t start[PERF_EVENT_COUNT];
+    const char* reason;            // why counters are unavailable
+} PerfCounters;
+
+typedef struct PerfSample {
+    const char* name;              // must point to a string literal
+    uint64_t calls;
+    double pixels;
+    double counts[PERF_EVENT_COUNT];
+    int have[PERF_EVENT_COUNT];
+} PerfSample;
+
+#if PERF_SUPPORTED
+static inline int perf_open_event(uint32_t type, uint64_t config, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd < 0;   // the leader starts the group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+// One group read: { nr, time_enabled, time_running, value[nr] }. Values are
+// scaled up when the kernel multiplexed the group off the PMU.
+static inline int perf_read_group(const PerfCounters* pc, uint64_t out[PERF_EVENT_COUNT]) {
+    uint64_t buf[3 + PERF_EVENT_COUNT];
+    ssize_t want = (ssize_t)(sizeof(uint64_t) * (size_t)(3 + pc->nr));
+    if (read(pc->fds[PERF_CYCLES], buf, (size_t)want) != want) return 0;
+    double scale = (buf[2] && buf[2] < buf[1]) ? (double)buf[1] / (double)buf[2] : 1.0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        out[e] = pc->slot[e] >= 0 ? (uint64_t)((double)buf[3 + pc->slot[e]] * scale) : 0;
+    }
+    return 1;
+}
+#endif
+
+static inline void perf_counters_init(PerfCounters* pc) {
+    memset(pc, 0, sizeof(*pc));
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        pc->fds[e] = -1;
+        pc->slot[e] = -1;
+    }
+    pc->reason = "not opened";
+}
+
+// Returns 1 when at least cycles are counted. Safe to call on any platform.
+static inline int perf_counters_open(PerfCounters* pc) {
+    perf_counters_init(pc);
+#if PERF_SUPPORTED
+    static const uint64_t kConfig[PERF_EVENT_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int leader = perf_open_event(PERF_TYPE_HARDWARE, kConfig[PERF_CYCLES], -1);
+    if (leader < 0) {
+        pc->reason = errno == ENOENT || errno == EOPNOTSUPP ? "no hardware PMU (VM?)"
+                   : errno == EACCES || errno == EPERM     ? "perf_event_open not permitted"
+                   : errno == ENOSYS                       ? "perf_event_open not supported"
+                                                           : "perf_event_open failed";
+        return 0;
+    }
+    pc->fds[PERF_CYCLES] = leader;
+    pc->slot[PERF_CYCLES] = pc->nr++;
+    for (int e = 1; e < PERF_EVENT_COUNT; e++) {
+        int fd = perf_open_event(PERF_TYPE_HARDWARE, kConfig[e], leader);
+        if (fd >= 0) {
+            pc->fds[e] = fd;
+            pc->slot[e] = pc->nr++;
+        }
+    }
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    pc->available = 1;
+    pc->reason = NULL;
+    return 1;
+#else
+    pc->reason = "hardware counters are only read on Linux";
+    return 0;
+#endif
+}
+
+static inline void perf_counters_close(PerfCounters* pc) {
+#if PERF_SUPPORTED
+    for (int e = PERF_EVENT_COUNT - 1; e >= 0; e--) {
+        if (pc->fds[e] >= 0) close(pc->fds[e]);
+    }
+#endif
+    perf_counters_init(pc);
+}
+
+static inline void perf_start(PerfCounters* pc) {
+#if PERF_SUPPORTED
+    if (pc->available && !perf_read_group(pc, pc->start)) pc->available = 0;
+#else
+    (void)pc;
+#endif
+}
+
+// Adds the counts since perf_start() to `s`, for one call over `pixels` pixels.
+static inline void perf_stop(PerfCounters* pc, PerfSample* s, double pixels) {
+    s->calls++;
+    s->pixels += pixels;
+#if PERF_SUPPORTED
+    uint64_t now[PERF_EVENT_COUNT];
+    if (!pc->available || !perf_read_group(pc, now)) return;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (pc->slot[e] < 0) continue;
+        s->counts[e] += (double)(now[e] - pc->start[e]);
+        s->have[e] = 1;
+    }
+#else
+    (void)pc;
+#endif
+}
+
+static inline double perf_ipc(const PerfSample* s) {
+    return s->have[PERF_CYCLES] && s->have[PERF_INSTRUCTIONS] && s->counts[PERF_CYCLES] > 0.0
+               ? s->counts[PERF_INSTRUCTIONS] / s->counts[PERF_CYCLES]
+               : -1.0;
+}
+
+// Per-pixel value of event `e`, or -1 when it was not counted.
+static inline double perf_per_pixel(const PerfSample* s, int e) {
+    return s->have[e] && s->pixels > 0.0 ? s->counts[e] / s->pixels : -1.0;
+}
+
+static inline void perf_print_value(FILE* fp, double v, const char* fmt) {
+    if (v < 0.0) fprintf(fp, "%8s", "n/a");
+    else fprintf(fp, fmt, v);
+}
+
+// One line per stage: IPC and cycles, instructions, cache and branch misses
+// per pixel.
+static inline void perf_report(const PerfCounters* pc, const PerfSample* samples, int count, FILE* fp) {
+    if (!pc->available) {
+        fprintf(fp, "perf counters: unavailable (%s)\n", pc->reason ? pc->reason : "read failed");
+        return;
+    }
+    fprintf(fp, "perf counters per pixel:   %8s %8s %8s %8s %8s\n", "ipc", "cyc", "instr", "cache-m", "branch-m");
+    for (int i = 0; i < count; i++) {
+        const PerfSample* s = &samples[i];
+        if (!s->calls) continue;
+        fprintf(fp, "  %-10s %7llu calls", s->name, (unsigned long long)s->calls);
+        fprintf(fp, " ");
+        perf_print_value(fp, perf_ipc(s), "%8.2f");
+        fprintf(fp, " ");
+        perf_print_value(fp, perf_per_pixel(s, PERF_CYCLES), "%8.3f");
+        fprintf(fp, " ");
+        perf_print_value(fp, perf_per_pixel(s, PERF_INSTRUCTIONS), "%8.3f");
+        fprintf(fp, " ");
+        perf_print_value(fp, perf_per_pixel(s, PERF_CACHE_MISSES), "%8.5f");
+        fprintf(fp, " ");
+        perf_print_value(fp, perf_per_pixel(s, PERF_BRANCH_MISSES), "%8.5f");
+        fprintf(fp, "\n");
+    }
+}
+
+#endif // PICKER_PERF_H
@@ -0,0 +1,405 @@
+// Minimal Color Picker - small PNG decoder (header-only, C99).
+//
+// Enough PNG to load a design mock for the onion-skin comparison
+// (picker_onion.h) without a zlib dependency: grey, grey+alpha, RGB, RGBA
+// and palette images of 8 bits per sample (16-bit samples keep their high
+// byte), non-interlaced, with tRNS transparency. The zlib stream is inflated
+// by a plain canonical-Huffman decoder that reads one bit at a time. That is
+// slow next to zlib, but a mock is decoded once and then kept as a tiled
+// cache, so no frame ever waits for it.
+//
+//   int w, h;
+//   uint8_t* bgra = png_decode_bgra(data, size, &w, &h);   // NULL on failure, free() it
+//
+// The result is straight (not premultiplied) BGRA, rows of w * 4 bytes.
+
+#ifndef PICKER_PNG_H
+#define PICKER_PNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PNG_MAX_SIDE 32768
+
+// ----------------------
+// Inflate
+// ----------------------
+
+typedef struct PngHuffman {
+    uint16_t count[16];    // codes of each length
+    uint16_t symbol[320];  // symbols in canonical order
+} PngHuffman;
+
+typedef struct PngInflate {
+    const uint8_t* in;
+    size_t inSize, inPos;
+    uint32_t bitBuf;
+    int bitCount;
+    uint8_t* out;
+    size_t outSize, outPos;
+    int error;
+} PngInflate;
+
+static inline int png_bits(PngInflate* s, int need) {
+    uint32_t v = s->bitBuf;
+    while (s->bitCount < need) {
+        if (s->inPos >= s->inSize) {
+            s->error = 1;
+            return 0;
+        }
+        v |= (uint32_t)s->in[s->inPos++] << s->bitCount;
+        s->bitCount += 8;
+    }
+    s->bitBuf = v >> need;
+    s->bitCount -= need;
+    return (int)(v & ((1u << need) - 1));
+}
+
+// Builds a canonical code from code lengths; 0 when over-subscribed.
+static inline int png_huffman_build(PngHuffman* h, const uint8_t* lengths, int n) {
+    uint16_t offs[16];
+    memset(h->count, 0, sizeof(h->count));
+    for (int i = 0; i < n; i++) h->count[lengths[i]]++;
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) return 0;
+    }
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len + 1] = (uint16_t)(offs[len] + h->count[len]);
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) h->symbol[offs[lengths[i]]++] = (uint16_t)i;
+    }
+    return 1;
+}
+
+static inline int png_decode_symbol(PngInflate* s, const PngHuffman* h) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        code |= png_bits(s, 1);
+        int count = h->count[len];
+        if (code - count < first) return h->symbol[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    s->error = 1;
+    return 0;
+}
+
+static const uint16_t kPngLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t kPngLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t kPngDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+    6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t kPngDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static inline int png_inflate_codes(PngInflate* s, const PngHuffman* lit, const PngHuffman* dist) {
+    for (;;) {
+        int sym = png_decode_symbol(s, lit);
+        if (s->error) return 0;
+        if (sym < 256) {
+            if (s->outPos >= s->outSize) return 0;
+            s->out[s->outPos++] = (uint8_t)sym;
+        } else if (sym == 256) {
+            return 1;
+        } else {
+            sym -= 257;
+            if (sym >= 29) return 0;
+            size_t len = kPngLengthBase[sym] + (size_t)png_bits(s, kPngLengthExtra[sym]);
+            int d = png_decode_symbol(s, dist);
+            if (s->error || d >= 30) return 0;
+            size_t back = kPngDistBase[d] + (size_t)png_bits(s, kPngDistExtra[d]);
+            if (s->error || back > s->outPos || len > s->outSize - s->outPos) return 0;
+            // Byte by byte: the copy may overlap what it writes.
+            uint8_t* o = s->out + s->outPos;
+            for (size_t i = 0; i < len; i++) o[i] = o[(ptrdiff_t)i - (ptrdiff_t)back];
+            s->outPos += len;
+        }
+    }
+}
+
+static inline int png_inflate_stored(PngInflate* s) {
+    s->bitBuf = 0;  // to a byte boundary
+    s->bitCount = 0;
+    if (s->inSize - s->inPos < 4) return 0;
+    const uint8_t* p = s->in + s->inPos;
+    size_t len = (size_t)p[0] | (size_t)p[1] << 8;
+    if ((len ^ ((size_t)p[2] | (size_t)p[3] << 8)) != 0xFFFF) return 0;
+    s->inPos += 4;
+    if (len > s->inSize - s->inPos || len > s->outSize - s->outPos) return 0;
+    memcpy(s->out + s->outPos, s->in + s->inPos, len);
+    s->inPos += len;
+    s->outPos += len;
+    return 1;
+}
+
+static inline int png_inflate_fixed(PngInflate* s) {
+    uint8_t lengths[288];
+    PngHuffman lit, dist;
+    int i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    png_huffman_build(&lit, lengths, 288);
+    for (i = 0; i < 30; i++) lengths[i] = 5;
+    png_huffman_build(&dist, lengths, 30);
+    return png_inflate_codes(s, &lit, &dist);
+}
+
+static inline int png_inflate_dynamic(PngInflate* s) {
+    static const uint8_t kOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    uint8_t lengths[320];
+    PngHuffman lencode, lit, dist;
+    int nlen = png_bits(s, 5) + 257, ndist = png_bits(s, 5) + 1, ncode = png_bits(s, 4) + 4;
+    if (s->error || nlen > 286 || ndist > 30) return 0;
+    memset(lengths, 0, 19);
+    for (int i = 0; i < ncode; i++) lengths[kOrder[i]] = (uint8_t)png_bits(s, 3);
+    if (s->error || !png_huffman_build(&lencode, lengths, 19)) return 0;
+
+    for (int i = 0; i < nlen + ndist;) {
+        int sym = png_decode_symbol(s, &lencode);
+        if (s->error) return 0;
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+        uint8_t v = 0;
+        int rep;
+        if (sym == 16) {
+            if (i == 0) return 0;
+            v = lengths[i - 1];
+            rep = 3 + png_bits(s, 2);
+        } else if (sym == 17) {
+            rep = 3 + png_bits(s, 3);
+        } else {
+            rep = 11 + png_bits(s, 7);
+        }
+        if (s->error || i + rep > nlen + ndist) return 0;
+        while (rep--) lengths[i++] = v;
+    }
+    if (!lengths[256]) return 0;  // no end-of-block code
+    if (!png_huffman_build(&lit, lengths, nlen) || !png_huffman_build(&dist, lengths + nlen, ndist)) return 0;
+    return png_inflate_codes(s, &lit, &dist);
+}
+
+// Inflates a zlib stream into out[0..outSize); returns the bytes written, or
+// 0 on a damaged stream or a checksum mismatch.
+static inline size_t png_zlib_inflate(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+    if (inSize < 6 || (in[0] & 0x0F) != 8 || ((in[0] << 8) | in[1]) % 31 || (in[1] & 0x20)) return 0;
+    PngInflate s;
+    memset(&s, 0, sizeof(s));
+    s.in = in + 2;
+    s.inSize = inSize - 2;
+    s.out = out;
+    s.outSize = outSize;
+    int last;
+    do {
+        last = png_bits(&s, 1);
+        int type = png_bits(&s, 2);
+        int ok = type == 0 ? png_inflate_stored(&s)
+               : type == 1 ? png_inflate_fixed(&s)
+               : type == 2 ? png_inflate_dynamic(&s)
+                           : 0;
+        if (!ok || s.error) return 0;
+    } while (!last);
+
+    // Adler-32 of the output follows, big-endian, on a byte boundary.
+    if (s.inSize - s.inPos < 4) return 0;
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < s.outPos;) {
+        size_t end = i + 5552 < s.outPos ? i + 5552 : s.outPos;  // no uint32 overflow before the modulo
+        for (; i < end; i++) {
+            a += out[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    const uint8_t* c = s.in + s.inPos;
+    uint32_t want = (uint32_t)c[0] << 24 | (uint32_t)c[1] << 16 | (uint32_t)c[2] << 8 | c[3];
+    return want == (b << 16 | a) ? s.outPos : 0;
+}
+
+// ----------------------
+// PNG
+// ----------------------
+
+static inline uint32_t png_be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline int png_paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p, pb = p > b ? p - b : b - p, pc = p > c ? p - c : c - p;
+    return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+
+// Undoes the per-row filters in place; raw holds h rows of 1 + rowBytes.
+static inline int png_unfilter(uint8_t* raw, int h, size_t rowBytes, int bpp) {
+    const uint8_t* prev = NULL;
+    for (int y = 0; y < h; y++) {
+        uint8_t* r = raw + (size_t)y * (rowBytes + 1);
+        int type = r[0];
+        uint8_t* p = r + 1;
+        for (size_t i = 0; i < rowBytes; i++) {
+            int a = i >= (size_t)bpp ? p[i - bpp] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = prev && i >= (size_t)bpp ? prev[i - bpp] : 0;
+            switch (type) {
+                case 0: break;
+                case 1: p[i] = (uint8_t)(p[i] + a); break;
+                case 2: p[i] = (uint8_t)(p[i] + b); break;
+                case 3: p[i] = (uint8_t)(p[i] + ((a + b) >> 1)); break;
+                case 4: p[i] = (uint8_t)(p[i] + png_paeth(a, b, c)); break;
+                default: return 0;
+            }
+        }
+        prev = p;
+    }
+    return 1;
+}
+
+static inline uint8_t* png_decode_bgra(const uint8_t* data, size_t size, int* width, int* height) {
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static const int kChannels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    if (size < 8 + 25 || memcmp(data, kSignature, 8)) return NULL;
+
+    // One pass over the chunks for the header, palette, transparency and
+    // the total IDAT size, a second to gather the IDAT data.
+    uint32_t w = 0, h = 0;
+    int depth = 0, type = -1, interlace = 0, paletteSize = 0, keyed = 0;
+    uint8_t palette[256 * 4];
+    uint16_t key[3] = { 0, 0, 0 };
+    size_t idatSize = 0;
+    for (size_t pos = 8; pos + 12 <= size;) {
+        uint32_t len = png_be32(data + pos);
+        const uint8_t* t = data + pos + 4;
+        const uint8_t* c = data + pos + 8;
+        if (len > size - pos - 12) return NULL;
+        if (!memcmp(t, "IHDR", 4) && len >= 13) {
+            w = png_be32(c);
+            h = png_be32(c + 4);
+            depth = c[8];
+            type = c[9];
+            interlace = c[12];
+            if (c[10] || c[11]) return NULL;
+        } else if (!memcmp(t, "PLTE", 4)) {
+            paletteSize = (int)(len / 3) < 256 ? (int)(len / 3) : 256;
+            for (int i = 0; i < paletteSize; i++) {
+                palette[i * 4 + 0] = c[i * 3 + 2];
+                palette[i * 4 + 1] = c[i * 3 + 1];
+                palette[i * 4 + 2] = c[i * 3 + 0];
+                palette[i * 4 + 3] = 255;
+            }
+        } else if (!memcmp(t, "tRNS", 4)) {
+            if (type == 3) {
+                for (uint32_t i = 0; i < len && (int)i < paletteSize; i++) palette[i * 4 + 3] = c[i];
+            } else if ((type == 0 && len >= 2) || (type == 2 && len >= 6)) {
+                for (int i = 0; i < (type == 0 ? 1 : 3); i++) key[i] = (uint16_t)(c[i * 2] << 8 | c[i * 2 + 1]);
+                keyed = 1;
+            }
+        } else if (!memcmp(t, "IDAT", 4)) {
+            idatSize += len;
+        } else if (!memcmp(t, "IEND", 4)) {
+            break;
+        }
+        pos += 12 + (size_t)len;
+    }
+    if (!w || !h || w > PNG_MAX_SIDE || h > PNG_MAX_SIDE || interlace || !idatSize) return NULL;
+    if (type < 0 || type > 6 || !kChannels[type] || (depth != 8 && (depth != 16 || type == 3))) return NULL;
+    if (type == 3 && !paletteSize) return NULL;
+
+    int bpp = kChannels[type] * depth / 8;
+    size_t rowBytes = (size_t)w * (size_t)bpp;
+    size_t rawSize = (rowBytes + 1) * h;
+    uint8_t* idat = (uint8_t*)malloc(idatSize);
+    uint8_t* raw = (uint8_t*)malloc(rawSize);
+    uint8_t* out = (uint8_t*)malloc((size_t)w * h * 4);
+    int ok = idat && raw && out;
+    if (ok) {
+        size_t at = 0;
+        for (size_t pos = 8; pos + 12 <= size;) {
+            uint32_t len = png_be32(data + pos);
+            if (!memcmp(data + pos + 4, "IDAT", 4)) {
+                memcpy(idat + at, data + pos + 8, len);
+                at += len;
+            }
+            if (!memcmp(data + pos + 4, "IEND", 4)) break;
+            pos += 12 + (size_t)len;
+        }
+        ok = png_zlib_inflate(idat, idatSize, raw, rawSize) == rawSize && png_unfilter(raw, (int)h, rowBytes, bpp);
+    }
+    if (ok) {
+        int step = depth / 8;  // 16-bit samples: the high byte comes first
+        for (uint32_t y = 0; y < h; y++) {
+            const uint8_t* p = raw + (size_t)y * (rowBytes + 1) + 1;
+            uint8_t* o = out + (size_t)y * w * 4;
+            for (uint32_t x = 0; x < w; x++, p += bpp, o += 4) {
+                int r, g, b, a = 255;
+                switch (type) {
+                    case 0:
+                        r = g = b = p[0];
+                        if (keyed && (step == 2 ? (p[0] << 8 | p[1]) : p[0]) == key[0]) a = 0;
+                        break;
+                    case 2:
+                        r = p[0];
+                        g = p[step];
+                        b = p[2 * step];
+                        if (keyed) {
+                            int match = 1;
+                            for (int i = 0; i < 3; i++) {
+                                int v = step == 2 ? (p[i * 2] << 8 | p[i * 2 + 1]) : p[i];
+                                match &= v == key[i];
+                            }
+                            if (match) a = 0;
+                        }
+                        break;
+                    case 3:
+                        if (p[0] >= paletteSize) {
+                            ok = 0;
+                            r = g = b = 0;
+                            break;
+                        }
+                        memcpy(o, palette + p[0] * 4, 4);
+                        continue;
+                    case 4:
+                        r = g = b = p[0];
+                        a = p[step];
+                        break;
+                    default:
+                        r = p[0];
+                        g = p[step];
+                        b = p[2 * step];
+                        a = p[3 * step];
+                        break;
+                }
+                o[0] = (uint8_t)b;
+                o[1] = (uint8_t)g;
+                o[2] = (uint8_t)r;
+                o[3] = (uint8_t)a;
+            }
+        }
+    }
+    free(idat);
+    free(raw);
+    if (!ok) {
+        free(out);
+        return NULL;
+    }
+    *width = (int)w;
+    *height = (int)h;
+    return out;
+}
+
+#endif // PICKER_PNG_H
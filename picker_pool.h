@@ -0,0 +1,443 @@
+// Minimal Color Picker - small worker pool and tiled loupe compose (header-only, C99).
+//
+// A fixed set of worker threads is created once; pool_run() hands them a
+// batch of `count` independent tasks and the calling thread works on the
+// batch too. Tasks are claimed one at a time from an atomic counter, so a
+// slow band does not hold back the others. Nothing is allocated per batch,
+// which keeps the audited frame loop allocation-free.
+//
+//   pool_init(&pool, pool_default_threads());
+//   pool_run(&pool, fn, ctx, count);   // returns when fn(ctx, 0..count-1) ran
+//   pool_destroy(&pool);
+//
+// compose_loupe_tiled() splits a loupe into bands of whole rows sized to stay
+// in L2 through all four compose passes and runs them on the pool. Small
+// loupes fit in one band and never wake the workers. compose_loupes_tiled()
+// does the same for several loupes (pinned loupes) in a single batch. A job
+// may carry a source filter (picker_filter.h), applied inside its bands.
+//
+// pool_run_tiles() is for analysis over large regions (up to a whole screen):
+// the region is cut into square tiles and every participant (each worker and
+// the caller) starts on its own contiguous run of them, kept as a deque. A
+// participant that runs out steals the far half of another's deque, so a
+// thread delayed by the scheduler or by expensive tiles does not hold up the
+// batch, and tiles stay in row order within each run for locality.
+//
+//   pool_run_tiles(&pool, fn, ctx, width, height, POOL_TILE);  // fn(ctx, slot, x, y, w, h)
+
+#ifndef PICKER_POOL_H
+#define PICKER_POOL_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "picker_filter.h"
+#include "picker_kernels.h"
+#include "picker_trace.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define POOL_MAX_THREADS 8
+#define POOL_BAND_BYTES (256 * 1024)  // destination bytes per compose band
+#define POOL_MIN_BAND_ROWS 8
+#define POOL_MAX_LOUPES 8           // loupes per compose_loupes_tiled() batch
+#define POOL_MAX_SLOTS (POOL_MAX_THREADS + 1)  // workers plus the caller
+#define POOL_TILE 128               // default pool_run_tiles() tile side
+
+typedef void (*PoolTaskFn)(void* ctx, int index);
+
+typedef struct WorkerPool {
+    int threads;  // worker threads, not counting the caller
+#ifdef _WIN32
+    HANDLE handles[POOL_MAX_THREADS];
+    SRWLOCK lock;
+    CONDITION_VARIABLE wake;
+    CONDITION_VARIABLE done;
+#else
+    pthread_t handles[POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+#endif
+    PoolTaskFn fn;
+    void* ctx;
+    long count;
+    volatile long next;     // next task index to claim
+    int pending;            // workers still inside the current batch
+    uint64_t generation;    // bumped once per batch
+    int quit;
+
+    // Counters (for --stats).
+    uint64_t batches;
+    uint64_t tasks;
+    uint64_t tiles;
+    uint64_t steals;
+} WorkerPool;
+
+#ifdef _WIN32
+static inline void pool_lock(WorkerPool* p) { AcquireSRWLockExclusive(&p->lock); }
+static inline void pool_unlock(WorkerPool* p) { ReleaseSRWLockExclusive(&p->lock); }
+static inline void pool_wait(WorkerPool* p, CONDITION_VARIABLE* cv) { SleepConditionVariableSRW(cv, &p->lock, INFINITE, 0); }
+static inline void pool_broadcast(CONDITION_VARIABLE* cv) { WakeAllConditionVariable(cv); }
+static inline long pool_claim(WorkerPool* p) { return InterlockedExchangeAdd(&p->next, 1); }
+static inline long long pool_load64(volatile long long* v) { return InterlockedCompareExchange64(v, 0, 0); }
+static inline int pool_cas64(volatile long long* v, long long expect, long long want) {
+    return InterlockedCompareExchange64(v, want, expect) == expect;
+}
+static inline void pool_store64(volatile long long* v, long long x) { InterlockedExchange64(v, x); }
+static inline void pool_count(volatile long* v) { InterlockedIncrement(v); }
+#else
+static inline void pool_lock(WorkerPool* p) { pthread_mutex_lock(&p->lock); }
+static inline void pool_unlock(WorkerPool* p) { pthread_mutex_unlock(&p->lock); }
+static inline void pool_wait(WorkerPool* p, pthread_cond_t* cv) { pthread_cond_wait(cv, &p->lock); }
+static inline void pool_broadcast(pthread_cond_t* cv) { pthread_cond_broadcast(cv); }
+static inline long pool_claim(WorkerPool* p) { return __atomic_fetch_add(&p->next, 1, __ATOMIC_ACQ_REL); }
+static inline long long pool_load64(volatile long long* v) { return __atomic_load_n(v, __ATOMIC_ACQUIRE); }
+static inline int pool_cas64(volatile long long* v, long long expect, long long want) {
+    return __atomic_compare_exchange_n(v, &expect, want, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+static inline void pool_store64(volatile long long* v, long long x) { __atomic_store_n(v, x, __ATOMIC_RELEASE); }
+static inline void pool_count(volatile long* v) { __atomic_add_fetch(v, 1, __ATOMIC_RELAXED); }
+#endif
+
+// Runs tasks of the current batch until none are left.
+static inline void pool_drain(WorkerPool* p) {
+    for (;;) {
+        long i = pool_claim(p);
+        if (i >= p->count) return;
+        p->fn(p->ctx, (int)i);
+    }
+}
+
+static inline void pool_worker_loop(WorkerPool* p) {
+    trace_thread_name("worker");
+    uint64_t seen = 0;
+    for (;;) {
+        pool_lock(p);
+        while (p->generation == seen && !p->quit) pool_wait(p, &p->wake);
+        if (p->quit) {
+            pool_unlock(p);
+            return;
+        }
+        seen = p->generation;
+        pool_unlock(p);
+
+        pool_drain(p);
+
+        pool_lock(p);
+        if (--p->pending == 0) pool_broadcast(&p->done);
+        pool_unlock(p);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pool_thread_main(LPVOID arg) {
+    pool_worker_loop((WorkerPool*)arg);
+    return 0;
+}
+#else
+static void* pool_thread_main(void* arg) {
+    pool_worker_loop((WorkerPool*)arg);
+    return NULL;
+}
+#endif
+
+// Online cores minus the caller, capped at POOL_MAX_THREADS.
+static inline int pool_default_threads(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    long cores = (long)si.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (cores < 2) return 0;
+    return cores - 1 > POOL_MAX_THREADS ? POOL_MAX_THREADS : (int)(cores - 1);
+}
+
+// Starts `threads` workers (clamped to [0, POOL_MAX_THREADS]). With 0, or if
+// threads cannot be created, pool_run() simply runs every task on the caller.
+static inline void pool_init(WorkerPool* p, int threads) {
+    WorkerPool zero = { 0 };
+    *p = zero;
+    if (threads < 0) threads = 0;
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+#ifdef _WIN32
+    InitializeSRWLock(&p->lock);
+    InitializeConditionVariable(&p->wake);
+    InitializeConditionVariable(&p->done);
+#else
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+#endif
+    for (int i = 0; i < threads; i++) {
+#ifdef _WIN32
+        p->handles[i] = CreateThread(NULL, 0, pool_thread_main, p, 0, NULL);
+        if (!p->handles[i]) break;
+#else
+        if (pthread_create(&p->handles[i], NULL, pool_thread_main, p) != 0) break;
+#endif
+        p->threads++;
+    }
+}
+
+static inline void pool_destroy(WorkerPool* p) {
+    pool_lock(p);
+    p->quit = 1;
+    pool_broadcast(&p->wake);
+    pool_unlock(p);
+    for (int i = 0; i < p->threads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(p->handles[i], INFINITE);
+        CloseHandle(p->handles[i]);
+#else
+        pthread_join(p->handles[i], NULL);
+#endif
+    }
+    p->threads = 0;
+#ifndef _WIN32
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+#endif
+}
+
+// Runs fn(ctx, i) for i in [0, count) across the workers and the caller, and
+// returns when all of them have finished.
+static inline void pool_run(WorkerPool* p, PoolTaskFn fn, void* ctx, int count) {
+    if (count <= 0) return;
+    p->batches++;
+    p->tasks += (uint64_t)count;
+    if (p->threads == 0 || count == 1) {
+        for (int i = 0; i < count; i++) fn(ctx, i);
+        return;
+    }
+
+    pool_lock(p);
+    p->fn = fn;
+    p->ctx = ctx;
+    p->count = count;
+    p->next = 0;
+    p->pending = p->threads;
+    p->generation++;
+    pool_broadcast(&p->wake);
+    pool_unlock(p);
+
+    pool_drain(p);
+
+    pool_lock(p);
+    while (p->pending) pool_wait(p, &p->done);
+    pool_unlock(p);
+}
+
+// ----------------------------------------------------------------------------
+// Tiled loupe compose
+// ----------------------------------------------------------------------------
+
+typedef struct LoupeJob {
+    const uint8_t* cap;
+    int capSize, capStride;
+    uint8_t* dst;
+    int radius, dstStride;
+    int borderWidth, antialias, markerSize;
+    int bandRows;
+    const LoupeFilter* filter;  // NULL: the capture as it is
+} LoupeJob;
+
+static inline void loupe_band_task(void* ctx, int index) {
+    const LoupeJob* j = (const LoupeJob*)ctx;
+    int y0 = index * j->bandRows;
+    compose_loupe_filtered_rows(j->filter, j->cap, j->capSize, j->capStride, j->dst, j->radius, j->dstStride,
+                                j->borderWidth, j->antialias, j->markerSize, y0, y0 + j->bandRows);
+}
+
+// Rows per band for a destination stride: about POOL_BAND_BYTES of output.
+static inline int loupe_band_rows(int dstStride) {
+    int rows = POOL_BAND_BYTES / (dstStride > 0 ? dstStride : 1);
+    return rows < POOL_MIN_BAND_ROWS ? POOL_MIN_BAND_ROWS : rows;
+}
+
+static inline LoupeJob loupe_job(const uint8_t* cap, int capSize, int capStride, uint8_t* dst, int radius,
+                                 int dstStride, int borderWidth, int antialias, int markerSize) {
+    LoupeJob job;
+    job.cap = cap;
+    job.capSize = capSize;
+    job.capStride = capStride;
+    job.dst = dst;
+    job.radius = radius;
+    job.dstStride = dstStride;
+    job.borderWidth = borderWidth;
+    job.antialias = antialias;
+    job.markerSize = markerSize;
+    job.bandRows = loupe_band_rows(dstStride);
+    job.filter = NULL;
+    return job;
+}
+
+static inline int loupe_job_bands(const LoupeJob* j) {
+    return (j->radius * 2 + j->bandRows - 1) / j->bandRows;
+}
+
+typedef struct LoupeBatch {
+    const LoupeJob* jobs;
+    int firstBand[POOL_MAX_LOUPES + 1];  // task index of each job's first band
+} LoupeBatch;
+
+static inline void loupe_batch_task(void* ctx, int index) {
+    const LoupeBatch* b = (const LoupeBatch*)ctx;
+    int j = 0;
+    while (index >= b->firstBand[j + 1]) j++;
+    loupe_band_task((void*)&b->jobs[j], index - b->firstBand[j]);
+}
+
+// Composes several loupes as one pool batch: every band of every loupe is a
+// task, so loupes that each fit in one band still run side by side and the
+// workers are woken once per frame, not once per loupe.
+static inline void compose_loupes_tiled(WorkerPool* pool, const LoupeJob* jobs, int count) {
+    while (count > 0) {
+        int n = count < POOL_MAX_LOUPES ? count : POOL_MAX_LOUPES;
+        LoupeBatch batch;
+        batch.jobs = jobs;
+        batch.firstBand[0] = 0;
+        for (int j = 0; j < n; j++) batch.firstBand[j + 1] = batch.firstBand[j] + loupe_job_bands(&jobs[j]);
+        pool_run(pool, loupe_batch_task, &batch, batch.firstBand[n]);
+        jobs += n;
+        count -= n;
+    }
+}
+
+// Same output as compose_loupe(), band by band on the pool.
+static inline void compose_loupe_tiled(WorkerPool* pool, const uint8_t* cap, int capSize, int capStride,
+                                       uint8_t* dst, int radius, int dstStride,
+                                       int borderWidth, int antialias, int markerSize) {
+    LoupeJob job = loupe_job(cap, capSize, capStride, dst, radius, dstStride, borderWidth, antialias, markerSize);
+    pool_run(pool, loupe_band_task, &job, loupe_job_bands(&job));
+}
+
+// compose_loupe_tiled() through a source filter (picker_filter.h).
+static inline void compose_loupe_filtered_tiled(WorkerPool* pool, const LoupeFilter* filter, const uint8_t* cap,
+                                                int capSize, int capStride, uint8_t* dst, int radius, int dstStride,
+                                                int borderWidth, int antialias, int markerSize) {
+    LoupeJob job = loupe_job(cap, capSize, capStride, dst, radius, dstStride, borderWidth, antialias, markerSize);
+    job.filter = filter;
+    pool_run(pool, loupe_band_task, &job, loupe_job_bands(&job));
+}
+
+// ----------------------------------------------------------------------------
+// Tiled region work with stealing
+// ----------------------------------------------------------------------------
+
+// `slot` is the participant running the tile, 0..pool_slots() - 1; no two
+// threads use one slot at the same time, so per-slot partial results (a
+// histogram per slot, merged afterwards) need no atomics.
+typedef void (*PoolTileFn)(void* ctx, int slot, int x, int y, int w, int h);
+
+// One participant's tiles [lo, hi), packed into one word so the owner taking
+// from the front and a thief taking from the back agree with a single CAS.
+// Padded to a cache line so participants don't share one.
+typedef struct PoolDeque {
+    volatile long long range;
+    char pad[64 - sizeof(long long)];
+} PoolDeque;
+
+typedef struct TileBatch {
+    PoolTileFn fn;
+    void* ctx;
+    int width, height, tile, tilesX;
+    int slots;
+    volatile long steals;
+    PoolDeque deques[POOL_MAX_SLOTS];
+} TileBatch;
+
+static inline long long pool_range(int lo, int hi) { return ((long long)hi << 32) | (unsigned)lo; }
+static inline int pool_range_lo(long long r) { return (int)(unsigned)(r & 0xFFFFFFFF); }
+static inline int pool_range_hi(long long r) { return (int)(r >> 32); }
+
+static inline int pool_slots(const WorkerPool* p) { return p->threads + 1; }
+
+// Next tile from the front of `d`, or -1 when it is empty.
+static inline int pool_deque_pop(PoolDeque* d) {
+    for (;;) {
+        long long r = pool_load64(&d->range);
+        int lo = pool_range_lo(r), hi = pool_range_hi(r);
+        if (lo >= hi) return -1;
+        if (pool_cas64(&d->range, r, pool_range(lo + 1, hi))) return lo;
+    }
+}
+
+// Takes the back half of some other participant's tiles: returns the first
+// and leaves the rest in `slot`'s own (empty) deque. -1 when every deque was
+// empty. Tiles are only ever removed from a deque, never returned, so a range
+// cannot reappear between a read and its CAS.
+static inline int pool_steal(TileBatch* b, int slot) {
+    for (int k = 1; k < b->slots; k++) {
+        PoolDeque* victim = &b->deques[(slot + k) % b->slots];
+        for (;;) {
+            long long r = pool_load64(&victim->range);
+            int lo = pool_range_lo(r), hi = pool_range_hi(r);
+            if (lo >= hi) break;
+            int mid = hi - (hi - lo + 1) / 2;
+            if (pool_cas64(&victim->range, r, pool_range(lo, mid))) {
+                pool_store64(&b->deques[slot].range, pool_range(mid + 1, hi));
+                pool_count(&b->steals);
+                return mid;
+            }
+        }
+    }
+    return -1;
+}
+
+static inline void pool_tile_slot_task(void* ctx, int slot) {
+    TileBatch* b = (TileBatch*)ctx;
+    for (;;) {
+        int t = pool_deque_pop(&b->deques[slot]);
+        if (t < 0) t = pool_steal(b, slot);
+        if (t < 0) return;
+        int x = (t % b->tilesX) * b->tile, y = (t / b->tilesX) * b->tile;
+        int w = x + b->tile < b->width ? b->tile : b->width - x;
+        int h = y + b->tile < b->height ? b->tile : b->height - y;
+        b->fn(b->ctx, slot, x, y, w, h);
+    }
+}
+
+// Runs fn over every tile x tile square of a width x height region (edge
+// tiles are cut to fit) and returns when all are done. Each participant runs
+// as one pool task; it drains its own deque, then steals until none is left.
+static inline void pool_run_tiles(WorkerPool* p, PoolTileFn fn, void* ctx, int width, int height, int tile) {
+    if (width <= 0 || height <= 0) return;
+    if (tile <= 0) tile = POOL_TILE;
+    TileBatch b;
+    b.fn = fn;
+    b.ctx = ctx;
+    b.width = width;
+    b.height = height;
+    b.tile = tile;
+    b.tilesX = (width + tile - 1) / tile;
+    b.slots = pool_slots(p);
+    b.steals = 0;
+    int count = b.tilesX * ((height + tile - 1) / tile);
+    for (int i = 0; i < b.slots; i++) {
+        b.deques[i].range = pool_range((int)((long long)count * i / b.slots),
+                                       (int)((long long)count * (i + 1) / b.slots));
+    }
+    pool_run(p, pool_tile_slot_task, &b, b.slots);
+    p->tiles += (uint64_t)count;
+    p->steals += (uint64_t)b.steals;
+}
+
+static inline void pool_report(const WorkerPool* p, FILE* fp) {
+    fprintf(fp, "pool: %d worker thread(s), %llu batches, %llu tasks, %llu tiles, %llu steals\n", p->threads,
+            (unsigned long long)p->batches, (unsigned long long)p->tasks, (unsigned long long)p->tiles,
+            (unsigned long long)p->steals);
+}
+
+#endif // PICKER_POOL_H
@@ -0,0 +1,117 @@
+// Minimal Color Picker - shared capture planning for several loupes (header-only, C99).
+//
+// With pinned loupes (--pin) every frame needs one capture square per loupe.
+// Grabbing each square on its own costs a round trip to the display server
+// (or a BitBlt) per loupe; grabbing the bounding box of all of them costs one
+// request but can copy most of the screen when the loupes are far apart.
+// region_plan() sits between the two: it merges squares into the same grab
+// while the merged rectangle is not much bigger than the parts (overlapping
+// or nearby loupes share a grab), and keeps distant ones apart.
+//
+// The grabs are packed back to back into one buffer, each with rows of its
+// own width, so all loupes read their square from a single shared capture:
+//
+//   region_plan(&plan, squares, n, REGION_GRAB_COST, capacityPixels);
+//   for each grab g: copy plan.grabs[g] to base + plan.offset[g] * 4
+//   square i:        region_view(&plan, base, squares, i, &stride)
+//
+// Squares are expected to lie inside the captured screen; the caller clamps.
+
+#ifndef PICKER_REGIONS_H
+#define PICKER_REGIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REGION_MAX 8
+// Extra pixels a merged grab may copy before a separate request is cheaper:
+// roughly what one more round trip costs in copy bandwidth.
+#define REGION_GRAB_COST (64 * 1024)
+
+typedef struct RegionRect {
+    int x, y, w, h;
+} RegionRect;
+
+typedef struct RegionPlan {
+    int count;                  // grabs this frame
+    RegionRect grabs[REGION_MAX];
+    size_t offset[REGION_MAX];  // first pixel of each grab in the shared buffer
+    int grabOf[REGION_MAX];     // grab holding each input square
+    size_t pixels;              // total pixels grabbed
+} RegionPlan;
+
+static inline int64_t region_area(RegionRect r) { return (int64_t)r.w * r.h; }
+
+static inline RegionRect region_bounds(RegionRect a, RegionRect b) {
+    int x0 = a.x < b.x ? a.x : b.x;
+    int y0 = a.y < b.y ? a.y : b.y;
+    int x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    int y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    RegionRect r = { x0, y0, x1 - x0, y1 - y0 };
+    return r;
+}
+
+// Groups `n` (<= REGION_MAX) squares into grabs. Pairs are merged greedily,
+// cheapest first, while the merge adds at most `grabCost` pixels over the two
+// separate grabs. If the grabs would not fit in `capacity` pixels they are
+// merged into one bounding box, which the caller sizes the buffer for.
+static inline void region_plan(RegionPlan* plan, const RegionRect* squares, int n, int64_t grabCost,
+                               int64_t capacity) {
+    if (n > REGION_MAX) n = REGION_MAX;
+    plan->count = n;
+    for (int i = 0; i < n; i++) {
+        plan->grabs[i] = squares[i];
+        plan->grabOf[i] = i;
+    }
+
+    while (plan->count > 1) {
+        int ba = -1, bb = -1;
+        int64_t best = grabCost;
+        for (int a = 0; a < plan->count; a++) {
+            for (int b = a + 1; b < plan->count; b++) {
+                int64_t extra = region_area(region_bounds(plan->grabs[a], plan->grabs[b])) -
+                                region_area(plan->grabs[a]) - region_area(plan->grabs[b]);
+                if (extra <= best) {
+                    best = extra;
+                    ba = a;
+                    bb = b;
+                }
+            }
+        }
+        if (ba < 0) break;
+        // Merge bb into ba and move the last grab into bb's slot.
+        plan->grabs[ba] = region_bounds(plan->grabs[ba], plan->grabs[bb]);
+        int last = plan->count - 1;
+        plan->grabs[bb] = plan->grabs[last];
+        for (int i = 0; i < n; i++) {
+            if (plan->grabOf[i] == bb) plan->grabOf[i] = ba;
+            else if (plan->grabOf[i] == last) plan->grabOf[i] = bb;
+        }
+        plan->count--;
+    }
+
+    int64_t total = 0;
+    for (int g = 0; g < plan->count; g++) total += region_area(plan->grabs[g]);
+    if (total > capacity && plan->count > 1) {
+        for (int g = 1; g < plan->count; g++) plan->grabs[0] = region_bounds(plan->grabs[0], plan->grabs[g]);
+        plan->count = 1;
+        for (int i = 0; i < n; i++) plan->grabOf[i] = 0;
+    }
+
+    plan->pixels = 0;
+    for (int g = 0; g < plan->count; g++) {
+        plan->offset[g] = plan->pixels;
+        plan->pixels += (size_t)region_area(plan->grabs[g]);
+    }
+}
+
+// Square `i` inside the shared buffer `base` (BGRA), with its row stride.
+static inline const uint8_t* region_view(const RegionPlan* plan, const uint8_t* base, const RegionRect* squares,
+                                         int i, int* stride) {
+    int g = plan->grabOf[i];
+    const RegionRect* r = &plan->grabs[g];
+    *stride = r->w * 4;
+    return base + (plan->offset[g] + (size_t)(squares[i].y - r->y) * (size_t)r->w + (size_t)(squares[i].x - r->x)) * 4;
+}
+
+#endif // PICKER_REGIONS_H
@@ -0,0 +1,450 @@
+// Minimal Color Picker - pixel ruler (header-only, C99).
+//
+// Four rays leave the cursor pixel, left, right, up and down, and each stops
+// at the first pixel whose B, G or R differs from the cursor pixel's by more
+// than `tol`. The pixels passed on the way are the distance to the nearest
+// edge in that direction, as a design ruler measures it. A ray that reaches
+// the side of the frame first reports the distance to that side.
+//
+// The horizontal rays scan the cursor's row. The vertical rays would touch
+// one pixel per cache line in a row-major frame, so they read a band of
+// RULER_BAND columns around the cursor instead. The band is transposed into
+// column-major order in tiles of RULER_BAND x RULER_TILE_ROWS pixels, using
+// 4x4 SSE2 transposes, and its columns are scanned with the row code. A tile
+// is transposed only when a ray reaches it and is kept until the next
+// measurement, so a ray that stops near the cursor costs one tile. Every scan
+// tests eight pixels per step with SSE2: the saturating absolute difference
+// against the cursor pixel, less the tolerance, must be zero in every colour
+// byte. The portable version finds the same pixels.
+//
+// The pickers grab only the cursor's row and band each frame, not the screen,
+// and ruler_draw_bgra() draws the rays, a tick at each edge and the distances
+// into the composed loupe.
+//
+//   ruler_reserve(&cache, screenHeight);                   // 0 on failure
+//   (or cache.direct = 1: no tiles, the band's column is scanned in place)
+//   ruler_measure_cross(&cache, row, w, band, bandStride, bandW, h, x, x - bandX, y, tol, &r);
+//   ruler_draw_bgra(&r, loupe, radius, stride, capSize, borderWidth, glyph);
+
+#ifndef PICKER_RULER_H
+#define PICKER_RULER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picker_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RULER_SSE2 1
+#else
+#define RULER_SSE2 0
+#endif
+
+#define RULER_BAND 8          // columns transposed around the cursor
+#define RULER_TILE_ROWS 64    // rows per transposed tile
+#define RULER_COLOUR 0xFFFF2D78u
+#define RULER_LABEL_BG 0xFF202020u
+
+enum { RULER_LEFT = 1, RULER_RIGHT = 2, RULER_UP = 4, RULER_DOWN = 8 };
+
+typedef struct RulerResult {
+    int left, right, up, down;  // matching pixels past the cursor's, per direction
+    int edges;                  // RULER_* bits: the ray stopped at an edge, not the frame's side
+    uint32_t colour;            // the cursor pixel
+} RulerResult;
+
+typedef struct RulerCache {
+    uint32_t* cols;      // the band, column-major: RULER_BAND columns of h pixels
+    uint32_t* tileGen;   // per tile: == gen once transposed for the current measurement
+    size_t colsCap, tilesCap;
+    uint32_t gen;
+    int direct;          // no tiles: scan the band's column in place (for a memory cap)
+
+    // Counters (for --stats).
+    uint64_t measures;
+    uint64_t tiles;      // transposed, over all measurements
+    double totalMs, maxMs;
+} RulerCache;
+
+// Grows the cache to bands of h rows. Returns 0 on failure.
+static inline int ruler_reserve(RulerCache* c, int h) {
+    size_t cols = (size_t)RULER_BAND * (size_t)h;
+    size_t tiles = ((size_t)h + RULER_TILE_ROWS - 1) / RULER_TILE_ROWS;
+    if (cols > c->colsCap) {
+        uint32_t* p = (uint32_t*)realloc(c->cols, cols * 4);
+        if (!p) return 0;
+        c->cols = p;
+        c->colsCap = cols;
+    }
+    if (tiles > c->tilesCap) {
+        uint32_t* t = (uint32_t*)realloc(c->tileGen, tiles * 4);
+        if (!t) return 0;
+        memset(t, 0, tiles * 4);
+        c->tileGen = t;
+        c->tilesCap = tiles;
+        c->gen = 0;
+    }
+    return 1;
+}
+
+static inline void ruler_free(RulerCache* c) {
+    free(c->cols);
+    free(c->tileGen);
+    memset(c, 0, sizeof(*c));
+}
+
+// Bytes held, for the memory report.
+static inline size_t ruler_bytes(const RulerCache* c) {
+    return (c->colsCap + c->tilesCap) * 4;
+}
+
+// Bytes ruler_reserve() takes for bands of h rows, for a memory budget.
+static inline size_t ruler_bytes_for(int h) {
+    return ((size_t)RULER_BAND * (size_t)h + ((size_t)h + RULER_TILE_ROWS - 1) / RULER_TILE_ROWS) * 4;
+}
+
+// Left edge of the band for column x of a w-wide frame: aligned, and inside
+// the frame when it is at least RULER_BAND wide.
+static inline int ruler_band_x(int x, int w) {
+    int bx = x & ~(RULER_BAND - 1);
+    if (bx + RULER_BAND > w) bx = w - RULER_BAND;
+    return bx < 0 ? 0 : bx;
+}
+
+// Significant change: alpha is ignored and any colour channel may differ by
+// up to `tol`.
+static inline int ruler_differs(uint32_t p, uint32_t ref, int tol) {
+    for (int s = 0; s < 24; s += 8) {
+        int d = (int)((p >> s) & 0xFF) - (int)((ref >> s) & 0xFF);
+        if (d > tol || -d > tol) return 1;
+    }
+    return 0;
+}
+
+// First i in [i, end) that differs; end when none.
+static inline int ruler_next_generic(const uint32_t* p, int i, int end, uint32_t ref, int tol) {
+    while (i < end && !ruler_differs(p[i], ref, tol)) i++;
+    return i;
+}
+
+// Last i in [begin, i] that differs; begin - 1 when none.
+static inline int ruler_prev_generic(const uint32_t* p, int i, int begin, uint32_t ref, int tol) {
+    while (i >= begin && !ruler_differs(p[i], ref, tol)) i--;
+    return i;
+}
+
+#if RULER_SSE2
+typedef struct RulerSse2 {
+    __m128i ref, tol;
+} RulerSse2;
+
+// The tolerance as a byte per channel; alpha always passes.
+static inline RulerSse2 ruler_sse2_init(uint32_t ref, int tol) {
+    uint32_t t = (uint32_t)(tol > 255 ? 255 : tol);
+    RulerSse2 k;
+    k.ref = _mm_set1_epi32((int)ref);
+    k.tol = _mm_set1_epi32((int)(0xFF000000u | (t << 16) | (t << 8) | t));
+    return k;
+}
+
+// Bit i set when pixel i of the eight at `p` differs.
+static inline int ruler_mask8_sse2(const uint32_t* p, const RulerSse2* k) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_loadu_si128((const __m128i*)p);
+    __m128i b = _mm_loadu_si128((const __m128i*)(p + 4));
+    __m128i da = _mm_or_si128(_mm_subs_epu8(a, k->ref), _mm_subs_epu8(k->ref, a));
+    __m128i db = _mm_or_si128(_mm_subs_epu8(b, k->ref), _mm_subs_epu8(k->ref, b));
+    int same = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_subs_epu8(da, k->tol), zero))) |
+               (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_subs_epu8(db, k->tol), zero))) << 4);
+    return ~same & 0xFF;
+}
+
+static inline int ruler_next_sse2(const uint32_t* p, int i, int end, uint32_t ref, int tol, const RulerSse2* k) {
+    for (; i + 8 <= end; i += 8) {
+        int m = ruler_mask8_sse2(p + i, k);
+        if (m) {
+            int b = 0;
+            while (!(m & (1 << b))) b++;
+            return i + b;
+        }
+    }
+    return ruler_next_generic(p, i, end, ref, tol);
+}
+
+static inline int ruler_prev_sse2(const uint32_t* p, int i, int begin, uint32_t ref, int tol, const RulerSse2* k) {
+    for (; i - 7 >= begin; i -= 8) {
+        int m = ruler_mask8_sse2(p + i - 7, k);
+        if (m) {
+            int b = 7;
+            while (!(m & (1 << b))) b--;
+            return i - 7 + b;
+        }
+    }
+    return ruler_prev_generic(p, i, begin, ref, tol);
+}
+
+// Four rows of four pixels at `s` become four columns of four at `d`, the
+// columns `h` pixels apart.
+static inline void ruler_transpose4_sse2(const uint8_t* s, int stride, uint32_t* d, int h) {
+    __m128i r0 = _mm_loadu_si128((const __m128i*)s);
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(s + stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(s + 2 * (size_t)stride));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(s + 3 * (size_t)stride));
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+    _mm_storeu_si128((__m128i*)d, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(d + h), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(d + 2 * (size_t)h), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i*)(d + 3 * (size_t)h), _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+// The band `bw` columns wide and h rows tall at `band`, with tile t
+// transposed into c->cols for the current measurement.
+static inline const uint32_t* ruler_tile(RulerCache* c, const uint8_t* band, int stride, int bw, int h, int t,
+                                         int simd) {
+    if (c->tileGen[t] == c->gen) return c->cols;
+    int y0 = t * RULER_TILE_ROWS;
+    int y1 = y0 + RULER_TILE_ROWS < h ? y0 + RULER_TILE_ROWS : h;
+    int y = y0;
+#if RULER_SSE2
+    if (simd && bw == RULER_BAND) {
+        for (; y + 4 <= y1; y += 4) {
+            const uint8_t* s = band + (size_t)y * stride;
+            ruler_transpose4_sse2(s, stride, c->cols + y, h);
+            ruler_transpose4_sse2(s + 16, stride, c->cols + 4 * (size_t)h + y, h);
+        }
+    }
+#else
+    (void)simd;
+#endif
+    for (; y < y1; y++) {
+        const uint32_t* s = pixel_row_const(band, stride, y);
+        for (int x = 0; x < bw; x++) c->cols[(size_t)x * h + y] = s[x];
+    }
+    c->tileGen[t] = c->gen;
+    c->tiles++;
+    return c->cols;
+}
+
+// ruler_next_generic() and ruler_prev_generic() down a column of `band`,
+// `stride` bytes per row: the scans of a cache that holds no tiles.
+static inline int ruler_next_column(const uint8_t* band, int stride, int i, int end, uint32_t ref, int tol) {
+    while (i < end && !ruler_differs(pixel_row_const(band, stride, i)[0], ref, tol)) i++;
+    return i;
+}
+
+static inline int ruler_prev_column(const uint8_t* band, int stride, int i, int begin, uint32_t ref, int tol) {
+    while (i >= begin && !ruler_differs(pixel_row_const(band, stride, i)[0], ref, tol)) i--;
+    return i;
+}
+
+// The ruler's scans with the SSE2 versions when `simd` is set.
+#if RULER_SSE2
+#define RULER_SCAN(fn, ...) (simd ? fn##_sse2(__VA_ARGS__, &k) : fn##_generic(__VA_ARGS__))
+#else
+#define RULER_SCAN(fn, ...) fn##_generic(__VA_ARGS__)
+#endif
+
+// Measures from pixel (x, y) given the row through it (w pixels) and a band
+// of bw <= RULER_BAND columns holding it at column `col` (h rows, `stride`
+// bytes apart), and stores the distances in *r. Returns 0 on failure to
+// allocate.
+static inline int ruler_measure_cross_impl(RulerCache* c, const uint32_t* row, int w, const uint8_t* band,
+                                           int stride, int bw, int h, int x, int col, int y, int tol,
+                                           RulerResult* r, int simd) {
+    memset(r, 0, sizeof(*r));
+    if (x < 0 || x >= w || y < 0 || y >= h || col < 0 || col >= bw) return 1;
+    if (!c->direct && !ruler_reserve(c, h)) return 0;
+    if (!c->direct && ++c->gen == 0) {
+        memset(c->tileGen, 0, c->tilesCap * 4);
+        c->gen = 1;
+    }
+    uint32_t ref = row[x];
+    r->colour = ref;
+#if RULER_SSE2
+    RulerSse2 k = ruler_sse2_init(ref, tol);
+#endif
+
+    int j = RULER_SCAN(ruler_prev, row, x - 1, 0, ref, tol);
+    r->left = x - 1 - j;
+    if (j >= 0) r->edges |= RULER_LEFT;
+    j = RULER_SCAN(ruler_next, row, x + 1, w, ref, tol);
+    r->right = j - x - 1;
+    if (j < w) r->edges |= RULER_RIGHT;
+
+    if (c->direct) {
+        const uint8_t* column = band + (size_t)col * 4;
+        j = ruler_prev_column(column, stride, y - 1, 0, ref, tol);
+        r->up = y - 1 - j;
+        if (j >= 0) r->edges |= RULER_UP;
+        j = ruler_next_column(column, stride, y + 1, h, ref, tol);
+        r->down = j - y - 1;
+        if (j < h) r->edges |= RULER_DOWN;
+        c->measures++;
+        return 1;
+    }
+
+    // Up and down through the column, a tile at a time.
+    j = -1;
+    for (int i = y - 1; i >= 0;) {
+        int t = i / RULER_TILE_ROWS, begin = t * RULER_TILE_ROWS;
+        const uint32_t* p = ruler_tile(c, band, stride, bw, h, t, simd) + (size_t)col * h;
+        j = RULER_SCAN(ruler_prev, p, i, begin, ref, tol);
+        if (j >= begin) break;
+        i = begin - 1;
+        j = -1;
+    }
+    r->up = y - 1 - j;
+    if (j >= 0) r->edges |= RULER_UP;
+    j = h;
+    for (int i = y + 1; i < h;) {
+        int t = i / RULER_TILE_ROWS, end = (t + 1) * RULER_TILE_ROWS < h ? (t + 1) * RULER_TILE_ROWS : h;
+        const uint32_t* p = ruler_tile(c, band, stride, bw, h, t, simd) + (size_t)col * h;
+        j = RULER_SCAN(ruler_next, p, i, end, ref, tol);
+        if (j < end) break;
+        i = end;
+        j = h;
+    }
+    r->down = j - y - 1;
+    if (j < h) r->edges |= RULER_DOWN;
+    c->measures++;
+    return 1;
+}
+#undef RULER_SCAN
+
+static inline int ruler_measure_cross(RulerCache* c, const uint32_t* row, int w, const uint8_t* band, int stride,
+                                      int bw, int h, int x, int col, int y, int tol, RulerResult* r) {
+    return ruler_measure_cross_impl(c, row, w, band, stride, bw, h, x, col, y, tol, r, RULER_SSE2);
+}
+
+// Measures from (x, y) of a whole w x h frame, its band taken in place.
+static inline int ruler_measure(RulerCache* c, const uint8_t* px, int w, int h, int stride, int x, int y, int tol,
+                                RulerResult* r) {
+    int bx = ruler_band_x(x, w), bw = w < RULER_BAND ? w : RULER_BAND;
+    return ruler_measure_cross_impl(c, pixel_row_const(px, stride, y < 0 ? 0 : y), w, px + (size_t)bx * 4, stride,
+                                    bw, h, x, x - bx, y, tol, r, RULER_SSE2);
+}
+
+// Portable version; same distances.
+static inline int ruler_measure_generic(RulerCache* c, const uint8_t* px, int w, int h, int stride, int x, int y,
+                                        int tol, RulerResult* r) {
+    int bx = ruler_band_x(x, w), bw = w < RULER_BAND ? w : RULER_BAND;
+    return ruler_measure_cross_impl(c, pixel_row_const(px, stride, y < 0 ? 0 : y), w, px + (size_t)bx * 4, stride,
+                                    bw, h, x, x - bx, y, tol, r, 0);
+}
+
+// Folds the distances into a hash, so parking notices an edge moving outside
+// the capture square.
+static inline uint64_t ruler_hash(const RulerResult* r) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    int v[6] = { r->left, r->right, r->up, r->down, r->edges, (int)r->colour };
+    for (int i = 0; i < 6; i++) h = (h ^ (uint32_t)v[i]) * 0x100000001B3ull;
+    return h;
+}
+
+// ----------------------
+// Loupe overlay
+// ----------------------
+
+// 3x5 digits, top row in the high bits.
+static const uint16_t kRulerDigits[10] = {
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF,
+};
+
+// Writes one loupe pixel, only inside the opaque disc.
+static inline void ruler_put(uint8_t* px, int d, int stride, int x, int y, uint32_t c) {
+    if (x < 0 || y < 0 || x >= d || y >= d) return;
+    uint32_t* p = pixel_row(px, stride, y) + x;
+    if ((*p >> 24) == 0xFF) *p = c;
+}
+
+static inline void ruler_fill(uint8_t* px, int d, int stride, int x0, int y0, int x1, int y1, uint32_t c) {
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) ruler_put(px, d, stride, x, y, c);
+    }
+}
+
+// Draws `v` in digits `g` loupe pixels square, on a dark box centred on
+// (cx, cy).
+static inline void ruler_label(uint8_t* px, int d, int stride, int cx, int cy, int v, int g) {
+    char s[12];
+    int n = snprintf(s, sizeof(s), "%d", v);
+    int tw = n * 4 * g - g, th = 5 * g;
+    int x0 = cx - tw / 2, y0 = cy - th / 2;
+    ruler_fill(px, d, stride, x0 - g, y0 - g, x0 + tw + g, y0 + th + g, RULER_LABEL_BG);
+    for (int i = 0; i < n; i++) {
+        uint16_t bits = kRulerDigits[s[i] - '0'];
+        for (int b = 0; b < 15; b++) {
+            if (!(bits & (1 << (14 - b)))) continue;
+            int gx = x0 + i * 4 * g + (b % 3) * g, gy = y0 + (b / 3) * g;
+            ruler_fill(px, d, stride, gx, gy, gx + g, gy + g, 0xFFFFFFFFu);
+        }
+    }
+}
+
+// Loupe coordinate where capture pixel k begins, as the nearest-neighbour
+// scale from a capSize square to d pixels places it.
+static inline int ruler_loupe_at(int k, int d, int capSize) {
+    return (int)(((int64_t)k * d + capSize - 1) / capSize);
+}
+
+// Draws the four rays of `r` into a composed loupe of `radius` magnified
+// from a capSize square, inside the border of width `inset`: a line from the
+// cursor's pixel to each edge, a tick across the last pixel before it and
+// the distance beside the line, in digits `glyph` pixels per dot. Lines end
+// at the border when the edge lies beyond the loupe.
+static inline void ruler_draw_bgra(const RulerResult* r, uint8_t* px, int radius, int stride, int capSize, int inset,
+                                   int glyph) {
+    int d = radius * 2, c = capSize / 2, lim = radius - inset - 1;
+    int g = glyph < 1 ? 1 : glyph;
+    int dist[4] = { r->left, r->right, r->up, r->down };
+    for (int dir = 0; dir < 4; dir++) {
+        int neg = dir == 0 || dir == 2, across = dir >= 2;
+        // Offsets from the centre along the ray, of the cursor pixel's
+        // outermost loupe pixel and of the last matching pixel's.
+        int start = neg ? radius - ruler_loupe_at(c, d, capSize) : ruler_loupe_at(c + 1, d, capSize) - 1 - radius;
+        int end = neg ? radius - ruler_loupe_at(c - dist[dir], d, capSize)
+                      : ruler_loupe_at(c + dist[dir] + 1, d, capSize) - 1 - radius;
+        int stop = end < lim ? end : lim;
+        for (int a = start; a <= stop; a++) {
+            int along = neg ? radius - a : radius + a;
+            ruler_put(px, d, stride, across ? radius : along, across ? along : radius, RULER_COLOUR);
+        }
+        if ((r->edges & (1 << dir)) && end <= lim) {
+            int along = neg ? radius - end : radius + end;
+            for (int t = -3 * g; t <= 3 * g; t++) {
+                ruler_put(px, d, stride, across ? radius + t : along, across ? along : radius + t, RULER_COLOUR);
+            }
+        }
+        // The label sits beside the middle of the visible line, clear of the
+        // tick, the marker and the border.
+        char s[12];
+        int tw = snprintf(s, sizeof(s), "%d", dist[dir]) * 4 * g - g, th = 5 * g;
+        int alongHalf = (across ? th : tw) / 2 + g, acrossHalf = (across ? tw : th) / 2 + g;
+        int mid = (start + stop) / 2;
+        if (mid > lim - alongHalf - g) mid = lim - alongHalf - g;
+        if (mid < start + alongHalf + g) mid = start + alongHalf + g;
+        int along = neg ? radius - mid : radius + mid, off = 3 * g + acrossHalf + 1;
+        if (across) ruler_label(px, d, stride, radius + off, along, dist[dir], g);
+        else ruler_label(px, d, stride, along, radius - off, dist[dir], g);
+    }
+}
+
+// Counts one measurement's cost, for --stats.
+static inline void ruler_count_ms(RulerCache* c, double ms) {
+    c->totalMs += ms;
+    if (ms > c->maxMs) c->maxMs = ms;
+}
+
+static inline void ruler_report(const RulerCache* c, FILE* fp) {
+    if (!c->measures) return;
+    fprintf(fp, "ruler: %llu measurements, %.2f tiles transposed each, %.3f ms mean, %.3f ms max\n",
+            (unsigned long long)c->measures, (double)c->tiles / (double)c->measures,
+            c->totalMs / (double)c->measures, c->maxMs);
+}
+
+#endif // PICKER_RULER_H
@@ -0,0 +1,307 @@
+// Minimal Color Picker - waveform and vectorscope of the captured region (header-only, C99).
+//
+// Two scopes of an n x n region around the cursor, for grading work where one
+// pixel says too little. The waveform has a column per region column (up to
+// SCOPE_LEVELS, wider regions share columns) and plots each pixel's luma
+// up that column. The vectorscope plots each pixel's chroma, Cb across and
+// Cr up, with neutral grey in the centre. Both use BT.709 weights in 8-bit
+// fixed point, on the sRGB bytes as captured, like a broadcast scope fed the
+// screen.
+//
+// The region is read from the loupe's capture square; nothing is grabbed
+// again. Binning runs on the worker pool with pool_run_tiles(). Each
+// participant adds into its own ScopeBins, cleared when it takes its first
+// tile, and the partials are summed into slot 0 afterwards, so no bin is
+// shared between threads. With SSE2 four pixels' luma and chroma are computed
+// per step and the vectorscope's bin indices come out of the same registers;
+// the increments themselves are scalar (SSE2 has no scatter). The portable
+// version produces the same bins.
+//
+// scope_render_bgra() draws both scopes side by side into an opaque
+// SCOPE_PANEL_W x SCOPE_PANEL_H panel, brightness rising with the log of
+// each bin's count, over a dim graticule. The pickers recompute and redraw
+// the panel only on frames whose capture changed.
+//
+//   scope_reserve(&scope, pool_slots(&pool), n);         // 0 on failure
+//   const uint8_t* r = scope_region(cap, capSize, capStride, n, &size);
+//   scope_run(&scope, &pool, r, size, size, capStride);  // bins in scope.slots[0]
+//   scope_render_bgra(&scope, panel, panelStride);
+
+#ifndef PICKER_SCOPE_H
+#define PICKER_SCOPE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picker_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCOPE_SSE2 1
+#else
+#define SCOPE_SSE2 0
+#endif
+
+#define SCOPE_LEVELS 256  // luma and chroma levels; each scope is this square
+#define SCOPE_GAP 8       // panel margin and space between the scopes
+#define SCOPE_PANEL_W (2 * SCOPE_LEVELS + 3 * SCOPE_GAP)
+#define SCOPE_PANEL_H (SCOPE_LEVELS + 2 * SCOPE_GAP)
+
+// BT.709 in 8-bit fixed point: Y = (54 R + 183 G + 19 B + 128) >> 8 and
+// C = ((X - Y) * k + 128 * 256 + 128) >> 8. The chroma scales keep every
+// product within int16 (|B - Y| <= 236, |R - Y| <= 202), which the SSE2
+// path relies on, and every result within 0..255.
+#define SCOPE_KR 54
+#define SCOPE_KG 183
+#define SCOPE_KB 19
+#define SCOPE_KCB 138  // 256 / 1.8556
+#define SCOPE_KCR 162  // 256 / 1.5748, rounded down so R - Y = 202 stays in range
+
+typedef struct ScopeBins {
+    uint32_t wave[SCOPE_LEVELS * SCOPE_LEVELS];  // [column][luma]
+    uint32_t vec[SCOPE_LEVELS * SCOPE_LEVELS];   // [255 - Cr][Cb], as drawn
+} ScopeBins;
+
+typedef struct ScopeMap {
+    ScopeBins* slots;        // one per pool participant; slot 0 holds the sums
+    int slotCap;
+    uint8_t* colOf;          // waveform column of each region column
+    int colCap;
+    uint8_t used[POOL_MAX_SLOTS];  // slot took a tile in this run
+    int cols;                // waveform columns in use
+    int width, height;       // region of the last run
+
+    // Set for the duration of a run.
+    const uint8_t* px;
+    int stride;
+
+    // Counters (for --stats).
+    uint64_t runs;
+    uint64_t pixels;
+    uint64_t skipped;        // frames whose capture did not change
+    double totalMs, maxMs;
+} ScopeMap;
+
+static inline int scope_luma(uint32_t b, uint32_t g, uint32_t r) {
+    return (int)((SCOPE_KR * r + SCOPE_KG * g + SCOPE_KB * b + 128) >> 8);
+}
+
+static inline int scope_chroma(int diff, int k) {
+    return (diff * k + 128 * 256 + 128) >> 8;  // the sum is never negative
+}
+
+// Grows the partials to `slots` participants and the column map to a region
+// `width` wide. Returns 0 on failure; nothing is allocated once the sizes
+// have been seen.
+static inline int scope_reserve(ScopeMap* m, int slots, int width) {
+    if (slots > POOL_MAX_SLOTS) slots = POOL_MAX_SLOTS;
+    if (slots > m->slotCap) {
+        ScopeBins* s = (ScopeBins*)realloc(m->slots, (size_t)slots * sizeof(ScopeBins));
+        if (!s) return 0;
+        m->slots = s;
+        m->slotCap = slots;
+    }
+    if (width > m->colCap) {
+        uint8_t* c = (uint8_t*)realloc(m->colOf, (size_t)width);
+        if (!c) return 0;
+        m->colOf = c;
+        m->colCap = width;
+    }
+    return 1;
+}
+
+static inline void scope_free(ScopeMap* m) {
+    free(m->slots);
+    free(m->colOf);
+    memset(m, 0, sizeof(*m));
+}
+
+// Bytes held, for the memory report.
+static inline size_t scope_bytes(const ScopeMap* m) {
+    return (size_t)m->slotCap * sizeof(ScopeBins) + (size_t)m->colCap;
+}
+
+// The centre n x n of a size x size capture square (the whole square when n
+// is 0 or larger); its side is stored in *out.
+static inline const uint8_t* scope_region(const uint8_t* cap, int size, int stride, int n, int* out) {
+    if (n <= 0 || n > size) n = size;
+    int o = (size - n) / 2;
+    *out = n;
+    return cap + (size_t)o * stride + (size_t)o * 4;
+}
+
+// Adds pixels [x0, x1) of one region row into `b`.
+static inline void scope_bin_row_generic(ScopeBins* b, const uint8_t* colOf, const uint8_t* row, int x0, int x1) {
+    const uint32_t* p = (const uint32_t*)row;
+    for (int x = x0; x < x1; x++) {
+        uint32_t v = p[x];
+        uint32_t bl = v & 0xFF, g = (v >> 8) & 0xFF, r = (v >> 16) & 0xFF;
+        int y = scope_luma(bl, g, r);
+        int cb = scope_chroma((int)bl - y, SCOPE_KCB), cr = scope_chroma((int)r - y, SCOPE_KCR);
+        b->wave[colOf[x] * SCOPE_LEVELS + y]++;
+        b->vec[(SCOPE_LEVELS - 1 - cr) * SCOPE_LEVELS + cb]++;
+    }
+}
+
+#if SCOPE_SSE2
+// Chroma of four pixels: (d * k + 32896) >> 8 with d * k in int16. The low
+// half of each 32-bit lane holds the product; shifting it to the top and
+// back sign-extends it.
+static inline __m128i scope_chroma_sse2(__m128i d, __m128i k) {
+    __m128i prod = _mm_srai_epi32(_mm_slli_epi32(_mm_mullo_epi16(d, k), 16), 16);
+    return _mm_srli_epi32(_mm_add_epi32(prod, _mm_set1_epi32(128 * 256 + 128)), 8);
+}
+
+static inline void scope_bin_row_sse2(ScopeBins* b, const uint8_t* colOf, const uint8_t* row, int x0, int x1) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128i kr = _mm_set1_epi32(SCOPE_KR), kg = _mm_set1_epi32(SCOPE_KG), kb = _mm_set1_epi32(SCOPE_KB);
+    const __m128i kcb = _mm_set1_epi32(SCOPE_KCB), kcr = _mm_set1_epi32(SCOPE_KCR);
+    const __m128i round = _mm_set1_epi32(128), top = _mm_set1_epi32(SCOPE_LEVELS - 1);
+    int x = x0;
+    for (; x + 4 <= x1; x += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + (size_t)x * 4));
+        __m128i bl = _mm_and_si128(v, mask);
+        __m128i g = _mm_and_si128(_mm_srli_epi32(v, 8), mask);
+        __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), mask);
+        // Bytes times weights below 256 fit the low 16 bits of each lane.
+        __m128i y = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(r, kr), _mm_mullo_epi16(g, kg)),
+                                  _mm_add_epi32(_mm_mullo_epi16(bl, kb), round));
+        y = _mm_srli_epi32(y, 8);
+        __m128i cb = scope_chroma_sse2(_mm_sub_epi32(bl, y), kcb);
+        __m128i cr = scope_chroma_sse2(_mm_sub_epi32(r, y), kcr);
+        __m128i vi = _mm_or_si128(_mm_slli_epi32(_mm_sub_epi32(top, cr), 8), cb);
+        uint32_t ys[4], vis[4];
+        _mm_storeu_si128((__m128i*)ys, y);
+        _mm_storeu_si128((__m128i*)vis, vi);
+        for (int i = 0; i < 4; i++) {
+            b->wave[colOf[x + i] * SCOPE_LEVELS + ys[i]]++;
+            b->vec[vis[i]]++;
+        }
+    }
+    scope_bin_row_generic(b, colOf, row, x, x1);
+}
+#endif
+
+static inline void scope_bin_row(ScopeBins* b, const uint8_t* colOf, const uint8_t* row, int x0, int x1) {
+#if SCOPE_SSE2
+    scope_bin_row_sse2(b, colOf, row, x0, x1);
+#else
+    scope_bin_row_generic(b, colOf, row, x0, x1);
+#endif
+}
+
+static inline void scope_tile(void* ctx, int slot, int x, int y, int w, int h) {
+    ScopeMap* m = (ScopeMap*)ctx;
+    ScopeBins* b = &m->slots[slot];
+    if (!m->used[slot]) {
+        memset(b, 0, sizeof(*b));
+        m->used[slot] = 1;
+    }
+    for (int j = y; j < y + h; j++) scope_bin_row(b, m->colOf, m->px + (size_t)j * m->stride, x, x + w);
+}
+
+// Bins the w x h BGRA region at `px` into m->slots[0], tile by tile on
+// `pool`. scope_reserve() must have been called for the pool and width.
+static inline void scope_run(ScopeMap* m, WorkerPool* pool, const uint8_t* px, int w, int h, int stride) {
+    int cols = w < SCOPE_LEVELS ? w : SCOPE_LEVELS;
+    if (w != m->width || cols != m->cols) {
+        for (int x = 0; x < w; x++) m->colOf[x] = (uint8_t)((long long)x * cols / w);
+    }
+    m->cols = cols;
+    m->width = w;
+    m->height = h;
+    m->px = px;
+    m->stride = stride;
+    // Partials for fewer participants than the pool has: bin on this thread.
+    int slots = pool_slots(pool) <= m->slotCap ? pool_slots(pool) : 1;
+    memset(m->used, 0, sizeof(m->used));
+    if (slots == 1) {
+        scope_tile(m, 0, 0, 0, w, h);
+    } else {
+        pool_run_tiles(pool, scope_tile, m, w, h, POOL_TILE);
+    }
+    if (!m->used[0]) memset(&m->slots[0], 0, sizeof(ScopeBins));
+    for (int s = 1; s < slots; s++) {
+        if (!m->used[s]) continue;
+        uint32_t* dw = m->slots[0].wave;
+        uint32_t* dv = m->slots[0].vec;
+        const uint32_t* sw = m->slots[s].wave;
+        const uint32_t* sv = m->slots[s].vec;
+        for (int i = 0; i < SCOPE_LEVELS * SCOPE_LEVELS; i++) {
+            dw[i] += sw[i];
+            dv[i] += sv[i];
+        }
+    }
+    m->px = NULL;
+    m->runs++;
+    m->pixels += (uint64_t)w * (uint64_t)h;
+}
+
+// Trace brightness for a bin count: 0 for none, then up one step per
+// doubling.
+static inline uint32_t scope_level(uint32_t count) {
+    if (!count) return 0;
+    uint32_t bits = 0;
+    while (count) {
+        bits++;
+        count >>= 1;
+    }
+    uint32_t v = 72 + 16 * bits;
+    return v > 255 ? 255 : v;
+}
+
+static inline uint32_t scope_grey(uint32_t v) { return 0xFF000000u | (v << 16) | (v << 8) | v; }
+
+// Draws both scopes from m->slots[0] into an opaque SCOPE_PANEL_W x
+// SCOPE_PANEL_H BGRA panel: the waveform on the left (luma up), the
+// vectorscope on the right (Cb across, Cr up).
+static inline void scope_render_bgra(const ScopeMap* m, uint8_t* dst, int stride) {
+    const uint32_t bg = scope_grey(24), grid = scope_grey(56);
+    for (int y = 0; y < SCOPE_PANEL_H; y++) {
+        uint32_t* d = (uint32_t*)(dst + (size_t)y * stride);
+        for (int x = 0; x < SCOPE_PANEL_W; x++) d[x] = bg;
+    }
+    const ScopeBins* b = m->slots;
+    int cols = m->cols > 0 ? m->cols : 1;
+    for (int row = 0; row < SCOPE_LEVELS; row++) {
+        uint32_t* d = (uint32_t*)(dst + (size_t)(SCOPE_GAP + row) * stride) + SCOPE_GAP;
+        uint32_t* v = d + SCOPE_LEVELS + SCOPE_GAP;
+        int luma = SCOPE_LEVELS - 1 - row;
+        // Waveform graticule every quarter of the range; vectorscope axes
+        // through neutral and a ring at full saturation.
+        int waveLine = luma % 64 == 0 || luma == SCOPE_LEVELS - 1;
+        int dy = row - SCOPE_LEVELS / 2;
+        for (int x = 0; x < SCOPE_LEVELS; x++) {
+            uint32_t w = b ? scope_level(b->wave[(x * cols / SCOPE_LEVELS) * SCOPE_LEVELS + luma]) : 0;
+            if (w) {
+                d[x] = 0xFF000000u | ((w / 3) << 16) | (w << 8) | (w / 3);
+            } else if (waveLine) {
+                d[x] = grid;
+            }
+            uint32_t c = b ? scope_level(b->vec[row * SCOPE_LEVELS + x]) : 0;
+            int dx = x - SCOPE_LEVELS / 2, rr = dx * dx + dy * dy;
+            if (c) {
+                v[x] = 0xFF000000u | ((c / 3) << 16) | (c << 8) | (c / 3);
+            } else if (dx == 0 || dy == 0 || (rr >= 126 * 126 && rr < 128 * 128)) {
+                v[x] = grid;
+            }
+        }
+    }
+}
+
+// Counts one scope frame's cost (binning and drawing), for --stats.
+static inline void scope_count_ms(ScopeMap* m, double ms) {
+    m->totalMs += ms;
+    if (ms > m->maxMs) m->maxMs = ms;
+}
+
+static inline void scope_report(const ScopeMap* m, FILE* fp) {
+    if (!m->runs && !m->skipped) return;
+    fprintf(fp, "scope: %llu runs over %.0f px each, %llu frames unchanged, %.3f ms mean, %.3f ms max\n",
+            (unsigned long long)m->runs, m->runs ? (double)m->pixels / (double)m->runs : 0.0,
+            (unsigned long long)m->skipped, m->runs ? m->totalMs / (double)m->runs : 0.0, m->maxMs);
+}
+
+#endif // PICKER_SCOPE_H
@@ -0,0 +1,229 @@
+// Minimal Color Picker - optional Chrome trace-event recorder (header-only).
+//
+// Each thread that emits an event gets its own fixed-size ring of events. Only
+// the owning thread writes to its ring, so recording is a timestamp read plus a
+// store (no locks, no allocation after the first event on that thread). When a
+// ring is full the oldest events are overwritten, which keeps the most recent
+// window around for intermittent stutter reports.
+//
+// trace_dump_json() writes {"traceEvents":[...]} which loads in Perfetto or
+// chrome://tracing. Call it once at exit, after other threads stopped emitting.
+//
+// Usage:
+//   trace_enable(0);                 // 0 = default ring size
+//   trace_thread_name("ui");
+//   trace_begin("frame"); ... trace_end("frame");
+//   trace_dump_json(fp);
+
+#ifndef PICKER_TRACE_H
+#define PICKER_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER)
+#define TRACE_TLS __declspec(thread)
+#else
+#define TRACE_TLS __thread
+#endif
+
+#define TRACE_MAX_THREADS 32
+#define TRACE_DEFAULT_EVENTS (1u << 16)  // per thread; 1.5 MB at 24 bytes/event
+
+typedef struct TraceEvent {
+    const char* name;   // must point to a string literal (not copied)
+    uint64_t ticks;
+    char phase;         // 'B', 'E' or 'i'
+} TraceEvent;
+
+typedef struct TraceRing {
+    TraceEvent* events;
+    uint32_t mask;           // capacity - 1 (capacity is a power of two)
+    volatile uint64_t head;  // total events written by the owner thread
+    const char* thread_name;
+    int tid;
+} TraceRing;
+
+static int g_trace_enabled;
+static uint32_t g_trace_capacity = TRACE_DEFAULT_EVENTS;
+static TraceRing* volatile g_trace_rings[TRACE_MAX_THREADS];
+static volatile long g_trace_ring_count;
+static TRACE_TLS TraceRing* t_trace_ring;
+static TRACE_TLS int t_trace_full;  // this thread found no free ring slot
+
+static inline uint64_t trace_now_ticks(void) {
+#ifdef _WIN32
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return (uint64_t)t.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline double trace_ticks_per_us(void) {
+#ifdef _WIN32
+    LARGE_INTEGER f;
+    QueryPerformanceFrequency(&f);
+    return (double)f.QuadPart / 1e6;
+#else
+    return 1000.0;
+#endif
+}
+
+static inline long trace_atomic_inc(volatile long* v) {
+#ifdef _WIN32
+    return InterlockedIncrement(v);
+#else
+    return __atomic_add_fetch(v, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+// Enables recording. `events_per_thread` is rounded up to a power of two.
+static inline void trace_enable(uint32_t events_per_thread) {
+    if (events_per_thread) {
+        uint32_t cap = 256;
+        while (cap < events_per_thread && cap < (1u << 24)) cap <<= 1;
+        g_trace_capacity = cap;
+    }
+    g_trace_enabled = 1;
+}
+
+static inline TraceRing* trace_register_thread(void) {
+    if (t_trace_full) return NULL;
+
+    long slot = trace_atomic_inc(&g_trace_ring_count) - 1;
+    if (slot >= TRACE_MAX_THREADS) {
+        t_trace_full = 1;
+        return NULL;
+    }
+
+    TraceRing* ring = (TraceRing*)calloc(1, sizeof(TraceRing));
+    TraceEvent* events = (TraceEvent*)malloc(sizeof(TraceEvent) * g_trace_capacity);
+    if (!ring || !events) {
+        free(ring);
+        free(events);
+        t_trace_full = 1;
+        return NULL;
+    }
+    ring->events = events;
+    ring->mask = g_trace_capacity - 1;
+    ring->tid = (int)slot + 1;
+    t_trace_ring = ring;
+    g_trace_rings[slot] = ring;
+    return ring;
+}
+
+static inline void trace_emit(const char* name, char phase) {
+    if (!g_trace_enabled) return;
+    TraceRing* ring = t_trace_ring;
+    if (!ring && !(ring = trace_register_thread())) return;
+
+    uint64_t h = ring->head;
+    TraceEvent* e = &ring->events[h & ring->mask];
+    e->name = name;
+    e->ticks = trace_now_ticks();
+    e->phase = phase;
+    ring->head = h + 1;
+}
+
+static inline void trace_begin(const char* name) { trace_emit(name, 'B'); }
+static inline void trace_end(const char* name) { trace_emit(name, 'E'); }
+static inline void trace_instant(const char* name) { trace_emit(name, 'i'); }
+
+// Names the calling thread in the trace viewer. `name` must be a string literal.
+static inline void trace_thread_name(const char* name) {
+    if (!g_trace_enabled) return;
+    TraceRing* ring = t_trace_ring;
+    if (!ring && !(ring = trace_register_thread())) return;
+    ring->thread_name = name;
+}
+
+// Largest ring size (events per thread, a power of two, at least 256) whose
+// events fit in `bytes`; for sizing history under a memory cap.
+static inline uint32_t trace_events_for_bytes(size_t bytes) {
+    uint32_t cap = 256;
+    while (cap < TRACE_DEFAULT_EVENTS && (size_t)cap * 2 * sizeof(TraceEvent) <= bytes) cap <<= 1;
+    return cap;
+}
+
+// Bytes held by the rings registered so far (for memory accounting).
+static inline size_t trace_bytes(void) {
+    long count = g_trace_ring_count;
+    if (count > TRACE_MAX_THREADS) count = TRACE_MAX_THREADS;
+    size_t total = 0;
+    for (long i = 0; i < count; i++) {
+        if (g_trace_rings[i]) total += sizeof(TraceRing) + sizeof(TraceEvent) * ((size_t)g_trace_rings[i]->mask + 1);
+    }
+    return total;
+}
+
+static inline void trace_dump_json(FILE* fp) {
+    if (!fp) return;
+
+    long count = g_trace_ring_count;
+    if (count > TRACE_MAX_THREADS) count = TRACE_MAX_THREADS;
+
+    // Timestamps are relative to the oldest retained event so they stay small.
+    uint64_t base = UINT64_MAX;
+    for (long i = 0; i < count; i++) {
+        TraceRing* ring = g_trace_rings[i];
+        if (!ring || ring->head == 0) continue;
+        uint64_t cap = (uint64_t)ring->mask + 1;
+        uint64_t first = ring->head > cap ? ring->head - cap : 0;
+        uint64_t t = ring->events[first & ring->mask].ticks;
+        if (t < base) base = t;
+    }
+    if (base == UINT64_MAX) base = 0;
+
+    double per_us = trace_ticks_per_us();
+    int first_record = 1;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (long i = 0; i < count; i++) {
+        TraceRing* ring = g_trace_rings[i];
+        if (!ring) continue;
+
+        if (ring->thread_name) {
+            fprintf(fp, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                    first_record ? "" : ",\n", ring->tid, ring->thread_name);
+            first_record = 0;
+        }
+
+        uint64_t cap = (uint64_t)ring->mask + 1;
+        uint64_t head = ring->head;
+        uint64_t first = head > cap ? head - cap : 0;
+        int depth = 0;
+
+        for (uint64_t j = first; j < head; j++) {
+            const TraceEvent* e = &ring->events[j & ring->mask];
+            // After a wrap the ring may start mid-slice; drop unmatched ends.
+            if (e->phase == 'E') {
+                if (depth == 0) continue;
+                depth--;
+            } else if (e->phase == 'B') {
+                depth++;
+            }
+            double ts = (double)(e->ticks - base) / per_us;
+            fprintf(fp, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"name\":\"%s\"%s}",
+                    first_record ? "" : ",\n", e->phase, ring->tid, ts, e->name,
+                    e->phase == 'i' ? ",\"s\":\"t\"" : "");
+            first_record = 0;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+}
+
+#endif // PICKER_TRACE_H
@@ -0,0 +1,356 @@
+// Minimal Color Picker - pixel watchpoints (header-only, C99).
+//
+// Watch mode samples a list of screen points at a fixed rate and reports
+// each point whose colour moved more than `tol` per channel (B, G or R) from
+// the colour last reported for it, as status lights and dashboards change.
+//
+// A round trip to the display server (or a BitBlt) per point would make the
+// cost grow with the points, so watch_plan() clusters them into regions
+// once, up front. Points are binned into WATCH_CELL squares; each cell's
+// points give a bounding rectangle. Rectangles next to each other in a row of
+// cells, then in a column, are merged while the merge copies at most
+// `grabCost` pixels more than the two apart, the rule region_plan() uses for
+// loupes. A dense panel becomes one grab and distant lights stay apart. The
+// regions are packed back to back in one buffer, each with rows of its own
+// width (an X image can be pointed anywhere), or stacked one under another
+// at the widest region's stride (a DIB has one stride). Each point keeps the
+// index of its pixel in the buffer, ordered so the check walks it forwards.
+//
+// watch_check() gathers four points' pixels into an SSE2 register and
+// compares them with their reference colours: the saturating absolute
+// difference, less the tolerance, must be zero in every colour byte. That is
+// a few instructions per point against one grab per region, so a tick costs
+// about what its regions cost to grab. The portable version finds the same
+// changes.
+//
+//   watch_plan(&ws, xs, ys, n, WATCH_CELL, REGION_GRAB_COST, stacked);   // 0 on failure
+//   each tick: copy ws.regions[r] to buf + ws.offset[r] * 4, rows
+//              ws.stride (or its width when packed) apart, for every r
+//              int changed = watch_check(&ws, buf, tol);         // ws.events[0..changed)
+
+#ifndef PICKER_WATCH_H
+#define PICKER_WATCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "picker_kernels.h"
+#include "picker_regions.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WATCH_SSE2 1
+#else
+#define WATCH_SSE2 0
+#endif
+
+#define WATCH_CELL 64  // clustering grid, in screen pixels
+
+typedef struct WatchEvent {
+    int point;          // index into x, y
+    uint32_t from, to;  // colour last reported, colour now
+} WatchEvent;
+
+typedef struct WatchSet {
+    int count;            // points
+    int* x;               // point positions, in buffer order
+    int* y;
+    uint32_t* index;      // each point's pixel in the packed buffer
+    uint32_t* ref;        // each point's last reported colour
+    WatchEvent* events;   // this tick's changes, room for every point
+    int regionCount;
+    RegionRect* regions;
+    size_t* offset;       // first pixel of each region in the packed buffer
+    size_t pixels;        // buffer size
+    int stride;           // stacked: row stride of the buffer; packed: 0
+    int baseline;         // ref holds a sample
+    uint64_t ticks, changes;
+    double grabMs, checkMs, maxCheckMs;
+} WatchSet;
+
+// One clustering cell or merged rectangle.
+typedef struct WatchBox {
+    RegionRect r;
+    int lane;  // cell row, then cell column, of the merge pass
+    int pos;   // order along the lane: x, then y
+} WatchBox;
+
+typedef struct WatchKey {
+    int cy, cx, y, x;
+    int point;
+    uint32_t index;  // pixel in the packed buffer, once planned
+} WatchKey;
+
+static int watch_key_cmp(const void* a, const void* b) {
+    const WatchKey* p = (const WatchKey*)a;
+    const WatchKey* q = (const WatchKey*)b;
+    if (p->cy != q->cy) return p->cy < q->cy ? -1 : 1;
+    if (p->cx != q->cx) return p->cx < q->cx ? -1 : 1;
+    if (p->y != q->y) return p->y < q->y ? -1 : 1;
+    if (p->x != q->x) return p->x < q->x ? -1 : 1;
+    return 0;
+}
+
+static int watch_box_cmp(const void* a, const void* b) {
+    const WatchBox* p = (const WatchBox*)a;
+    const WatchBox* q = (const WatchBox*)b;
+    if (p->lane != q->lane) return p->lane < q->lane ? -1 : 1;
+    if (p->pos != q->pos) return p->pos < q->pos ? -1 : 1;
+    return 0;
+}
+
+static int watch_index_cmp(const void* a, const void* b) {
+    const WatchKey* p = (const WatchKey*)a;
+    const WatchKey* q = (const WatchKey*)b;
+    return p->index < q->index ? -1 : (p->index > q->index ? 1 : 0);
+}
+
+// Sorts the boxes by lane and merges neighbours in a lane while the merge
+// adds at most grabCost pixels over the two apart. Returns the boxes left.
+static inline int watch_merge_lanes(WatchBox* b, int n, int64_t grabCost) {
+    qsort(b, (size_t)n, sizeof(*b), watch_box_cmp);
+    int out = 0;
+    for (int i = 0; i < n; i++) {
+        if (out > 0 && b[out - 1].lane == b[i].lane) {
+            RegionRect u = region_bounds(b[out - 1].r, b[i].r);
+            if (region_area(u) - region_area(b[out - 1].r) - region_area(b[i].r) <= grabCost) {
+                b[out - 1].r = u;
+                continue;
+            }
+        }
+        b[out++] = b[i];
+    }
+    return out;
+}
+
+static inline void watch_free(WatchSet* ws) {
+    free(ws->x);
+    free(ws->y);
+    free(ws->index);
+    free(ws->ref);
+    free(ws->events);
+    free(ws->regions);
+    free(ws->offset);
+    memset(ws, 0, sizeof(*ws));
+}
+
+// Bytes held, for the memory report (the packed buffer is the caller's).
+static inline size_t watch_bytes(const WatchSet* ws) {
+    return (size_t)ws->count * (2 * sizeof(int) + 2 * sizeof(uint32_t) + sizeof(WatchEvent)) +
+           (size_t)ws->regionCount * (sizeof(RegionRect) + sizeof(size_t));
+}
+
+// Clusters `n` points (non-negative, on one screen) into regions, packed or
+// stacked in the buffer. Returns 0 when out of memory.
+static inline int watch_plan(WatchSet* ws, const int* xs, const int* ys, int n, int cell, int64_t grabCost,
+                             int stacked) {
+    watch_free(ws);
+    if (n <= 0) return 1;
+    WatchKey* keys = (WatchKey*)malloc((size_t)n * sizeof(*keys));
+    WatchBox* boxes = (WatchBox*)malloc((size_t)n * sizeof(*boxes));
+    ws->x = (int*)malloc((size_t)n * sizeof(int));
+    ws->y = (int*)malloc((size_t)n * sizeof(int));
+    ws->index = (uint32_t*)malloc((size_t)n * sizeof(uint32_t));
+    ws->ref = (uint32_t*)calloc((size_t)n, sizeof(uint32_t));
+    ws->events = (WatchEvent*)malloc((size_t)n * sizeof(WatchEvent));
+    if (!keys || !boxes || !ws->x || !ws->y || !ws->index || !ws->ref || !ws->events) {
+        free(keys);
+        free(boxes);
+        watch_free(ws);
+        return 0;
+    }
+    ws->count = n;
+    for (int i = 0; i < n; i++) {
+        keys[i].cy = ys[i] / cell;
+        keys[i].cx = xs[i] / cell;
+        keys[i].y = ys[i];
+        keys[i].x = xs[i];
+        keys[i].point = i;
+    }
+    qsort(keys, (size_t)n, sizeof(*keys), watch_key_cmp);
+
+    // One box per occupied cell, laned by cell row.
+    int nb = 0;
+    for (int i = 0; i < n; i++) {
+        RegionRect p = { keys[i].x, keys[i].y, 1, 1 };
+        if (nb > 0 && i > 0 && keys[i].cy == keys[i - 1].cy && keys[i].cx == keys[i - 1].cx) {
+            boxes[nb - 1].r = region_bounds(boxes[nb - 1].r, p);
+        } else {
+            boxes[nb].r = p;
+            boxes[nb].lane = keys[i].cy;
+            boxes[nb].pos = keys[i].x;
+            nb++;
+        }
+    }
+    nb = watch_merge_lanes(boxes, nb, grabCost);
+    for (int i = 0; i < nb; i++) {
+        boxes[i].lane = boxes[i].r.x / cell;
+        boxes[i].pos = boxes[i].r.y;
+    }
+    nb = watch_merge_lanes(boxes, nb, grabCost);
+
+    ws->regions = (RegionRect*)malloc((size_t)nb * sizeof(RegionRect));
+    ws->offset = (size_t*)malloc((size_t)nb * sizeof(size_t));
+    if (!ws->regions || !ws->offset) {
+        free(keys);
+        free(boxes);
+        watch_free(ws);
+        return 0;
+    }
+    ws->regionCount = nb;
+    ws->stride = 0;
+    for (int r = 0; stacked && r < nb; r++) {
+        if (boxes[r].r.w > ws->stride) ws->stride = boxes[r].r.w;
+    }
+    ws->pixels = 0;
+    for (int r = 0; r < nb; r++) {
+        ws->regions[r] = boxes[r].r;
+        ws->offset[r] = ws->pixels;
+        ws->pixels += (size_t)(stacked ? ws->stride : boxes[r].r.w) * (size_t)boxes[r].r.h;
+    }
+
+    // Each point reads from a region holding it: usually the previous
+    // point's, as they are still in cell order. Regions can overlap where a
+    // merged rectangle grew over another; any of them will do.
+    int r = 0;
+    for (int i = 0; i < n; i++) {
+        int px = keys[i].x, py = keys[i].y;
+        const RegionRect* g = &ws->regions[r];
+        if (px < g->x || py < g->y || px >= g->x + g->w || py >= g->y + g->h) {
+            r = 0;
+            for (g = ws->regions; px < g->x || py < g->y || px >= g->x + g->w || py >= g->y + g->h; g++) r++;
+        }
+        size_t rowPixels = (size_t)(ws->stride ? ws->stride : g->w);
+        keys[i].index = (uint32_t)(ws->offset[r] + (size_t)(py - g->y) * rowPixels + (size_t)(px - g->x));
+    }
+    qsort(keys, (size_t)n, sizeof(*keys), watch_index_cmp);
+    for (int i = 0; i < n; i++) {
+        ws->index[i] = keys[i].index;
+        ws->x[i] = keys[i].x;
+        ws->y[i] = keys[i].y;
+    }
+    free(keys);
+    free(boxes);
+    return 1;
+}
+
+static inline int watch_differs(uint32_t p, uint32_t ref, int tol) {
+    for (int s = 0; s < 24; s += 8) {
+        int d = (int)((p >> s) & 0xFF) - (int)((ref >> s) & 0xFF);
+        if (d > tol || -d > tol) return 1;
+    }
+    return 0;
+}
+
+// Records the event for point i and makes its colour the new reference.
+static inline int watch_record(WatchSet* ws, int n, int i, uint32_t c) {
+    WatchEvent* e = &ws->events[n];
+    e->point = i;
+    e->from = ws->ref[i];
+    e->to = c;
+    ws->ref[i] = c;
+    return n + 1;
+}
+
+// The first call records every point's colour and reports nothing.
+static inline int watch_baseline(WatchSet* ws, const uint32_t* px) {
+    for (int i = 0; i < ws->count; i++) ws->ref[i] = px[ws->index[i]] | 0xFF000000u;
+    ws->baseline = 1;
+    return 0;
+}
+
+static inline int watch_check_generic(WatchSet* ws, const uint8_t* buf, int tol) {
+    const uint32_t* px = (const uint32_t*)buf;
+    if (!ws->baseline) return watch_baseline(ws, px);
+    int n = 0;
+    for (int i = 0; i < ws->count; i++) {
+        uint32_t c = px[ws->index[i]] | 0xFF000000u;
+        if (watch_differs(c, ws->ref[i], tol)) n = watch_record(ws, n, i, c);
+    }
+    ws->changes += (uint64_t)n;
+    return n;
+}
+
+#if WATCH_SSE2
+static inline int watch_check_sse2(WatchSet* ws, const uint8_t* buf, int tol) {
+    const uint32_t* px = (const uint32_t*)buf;
+    if (!ws->baseline) return watch_baseline(ws, px);
+    uint32_t t = (uint32_t)(tol > 255 ? 255 : tol);
+    // Alpha always passes.
+    const __m128i kTol = _mm_set1_epi32((int)(0xFF000000u | (t << 16) | (t << 8) | t));
+    const __m128i kAlpha = _mm_set1_epi32((int)0xFF000000u);
+    const __m128i zero = _mm_setzero_si128();
+    const uint32_t* idx = ws->index;
+    int n = 0, i = 0;
+    for (; i + 4 <= ws->count; i += 4) {
+        __m128i p = _mm_or_si128(_mm_set_epi32((int)px[idx[i + 3]], (int)px[idx[i + 2]], (int)px[idx[i + 1]],
+                                               (int)px[idx[i]]),
+                                 kAlpha);
+        __m128i r = _mm_loadu_si128((const __m128i*)(ws->ref + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(p, r), _mm_subs_epu8(r, p));
+        int m = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_subs_epu8(d, kTol), zero))) & 0xF;
+        while (m) {
+            int b = 0;
+            while (!(m & (1 << b))) b++;
+            m &= m - 1;
+            n = watch_record(ws, n, i + b, px[idx[i + b]] | 0xFF000000u);
+        }
+    }
+    for (; i < ws->count; i++) {
+        uint32_t c = px[idx[i]] | 0xFF000000u;
+        if (watch_differs(c, ws->ref[i], tol)) n = watch_record(ws, n, i, c);
+    }
+    ws->changes += (uint64_t)n;
+    return n;
+}
+#endif
+
+// Compares every point of the packed buffer `buf` with its reference colour
+// and returns how many changed; their events are ws->events[0..n).
+static inline int watch_check(WatchSet* ws, const uint8_t* buf, int tol) {
+#if WATCH_SSE2
+    return watch_check_sse2(ws, buf, tol);
+#else
+    return watch_check_generic(ws, buf, tol);
+#endif
+}
+
+static inline void watch_count_ms(WatchSet* ws, double grabMs, double checkMs) {
+    ws->ticks++;
+    ws->grabMs += grabMs;
+    ws->checkMs += checkMs;
+    if (checkMs > ws->maxCheckMs) ws->maxCheckMs = checkMs;
+}
+
+// One line per line of a points file: "x,y" or "x y". Returns 0 for blank
+// lines, comments (#) and anything else.
+static inline int watch_parse_point(const char* line, int* x, int* y) {
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line == '#') return 0;
+    char sep[2];
+    if (sscanf(line, "%d ,%d", x, y) == 2) return 1;
+    if (sscanf(line, "%d%1[ \t]%d", x, sep, y) == 3) return 1;
+    return 0;
+}
+
+// "change X,Y #RRGGBB -> #RRGGBB t=S", with the point moved by (ox, oy).
+static inline void watch_format_event(const WatchSet* ws, const WatchEvent* e, int ox, int oy, double tMs, char* buf,
+                                      size_t size) {
+    char from[8], to[8];
+    format_hex_color(e->from, from);
+    format_hex_color(e->to, to);
+    snprintf(buf, size, "change %d,%d %s -> %s t=%.3f", ws->x[e->point] + ox, ws->y[e->point] + oy, from, to,
+             tMs / 1000.0);
+}
+
+static inline void watch_report(const WatchSet* ws, FILE* fp) {
+    if (!ws->ticks) return;
+    fprintf(fp, "watch: %d points in %d regions (%llu px), %llu ticks, %llu changes, grab %.3f ms mean, "
+                "check %.3f ms mean, %.3f ms max\n",
+            ws->count, ws->regionCount, (unsigned long long)ws->pixels, (unsigned long long)ws->ticks, (unsigned long long)ws->changes,
+            ws->grabMs / (double)ws->ticks, ws->checkMs / (double)ws->ticks, ws->maxCheckMs);
+}
+
+#endif // PICKER_WATCH_H
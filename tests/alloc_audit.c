@@ -0,0 +1,81 @@
+// Minimal Color Picker - steady-state allocation audit (headless).
+// Build/run: make test
+//
+// Drives the platform-independent part of a frame (edge-shifted capture,
+// compose, giant-loupe compose on the worker pool, hash, pick sampling, hex
+// conversion, trace recording) with the
+// counting allocator from picker_alloc_audit.h interposed, and fails if any
+// frame after warm-up calls malloc/free. The X11 picker runs the same audit
+// against a real display when built with -DALLOC_AUDIT.
+
+#define _POSIX_C_SOURCE 200809L
+#define ALLOC_AUDIT 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_alloc_audit.h"
+#include "../picker_kernels.h"
+#include "../picker_pool.h"
+#include "../picker_trace.h"
+
+static const int kRadius = 120;
+static const int kZoom = 8;
+static const int kGiantRadius = 512;     // several bands, so the pool really runs
+static const int kFrames = 600;
+
+static volatile uint64_t g_sink;
+
+int main(void) {
+    // The interposer must see our own calls, or a pass means nothing.
+    long before = alloc_audit_allocs();
+    void* probe = malloc(64);
+    if (alloc_audit_allocs() == before) {
+        fprintf(stderr, "allocator interposition is not active\n");
+        return 1;
+    }
+    free(probe);
+
+    int d = kRadius * 2;
+    int capSize = (d / kZoom) | 1;
+    uint8_t* cap = (uint8_t*)malloc((size_t)capSize * capSize * 4);
+    uint8_t* out = (uint8_t*)malloc((size_t)d * d * 4);
+    int gd = kGiantRadius * 2;
+    uint8_t* giant = (uint8_t*)malloc((size_t)gd * gd * 4);
+    if (!cap || !out || !giant) return 1;
+
+    trace_enable(1024);
+    trace_thread_name("audit");
+    // Workers start (and register their trace rings) before the first frame.
+    WorkerPool pool;
+    pool_init(&pool, 2);
+
+    for (int f = 0; f < kFrames; f++) {
+        trace_begin("frame");
+
+        // Synthetic capture, sometimes at a screen edge.
+        for (int i = 0; i < capSize * capSize * 4; i++) cap[i] = (uint8_t)(i * 7 + f);
+        int edge = f % 5;
+        shift_bgra(cap, capSize, capSize, capSize * 4, edge == 1 ? -edge * 3 : 0, edge == 2 ? edge * 2 : 0);
+
+        compose_loupe(cap, capSize, capSize * 4, out, kRadius, d * 4, 2, 1, 6);
+        if (f % 4 == 0) compose_loupe_tiled(&pool, cap, capSize, capSize * 4, giant, kGiantRadius, gd * 4, 2, 1, 6);
+        g_sink += hash_bgra(cap, capSize, capSize, capSize * 4);
+
+        char hex[8];
+        uint32_t c = sample_average_bgra(cap, capSize, capSize, capSize * 4, capSize / 2, capSize / 2, 0);
+        format_hex_color(c, hex);
+        g_sink += (uint8_t)hex[1];
+
+        trace_end("frame");
+        alloc_audit_frame();
+    }
+
+    pool_destroy(&pool);
+    free(cap);
+    free(out);
+    free(giant);
+    return alloc_audit_report(stdout) ? 1 : 0;
+}
@@ -0,0 +1,288 @@
+// Minimal Color Picker - block-hash change detection tests.
+// Build/run: make test
+//
+// The SSE2 block hash must equal the portable one bit for bit, for full and
+// edge blocks; flipping any single bit of a block must change its hash.
+// damage_update() must flag every block on the first update and after a
+// resize, none on an unchanged region, and exactly the block holding a
+// changed pixel, with matching pixel bounds. The flash diagnostic must tint
+// only the loupe pixels scaled from changed blocks, keep them valid
+// premultiplied BGRA, and fade out after DAMAGE_FLASH_FRAMES frames.
+// compose_loupe_rect() over any partition of the loupe must reproduce
+// compose_loupe(), and damage_compose_loupe() must turn the previous frame's
+// loupe into exactly the full compose of the new capture, touching nothing
+// outside the dirty rectangle it returns.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_damage.h"
+#include "../picker_kernels.h"
+#include "test_util.h"
+
+static uint8_t* noise(size_t bytes, uint32_t seed) {
+    uint8_t* px = (uint8_t*)malloc(bytes);
+    uint32_t s = seed * 2654435761u + 1;
+    for (size_t i = 0; px && i < bytes; i++) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        px[i] = (uint8_t)s;
+    }
+    return px;
+}
+
+static void test_hash(void) {
+    enum { W = 40, H = 40 };
+    uint8_t* px = noise((size_t)W * H * 4, 1);
+    if (!px) {
+        g_failures++;
+        return;
+    }
+    int stride = W * 4;
+    int bad = 0;
+    for (int h = 1; h <= DAMAGE_BLOCK; h++) {
+        for (int w = 1; w <= DAMAGE_BLOCK; w++) {
+            const uint8_t* b = px + (size_t)(h % 7) * stride + (size_t)(w % 5) * 4;
+            bad += block_hash_bgra(b, w, h, stride) != block_hash_bgra_generic(b, w, h, stride);
+        }
+    }
+    CHECK(bad == 0);
+
+    // Any one bit of a full block: the hash changes. Pixels next to the block
+    // are not part of it.
+    uint64_t h0 = block_hash_bgra(px, DAMAGE_BLOCK, DAMAGE_BLOCK, stride);
+    int same = 0;
+    for (int y = 0; y < DAMAGE_BLOCK; y++) {
+        for (int i = 0; i < DAMAGE_BLOCK * 4; i++) {
+            uint8_t* p = px + (size_t)y * stride + i;
+            for (int bit = 0; bit < 8; bit++) {
+                *p ^= (uint8_t)(1 << bit);
+                same += block_hash_bgra(px, DAMAGE_BLOCK, DAMAGE_BLOCK, stride) == h0;
+                *p ^= (uint8_t)(1 << bit);
+            }
+        }
+    }
+    CHECK(same == 0);
+    px[DAMAGE_BLOCK * 4] ^= 0xFF;
+    px[(size_t)DAMAGE_BLOCK * stride] ^= 0xFF;
+    CHECK(block_hash_bgra(px, DAMAGE_BLOCK, DAMAGE_BLOCK, stride) == h0);
+
+    // A flat block and the same block one pixel narrower differ.
+    memset(px, 0, (size_t)W * H * 4);
+    CHECK(block_hash_bgra(px, 16, 16, stride) != block_hash_bgra(px, 15, 16, stride));
+    free(px);
+}
+
+static void test_update(void) {
+    enum { S = 61 };  // four blocks across, the last 13 px wide
+    int stride = S * 4;
+    uint8_t* px = noise((size_t)S * S * 4, 2);
+    DamageMap m;
+    memset(&m, 0, sizeof(m));
+    CHECK(px && damage_reserve(&m, S, S));
+    if (!px || !m.hash) {
+        free(px);
+        return;
+    }
+    CHECK(damage_update(&m, px, S, S, stride) == 16);
+    CHECK(m.cols == 4 && m.rows == 4);
+    CHECK(m.x0 == 0 && m.y0 == 0 && m.x1 == S && m.y1 == S);
+    uint64_t frame = m.frameHash;
+
+    CHECK(damage_update(&m, px, S, S, stride) == 0);
+    CHECK(m.frameHash == frame && m.x0 >= m.x1);
+    CHECK(m.stillUpdates == 1);
+
+    // One pixel in the bottom-right edge block, then one in block (1, 2).
+    px[((size_t)60 * S + 50) * 4 + 2] ^= 0x01;
+    CHECK(damage_update(&m, px, S, S, stride) == 1);
+    CHECK(m.changed[15] == 1 && m.frameHash != frame);
+    CHECK(m.x0 == 48 && m.y0 == 48 && m.x1 == S && m.y1 == S);
+    px[((size_t)40 * S + 17) * 4] ^= 0x80;
+    CHECK(damage_update(&m, px, S, S, stride) == 1);
+    CHECK(m.changed[2 * 4 + 1] == 1 && m.changed[15] == 0);
+    CHECK(m.x0 == 16 && m.y0 == 32 && m.x1 == 32 && m.y1 == 48);
+
+    // A smaller square (a wheel notch) counts as all new.
+    CHECK(damage_update(&m, px, 31, 31, stride) == 4);
+    CHECK(damage_update(&m, px, 31, 31, stride) == 0);
+    CHECK(m.updates == 6 && m.blocksChanged == 16 + 1 + 1 + 4);
+
+    // Reserving a larger region keeps working and starts over.
+    CHECK(damage_reserve(&m, 1000, 1000));
+    CHECK(damage_update(&m, px, 31, 31, stride) == 4);
+    damage_free(&m);
+    free(px);
+}
+
+static void test_flash(void) {
+    enum { S = 31, D = 240 };
+    uint8_t* cap = noise((size_t)S * S * 4, 3);
+    uint8_t* loupe = (uint8_t*)malloc((size_t)D * D * 4);
+    uint8_t* plain = (uint8_t*)malloc((size_t)D * D * 4);
+    DamageMap m;
+    memset(&m, 0, sizeof(m));
+    CHECK(cap && loupe && plain && damage_reserve(&m, S, S));
+    if (!cap || !loupe || !plain || !m.hash) {
+        free(cap);
+        free(loupe);
+        free(plain);
+        return;
+    }
+    scale_nearest_bgra(cap, S, S, S * 4, plain, D, D, D * 4);
+    apply_circle_alpha_mask(plain, D / 2, D * 4);
+    damage_update(&m, cap, S, S, S * 4);
+    damage_update(&m, cap, S, S, S * 4);
+    // Fade the first update's flash away, then change block (1, 0): source
+    // columns 16..30 and rows 0..15.
+    for (int i = 0; i < DAMAGE_FLASH_FRAMES; i++) {
+        memcpy(loupe, plain, (size_t)D * D * 4);
+        damage_flash_bgra(&m, loupe, D, D, D * 4);
+    }
+    memcpy(loupe, plain, (size_t)D * D * 4);
+    damage_flash_bgra(&m, loupe, D, D, D * 4);
+    CHECK(memcmp(loupe, plain, (size_t)D * D * 4) == 0);
+
+    cap[(size_t)(20) * 4] ^= 0x40;
+    CHECK(damage_update(&m, cap, S, S, S * 4) == 1);
+    memcpy(loupe, plain, (size_t)D * D * 4);
+    damage_flash_bgra(&m, loupe, D, D, D * 4);
+    int x0 = (16 * D + S - 1) / S, y1 = (16 * D + S - 1) / S;
+    int outside = 0, inside = 0, invalid = 0;
+    for (int y = 0; y < D; y++) {
+        for (int x = 0; x < D; x++) {
+            uint32_t a = ((const uint32_t*)plain)[y * D + x];
+            uint32_t b = ((const uint32_t*)loupe)[y * D + x];
+            int in = x >= x0 && y < y1;
+            if (!in) outside += a != b;
+            if (in && (a >> 24) == 255) inside += a != b;
+            uint32_t al = b >> 24;
+            invalid += ((b >> 16) & 0xFF) > al || ((b >> 8) & 0xFF) > al || (b & 0xFF) > al || (b >> 24) != (a >> 24);
+        }
+    }
+    CHECK(outside == 0 && invalid == 0);
+    CHECK(inside > 0);
+
+    // The tint fades over DAMAGE_FLASH_FRAMES frames and is then gone.
+    for (int i = 1; i < DAMAGE_FLASH_FRAMES; i++) damage_flash_bgra(&m, loupe, D, D, D * 4);
+    memcpy(loupe, plain, (size_t)D * D * 4);
+    damage_flash_bgra(&m, loupe, D, D, D * 4);
+    CHECK(memcmp(loupe, plain, (size_t)D * D * 4) == 0);
+    damage_free(&m);
+    free(cap);
+    free(loupe);
+    free(plain);
+}
+
+static int compose_rect_partition_matches(int radius, int capSize, int antialias) {
+    int d = radius * 2;
+    uint8_t* cap = noise((size_t)capSize * capSize * 4, (uint32_t)(radius + capSize));
+    uint8_t* other = noise((size_t)capSize * capSize * 4, 77);
+    uint8_t* want = (uint8_t*)malloc((size_t)d * d * 4);
+    uint8_t* got = (uint8_t*)malloc((size_t)d * d * 4);
+    int ok = cap && other && want && got;
+    if (ok) {
+        compose_loupe(cap, capSize, capSize * 4, want, radius, d * 4, 2, antialias, 6);
+        compose_loupe(other, capSize, capSize * 4, got, radius, d * 4, 2, antialias, 6);
+        // Uneven columns and rows, some one pixel wide.
+        uint32_t s = (uint32_t)d;
+        for (int y = 0; y < d;) {
+            s = s * 1103515245u + 12345u;
+            int y1 = y + 1 + (int)((s >> 16) % 37);
+            for (int x = 0; x < d;) {
+                s = s * 1103515245u + 12345u;
+                int x1 = x + 1 + (int)((s >> 16) % 53);
+                compose_loupe_rect(cap, capSize, capSize * 4, got, radius, d * 4, 2, antialias, 6, x, y, x1, y1);
+                x = x1;
+            }
+            y = y1;
+        }
+        ok = memcmp(want, got, (size_t)d * d * 4) == 0;
+    }
+    free(cap);
+    free(other);
+    free(want);
+    free(got);
+    return ok;
+}
+
+static void test_compose_rect(void) {
+    CHECK(compose_rect_partition_matches(16, 5, 1));
+    CHECK(compose_rect_partition_matches(120, 31, 1));
+    CHECK(compose_rect_partition_matches(120, 31, 0));
+    CHECK(compose_rect_partition_matches(301, 77, 1));
+    CHECK(compose_rect_partition_matches(64, 128, 1));  // zoom below 1
+}
+
+static void test_patch(int radius, int capSize) {
+    int d = radius * 2;
+    size_t capBytes = (size_t)capSize * capSize * 4, loupeBytes = (size_t)d * d * 4;
+    uint8_t* cap = noise(capBytes, (uint32_t)capSize);
+    uint8_t* loupe = (uint8_t*)malloc(loupeBytes);
+    uint8_t* before = (uint8_t*)malloc(loupeBytes);
+    uint8_t* want = (uint8_t*)malloc(loupeBytes);
+    DamageMap m;
+    memset(&m, 0, sizeof(m));
+    CHECK(cap && loupe && before && want && damage_reserve(&m, capSize, capSize));
+    if (!cap || !loupe || !before || !want || !m.hash) {
+        free(cap);
+        free(loupe);
+        free(before);
+        free(want);
+        return;
+    }
+    compose_loupe(cap, capSize, capSize * 4, loupe, radius, d * 4, 2, 1, 6);
+    damage_update(&m, cap, capSize, capSize, capSize * 4);
+
+    int dirty[4];
+    damage_update(&m, cap, capSize, capSize, capSize * 4);
+    CHECK(damage_compose_loupe(&m, cap, capSize * 4, loupe, radius, d * 4, 2, 1, 6, dirty) == 0);
+    CHECK(dirty[0] >= dirty[2]);
+
+    // The centre pixel (marker), the first and last pixels (border ring and
+    // outside the circle) and a pixel in the middle of a block row.
+    int c = capSize / 2;
+    static const int spots[][2] = { { 0, 0 }, { -1, -1 }, { 0, 5 } };
+    for (int round = 0; round < 4; round++) {
+        int x = round < 3 ? (spots[round][0] < 0 ? capSize - 1 : spots[round][0]) : c;
+        int y = round < 3 ? (spots[round][1] < 0 ? capSize - 1 : spots[round][1] * capSize / 10) : c;
+        cap[((size_t)y * capSize + x) * 4 + 1] ^= 0x33;
+        if (round == 2) cap[((size_t)y * capSize + capSize - 1 - x) * 4] ^= 0x33;
+        damage_update(&m, cap, capSize, capSize, capSize * 4);
+        memcpy(before, loupe, loupeBytes);
+        size_t px = damage_compose_loupe(&m, cap, capSize * 4, loupe, radius, d * 4, 2, 1, 6, dirty);
+        compose_loupe(cap, capSize, capSize * 4, want, radius, d * 4, 2, 1, 6);
+        CHECK(memcmp(loupe, want, loupeBytes) == 0);
+        CHECK(px > 0 && px < (size_t)d * d);
+        int outside = 0;
+        for (int ly = 0; ly < d; ly++) {
+            for (int lx = 0; lx < d; lx++) {
+                int in = lx >= dirty[0] && lx < dirty[2] && ly >= dirty[1] && ly < dirty[3];
+                size_t o = ((size_t)ly * d + lx) * 4;
+                outside += !in && memcmp(before + o, loupe + o, 4) != 0;
+            }
+        }
+        CHECK(outside == 0);
+    }
+    damage_free(&m);
+    free(cap);
+    free(loupe);
+    free(before);
+    free(want);
+}
+
+int main(void) {
+    test_hash();
+    test_update();
+    test_flash();
+    test_compose_rect();
+    test_patch(120, 31);
+    test_patch(240, 61);
+    test_patch(512, 129);
+    return test_report("damage");
+}
@@ -0,0 +1,132 @@
+// Minimal Color Picker - gamma-correct downsampling tests.
+// Build/run: make test
+//
+// downsample_box_bgra() must return flat blocks unchanged, average in linear
+// light (a black/white checkerboard is ~188, not 128), match a double-precision
+// reference to within one code, read only the k x k block of each output
+// pixel, and give identical bytes on the SSE2 and portable paths.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_downsample.h"
+#include "test_util.h"
+
+static uint32_t g_acc[1024 * 4];
+
+static void test_tables(void) {
+    const SrgbTables* t = srgb_tables();
+    int bad = 0;
+    for (int c = 0; c < 256; c++) bad += t->toSrgb[t->toLinear[c] >> 4] != c;
+    CHECK(bad == 0);
+    CHECK(t->toLinear[0] == 0 && t->toLinear[255] == 65535);
+}
+
+static void test_flat_blocks(void) {
+    // Every grey level, one 4x4 block each: 256 output pixels in one row.
+    enum { K = 4, W = 256 };
+    static uint8_t src[K * W * K * 4];
+    static uint8_t dst[W * 4];
+    for (int y = 0; y < K; y++) {
+        for (int x = 0; x < W * K; x++) {
+            uint8_t* p = src + ((size_t)y * W * K + x) * 4;
+            p[0] = (uint8_t)(x / K);
+            p[1] = (uint8_t)(255 - x / K);
+            p[2] = (uint8_t)(x / K);
+            p[3] = 0;
+        }
+    }
+    downsample_box_bgra(src, W * K * 4, dst, W, 1, W * 4, K, g_acc);
+    int bad = 0;
+    for (int x = 0; x < W; x++) {
+        const uint8_t* p = dst + x * 4;
+        bad += p[0] != x || p[1] != 255 - x || p[2] != x || p[3] != 255;
+    }
+    CHECK(bad == 0);
+}
+
+static void test_checkerboard(void) {
+    enum { K = 2 };
+    uint8_t src[K * K * 4];
+    uint8_t dst[4];
+    for (int i = 0; i < K * K; i++) memset(src + i * 4, ((i + i / K) & 1) ? 255 : 0, 4);
+    downsample_box_bgra(src, K * 4, dst, 1, 1, 4, K, g_acc);
+    CHECK(dst[0] >= 186 && dst[0] <= 189);
+    CHECK(dst[0] == dst[1] && dst[1] == dst[2]);
+}
+
+static void fill_noise(uint8_t* px, size_t bytes, uint32_t seed) {
+    uint32_t s = seed * 2654435761u + 1;
+    for (size_t i = 0; i < bytes; i++) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        px[i] = (uint8_t)s;
+    }
+}
+
+static void test_reference(int k, int dstW, int dstH) {
+    int srcW = dstW * k + 3;  // padding columns and rows that must be ignored
+    int srcH = dstH * k + 2;
+    int srcStride = srcW * 4;
+    uint8_t* src = (uint8_t*)malloc((size_t)srcH * srcStride);
+    uint8_t* dst = (uint8_t*)malloc((size_t)dstW * dstH * 4);
+    uint8_t* gen = (uint8_t*)malloc((size_t)dstW * dstH * 4);
+    if (!src || !dst || !gen) {
+        g_failures++;
+        free(src);
+        free(dst);
+        free(gen);
+        return;
+    }
+    fill_noise(src, (size_t)srcH * srcStride, (uint32_t)(k * 100 + dstW));
+    downsample_box_bgra(src, srcStride, dst, dstW, dstH, dstW * 4, k, g_acc);
+    downsample_box_bgra_generic(src, srcStride, gen, dstW, dstH, dstW * 4, k, g_acc);
+    CHECK(memcmp(dst, gen, (size_t)dstW * dstH * 4) == 0);
+
+    int worst = 0;
+    for (int y = 0; y < dstH; y++) {
+        for (int x = 0; x < dstW; x++) {
+            for (int c = 0; c < 3; c++) {
+                double sum = 0.0;
+                for (int j = 0; j < k; j++) {
+                    for (int i = 0; i < k; i++) {
+                        sum += srgb_decode(src[(size_t)(y * k + j) * srcStride + (size_t)(x * k + i) * 4 + c] / 255.0);
+                    }
+                }
+                int want = (int)floor(srgb_encode(sum / (k * k)) * 255.0 + 0.5);
+                int got = dst[((size_t)y * dstW + x) * 4 + c];
+                int diff = abs(want - got);
+                if (diff > worst) worst = diff;
+            }
+            CHECK(dst[((size_t)y * dstW + x) * 4 + 3] == 255);
+        }
+    }
+    if (worst > 1) printf("  k=%d: off by %d from the reference\n", k, worst);
+    CHECK(worst <= 1);
+    free(src);
+    free(dst);
+    free(gen);
+}
+
+int main(void) {
+    test_tables();
+    test_flat_blocks();
+    test_checkerboard();
+    test_reference(2, 33, 17);
+    test_reference(3, 41, 41);
+    test_reference(4, 61, 61);
+    test_reference(8, 31, 9);
+    test_reference(DOWNSAMPLE_MAX_FACTOR, 7, 5);
+    if (g_failures) {
+        printf("downsample: %d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("downsample: all checks passed (%s)\n", DOWNSAMPLE_SSE2 ? "sse2" : "portable");
+    return 0;
+}
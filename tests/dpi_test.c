@@ -0,0 +1,154 @@
+// Minimal Color Picker - per-monitor DPI geometry tests.
+// Build/run: make test
+//
+// At 96 dpi loupe_geometry() must give the sizes the picker always used; at
+// 150% and 200% every logical size must scale while the zoom stays in
+// physical pixels, so the capture square covers the same physical pixels per
+// loupe pixel on every monitor. On synthetic mixed-DPI layouts
+// dpi_map_pixel() must hit every physical pixel of a display exactly once in
+// order, and repeat whole pixels of a coarser neighbour without skipping any.
+// Drawing at native resolution must touch fewer bytes per frame than drawing
+// in logical pixels and letting the compositor scale the loupe up.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../picker_dpi.h"
+#include "test_util.h"
+
+static const LoupeStyle kStyle = { 120, 1024, 2, 6, 40 };
+
+static void test_geometry(void) {
+    LoupeGeometry g = loupe_geometry(&kStyle, 8.0, 96, INT_MAX);
+    CHECK(g.radius == 120 && g.diameter == 240 && g.capSize == 31 && g.srcSize == 31 && g.levels == 1);
+    CHECK(g.borderWidth == 2 && g.markerSize == 6 && g.offset == 40);
+
+    g = loupe_geometry(&kStyle, 8.0, 192, INT_MAX);
+    CHECK(g.radius == 240 && g.diameter == 480 && g.capSize == 61);
+    CHECK(g.borderWidth == 4 && g.markerSize == 12 && g.offset == 80);
+
+    g = loupe_geometry(&kStyle, 8.0, 144, INT_MAX);
+    CHECK(g.radius == 180 && g.borderWidth == 3 && g.markerSize == 9 && g.offset == 60);
+
+    // One zoom step is one physical pixel: the capture covers the loupe at
+    // `zoom` physical loupe pixels per physical screen pixel, to within the
+    // one pixel the odd size adds.
+    static const int dpis[] = { 96, 120, 144, 168, 192, 288 };
+    static const double zooms[] = { 1.0, 2.0, 3.0, 8.0, 2.378, 64.0 };
+    for (size_t i = 0; i < sizeof(dpis) / sizeof(dpis[0]); i++) {
+        for (size_t j = 0; j < sizeof(zooms) / sizeof(zooms[0]); j++) {
+            g = loupe_geometry(&kStyle, zooms[j], dpis[i], INT_MAX);
+            double covered = g.capSize * zooms[j];
+            CHECK(g.capSize % 2 == 1);
+            CHECK(covered > g.diameter - 2 * zooms[j] && covered < g.diameter + 2 * zooms[j]);
+        }
+    }
+
+    // The physical radius is capped; the capture never exceeds the limit.
+    g = loupe_geometry(&kStyle, 8.0, 96 * 3, INT_MAX);
+    CHECK(g.radius == 360);
+    LoupeStyle big = kStyle;
+    big.radius = 1024;
+    g = loupe_geometry(&big, 1.0, 192, 1080);
+    CHECK(g.radius == 1024 && g.capSize == 1079);
+
+    // Zoomed out: levels from the zoom, the source about the loupe's size.
+    g = loupe_geometry(&kStyle, 0.25, 192, INT_MAX);
+    CHECK(g.levels == 3 && g.srcSize == 479 && g.capSize == 479 * 4);
+    g = loupe_geometry(&kStyle, 0.125, 96, 1080);
+    CHECK(g.levels == 4 && g.srcSize == 135 && g.capSize == 135 * 8);
+}
+
+// A 2x laptop panel with a 1x monitor to its right and a 1.5x one below.
+static const DpiDisplay kLayout[] = {
+    { 0, 0, 1440, 900, 192 },
+    { 1440, 0, 1920, 1080, 96 },
+    { 0, 900, 1280, 720, 144 },
+};
+enum { LAYOUT_COUNT = sizeof(kLayout) / sizeof(kLayout[0]) };
+
+static void test_same_dpi_is_exact(void) {
+    // Every pixel of the 2x panel, in its own grid: exactly its own pixel.
+    int bad = 0;
+    for (int gy = 0; gy < 1800; gy += 7) {
+        for (int gx = 0; gx < 2880; gx++) {
+            int px, py;
+            int d = dpi_map_pixel(kLayout, LAYOUT_COUNT, 192, gx, gy, &px, &py);
+            bad += d != 0 || px != gx || py != gy;
+        }
+    }
+    CHECK(bad == 0);
+
+    // The 1.5x display in its own grid: offset by its origin, no rounding
+    // drift across the whole width.
+    bad = 0;
+    for (int gx = 0; gx < 1920; gx++) {
+        int px, py;
+        int d = dpi_map_pixel(kLayout, LAYOUT_COUNT, 144, gx, 1350 + 11, &px, &py);
+        bad += d != 2 || px != gx || py != 11;
+    }
+    CHECK(bad == 0);
+}
+
+static void test_straddling_square(void) {
+    // A 61 px square in the 2x grid centred 10 points left of the 1x monitor.
+    int size = 61, half = size / 2;
+    int cx = (1440 - 10) * 2, cy = 450 * 2;
+    int onPanel = 0, onMonitor = 0, prevPx = -1, run = 0, badRun = 0, badOrder = 0;
+    for (int i = 0; i < size; i++) {
+        int px = 0, py = 0;
+        int d = dpi_map_pixel(kLayout, LAYOUT_COUNT, 192, cx - half + i, cy, &px, &py);
+        CHECK(d == 0 || d == 1);
+        if (d == 0) {
+            onPanel++;
+            CHECK(px == cx - half + i && py == cy);
+            continue;
+        }
+        onMonitor++;
+        CHECK(py == 450);
+        // Each 1x pixel covers two grid pixels: runs of two, then the next.
+        if (px == prevPx) {
+            run++;
+        } else {
+            if (prevPx >= 0 && run != 2) badRun++;
+            if (prevPx >= 0 && px != prevPx + 1) badOrder++;
+            if (prevPx < 0 && px != 0) badOrder++;
+            prevPx = px;
+            run = 1;
+        }
+    }
+    CHECK(onPanel == 2880 - (cx - half) && onMonitor == size - onPanel);
+    CHECK(badRun == 0 && badOrder == 0);
+
+    // Off every display: no pixel.
+    int px, py;
+    CHECK(dpi_map_pixel(kLayout, LAYOUT_COUNT, 192, -1, 10, &px, &py) == -1);
+    CHECK(dpi_map_pixel(kLayout, LAYOUT_COUNT, 192, 2 * 1300, 2 * 1000, &px, &py) == -1);
+}
+
+static void test_bytes_per_frame(void) {
+    // Logical drawing at scale s: capture and loupe at 96 dpi, then the
+    // compositor reads the logical loupe and writes the physical one.
+    static const int dpis[] = { 144, 192, 288 };
+    for (size_t i = 0; i < sizeof(dpis) / sizeof(dpis[0]); i++) {
+        LoupeGeometry logical = loupe_geometry(&kStyle, 8.0, 96, INT_MAX);
+        LoupeGeometry native = loupe_geometry(&kStyle, 8.0, dpis[i], INT_MAX);
+        size_t twoPass = loupe_frame_bytes(&logical) + (size_t)logical.diameter * logical.diameter * 4 +
+                         (size_t)native.diameter * native.diameter * 4;
+        size_t onePass = loupe_frame_bytes(&native);
+        printf("  %3d dpi: %zu bytes/frame native, %zu scaled by the compositor\n", dpis[i], onePass, twoPass);
+        CHECK(onePass < twoPass);
+    }
+}
+
+int main(void) {
+    test_geometry();
+    test_same_dpi_is_exact();
+    test_straddling_square();
+    test_bytes_per_frame();
+    return test_report("dpi");
+}
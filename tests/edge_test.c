@@ -0,0 +1,165 @@
+// Minimal Color Picker - sub-pixel edge and two-point measurement tests.
+// Build/run: make test
+//
+// A hard step must snap to the boundary between its pixels, and an
+// antialiased step covering a fraction of one pixel must snap to where the
+// edge was drawn, in both axes and in any colour. Flat areas and faint
+// noise must not snap, a point between two edges must take the nearer of
+// equally strong ones, and the line must not be searched past the square.
+// The pair report must give the distance and the on-screen angle.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_edge.h"
+#include "test_util.h"
+
+#define SIZE 15
+
+static uint32_t g_cap[SIZE * SIZE];
+
+static uint32_t mix(uint32_t a, uint32_t b, double f) {
+    uint32_t out = 0xFF000000u;
+    for (int s = 0; s < 24; s += 8) {
+        double va = (double)((a >> s) & 0xFF), vb = (double)((b >> s) & 0xFF);
+        out |= (uint32_t)(va + (vb - va) * f + 0.5) << s;
+    }
+    return out;
+}
+
+// A vertical edge at x = edge: colour a left of it, b right of it, each
+// pixel box-filtered over its width.
+static void draw_vertical_edge(double edge, uint32_t a, uint32_t b) {
+    for (int x = 0; x < SIZE; x++) {
+        double cover = (double)(x + 1) - edge;  // share of pixel x right of the edge
+        if (cover < 0.0) cover = 0.0;
+        if (cover > 1.0) cover = 1.0;
+        for (int y = 0; y < SIZE; y++) g_cap[y * SIZE + x] = mix(a, b, cover);
+    }
+}
+
+static void transpose(void) {
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = y + 1; x < SIZE; x++) {
+            uint32_t t = g_cap[y * SIZE + x];
+            g_cap[y * SIZE + x] = g_cap[x * SIZE + y];
+            g_cap[x * SIZE + y] = t;
+        }
+    }
+}
+
+static EdgePoint snap(int cx, int cy) {
+    return edge_snap_point((const uint8_t*)g_cap, SIZE, SIZE * 4, cx, cy, 100, 200, EDGE_REACH, EDGE_MIN_GRADIENT);
+}
+
+static void test_step(void) {
+    draw_vertical_edge(9.0, 0xFF000000u, 0xFFFFFFFFu);
+    EdgePoint e = snap(7, 7);
+    CHECK(e.snappedX && !e.snappedY);
+    CHECK(fabs(e.x - 109.0) < 1e-9);
+    CHECK(fabs(e.y - 207.5) < 1e-9);  // the pixel's centre in the axis along the edge
+    CHECK(e.colour == 0xFF000000u);
+
+    // Beyond the reach nothing snaps.
+    e = snap(2, 7);
+    CHECK(!e.snappedX && fabs(e.x - 102.5) < 1e-9);
+}
+
+static void test_antialiased(void) {
+    static const uint32_t kPairs[][2] = {
+        { 0xFF000000u, 0xFFFFFFFFu },
+        { 0xFF2060C0u, 0xFFF0F0F0u },
+        { 0xFFFF0000u, 0xFF0000FFu },  // equal luma, different hue
+    };
+    for (int p = 0; p < 3; p++) {
+        for (int k = 1; k < 10; k++) {
+            double edge = 8.0 + k / 10.0;
+            draw_vertical_edge(edge, kPairs[p][0], kPairs[p][1]);
+            EdgePoint e = snap(7, 7);
+            CHECK(e.snappedX && !e.snappedY);
+            // Rounding the blended pixel to 8 bits moves the centroid by under 1/255.
+            CHECK(fabs(e.x - (100.0 + edge)) < 0.01);
+
+            transpose();
+            e = snap(7, 7);
+            CHECK(e.snappedY && !e.snappedX);
+            CHECK(fabs(e.y - (200.0 + edge)) < 0.01);
+        }
+    }
+}
+
+static void test_flat_and_noise(void) {
+    uint32_t seed = 0x5EED;
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        g_cap[i] = 0xFF808080u + (seed % 8) * 0x010101u;  // at most 21 per boundary
+    }
+    EdgePoint e = snap(7, 7);
+    CHECK(!e.snappedX && !e.snappedY);
+    CHECK(fabs(e.x - 107.5) < 1e-9 && fabs(e.y - 207.5) < 1e-9);
+}
+
+static void test_nearest_of_two(void) {
+    // A 1 px gap between two hard edges 3 px apart: the point at pixel 7
+    // takes the edge at 8 over the one at 5, which is further from its centre.
+    for (int i = 0; i < SIZE * SIZE; i++) g_cap[i] = 0xFFFFFFFFu;
+    for (int y = 0; y < SIZE; y++) {
+        for (int x = 0; x < 5; x++) g_cap[y * SIZE + x] = 0xFF000000u;
+        for (int x = 8; x < SIZE; x++) g_cap[y * SIZE + x] = 0xFF000000u;
+    }
+    EdgePoint e = snap(7, 7);
+    CHECK(e.snappedX && fabs(e.x - 108.0) < 1e-9);
+    e = snap(5, 7);
+    CHECK(e.snappedX && fabs(e.x - 105.0) < 1e-9);
+
+    // A one pixel line snaps to its middle.
+    for (int i = 0; i < SIZE * SIZE; i++) g_cap[i] = 0xFFFFFFFFu;
+    for (int y = 0; y < SIZE; y++) g_cap[y * SIZE + 7] = 0xFF000000u;
+    e = snap(7, 7);
+    CHECK(e.snappedX && fabs(e.x - 107.5) < 1e-9);
+}
+
+static void test_square_bounds(void) {
+    // An edge at the square's side: only boundaries inside it are read.
+    draw_vertical_edge(1.0, 0xFFFFFFFFu, 0xFF000000u);
+    EdgePoint e = edge_snap_point((const uint8_t*)g_cap, SIZE, SIZE * 4, 0, 0, 0, 0, EDGE_REACH, EDGE_MIN_GRADIENT);
+    CHECK(e.snappedX && fabs(e.x - 1.0) < 1e-9);
+    // A 1x1 square has no boundary.
+    e = edge_snap_point((const uint8_t*)g_cap, 1, 4, 0, 0, 10, 10, EDGE_REACH, EDGE_MIN_GRADIENT);
+    CHECK(!e.snappedX && !e.snappedY && fabs(e.x - 10.5) < 1e-9);
+}
+
+static void test_format(void) {
+    EdgePoint a, b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    a.x = 10.0;
+    a.y = 20.0;
+    a.snappedX = 1;
+    a.colour = 0xFF3366CCu;
+    b.x = 13.0;
+    b.y = 16.0;
+    char line[128];
+    edge_format_point(&a, line, sizeof(line));
+    CHECK(strcmp(line, "10.00|,20.00 #3366CC") == 0);
+    edge_format_pair(&a, &b, line, sizeof(line));
+    // Up and to the right on screen is a positive angle.
+    CHECK(strcmp(line, "distance 5.00 px  dx 3.00  dy -4.00  angle 53.1 deg") == 0);
+    edge_format_pair(&a, &a, line, sizeof(line));
+    CHECK(strcmp(line, "distance 0.00 px  dx 0.00  dy 0.00  angle 0.0 deg") == 0);
+}
+
+int main(void) {
+    test_step();
+    test_antialiased();
+    test_flat_and_noise();
+    test_nearest_of_two();
+    test_square_bounds();
+    test_format();
+    return test_report("edge");
+}
@@ -0,0 +1,179 @@
+// Minimal Color Picker - same-colour flood fill tests.
+// Build/run: make test
+//
+// A drawn rectangle must come back with its exact box, area and centroid,
+// and the tolerance must decide whether a slightly different border joins
+// it. On random blobs of a few colours, with and without tolerance, the span
+// fill (SSE2 and portable) must find exactly the pixels a plain 4-connected
+// breadth-first fill finds. A solid 3840x2160 frame is filled whole and its
+// time printed.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../picker_fill.h"
+#include "test_util.h"
+
+// Reference: breadth-first 4-connected fill, one pixel at a time.
+static FillResult reference_fill(const uint32_t* px, int w, int h, int sx, int sy, int tol, uint8_t* inside) {
+    FillResult r;
+    memset(&r, 0, sizeof(r));
+    memset(inside, 0, (size_t)w * h);
+    int* queue = (int*)malloc((size_t)w * h * sizeof(int));
+    uint32_t seed = px[(size_t)sy * w + sx];
+    int head = 0, tail = 0;
+    queue[tail++] = sy * w + sx;
+    inside[sy * w + sx] = 1;
+    r.x0 = w;
+    r.y0 = h;
+    double sx2 = 0.0, sy2 = 0.0;
+    while (head < tail) {
+        int i = queue[head++], x = i % w, y = i / w;
+        r.area++;
+        sx2 += x + 0.5;
+        sy2 += y + 0.5;
+        if (x < r.x0) r.x0 = x;
+        if (y < r.y0) r.y0 = y;
+        if (x + 1 > r.x1) r.x1 = x + 1;
+        if (y + 1 > r.y1) r.y1 = y + 1;
+        static const int dx[4] = { -1, 1, 0, 0 }, dy[4] = { 0, 0, -1, 1 };
+        for (int k = 0; k < 4; k++) {
+            int nx = x + dx[k], ny = y + dy[k];
+            if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+            int j = ny * w + nx;
+            if (inside[j] || !fill_match(px[j], seed, tol)) continue;
+            inside[j] = 1;
+            queue[tail++] = j;
+        }
+    }
+    r.cx = sx2 / (double)r.area;
+    r.cy = sy2 / (double)r.area;
+    free(queue);
+    return r;
+}
+
+static int same_region(const FillResult* a, const FillResult* b) {
+    double ex = a->cx - b->cx, ey = a->cy - b->cy;
+    return a->x0 == b->x0 && a->y0 == b->y0 && a->x1 == b->x1 && a->y1 == b->y1 && a->area == b->area &&
+           ex * ex + ey * ey < 1e-12;
+}
+
+static void test_button(void) {
+    int w = 200, h = 120;
+    uint32_t* px = (uint32_t*)malloc((size_t)w * h * 4);
+    fill_rect(px, w, 0, 0, w, h, 0xFFFFFFFFu);
+    fill_rect(px, w, 30, 40, 150, 72, 0xFF3366CCu);    // the button
+    fill_rect(px, w, 29, 39, 151, 40, 0xFF3467CBu);    // a border one step off
+    fill_rect(px, w, 60, 50, 120, 60, 0x00000000u);    // its label, a hole
+    FillMap m;
+    memset(&m, 0, sizeof(m));
+    FillResult r;
+    CHECK(flood_fill_bgra(&m, (const uint8_t*)px, w, h, w * 4, 35, 45, 0, &r));
+    CHECK(r.x0 == 30 && r.y0 == 40 && r.x1 == 150 && r.y1 == 72);
+    CHECK(r.area == 120u * 32u - 60u * 10u);
+    // Symmetric about the hole's centre line in x; in y the hole pulls down.
+    CHECK(r.cx > 89.999 && r.cx < 90.001);
+    double cy = ((double)120 * 32 * 56.0 - 60.0 * 10 * 55.0) / (double)r.area;
+    CHECK(r.cy > cy - 1e-9 && r.cy < cy + 1e-9);
+
+    // With a tolerance of one the border row joins.
+    CHECK(flood_fill_bgra(&m, (const uint8_t*)px, w, h, w * 4, 35, 45, 1, &r));
+    CHECK(r.x0 == 29 && r.y0 == 39 && r.x1 == 151 && r.y1 == 72);
+
+    // Alpha is ignored: the label differs from black only there.
+    px[0] = 0x12000000u;
+    CHECK(flood_fill_bgra(&m, (const uint8_t*)px, w, h, w * 4, 60, 50, 0, &r));
+    CHECK(r.area == 600 && r.x0 == 60 && r.x1 == 120);
+
+    // Outside the frame: nothing.
+    CHECK(flood_fill_bgra(&m, (const uint8_t*)px, w, h, w * 4, -1, 5, 0, &r) && r.area == 0);
+    CHECK(m.fills == 3);
+
+    // The marks wrap after 255 fills without leaking into the next ones.
+    for (int i = 0; i < 600; i++) {
+        CHECK(flood_fill_bgra(&m, (const uint8_t*)px, w, h, w * 4, 35 + i % 2, 45, 0, &r));
+        CHECK(r.area == 120u * 32u - 60u * 10u);
+    }
+    fill_free(&m);
+    free(px);
+}
+
+static void test_random_blobs(void) {
+    FillMap m;
+    memset(&m, 0, sizeof(m));
+    for (int round = 0; round < 40; round++) {
+        int w = 3 + (int)(next_random() % 157), h = 1 + (int)(next_random() % 93);
+        int colours = 2 + round % 3;
+        uint32_t* px = (uint32_t*)malloc((size_t)w * h * 4);
+        // Few colours in rectangles of random size make winding, holed regions.
+        fill_rect(px, w, 0, 0, w, h, 0xFF000000u);
+        for (int k = 0; k < w * h / 6 + 4; k++) {
+            int x0 = (int)(next_random() % w), y0 = (int)(next_random() % h);
+            int x1 = x0 + 1 + (int)(next_random() % 9), y1 = y0 + 1 + (int)(next_random() % 5);
+            uint32_t c = 0xFF000000u | (uint32_t)(next_random() % colours) * 0x101010u;
+            c += next_random() % 3;  // within a tolerance of 2 of its band
+            fill_rect(px, w, x0, y0, x1 < w ? x1 : w, y1 < h ? y1 : h, c);
+        }
+        uint8_t* inside = (uint8_t*)malloc((size_t)w * h);
+        for (int t = 0; t < 6; t++) {
+            int sx = (int)(next_random() % w), sy = (int)(next_random() % h);
+            int tol = (t % 2) * 2;
+            FillResult want = reference_fill(px, w, h, sx, sy, tol, inside);
+            FillResult a, b;
+            CHECK(flood_fill_bgra(&m, (const uint8_t*)px, w, h, w * 4, sx, sy, tol, &a));
+            CHECK(same_region(&a, &want));
+            int marked = 1;
+            for (int i = 0; i < w * h; i++) marked &= (m.visited[i] == m.gen) == inside[i];
+            CHECK(marked);
+            CHECK(flood_fill_bgra_generic(&m, (const uint8_t*)px, w, h, w * 4, sx, sy, tol, &b));
+            CHECK(same_region(&b, &want) && a.spans == b.spans);
+        }
+        free(inside);
+        free(px);
+    }
+    fill_free(&m);
+}
+
+typedef struct FrameFill {
+    FillMap m;
+    const uint32_t* px;
+    int w, h;
+    FillResult r;
+    int ok;
+} FrameFill;
+
+static void run_fill(void* p) {
+    FrameFill* f = (FrameFill*)p;
+    f->ok = flood_fill_bgra(&f->m, (const uint8_t*)f->px, f->w, f->h, f->w * 4, f->w / 2, f->h / 2, 0, &f->r);
+}
+
+static void test_4k_frame(void) {
+    int w = 3840, h = 2160;
+    uint32_t* px = (uint32_t*)malloc((size_t)w * h * 4);
+    fill_rect(px, w, 0, 0, w, h, 0xFF202428u);
+    static FrameFill f;
+    f.px = px;
+    f.w = w;
+    f.h = h;
+    double best = best_ms(run_fill, &f, 5);
+    FillResult r = f.r;
+    CHECK(f.ok);
+    CHECK(r.area == (uint64_t)w * h && r.x0 == 0 && r.y0 == 0 && r.x1 == w && r.y1 == h);
+    CHECK(r.cx == w / 2.0 && r.cy == h / 2.0);
+    printf("  solid %dx%d frame: %.2f ms (%s)\n", w, h, best, FILL_SSE2 ? "sse2" : "portable");
+    fill_free(&f.m);
+    free(px);
+}
+
+int main(void) {
+    g_seed = 0xF111;
+    test_button();
+    test_random_blobs();
+    test_4k_frame();
+    return test_report("fill");
+}
@@ -0,0 +1,274 @@
+// Minimal Color Picker - golden-image and performance regression tests.
+// Build/run: make test
+//            tests/golden_test [--update] [--threshold 1.5] [--no-perf]
+//
+// Renders the loupe with compose_loupe() (the same kernels draw_overlay_frame
+// uses) from fixed synthetic captures at several radii and zoom factors, and
+// compares the result byte-for-byte with tests/golden/<case>.pam.
+//
+// Each case is also timed (best of several batches) and compared with
+// tests/perf_baseline.txt; a case fails when it is slower than
+// baseline * threshold. The threshold defaults to 1.5 and can be set with
+// --threshold or GOLDEN_PERF_THRESHOLD. Baselines are machine-specific:
+// regenerate them with --update on the machine that runs the check.
+//
+// --update rewrites the goldens and the baseline instead of comparing.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../picker_kernels.h"
+
+#ifndef TEST_DIR
+#define TEST_DIR "tests"
+#endif
+
+typedef struct Case {
+    int radius;
+    int zoom;
+} Case;
+
+static const Case kCases[] = {
+    { 16, 2 }, { 16, 4 }, { 40, 4 }, { 40, 8 }, { 64, 16 }, { 120, 8 },
+};
+#define CASE_COUNT ((int)(sizeof(kCases) / sizeof(kCases[0])))
+
+static const int kBorderWidth = 2;
+static const int kMarkerSize = 6;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int cap_size_for(const Case* c) {
+    int n = (c->radius * 2) / c->zoom;
+    return (n % 2 == 0) ? n + 1 : n;
+}
+
+static void case_name(const Case* c, char* out, size_t n) {
+    snprintf(out, n, "r%d_z%d", c->radius, c->zoom);
+}
+
+// Deterministic capture: noise over a diagonal gradient, so every source pixel
+// is distinct and any mapping error shows up.
+static void make_capture(uint8_t* px, int size, uint32_t seed) {
+    uint32_t s = seed * 2654435761u + 7;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+            uint8_t* p = px + ((size_t)y * size + x) * 4;
+            p[0] = (uint8_t)(x * 255 / size) ^ (uint8_t)(s & 0x1F);
+            p[1] = (uint8_t)(y * 255 / size) ^ (uint8_t)((s >> 8) & 0x1F);
+            p[2] = (uint8_t)(s >> 16);
+            p[3] = 0; // GDI/X11 captures leave alpha undefined
+        }
+    }
+}
+
+static void render_case(const Case* c, const uint8_t* cap, uint8_t* out) {
+    int capSize = cap_size_for(c);
+    compose_loupe(cap, capSize, capSize * 4, out, c->radius, c->radius * 2 * 4,
+                  kBorderWidth, 1, kMarkerSize);
+}
+
+// Goldens are binary PAM (RGB_ALPHA) so standard viewers can open them.
+static int write_pam(const char* path, const uint8_t* bgra, int w, int h) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) return 0;
+    fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", w, h);
+    for (int i = 0; i < w * h; i++) {
+        const uint8_t* p = bgra + (size_t)i * 4;
+        uint8_t rgba[4] = { p[2], p[1], p[0], p[3] };
+        fwrite(rgba, 1, 4, fp);
+    }
+    fclose(fp);
+    return 1;
+}
+
+static uint8_t* read_pam(const char* path, int* w, int* h) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    char line[128];
+    int depth = 0;
+    *w = *h = 0;
+    if (!fgets(line, sizeof(line), fp) || strncmp(line, "P7", 2) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "ENDHDR", 6) == 0) break;
+        sscanf(line, "WIDTH %d", w);
+        sscanf(line, "HEIGHT %d", h);
+        sscanf(line, "DEPTH %d", &depth);
+    }
+    if (*w <= 0 || *h <= 0 || depth != 4) {
+        fclose(fp);
+        return NULL;
+    }
+
+    size_t n = (size_t)*w * (size_t)*h;
+    uint8_t* px = (uint8_t*)malloc(n * 4);
+    if (!px || fread(px, 4, n, fp) != n) {
+        free(px);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t t = px[i * 4];
+        px[i * 4] = px[i * 4 + 2];
+        px[i * 4 + 2] = t;
+    }
+    return px;
+}
+
+static double time_case(const Case* c, const uint8_t* cap, uint8_t* out) {
+    int iters = 1;
+    for (;;) {
+        double t0 = now_ns();
+        for (int i = 0; i < iters; i++) render_case(c, cap, out);
+        if (now_ns() - t0 >= 5e6 || iters >= (1 << 20)) break;
+        iters *= 2;
+    }
+    double best = 1e300;
+    for (int b = 0; b < 7; b++) {
+        double t0 = now_ns();
+        for (int i = 0; i < iters; i++) render_case(c, cap, out);
+        double ns = (now_ns() - t0) / iters;
+        if (ns < best) best = ns;
+    }
+    return best;
+}
+
+static double baseline_for(const char* name) {
+    FILE* fp = fopen(TEST_DIR "/perf_baseline.txt", "r");
+    if (!fp) return 0.0;
+    char line[128], key[64];
+    double ns = 0.0, found = 0.0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %lf", key, &ns) == 2 && strcmp(key, name) == 0) found = ns;
+    }
+    fclose(fp);
+    return found;
+}
+
+int main(int argc, char** argv) {
+    int update = 0;
+    int perf = 1;
+    double threshold = 1.5;
+    const char* env = getenv("GOLDEN_PERF_THRESHOLD");
+    if (env) threshold = atof(env);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = 1;
+        } else if (strcmp(argv[i], "--no-perf") == 0) {
+            perf = 0;
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--update] [--threshold X] [--no-perf]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE* baselineOut = NULL;
+    if (update) {
+        baselineOut = fopen(TEST_DIR "/perf_baseline.txt", "w");
+        if (!baselineOut) {
+            fprintf(stderr, "Failed to write %s/perf_baseline.txt\n", TEST_DIR);
+            return 1;
+        }
+        fprintf(baselineOut, "# case  ns_per_frame  (written by golden_test --update)\n");
+    }
+
+    int failures = 0;
+    for (int i = 0; i < CASE_COUNT; i++) {
+        const Case* c = &kCases[i];
+        char name[32], path[256];
+        case_name(c, name, sizeof(name));
+        snprintf(path, sizeof(path), "%s/golden/%s.pam", TEST_DIR, name);
+
+        int capSize = cap_size_for(c);
+        int d = c->radius * 2;
+        uint8_t* cap = (uint8_t*)malloc((size_t)capSize * capSize * 4);
+        uint8_t* out = (uint8_t*)malloc((size_t)d * d * 4);
+        if (!cap || !out) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        make_capture(cap, capSize, (uint32_t)(c->radius * 31 + c->zoom));
+        render_case(c, cap, out);
+
+        const char* status = "ok";
+        if (update) {
+            if (!write_pam(path, out, d, d)) {
+                status = "FAIL (cannot write golden)";
+                failures++;
+            }
+        } else {
+            int gw, gh;
+            uint8_t* golden = read_pam(path, &gw, &gh);
+            if (!golden) {
+                status = "FAIL (missing golden)";
+                failures++;
+            } else if (gw != d || gh != d) {
+                status = "FAIL (size mismatch)";
+                failures++;
+            } else {
+                int diff = 0, first = -1;
+                for (int p = 0; p < d * d; p++) {
+                    if (memcmp(golden + (size_t)p * 4, out + (size_t)p * 4, 4) != 0) {
+                        if (first < 0) first = p;
+                        diff++;
+                    }
+                }
+                if (diff) {
+                    printf("  %s: %d pixels differ, first at (%d,%d)\n", name, diff, first % d, first / d);
+                    status = "FAIL (pixels differ)";
+                    failures++;
+                }
+            }
+            free(golden);
+        }
+
+        double ns = 0.0, base = 0.0;
+        if (perf || update) {
+            ns = time_case(c, cap, out);
+            if (update) {
+                fprintf(baselineOut, "%s %.0f\n", name, ns);
+            } else {
+                base = baseline_for(name);
+                if (base > 0.0 && ns > base * threshold && strcmp(status, "ok") == 0) {
+                    status = "FAIL (slower than baseline)";
+                    failures++;
+                }
+            }
+        }
+
+        printf("%-10s %-28s", name, status);
+        if (ns > 0.0) printf(" %10.0f ns/frame", ns);
+        if (base > 0.0) printf("  (baseline %.0f, x%.2f)", base, ns / base);
+        printf("\n");
+
+        free(cap);
+        free(out);
+    }
+
+    if (baselineOut) fclose(baselineOut);
+    if (failures) {
+        printf("%d case(s) failed\n", failures);
+        return 1;
+    }
+    printf("all %d cases passed\n", CASE_COUNT);
+    return 0;
+}
@@ -0,0 +1,259 @@
+// Minimal Color Picker - memory accounting and cap tests (headless, Linux).
+// Build/run: make test
+//
+// Checks the per-buffer current/peak bookkeeping, then sets a cap a little
+// above the process's starting footprint, sizes trace history the way the
+// pickers do (from mem_history_budget), fills every ring slot while running
+// frames, and verifies that resident memory stayed under the cap and that
+// history was actually shrunk to fit. A generous cap must leave history at
+// its default size. Then does the same for the optional caches the pickers
+// ask the budget for (the shared pin capture, mip pyramids, ruler tiles,
+// scope bins, the reference square), degrading each the way they do when it
+// is refused, and checks resident memory with all of them touched.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_dpi.h"
+#include "../picker_kernels.h"
+#include "../picker_mem.h"
+#include "../picker_mip.h"
+#include "../picker_ruler.h"
+#include "../picker_scope.h"
+#include "../picker_trace.h"
+#include "test_util.h"
+
+static const int kRadius = 120;
+static const int kZoom = 8;
+
+static void test_accounting(void) {
+    mem_set("a", 1000);
+    mem_set("b", 500);
+    mem_set("a", 4000);
+    mem_set("a", 200);
+    CHECK(mem_get("a") == 200);
+    CHECK(g_mem_accounts[0].peak == 4000);
+    CHECK(g_mem_total == 700);
+    CHECK(g_mem_total_peak == 4500);
+    mem_set("a", 0);
+    mem_set("b", 0);
+    CHECK(g_mem_total == 0);
+}
+
+static void test_history_budget(void) {
+    size_t wanted = TRACE_DEFAULT_EVENTS * sizeof(TraceEvent);
+    mem_set_cap(0);
+    CHECK(mem_history_budget(wanted) == wanted);
+    CHECK(trace_events_for_bytes(wanted) == TRACE_DEFAULT_EVENTS);
+    mem_set_cap(1024 * 1024 * 1024);
+    CHECK(mem_history_budget(wanted) == wanted);
+    mem_set_cap(1);
+    CHECK(mem_history_budget(wanted) == 0);
+    CHECK(trace_events_for_bytes(0) == 256);
+    mem_set_cap(0);
+}
+
+// The frame buffers plus a capped trace ring, driven like the pickers do.
+static void test_rss_under_cap(void) {
+    size_t rss, peak;
+    mem_process_rss(&rss, &peak);
+    CHECK(rss > 0);
+
+    int d = kRadius * 2;
+    int capSize = (d / kZoom) | 1;
+    size_t frameBytes = (size_t)d * d * 4 + (size_t)capSize * capSize * 4;
+
+    // Leave room for the frame buffers and the reserve but not for the
+    // default 1.5 MB of history.
+    size_t cap = rss + frameBytes + 1024 * 1024;
+    cap += cap / 8;
+    mem_set_cap(cap);
+
+    uint8_t* capture = (uint8_t*)malloc((size_t)capSize * capSize * 4);
+    uint8_t* out = (uint8_t*)malloc((size_t)d * d * 4);
+    if (!capture || !out) {
+        g_failures++;
+        return;
+    }
+    memset(capture, 0x40, (size_t)capSize * capSize * 4);
+    memset(out, 0, (size_t)d * d * 4);
+    mem_set("capture", (size_t)capSize * capSize * 4);
+    mem_set("loupe", (size_t)d * d * 4);
+
+    uint32_t events = trace_events_for_bytes(mem_history_budget(TRACE_DEFAULT_EVENTS * sizeof(TraceEvent)));
+    CHECK(events < TRACE_DEFAULT_EVENTS);
+    trace_enable(events);
+    trace_thread_name("ui");
+
+    // Wrap the ring several times so every slot is resident.
+    for (uint32_t f = 0; f < events; f++) {
+        trace_begin("frame");
+        compose_loupe(capture, capSize, capSize * 4, out, kRadius, d * 4, 2, 1, 6);
+        trace_end("frame");
+        trace_instant("tick");
+    }
+    mem_set("trace", trace_bytes());
+    CHECK(trace_bytes() >= (size_t)events * sizeof(TraceEvent));
+
+    mem_process_rss(&rss, &peak);
+    printf("  cap %.2f MiB, rss %.2f MiB, peak %.2f MiB, trace ring %u events\n",
+           cap / 1048576.0, rss / 1048576.0, peak / 1048576.0, events);
+    CHECK(rss < cap);
+    CHECK(peak < cap);
+
+    free(capture);
+    free(out);
+    mem_set_cap(0);
+}
+
+// A 4K screen with two pins, zoomed out to 1/4, on a four-thread pool.
+enum { kScreenW = 3840, kScreenH = 2160, kPins = 2, kSlots = 4 };
+
+typedef struct Caches {
+    uint8_t* loupe;
+    uint8_t* capture;
+    uint8_t* shared;
+    int sharedSquares;     // refused a screen-sized capture
+    MipPyramid mip[1 + kPins];
+    int levels;
+    RulerCache ruler;
+    ScopeMap scope;        // slotCap 0: turned off
+    uint8_t* refSquare;    // NULL: refused
+} Caches;
+
+static LoupeGeometry caches_geometry(double zoom) {
+    LoupeStyle style = { kRadius, 2048, 2, 8, 24 };
+    return loupe_geometry(&style, zoom, DPI_BASE, kScreenH);
+}
+
+// Sizes and allocates everything in the order the pickers decide it, then
+// touches every byte so resident memory reflects it.
+static int caches_run(Caches* c) {
+    memset(c, 0, sizeof(*c));
+    LoupeGeometry geo = caches_geometry(0.25);
+    int capAlloc = geo.capSize;  // the capture only grows, so zooming in keeps it
+
+    // Frame buffers: not optional, counted against the cap.
+    c->loupe = (uint8_t*)malloc((size_t)geo.diameter * geo.diameter * 4);
+    c->capture = (uint8_t*)malloc((size_t)capAlloc * capAlloc * 4);
+    if (!c->loupe || !c->capture) return 0;
+    memset(c->loupe, 0, (size_t)geo.diameter * geo.diameter * 4);
+    memset(c->capture, 0x40, (size_t)capAlloc * capAlloc * 4);
+    mem_set("loupe", (size_t)geo.diameter * geo.diameter * 4);
+
+    size_t screen = (size_t)kScreenW * kScreenH * 4;
+    size_t squares = (size_t)capAlloc * capAlloc * (kPins + 1) * 4;
+    c->sharedSquares = !mem_allows(screen) && squares < screen;
+    size_t shared = c->sharedSquares ? squares : screen;
+    c->shared = (uint8_t*)malloc(shared);
+    if (!c->shared) return 0;
+    memset(c->shared, 0x40, shared);
+    mem_set("capture", (size_t)capAlloc * capAlloc * 4 + shared);
+
+    while (geo.levels > 1 && !mem_allows(mip_bytes_for(geo.srcSize, geo.levels) * (1 + kPins))) {
+        geo = caches_geometry(1.0 / (1 << (geo.levels - 2)));
+    }
+    c->levels = geo.levels;
+    size_t mip = 0;
+    for (int i = 0; i < 1 + kPins && geo.levels > 1; i++) {
+        if (!mip_reserve(&c->mip[i], geo.srcSize, geo.levels)) return 0;
+        mip_update(&c->mip[i], c->capture, capAlloc * 4, geo.srcSize, geo.levels);
+        memset(c->mip[i].view, 0, c->mip[i].viewCap * 4);
+        mip += c->mip[i].bytes;
+    }
+    mem_set("mip", mip);
+
+    c->ruler.direct = !mem_allows(ruler_bytes_for(kScreenH));
+    if (!c->ruler.direct) {
+        if (!ruler_reserve(&c->ruler, kScreenH)) return 0;
+        memset(c->ruler.cols, 0, c->ruler.colsCap * 4);
+    }
+    mem_set("ruler", ruler_bytes(&c->ruler));
+
+    int slots = kSlots;
+    if (!mem_allows((size_t)slots * sizeof(ScopeBins) + (size_t)capAlloc)) slots = 1;
+    if (mem_allows((size_t)slots * sizeof(ScopeBins) + (size_t)capAlloc)) {
+        if (!scope_reserve(&c->scope, slots, capAlloc)) return 0;
+        memset(c->scope.slots, 0, (size_t)slots * sizeof(ScopeBins));
+        memset(c->scope.colOf, 0, (size_t)capAlloc);
+    }
+    mem_set("scope", scope_bytes(&c->scope));
+
+    size_t ref = (size_t)geo.capSize * geo.capSize * 4;
+    if (mem_allows(ref)) {
+        c->refSquare = (uint8_t*)malloc(ref);
+        if (!c->refSquare) return 0;
+        memset(c->refSquare, 0x80, ref);
+        mem_set("reference", ref);
+    }
+    return 1;
+}
+
+static void caches_free(Caches* c) {
+    free(c->loupe);
+    free(c->capture);
+    free(c->shared);
+    for (int i = 0; i < 1 + kPins; i++) mip_free(&c->mip[i]);
+    ruler_free(&c->ruler);
+    scope_free(&c->scope);
+    free(c->refSquare);
+    const char* names[] = { "loupe", "capture", "mip", "ruler", "scope", "reference" };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) mem_set(names[i], 0);
+}
+
+// A cap with room for the frame buffers and the pins' squares but not for a
+// screen-sized capture or every cache: the caches degrade and resident memory
+// stays under it. A generous cap grants them all.
+static void test_caches_under_cap(void) {
+    size_t rss, peak;
+    mem_set("loupe", 0);
+    mem_set("capture", 0);
+    mem_process_rss(&rss, &peak);
+
+    // Reported buffers count on top of the resident set, so the frame
+    // buffers and the squares count twice; 3 MiB is left for the caches.
+    LoupeGeometry geo = caches_geometry(0.25);
+    size_t frame = ((size_t)geo.diameter * geo.diameter + (size_t)geo.capSize * geo.capSize * (kPins + 2)) * 4;
+    size_t room = 2 * frame + (size_t)(3 << 20);
+    size_t cap = (rss + g_mem_total + room) / 7 * 8;
+    mem_set_cap(cap);
+    Caches c;
+    if (!caches_run(&c)) {
+        g_failures++;
+        caches_free(&c);
+        mem_set_cap(0);
+        return;
+    }
+    mem_process_rss(&rss, &peak);
+    printf("  cap %.2f MiB, rss %.2f MiB with caches: %s pin capture, %d mip levels, ruler %s, "
+           "scope %d slots, reference %s\n",
+           cap / 1048576.0, rss / 1048576.0, c.sharedSquares ? "square" : "screen", c.levels,
+           c.ruler.direct ? "direct" : "tiled", c.scope.slotCap, c.refSquare ? "on" : "off");
+    CHECK(rss < cap);
+    CHECK(c.sharedSquares);
+    CHECK(c.levels < 3);
+    CHECK(c.scope.slotCap < kSlots);
+    caches_free(&c);
+
+    mem_set_cap(1024u * 1024 * 1024);
+    if (!caches_run(&c)) g_failures++;
+    CHECK(!c.sharedSquares);
+    CHECK(c.levels == 3);
+    CHECK(!c.ruler.direct);
+    CHECK(c.scope.slotCap == kSlots);
+    CHECK(c.refSquare != NULL);
+    caches_free(&c);
+    mem_set_cap(0);
+}
+
+int main(void) {
+    test_accounting();
+    test_history_budget();
+    test_rss_under_cap();
+    test_caches_under_cap();
+    return test_report("mem");
+}
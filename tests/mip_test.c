@@ -0,0 +1,166 @@
+// Minimal Color Picker - mip pyramid tests.
+// Build/run: make test
+//
+// Each pyramid level must be exactly the 2x2 gamma-correct reduction of the
+// level above, held in the bytes mip_bytes_for() predicts; an update after a
+// one-pixel change must re-reduce only that tile and end up identical to a
+// fresh build; sampling at a power of two must copy one level and between
+// levels must blend in linear light; and wheel steps must land on quarter
+// octaves and return to exact powers of two.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_mip.h"
+#include "test_util.h"
+
+static uint8_t* noise(size_t bytes, uint32_t seed) {
+    uint8_t* px = (uint8_t*)malloc(bytes);
+    uint32_t s = seed * 2654435761u + 1;
+    for (size_t i = 0; px && i < bytes; i++) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        px[i] = (uint8_t)s;
+    }
+    return px;
+}
+
+static void test_levels_and_wheel(void) {
+    CHECK(mip_levels_for_scale(1.0) == 1);
+    CHECK(mip_levels_for_scale(1.5) == 2);
+    CHECK(mip_levels_for_scale(2.0) == 2);
+    CHECK(mip_levels_for_scale(2.1) == 3);
+    CHECK(mip_levels_for_scale(8.0) == 4);
+    CHECK(mip_levels_for_scale(100.0) == MIP_MAX_LEVELS);
+
+    double z = 1.0;
+    for (int i = 0; i < MIP_WHEEL_STEPS; i++) z = zoom_wheel_step(z, 1, 0.125, 64.0);
+    CHECK(z == 2.0);
+    for (int i = 0; i < 3 * MIP_WHEEL_STEPS; i++) z = zoom_wheel_step(z, -1, 0.125, 64.0);
+    CHECK(z == 0.25);
+    CHECK(zoom_wheel_step(0.125, -1, 0.125, 64.0) == 0.125);
+    CHECK(zoom_wheel_step(64.0, 1, 0.125, 64.0) == 64.0);
+    // An odd --zoom value snaps to the nearest quarter octave on the first notch.
+    CHECK(fabs(zoom_wheel_step(3.0, 1, 0.125, 64.0) - exp2(7.0 / 4.0)) < 1e-12);
+}
+
+// Level k must equal downsample_box_bgra(level k-1, 2) over the whole level.
+static int levels_match_reference(const MipPyramid* m) {
+    int ok = 1;
+    for (int k = 1; k < m->levels; k++) {
+        size_t bytes = (size_t)m->size[k] * m->size[k] * 4;
+        uint8_t* want = (uint8_t*)malloc(bytes);
+        static uint32_t acc[4096 * 4];
+        downsample_box_bgra(m->level[k - 1], m->stride[k - 1], want, m->size[k], m->size[k], m->size[k] * 4, 2, acc);
+        ok = ok && want && memcmp(want, m->level[k], bytes) == 0;
+        free(want);
+    }
+    return ok;
+}
+
+static void test_build(int srcSize, int levels) {
+    int size0 = srcSize << (levels - 1);
+    uint8_t* cap = noise((size_t)size0 * size0 * 4, (uint32_t)(srcSize + levels));
+    MipPyramid m;
+    memset(&m, 0, sizeof(m));
+    CHECK(cap && mip_reserve(&m, srcSize, levels));
+    if (!cap || !m.view) {
+        free(cap);
+        return;
+    }
+    CHECK(m.bytes == mip_bytes_for(srcSize, levels));
+    mip_update(&m, cap, size0 * 4, srcSize, levels);
+    CHECK(m.levels == levels && m.size[levels - 1] == srcSize);
+    CHECK(levels_match_reference(&m));
+    int tiles = (size0 + MIP_TILE - 1) / MIP_TILE;
+    CHECK(m.tilesReduced == (uint64_t)(tiles * tiles));
+
+    // Unchanged capture: nothing is reduced again.
+    mip_update(&m, cap, size0 * 4, srcSize, levels);
+    CHECK(m.tilesReduced == (uint64_t)(tiles * tiles));
+    CHECK(m.tilesClean == (uint64_t)(tiles * tiles));
+
+    // One changed pixel: only its tile, and the result matches a fresh build.
+    cap[((size_t)(size0 - 1) * size0 + (size_t)(size0 / 2)) * 4 + 1] ^= 0x5A;
+    mip_update(&m, cap, size0 * 4, srcSize, levels);
+    CHECK(m.tilesReduced == (uint64_t)(tiles * tiles) + 1);
+    MipPyramid fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    CHECK(mip_reserve(&fresh, srcSize, levels));
+    mip_update(&fresh, cap, size0 * 4, srcSize, levels);
+    for (int k = 1; k < levels; k++) {
+        CHECK(memcmp(m.level[k], fresh.level[k], (size_t)m.size[k] * m.size[k] * 4) == 0);
+    }
+    mip_free(&fresh);
+    mip_free(&m);
+    free(cap);
+}
+
+static void test_sample(void) {
+    enum { S = 15, LEVELS = 3, SIZE0 = S << (LEVELS - 1) };
+    uint8_t* cap = noise((size_t)SIZE0 * SIZE0 * 4, 99);
+    MipPyramid m;
+    memset(&m, 0, sizeof(m));
+    CHECK(cap && mip_reserve(&m, S, LEVELS));
+    if (!cap || !m.view) {
+        free(cap);
+        return;
+    }
+    mip_update(&m, cap, SIZE0 * 4, S, LEVELS);
+
+    // Scale 4 on a three-level pyramid is level 2, copied as is.
+    const uint8_t* v = mip_sample(&m, 4.0, S);
+    CHECK(memcmp(v, m.level[2], (size_t)S * S * 4) == 0);
+
+    // Scale 2: the centre S x S of level 1, centred on the cursor pixel.
+    v = mip_sample(&m, 2.0, S);
+    int bad = 0;
+    for (int y = 0; y < S; y++) {
+        for (int x = 0; x < S; x++) {
+            const uint8_t* want = m.level[1] + ((size_t)(y + S / 2 + 1) * m.size[1] + (size_t)(x + S / 2 + 1)) * 4;
+            bad += memcmp(v + ((size_t)y * S + x) * 4, want, 4) != 0;
+        }
+    }
+    CHECK(bad == 0);
+
+    // Between levels every channel lies between the two levels' values.
+    v = mip_sample(&m, 2.8284271247461903, S);
+    int c = S / 2;
+    const uint8_t* a = m.level[1] + ((size_t)(m.size[1] / 2) * m.size[1] + (size_t)(m.size[1] / 2)) * 4;
+    const uint8_t* b = m.level[2] + ((size_t)(m.size[2] / 2) * m.size[2] + (size_t)(m.size[2] / 2)) * 4;
+    const uint8_t* p = v + ((size_t)c * S + c) * 4;
+    for (int ch = 0; ch < 3; ch++) {
+        int lo = a[ch] < b[ch] ? a[ch] : b[ch], hi = a[ch] < b[ch] ? b[ch] : a[ch];
+        CHECK(p[ch] >= lo && p[ch] <= hi);
+    }
+    CHECK(p[3] == 255);
+    mip_free(&m);
+    free(cap);
+
+    // Blending black and white levels halfway is mid grey in linear light.
+    enum { FS = 5, FSIZE0 = FS * 2 };
+    static uint8_t flat[FSIZE0 * FSIZE0 * 4];
+    memset(&m, 0, sizeof(m));
+    CHECK(mip_reserve(&m, FS, 2));
+    for (int i = 0; i < FSIZE0 * FSIZE0; i++) memset(flat + i * 4, (i / FSIZE0 + i % FSIZE0) & 1 ? 255 : 0, 4);
+    mip_update(&m, flat, FSIZE0 * 4, FS, 2);
+    const uint8_t* g = m.level[1];
+    CHECK(g[0] >= 186 && g[0] <= 189);
+    mip_free(&m);
+}
+
+int main(void) {
+    test_levels_and_wheel();
+    test_build(15, 2);
+    test_build(239, 3);
+    test_build(63, 4);
+    test_build(240, 1);
+    test_sample();
+    return test_report("mip");
+}
@@ -0,0 +1,253 @@
+// Minimal Color Picker - onion-skin reference and filtered compose tests.
+// Build/run: make test
+//
+// The tiled cache must round-trip an image, refuse a stale or truncated
+// file, and hand back any square of it, with transparent pixels off the
+// image. The SSE2 blend and difference rows must equal the portable ones,
+// and the compose with the filter fused into the scale must equal a plain
+// compose of a filtered copy of the capture, for any loupe size and band
+// split. CIEDE2000 must match Sharma's published test pairs. The difference
+// amplifier's SSE2 rows must equal its tables, which are rebuilt only when
+// the centre colour changes.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_filter.h"
+#include "../picker_onion.h"
+#include "test_util.h"
+
+static uint32_t image_pixel(int x, int y) {
+    return (uint32_t)((x * 7 + y) & 255) << 24 | (uint32_t)(x & 255) << 16 | (uint32_t)(y & 255) << 8 |
+           (uint32_t)((x ^ y) & 255);
+}
+
+// Writes the cache of a w x h test image and reads the file back whole.
+static uint8_t* make_cache(int w, int h, size_t* size) {
+    uint32_t* img = (uint32_t*)malloc((size_t)w * h * 4);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) img[y * w + x] = image_pixel(x, y);
+    }
+    FILE* fp = tmpfile();
+    CHECK(fp != NULL);
+    if (!fp) exit(1);
+    CHECK(onion_cache_write(fp, (const uint8_t*)img, w, h, 1234, 5678));
+    free(img);
+    *size = (size_t)ftell(fp);
+    uint8_t* map = (uint8_t*)malloc(*size);
+    rewind(fp);
+    CHECK(fread(map, 1, *size, fp) == *size);
+    fclose(fp);
+    return map;
+}
+
+static void test_cache(void) {
+    size_t size;
+    uint8_t* map = make_cache(150, 90, &size);
+    CHECK(size == onion_cache_size(150, 90));
+    CHECK(size == ONION_HEADER + 3 * 2 * ONION_TILE_BYTES);
+
+    OnionRef ref;
+    CHECK(!onion_attach(&ref, map, size, 1235, 5678));  // the PNG changed size
+    CHECK(!onion_attach(&ref, map, size, 1234, 5679));  // or time
+    CHECK(!onion_attach(&ref, map, size - 1, 1234, 5678));
+    CHECK(onion_attach(&ref, map, size, 1234, 5678));
+    CHECK(ref.width == 150 && ref.height == 90 && ref.tilesX == 3 && ref.tilesY == 2);
+
+    // Squares inside, across tile corners, and hanging off every side.
+    static const int kAt[][3] = {
+        { 0, 0, 15 }, { 60, 60, 9 }, { 100, 20, 64 }, { -5, -7, 21 }, { 140, 85, 17 }, { -300, 10, 5 }, { 10, 95, 5 },
+        { 130, -20, 61 },
+    };
+    uint32_t square[64 * 64];
+    for (int k = 0; k < 8; k++) {
+        int x0 = kAt[k][0], y0 = kAt[k][1], n = kAt[k][2];
+        memset(square, 0xAB, sizeof(square));
+        onion_fetch(&ref, x0, y0, n, (uint8_t*)square, n * 4);
+        int bad = 0;
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                int ix = x0 + x, iy = y0 + y;
+                uint32_t want = ix >= 0 && iy >= 0 && ix < 150 && iy < 90 ? image_pixel(ix, iy) : 0;
+                bad += square[y * n + x] != want;
+            }
+        }
+        CHECK(bad == 0);
+    }
+    // The padding of edge tiles is transparent.
+    const uint32_t* lastTile = (const uint32_t*)(map + ONION_HEADER + 5 * ONION_TILE_BYTES);
+    CHECK(lastTile[0] == image_pixel(128, 64) && lastTile[22] == 0 && lastTile[26 * ONION_TILE] == 0);
+    free(map);
+}
+
+static LoupeFilter make_filter(int mode, const uint8_t* ref, int refStride, int opacity) {
+    LoupeFilter f;
+    memset(&f, 0, sizeof(f));
+    f.mode = mode;
+    f.ref = ref;
+    f.refStride = refStride;
+    f.opacity = opacity;
+    return f;
+}
+
+static void test_filter_rows(void) {
+    enum { N = 67 };
+    uint32_t s[N], r[N], a[N], b[N];
+    static const int kOpacity[] = { 0, 1, 32, 64, 100, 127, 128 };
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < N; i++) {
+            s[i] = next_random();
+            r[i] = next_random();
+            if (i % 5 == 0) r[i] |= 0xFF000000u;
+            if (i % 7 == 0) r[i] &= 0x00FFFFFFu;
+        }
+        for (int mode = LOUPE_FILTER_BLEND; mode <= LOUPE_FILTER_DIFF; mode++) {
+            for (int o = 0; o < 7; o++) {
+                LoupeFilter f = make_filter(mode, NULL, 0, kOpacity[o]);
+                filter_row_generic(&f, s, r, a, N);
+                filter_row(&f, s, r, b, N);
+                CHECK(memcmp(a, b, sizeof(a)) == 0);
+            }
+        }
+    }
+
+    // Endpoints: an opaque reference at full weight replaces the live pixel,
+    // a transparent one leaves it, and equal pixels differ by nothing.
+    LoupeFilter blend = make_filter(LOUPE_FILTER_BLEND, NULL, 0, 128);
+    LoupeFilter diff = make_filter(LOUPE_FILTER_DIFF, NULL, 0, 0);
+    CHECK(filter_pixel(0x00123456u, 0xFFABCDEFu, blend.mode, blend.opacity) == 0xFFABCDEFu);
+    CHECK(filter_pixel(0x00123456u, 0x00ABCDEFu, blend.mode, blend.opacity) == 0xFF123456u);
+    CHECK(filter_pixel(0xFF808080u, 0xFFFFFFFFu, LOUPE_FILTER_BLEND, 64) == 0xFFC0C0C0u);
+    CHECK(filter_pixel(0xFFFEFEFEu, 0xFFFFFFFFu, diff.mode, diff.opacity) == 0xFF010101u);
+    CHECK(filter_pixel(0xFF102030u, 0xFF302010u, diff.mode, diff.opacity) == 0xFF200020u);
+    CHECK(filter_pixel(0xFF102030u, 0x00302010u, diff.mode, diff.opacity) == 0xFF000000u);
+}
+
+static void test_fused_compose(void) {
+    static const int kCases[][2] = { { 15, 60 }, { 16, 60 }, { 31, 120 }, { 9, 7 }, { 41, 16 }, { 1, 20 } };
+    for (int c = 0; c < 6; c++) {
+        int n = kCases[c][0], radius = kCases[c][1], d = radius * 2, stride = d * 4 + 12;
+        uint32_t* cap = (uint32_t*)malloc((size_t)n * n * 4);
+        uint32_t* ref = (uint32_t*)malloc((size_t)n * n * 4);
+        uint32_t* filtered = (uint32_t*)malloc((size_t)n * n * 4);
+        uint8_t* want = (uint8_t*)malloc((size_t)d * stride);
+        uint8_t* got = (uint8_t*)malloc((size_t)d * stride);
+        for (int i = 0; i < n * n; i++) {
+            cap[i] = next_random();
+            ref[i] = next_random() | (i % 3 ? 0xFF000000u : 0);
+        }
+        for (int mode = LOUPE_FILTER_NONE; mode <= LOUPE_FILTER_AMPLIFY; mode++) {
+            LoupeFilter f = make_filter(mode, (const uint8_t*)ref, n * 4, 80);
+            if (mode == LOUPE_FILTER_AMPLIFY) {
+                f.ref = NULL;
+                filter_amplify(&f, cap[n * n / 2], 40);
+            }
+            for (int i = 0; i < n * n; i++) {
+                filtered[i] = mode == LOUPE_FILTER_NONE      ? cap[i]
+                            : mode == LOUPE_FILTER_AMPLIFY ? filter_amplify_pixel(&f, cap[i])
+                                                           : filter_pixel(cap[i], ref[i], mode, f.opacity);
+            }
+            memset(want, 0x5A, (size_t)d * stride);
+            memset(got, 0x5A, (size_t)d * stride);
+            compose_loupe_rows((const uint8_t*)filtered, n, n * 4, want, radius, stride, 3, 1, 9, 0, d);
+            // In uneven bands, as the pool splits it.
+            for (int y = 0; y < d; y += 13) {
+                compose_loupe_filtered_rows(&f, (const uint8_t*)cap, n, n * 4, got, radius, stride, 3, 1, 9, y,
+                                            y + 13);
+            }
+            CHECK(memcmp(want, got, (size_t)d * stride) == 0);
+        }
+        free(cap);
+        free(ref);
+        free(filtered);
+        free(want);
+        free(got);
+    }
+}
+
+static void test_amplify(void) {
+    static LoupeFilter f;
+    CHECK(filter_amplify(&f, 0xFFFFFFFFu, 8) == 1);
+    CHECK(f.mode == LOUPE_FILTER_AMPLIFY && f.gain == 16);
+    // #FEFEFE beside #FFFFFF: grey a full 16 levels apart, the centre at 128.
+    CHECK(filter_amplify_pixel(&f, 0x00FFFFFFu) == 0xFF808080u);
+    CHECK(filter_amplify_pixel(&f, 0xFFFEFEFEu) == 0xFF707070u);
+    CHECK(filter_amplify_pixel(&f, 0xFFF9FFFFu) == 0xFF208080u);
+    CHECK(filter_amplify_pixel(&f, 0xFF000000u) == 0xFF000000u);  // far below: black
+    // The same centre and range keep the tables; alpha does not count.
+    CHECK(filter_amplify(&f, 0x00FFFFFFu, 8) == 0);
+    CHECK(filter_amplify(&f, 0xFFFFFFFEu, 8) == 1);
+    CHECK(filter_amplify(&f, 0xFFFFFFFEu, 4) == 1 && f.gain == 32);
+    CHECK(filter_amplify(&f, 0xFF102030u, 0) == 1 && f.gain == 128);  // range 1
+    CHECK(filter_amplify_pixel(&f, 0xFF112031u) == 0xFFFF80FFu);
+    CHECK(filter_amplify_pixel(&f, 0xFF0F202Fu) == 0xFF008000u);
+
+    // SSE2 against the tables, centre colours near both ends and the middle.
+    enum { N = 67 };
+    uint32_t s[N], a[N], b[N];
+    static const int kRange[] = { 1, 2, 3, 8, 40, 128 };
+    for (int round = 0; round < 60; round++) {
+        uint32_t centre = round % 3 == 0 ? 0xFFFFFFFFu : round % 3 == 1 ? 0xFF000000u : next_random();
+        CHECK(filter_amplify(&f, centre, kRange[round % 6]));
+        for (int i = 0; i < N; i++) s[i] = i % 4 ? next_random() : centre ^ (next_random() & 0x070707u);
+        filter_row_generic(&f, s, NULL, a, N);
+        filter_row(&f, s, NULL, b, N);
+        CHECK(memcmp(a, b, sizeof(a)) == 0);
+    }
+}
+
+static void test_delta_e(void) {
+    // Sharma, Wu and Dalal (2005), pairs 1, 7, 11, 13, 17 and 25.
+    static const double kPairs[][7] = {
+        { 50.0, 2.6772, -79.7751, 50.0, 0.0, -82.7485, 2.0425 },
+        { 50.0, 0.0, 0.0, 50.0, -1.0, 2.0, 2.3669 },
+        { 50.0, 2.49, -0.001, 50.0, -2.49, 0.0009, 7.1792 },
+        { 50.0, 2.49, -0.001, 50.0, -2.49, 0.0011, 7.2195 },
+        { 50.0, 2.5, 0.0, 73.0, 25.0, -18.0, 27.1492 },
+        { 60.2574, -34.0099, 36.2677, 60.4626, -34.1751, 39.4387, 1.2644 },
+    };
+    for (int i = 0; i < 6; i++) {
+        double de = onion_delta_e2000(kPairs[i], kPairs[i] + 3);
+        CHECK(fabs(de - kPairs[i][6]) < 1e-4);
+        CHECK(fabs(onion_delta_e2000(kPairs[i] + 3, kPairs[i]) - de) < 1e-9);
+    }
+
+    double lab[3];
+    onion_lab(0xFFFFFFFFu, lab);
+    CHECK(fabs(lab[0] - 100.0) < 1e-3 && fabs(lab[1]) < 1e-3 && fabs(lab[2]) < 1e-3);
+    CHECK(onion_delta_e(0xFF3366CCu, 0x003366CCu) == 0.0);  // alpha is not a colour
+    double near = onion_delta_e(0xFFFEFEFEu, 0xFFFFFFFFu);
+    CHECK(near > 0.1 && near < 1.0);
+    CHECK(fabs(onion_delta_e(0xFF000000u, 0xFFFFFFFFu) - 100.0) < 1e-3);
+}
+
+static void test_label(void) {
+    enum { R = 60, D = R * 2 };
+    static uint32_t loupe[D * D];
+    for (int i = 0; i < D * D; i++) loupe[i] = 0xFF808080u;
+    onion_draw_delta_e((uint8_t*)loupe, R, D * 4, 12.34, 3, 2);
+    int white = 0, dark = 0, above = 0;
+    for (int y = 0; y < D; y++) {
+        for (int x = 0; x < D; x++) {
+            uint32_t p = loupe[y * D + x];
+            white += p == 0xFFFFFFFFu;
+            dark += p == RULER_LABEL_BG;
+            above += p != 0xFF808080u && y < R;
+        }
+    }
+    CHECK(white > 0 && dark > white && above == 0);  // "12.3" under the centre
+}
+
+int main(void) {
+    g_seed = 0x0510A;
+    test_cache();
+    test_filter_rows();
+    test_fused_compose();
+    test_amplify();
+    test_delta_e();
+    test_label();
+    return test_report("onion");
+}
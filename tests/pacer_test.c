@@ -0,0 +1,103 @@
+// Minimal Color Picker - frame pacer tests (synthetic clock).
+// Build/run: make test
+//
+// Drives picker_pacer.h with made-up tick times and frame durations and checks
+// jank counting and the quality-level state machine: step down under load,
+// skip ticks at the lowest level, step back up once there is headroom.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+
+#include "../picker_pacer.h"
+#include "test_util.h"
+
+static const double kBudget = 16.0;
+
+// Runs `ticks` timer ticks spaced `interval` ms apart; rendered frames take
+// `work` ms. Returns the time after the last tick.
+static double run(FramePacer* p, double t, int ticks, double interval, double work) {
+    for (int i = 0; i < ticks; i++) {
+        t += interval;
+        if (pacer_tick(p, t)) {
+            pacer_frame_begin(p, t);
+            pacer_frame_end(p, t + work);
+        }
+    }
+    return t;
+}
+
+static void test_steady(void) {
+    FramePacer p;
+    pacer_init(&p, kBudget);
+    run(&p, 0.0, 600, kBudget, 2.0);
+    CHECK(p.level == PACER_FULL);
+    CHECK(p.frames == 600);
+    CHECK(p.slowFrames == 0 && p.lateTicks == 0 && p.stepsDown == 0);
+    CHECK(p.framesAtLevel[PACER_FULL] == 600);
+}
+
+static void test_timer_granularity_is_not_jank(void) {
+    // A 16 ms WM_TIMER on the default 15.6 ms clock fires at ~15.6 or ~31.2 ms.
+    FramePacer p;
+    pacer_init(&p, kBudget);
+    double t = 0.0;
+    for (int i = 0; i < 200; i++) t = run(&p, t, 1, (i & 1) ? 31.2 : 15.6, 2.0);
+    CHECK(p.lateTicks == 0);
+    CHECK(p.level == PACER_FULL);
+}
+
+static void test_degrade_and_recover(void) {
+    FramePacer p;
+    pacer_init(&p, kBudget);
+
+    // Heavy frames: each step down takes PACER_BEHIND_FRAMES frames behind.
+    double t = run(&p, 0.0, PACER_BEHIND_FRAMES, kBudget, 14.0);
+    CHECK(p.level == PACER_NO_AA);
+    CHECK(!pacer_antialias(&p));
+    t = run(&p, t, PACER_BEHIND_FRAMES, kBudget, 14.0);
+    CHECK(p.level == PACER_HALF_RATE);
+    CHECK(p.stepsDown == 2);
+
+    // Lowest level renders every other tick and never steps further down.
+    uint64_t framesBefore = p.frames;
+    t = run(&p, t, 100, kBudget, 20.0);
+    CHECK(p.level == PACER_HALF_RATE);
+    CHECK(p.frames - framesBefore == 50);
+    CHECK(p.skippedTicks == 50);
+    CHECK(p.slowFrames == 50);
+
+    // Headroom: one level back up per PACER_HEADROOM_FRAMES relaxed frames.
+    t = run(&p, t, PACER_HEADROOM_FRAMES * 2, kBudget, 1.0);
+    CHECK(p.level == PACER_NO_AA);
+    run(&p, t, PACER_HEADROOM_FRAMES, kBudget, 1.0);
+    CHECK(p.level == PACER_FULL);
+    CHECK(p.stepsUp == 2);
+}
+
+static void test_late_ticks(void) {
+    FramePacer p;
+    pacer_init(&p, kBudget);
+    double t = run(&p, 0.0, 10, kBudget, 1.0);
+
+    // One stall of 50 ms: counted, about two ticks lost, but a single late tick
+    // is not enough to change quality.
+    t = run(&p, t, 1, 50.0, 1.0);
+    CHECK(p.lateTicks == 1);
+    CHECK(p.missedTicks == 2);
+    CHECK(p.worstIntervalMs == 50.0);
+    CHECK(p.level == PACER_FULL);
+
+    // Sustained stalls step down even though the frames themselves are cheap.
+    run(&p, t, PACER_BEHIND_FRAMES, 60.0, 1.0);
+    CHECK(p.level == PACER_NO_AA);
+    CHECK(p.slowFrames == 0);
+}
+
+int main(void) {
+    test_steady();
+    test_timer_granularity_is_not_jank();
+    test_degrade_and_recover();
+    test_late_ticks();
+    return test_report("pacer");
+}
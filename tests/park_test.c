@@ -0,0 +1,97 @@
+// Minimal Color Picker - idle parking tests.
+// Build/run: make test
+//
+// Drives picker_park.h with synthetic cursor positions and capture hashes:
+// park after enough identical frames, stay parked while polls see nothing
+// new, wake on input or on changed pixels, and never park when disabled.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+
+#include "../picker_park.h"
+#include "test_util.h"
+
+// Renders `n` identical frames 16 ms apart; returns how many asked to park.
+static int still_frames(IdleParker* p, int n, double* t, uint64_t hash) {
+    int parks = 0;
+    for (int i = 0; i < n; i++) {
+        *t += 16.0;
+        parks += park_after_frame(p, 100, 200, hash, *t);
+    }
+    return parks;
+}
+
+static void test_parks_when_still(void) {
+    IdleParker p;
+    park_init(&p, 1);
+    double t = 0.0;
+    // The first frame only establishes the reference.
+    CHECK(still_frames(&p, PARK_STILL_FRAMES, &t, 42) == 0);
+    CHECK(!p.parked);
+    CHECK(still_frames(&p, 1, &t, 42) == 1);
+    CHECK(p.parked && p.parks == 1);
+
+    // Polls with nothing new keep it parked and accumulate parked time.
+    for (int i = 0; i < 8; i++) {
+        t += PARK_POLL_MS;
+        CHECK(park_poll(&p, 100, 200, 42, t) == 0);
+    }
+    CHECK(p.parked);
+    CHECK(park_total_ms(&p, t) == 8 * PARK_POLL_MS);
+}
+
+static void test_changes_reset_the_count(void) {
+    IdleParker p;
+    park_init(&p, 1);
+    double t = 0.0;
+    for (int i = 0; i < PARK_STILL_FRAMES * 3; i++) {
+        t += 16.0;
+        // Content changes every 10 frames: never still for long enough.
+        CHECK(park_after_frame(&p, 100, 200, (uint64_t)(i / 10), t) == 0);
+    }
+    CHECK(p.parks == 0);
+}
+
+static void test_wakes(void) {
+    IdleParker p;
+    park_init(&p, 1);
+    double t = 0.0;
+    still_frames(&p, PARK_STILL_FRAMES + 1, &t, 7);
+    CHECK(p.parked);
+
+    t += 1000.0;
+    CHECK(park_wake(&p, t) == 1);
+    CHECK(!p.parked && p.inputWakes == 1);
+    CHECK(park_wake(&p, t) == 0);  // already awake
+    CHECK(park_total_ms(&p, t) == 1000.0);
+
+    // Parks again, then the pixels under the cursor change.
+    still_frames(&p, PARK_STILL_FRAMES + 1, &t, 7);
+    CHECK(p.parked);
+    t += PARK_POLL_MS;
+    CHECK(park_poll(&p, 100, 200, 8, t) == 1);
+    CHECK(!p.parked && p.damageWakes == 1);
+
+    // And the cursor moving counts as damage too, if no input event was seen.
+    still_frames(&p, PARK_STILL_FRAMES + 1, &t, 8);
+    t += PARK_POLL_MS;
+    CHECK(park_poll(&p, 101, 200, 8, t) == 1);
+    CHECK(p.damageWakes == 2);
+}
+
+static void test_disabled(void) {
+    IdleParker p;
+    park_init(&p, 0);
+    double t = 0.0;
+    CHECK(still_frames(&p, PARK_STILL_FRAMES * 4, &t, 1) == 0);
+    CHECK(!p.parked);
+}
+
+int main(void) {
+    test_parks_when_still();
+    test_changes_reset_the_count();
+    test_wakes();
+    test_disabled();
+    return test_report("park");
+}
@@ -0,0 +1,251 @@
+// Minimal Color Picker - PNG decoder tests.
+// Build/run: make test
+//
+// Small PNGs written by Python's zlib (fixed, dynamic and stored deflate
+// blocks, every row filter, IDAT split across chunks) must decode to the
+// pixels they were made from: RGB, RGBA, palette with tRNS, 16-bit grey with
+// alpha and grey with a transparent colour key. Damaged files must fail.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_png.h"
+#include "test_util.h"
+
+// Generated with Python: each row uses filter y % 5, and the image data is
+// split over two IDAT chunks.
+static const uint8_t kRgbFixed[312] = {
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x07, 0x08, 0x02, 0x00, 0x00, 0x00, 0x5C, 0x12, 0x50,
+    0x4D, 0x00, 0x00, 0x00, 0x79, 0x49, 0x44, 0x41, 0x54, 0x78, 0x01, 0x63, 0x60, 0x60, 0x60, 0x50,
+    0x65, 0x65, 0xF0, 0xE2, 0x62, 0xC8, 0xE7, 0x67, 0x98, 0x22, 0xC2, 0xB0, 0x53, 0x92, 0xE1, 0x9E,
+    0x1C, 0x03, 0xB3, 0x32, 0x83, 0x86, 0x06, 0x83, 0xAF, 0x2E, 0x43, 0x91, 0x11, 0xC3, 0x74, 0x73,
+    0x86, 0x3D, 0x36, 0x0C, 0x8C, 0xDC, 0xB2, 0x0C, 0xAA, 0xBF, 0x99, 0x55, 0xFF, 0x33, 0x83, 0xC8,
+    0xEF, 0xCC, 0x50, 0xB6, 0x35, 0x12, 0x1B, 0x2C, 0xCE, 0x04, 0x54, 0xC7, 0xAD, 0xCE, 0xCC, 0x2D,
+    0xC9, 0xC6, 0xAD, 0xCC, 0xC9, 0xAD, 0xCA, 0xC3, 0x2D, 0xCF, 0xCF, 0xAD, 0x28, 0xC4, 0x7D, 0x5B,
+    0x94, 0xFB, 0xAE, 0x04, 0xF7, 0x73, 0x69, 0xEE, 0x9B, 0x72, 0xDC, 0x8F, 0x15, 0xB9, 0x9F, 0xAA,
+    0x30, 0x8B, 0x59, 0x31, 0x48, 0xB0, 0xB3, 0x49, 0xC8, 0x70, 0x48, 0xF0, 0x73, 0x4A, 0x30, 0x70,
+    0x4B, 0x48, 0x57, 0xC3, 0xC9, 0x3A, 0x00, 0x00, 0x00, 0x7A, 0x49, 0x44, 0x41, 0x54, 0xF3, 0x48,
+    0x08, 0xF0, 0xCD, 0x70, 0xE6, 0x97, 0xB0, 0x11, 0x94, 0xD0, 0x17, 0x92, 0x50, 0x11, 0x91, 0x50,
+    0x17, 0x95, 0xB0, 0x10, 0x67, 0x01, 0x99, 0xF7, 0x97, 0x99, 0x9B, 0x97, 0x8D, 0xFB, 0x2F, 0x27,
+    0x37, 0x07, 0x0F, 0x37, 0x2F, 0x0F, 0xF7, 0x5F, 0x1E, 0xD5, 0xC7, 0x3C, 0xDC, 0xAC, 0x20, 0x06,
+    0xF7, 0x5B, 0x30, 0xC9, 0xCA, 0xC3, 0x60, 0x3E, 0x91, 0x21, 0x66, 0x0A, 0x7F, 0xE3, 0x6C, 0xB9,
+    0x65, 0xF3, 0x74, 0x4F, 0xB7, 0xDA, 0x7C, 0xE8, 0xF0, 0x16, 0xED, 0x8F, 0xB2, 0xDA, 0x94, 0x19,
+    0xBF, 0xB3, 0xA2, 0x65, 0x4F, 0xFB, 0xCA, 0xC5, 0xD3, 0xCE, 0x2D, 0x5B, 0xFA, 0x79, 0xED, 0x16,
+    0x46, 0xA7, 0x75, 0x0C, 0xAA, 0x7F, 0x85, 0x54, 0x7F, 0x0A, 0x81, 0x48, 0x49, 0x21, 0x28, 0xFB,
+    0x2E, 0xBA, 0x08, 0x00, 0x08, 0x45, 0x49, 0x01, 0x31, 0x50, 0xA7, 0xBC, 0x00, 0x00, 0x00, 0x00,
+    0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82,
+};
+
+static const uint8_t kRgbaDynamic[664] = {
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x0A, 0x08, 0x06, 0x00, 0x00, 0x00, 0xB4, 0x55, 0x7E,
+    0xE6, 0x00, 0x00, 0x01, 0x29, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0x75, 0x92, 0x5F, 0x48, 0x53,
+    0x71, 0x14, 0xC7, 0x8F, 0x2D, 0x77, 0x37, 0xCF, 0xDC, 0xCD, 0xB9, 0xE5, 0x99, 0xD7, 0x4D, 0xE7,
+    0x76, 0x9B, 0x1A, 0x23, 0x7F, 0x06, 0xCD, 0x74, 0x15, 0x15, 0xF9, 0x90, 0x09, 0x3E, 0xD4, 0x8B,
+    0xBF, 0x86, 0xA0, 0xF4, 0xE0, 0x53, 0x11, 0x44, 0x3D, 0x05, 0x51, 0x62, 0x6F, 0x11, 0x48, 0x0D,
+    0x87, 0xBE, 0x0C, 0x85, 0xA0, 0x82, 0x5F, 0x44, 0x20, 0x08, 0x11, 0x09, 0x06, 0xC2, 0xFA, 0x03,
+    0x11, 0xE5, 0x0C, 0x64, 0x44, 0x18, 0x04, 0xF6, 0x87, 0xFE, 0x8D, 0xB1, 0xCE, 0xCD, 0x15, 0x12,
+    0x78, 0xE1, 0xCB, 0xF7, 0x7C, 0xCF, 0xF9, 0x9D, 0xCB, 0x8F, 0xFB, 0xB9, 0x00, 0xFC, 0x98, 0x95,
+    0xA0, 0x1D, 0xAD, 0x02, 0xF7, 0x69, 0x1D, 0x7C, 0xE3, 0x5E, 0x68, 0x98, 0xF5, 0x43, 0xF8, 0x6D,
+    0x10, 0xDA, 0x6C, 0x61, 0x10, 0x2D, 0x2D, 0xD0, 0xD9, 0x17, 0x83, 0x03, 0x67, 0x3B, 0xA0, 0xE7,
+    0x66, 0x1C, 0xFA, 0xE6, 0x12, 0x70, 0x7C, 0xE5, 0x20, 0x48, 0x7B, 0x0F, 0x0C, 0xED, 0xEC, 0x85,
+    0x91, 0xFE, 0x7E, 0x38, 0x73, 0xEE, 0x04, 0x9C, 0x9F, 0x18, 0x80, 0x8B, 0x0F, 0x07, 0x61, 0xB4,
+    0x02, 0x03, 0x20, 0xCD, 0x82, 0x4D, 0x33, 0x4B, 0x2C, 0xCB, 0xBF, 0x97, 0xDD, 0xCA, 0xDD, 0xFF,
+    0xE5, 0xBF, 0xF3, 0xEE, 0x4D, 0xCE, 0xB3, 0x6F, 0xB1, 0x5E, 0x88, 0x51, 0x9B, 0x44, 0xBF, 0x5D,
+    0x62, 0xD8, 0x29, 0xD1, 0x74, 0x49, 0x6C, 0xD4, 0x25, 0x86, 0x3C, 0x12, 0x97, 0x7C, 0x12, 0x97,
+    0x49, 0xE2, 0x7B, 0x43, 0xE2, 0xEB, 0xA0, 0xC4, 0x7C, 0x48, 0xE2, 0xBB, 0x08, 0xCF, 0xA3, 0x3C,
+    0x6F, 0x93, 0x68, 0xC4, 0x24, 0x06, 0xDA, 0x79, 0x7F, 0x37, 0xEF, 0xEF, 0xE1, 0xFD, 0xBD, 0xD2,
+    0xB6, 0xBD, 0x0B, 0x1E, 0x90, 0x66, 0x57, 0xD4, 0xE0, 0x50, 0xA4, 0x3B, 0x15, 0x01, 0x2A, 0x32,
+    0x5C, 0x8A, 0xB6, 0xB9, 0x55, 0xEA, 0xB0, 0xAE, 0x28, 0x51, 0xA3, 0x68, 0x97, 0x47, 0x51, 0xC4,
+    0xAB, 0x28, 0xEA, 0x13, 0xD4, 0x59, 0x27, 0x28, 0x43, 0x82, 0x9E, 0xD4, 0x0B, 0x5A, 0x32, 0x04,
+    0xCD, 0x07, 0xEB, 0x5C, 0xA8, 0xD2, 0x00, 0x00, 0x01, 0x2A, 0x49, 0x44, 0x41, 0x54, 0x04, 0x2D,
+    0x04, 0x05, 0xE5, 0x9A, 0x04, 0x3D, 0x0D, 0x89, 0xAD, 0x7F, 0x6E, 0x58, 0xB4, 0x69, 0x58, 0x6D,
+    0xD7, 0xB0, 0xE8, 0xD4, 0xD0, 0xE1, 0xE2, 0x9A, 0x55, 0x74, 0x69, 0x66, 0x9E, 0xBD, 0x72, 0xBD,
+    0xC6, 0x8F, 0x65, 0xB7, 0x72, 0x63, 0xB9, 0xB6, 0xCE, 0x39, 0x36, 0xD4, 0xEC, 0x10, 0xBF, 0x0E,
+    0x0B, 0x27, 0xC7, 0xF5, 0xEC, 0xA5, 0x74, 0xF0, 0xE5, 0xCC, 0x54, 0x2C, 0xB7, 0x38, 0x9A, 0xC8,
+    0xAF, 0x5D, 0xED, 0xFD, 0xE0, 0xBB, 0x36, 0xF0, 0xA9, 0xEB, 0xDE, 0xC8, 0x8F, 0xC1, 0xD9, 0x0B,
+    0xA5, 0x2B, 0x73, 0x63, 0xF6, 0x5B, 0x99, 0x1B, 0xD5, 0xD9, 0x99, 0x69, 0xEF, 0x97, 0x3B, 0xF7,
+    0x0D, 0x7A, 0xF6, 0xB8, 0x79, 0xDF, 0xAB, 0x17, 0xAD, 0x43, 0x6F, 0x56, 0xDA, 0xC7, 0x1E, 0xAD,
+    0xC5, 0x6F, 0xCF, 0x97, 0xF6, 0x3F, 0x5F, 0x74, 0x1F, 0xF9, 0x96, 0x0D, 0x1C, 0xAB, 0x38, 0x74,
+    0x17, 0x9A, 0xCD, 0xA2, 0x47, 0x33, 0x7F, 0xB2, 0x2C, 0xF7, 0x97, 0xDD, 0xCA, 0xCB, 0x9B, 0xF4,
+    0x93, 0x9B, 0xF4, 0xD9, 0xD7, 0xA1, 0x84, 0x19, 0x4A, 0x60, 0x03, 0x14, 0x83, 0xA1, 0x98, 0x0C,
+    0x45, 0x32, 0x94, 0x24, 0x43, 0x19, 0x66, 0x28, 0x49, 0x86, 0x32, 0xCC, 0x50, 0x4E, 0x31, 0x94,
+    0x34, 0x43, 0x99, 0x66, 0x28, 0x69, 0x86, 0x32, 0xC9, 0x50, 0x32, 0x0C, 0x65, 0x92, 0xA1, 0x64,
+    0x18, 0x4A, 0xC7, 0x65, 0x98, 0x20, 0x8F, 0x5B, 0x10, 0xEA, 0x82, 0xBC, 0x35, 0x82, 0xFC, 0x1E,
+    0x91, 0xAA, 0xF2, 0x0A, 0xAA, 0x65, 0x00, 0xB9, 0x3A, 0x45, 0xAB, 0xA4, 0xE8, 0x73, 0xBD, 0xA2,
+    0x82, 0xA1, 0xE8, 0x6B, 0x40, 0xA5, 0x56, 0xA7, 0x14, 0xFD, 0x6A, 0x52, 0x54, 0x1B, 0x52, 0xE4,
+    0x0A, 0x2B, 0xF2, 0x47, 0x14, 0x79, 0x76, 0x28, 0xC2, 0xA8, 0x4A, 0x79, 0x5B, 0xCB, 0x50, 0xF8,
+    0xFF, 0x41, 0x9D, 0xA1, 0x14, 0x18, 0x8A, 0xC6, 0x1F, 0x17, 0x75, 0x0D, 0x4B, 0x7C, 0x43, 0xF4,
+    0x71, 0x26, 0xEE, 0x1B, 0x3C, 0x67, 0x15, 0x42, 0x9C, 0xD9, 0x91, 0x55, 0x2A, 0xBB, 0x95, 0xFF,
+    0xCD, 0x0D, 0xED, 0x37, 0xF6, 0x78, 0xCF, 0x55, 0x10, 0x7F, 0x67, 0xF7, 0x00, 0x00, 0x00, 0x00,
+    0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82,
+};
+
+static const uint8_t kPaletteStored[222] = {
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x07, 0x08, 0x03, 0x00, 0x00, 0x00, 0xE4, 0xAE, 0x37,
+    0x28, 0x00, 0x00, 0x00, 0x12, 0x50, 0x4C, 0x54, 0x45, 0x0A, 0x14, 0x1E, 0xC8, 0x64, 0x32, 0x00,
+    0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x01, 0x02, 0x03, 0x5A, 0x50, 0x46, 0xE9, 0xFC, 0x5B, 0x36, 0x00,
+    0x00, 0x00, 0x02, 0x74, 0x52, 0x4E, 0x53, 0x00, 0x80, 0x9B, 0x2B, 0x4E, 0x18, 0x00, 0x00, 0x00,
+    0x36, 0x49, 0x44, 0x41, 0x54, 0x78, 0x01, 0x01, 0x62, 0x00, 0x9D, 0xFF, 0x00, 0x00, 0x01, 0x02,
+    0x03, 0x04, 0x05, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0xFB, 0x01, 0x01, 0x01, 0x01, 0x01, 0xFB, 0x01, 0x02, 0x01, 0x01, 0x01, 0x01, 0xFB, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0xFB, 0x01, 0x01, 0x03, 0x02, 0x01, 0x01, 0xFB, 0xF7, 0xB3, 0x36, 0xD8, 0x00,
+    0x00, 0x00, 0x37, 0x49, 0x44, 0x41, 0x54, 0x01, 0x01, 0x01, 0x01, 0x01, 0xFB, 0x01, 0x01, 0x01,
+    0x04, 0x01, 0x01, 0xFB, 0x01, 0x01, 0x01, 0x01, 0x01, 0xFB, 0x01, 0x01, 0x01, 0x01, 0x00, 0x05,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x01, 0x00, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0xFB, 0x01, 0x01, 0x01, 0x01, 0x01, 0xFB, 0xD5, 0x5D, 0x0A, 0x52, 0xCD, 0x4D,
+    0xB8, 0x86, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82,
+};
+
+static const uint8_t kGreyAlpha16[372] = {
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x07, 0x10, 0x04, 0x00, 0x00, 0x00, 0x29, 0xE9, 0xD3,
+    0xD2, 0x00, 0x00, 0x00, 0x97, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0x63, 0x60, 0x00, 0x02, 0x55,
+    0x56, 0x76, 0x06, 0x2F, 0x2E, 0x3E, 0x86, 0x7C, 0x7E, 0x51, 0x86, 0x29, 0x22, 0x32, 0x0C, 0x3B,
+    0x25, 0x95, 0x19, 0xEE, 0xC9, 0x69, 0x31, 0x30, 0x2B, 0x1B, 0x32, 0x68, 0x68, 0x58, 0x30, 0xF8,
+    0xEA, 0xDA, 0x33, 0x14, 0x19, 0xB9, 0x31, 0x4C, 0x37, 0xF7, 0x65, 0xD8, 0x63, 0x13, 0xC2, 0xC0,
+    0xC8, 0x2D, 0x1B, 0xCD, 0xA0, 0xFA, 0x9B, 0x9D, 0x59, 0xF5, 0x3F, 0x10, 0x83, 0xE8, 0xEF, 0x50,
+    0x1A, 0xC4, 0xB7, 0x46, 0xE3, 0x43, 0xE5, 0x99, 0x40, 0x9A, 0xB8, 0xD5, 0xA3, 0x99, 0xB9, 0x25,
+    0xA3, 0xD9, 0xB8, 0x95, 0xA3, 0x39, 0xB9, 0x55, 0xA3, 0x79, 0xB8, 0xE5, 0xA3, 0xF9, 0xB9, 0x15,
+    0xA3, 0x85, 0xB8, 0x6F, 0x47, 0x8B, 0x72, 0xDF, 0x8D, 0x96, 0xE0, 0x7E, 0x1E, 0x2D, 0xCD, 0x7D,
+    0x33, 0x5A, 0x8E, 0xFB, 0x71, 0xB4, 0x22, 0xF7, 0xD3, 0x68, 0x15, 0x66, 0x31, 0xAB, 0x6D, 0x0C,
+    0x12, 0xEC, 0x1B, 0xD9, 0x24, 0x64, 0x36, 0x72, 0x48, 0xF0, 0x6F, 0xE4, 0x94, 0x60, 0xD8, 0xC8,
+    0x2F, 0x4A, 0x13, 0x44, 0x00, 0x00, 0x00, 0x98, 0x49, 0x44, 0x41, 0x54, 0x2D, 0x21, 0xBD, 0x91,
+    0x47, 0x42, 0x60, 0x23, 0xDF, 0x0C, 0xE7, 0x8D, 0xFC, 0x12, 0x36, 0x1B, 0x05, 0x25, 0xF4, 0x37,
+    0x0A, 0x49, 0xA8, 0x6C, 0x14, 0x91, 0x50, 0x37, 0x14, 0x95, 0xB0, 0x30, 0x14, 0x67, 0x01, 0xDB,
+    0xF4, 0x97, 0x9D, 0x99, 0x9B, 0x97, 0x9D, 0x0D, 0x48, 0x73, 0x72, 0x73, 0xB0, 0xF3, 0x00, 0xD9,
+    0x3C, 0x40, 0x36, 0x8F, 0xEA, 0x63, 0x20, 0xCD, 0x0A, 0x61, 0x73, 0xBF, 0x85, 0xD2, 0x40, 0x3E,
+    0x83, 0xF9, 0xC4, 0xE3, 0x0C, 0x31, 0x53, 0xCE, 0xF1, 0x37, 0xCE, 0xBE, 0x2A, 0xB7, 0x6C, 0xDE,
+    0x1D, 0xDD, 0xD3, 0xAD, 0x8F, 0x6D, 0x3E, 0x74, 0xBC, 0xF2, 0x16, 0xED, 0xFF, 0x18, 0x65, 0xB5,
+    0xE9, 0x47, 0x66, 0xFC, 0xCE, 0xFF, 0x15, 0x2D, 0x7B, 0xD8, 0xDA, 0x57, 0x2E, 0xE6, 0x9D, 0x76,
+    0x6E, 0x99, 0xC8, 0xD2, 0xCF, 0x6B, 0xA5, 0xB7, 0x30, 0x3A, 0xAD, 0x53, 0x62, 0x50, 0xFD, 0xCB,
+    0x2E, 0xA4, 0xFA, 0x13, 0x88, 0x41, 0xB4, 0x24, 0x94, 0x06, 0xF1, 0xEF, 0x62, 0x17, 0x07, 0x00,
+    0x24, 0x4F, 0x61, 0xD5, 0xE6, 0x9E, 0x63, 0x99, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44,
+    0xAE, 0x42, 0x60, 0x82,
+};
+
+static const uint8_t kGreyKey[145] = {
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+    0x00, 0x00, 0x00, 0x0D, 0x00, 0x00, 0x00, 0x07, 0x08, 0x00, 0x00, 0x00, 0x00, 0xF6, 0x1B, 0x98,
+    0xC6, 0x00, 0x00, 0x00, 0x02, 0x74, 0x52, 0x4E, 0x53, 0x00, 0x85, 0xEB, 0x41, 0xBA, 0x97, 0x00,
+    0x00, 0x00, 0x1F, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0x63, 0x60, 0x50, 0xF5, 0xCA, 0x9F, 0xB2,
+    0xF3, 0x1E, 0xB3, 0x86, 0x6F, 0xD1, 0xF4, 0x3D, 0x8C, 0xDC, 0xAA, 0x48, 0x80, 0x89, 0x1B, 0x19,
+    0x30, 0x8B, 0x49, 0x80, 0xC1, 0x0C, 0x60, 0x36, 0xD3, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x49, 0x44,
+    0x41, 0x54, 0x30, 0xC9, 0x02, 0x15, 0x55, 0x05, 0x93, 0x0C, 0xE6, 0x31, 0x8D, 0xCB, 0x4E, 0x7F,
+    0x10, 0xB5, 0x8A, 0x6F, 0x59, 0x79, 0xEE, 0x33, 0xA3, 0x13, 0xB2, 0x29, 0x00, 0x90, 0xD3, 0x13,
+    0x16, 0x63, 0xC1, 0xED, 0x01, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60,
+    0x82,
+};
+
+// The sample values the images were made from.
+static int sample_r(int x, int y) { return (x * 37 + y * 11) & 255; }
+static int sample_g(int x, int y) { return ((x * 5) ^ (y * 29)) & 255; }
+static int sample_b(int x, int y) { return (x * y * 3) & 255; }
+static int sample_a(int x, int y) { return ((x + y * 13) * 7) & 255; }
+
+static uint32_t bgra(int r, int g, int b, int a) {
+    return (uint32_t)a << 24 | (uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b;
+}
+
+static const uint32_t* decode(const uint8_t* data, size_t size, int w, int h) {
+    int dw = 0, dh = 0;
+    uint8_t* px = png_decode_bgra(data, size, &dw, &dh);
+    CHECK(px != NULL);
+    if (!px) return NULL;
+    CHECK(dw == w && dh == h);
+    if (dw != w || dh != h) {
+        free(px);
+        return NULL;
+    }
+    return (const uint32_t*)px;
+}
+
+static void test_rgb_rgba(void) {
+    const uint32_t* p = decode(kRgbFixed, sizeof(kRgbFixed), 13, 7);
+    int bad = 0;
+    for (int y = 0; p && y < 7; y++) {
+        for (int x = 0; x < 13; x++) bad += p[y * 13 + x] != bgra(sample_r(x, y), sample_g(x, y), sample_b(x, y), 255);
+    }
+    CHECK(p && bad == 0);
+    free((void*)p);
+
+    p = decode(kRgbaDynamic, sizeof(kRgbaDynamic), 20, 10);
+    bad = 0;
+    for (int y = 0; p && y < 10; y++) {
+        for (int x = 0; x < 20; x++) {
+            bad += p[y * 20 + x] != bgra(sample_r(x, y), sample_g(x, y), sample_b(x, y), sample_a(x, y));
+        }
+    }
+    CHECK(p && bad == 0);
+    free((void*)p);
+}
+
+static void test_palette_grey(void) {
+    static const uint32_t kPalette[6] = {
+        0x000A141Eu, 0x80C86432u, 0xFF00FF00u, 0xFFFFFFFFu, 0xFF010203u, 0xFF5A5046u,
+    };
+    const uint32_t* p = decode(kPaletteStored, sizeof(kPaletteStored), 13, 7);
+    int bad = 0;
+    for (int y = 0; p && y < 7; y++) {
+        for (int x = 0; x < 13; x++) bad += p[y * 13 + x] != kPalette[(x + y) % 6];
+    }
+    CHECK(p && bad == 0);
+    free((void*)p);
+
+    // 16-bit grey + alpha: the high bytes are the samples.
+    p = decode(kGreyAlpha16, sizeof(kGreyAlpha16), 13, 7);
+    bad = 0;
+    for (int y = 0; p && y < 7; y++) {
+        for (int x = 0; x < 13; x++) {
+            int v = sample_r(x, y);
+            bad += p[y * 13 + x] != bgra(v, v, v, sample_a(x, y));
+        }
+    }
+    CHECK(p && bad == 0);
+    free((void*)p);
+
+    // Grey with tRNS: the key's value is transparent wherever it occurs.
+    p = decode(kGreyKey, sizeof(kGreyKey), 13, 7);
+    bad = 0;
+    int keyed = 0;
+    for (int y = 0; p && y < 7; y++) {
+        for (int x = 0; x < 13; x++) {
+            int v = sample_r(x, y), a = v == sample_r(3, 2) ? 0 : 255;
+            keyed += a == 0;
+            bad += p[y * 13 + x] != bgra(v, v, v, a);
+        }
+    }
+    CHECK(p && bad == 0 && keyed >= 1);
+    free((void*)p);
+}
+
+static void test_damaged(void) {
+    int w, h;
+    uint8_t copy[sizeof(kRgbaDynamic)];
+    // Truncated inside the image data.
+    CHECK(png_decode_bgra(kRgbaDynamic, sizeof(kRgbaDynamic) / 2, &w, &h) == NULL);
+    // One flipped bit in the compressed data: the Adler-32 check, or the
+    // stream itself, rejects it.
+    memcpy(copy, kRgbaDynamic, sizeof(copy));
+    copy[sizeof(copy) / 2] ^= 0x10;
+    CHECK(png_decode_bgra(copy, sizeof(copy), &w, &h) == NULL);
+    // Not a PNG.
+    memcpy(copy, kRgbaDynamic, sizeof(copy));
+    copy[1] = 'Q';
+    CHECK(png_decode_bgra(copy, sizeof(copy), &w, &h) == NULL);
+    // Interlaced images are not supported.
+    memcpy(copy, kRgbaDynamic, sizeof(copy));
+    copy[8 + 8 + 12] = 1;
+    CHECK(png_decode_bgra(copy, sizeof(copy), &w, &h) == NULL);
+}
+
+int main(void) {
+    test_rgb_rgba();
+    test_palette_grey();
+    test_damaged();
+    return test_report("png");
+}
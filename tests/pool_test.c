@@ -0,0 +1,224 @@
+// Minimal Color Picker - worker pool and tiled compose tests.
+// Build/run: make test
+//
+// pool_run() must run every task index exactly once, with or without worker
+// threads, across many back-to-back batches; compose_loupe_tiled() must
+// produce byte-identical output to compose_loupe() for loupes that span one
+// band or many, including the 2048 px maximum; compose_loupes_tiled() must
+// match it for every loupe of a mixed batch. pool_run_tiles() must cover every
+// pixel of a region exactly once, cutting edge tiles to fit, and hand each
+// tile a slot no other running participant holds.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../picker_kernels.h"
+#include "../picker_pool.h"
+#include "test_util.h"
+
+#define TASKS 200
+
+typedef struct Counts {
+    volatile long hits[TASKS];
+} Counts;
+
+static void count_task(void* ctx, int index) {
+    Counts* c = (Counts*)ctx;
+    __atomic_add_fetch(&c->hits[index], 1, __ATOMIC_RELAXED);
+}
+
+static void test_every_task_once(int threads) {
+    WorkerPool pool;
+    pool_init(&pool, threads);
+    CHECK(pool.threads == threads);
+    static Counts counts;
+    for (int batch = 0; batch < 500; batch++) {
+        memset((void*)&counts, 0, sizeof(counts));
+        int n = 1 + batch % TASKS;
+        pool_run(&pool, count_task, &counts, n);
+        int bad = 0;
+        for (int i = 0; i < TASKS; i++) bad += counts.hits[i] != (i < n ? 1 : 0);
+        CHECK(bad == 0);
+        if (bad) break;
+    }
+    CHECK(pool.batches == 500);
+    pool_destroy(&pool);
+}
+
+static uint8_t* noise(size_t bytes, uint32_t seed) {
+    uint8_t* px = (uint8_t*)malloc(bytes);
+    uint32_t s = seed * 2654435761u + 1;
+    for (size_t i = 0; px && i < bytes; i++) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        px[i] = (uint8_t)s;
+    }
+    return px;
+}
+
+static void test_tiled_matches(WorkerPool* pool, int radius, int zoom, int antialias) {
+    int d = radius * 2;
+    int capSize = (d / zoom) | 1;
+    int stride = d * 4;
+    uint8_t* cap = noise((size_t)capSize * capSize * 4, (uint32_t)(radius + zoom));
+    uint8_t* want = (uint8_t*)malloc((size_t)d * stride);
+    uint8_t* got = (uint8_t*)malloc((size_t)d * stride);
+    if (!cap || !want || !got) {
+        g_failures++;
+        free(cap);
+        free(want);
+        free(got);
+        return;
+    }
+    memset(got, 0xAB, (size_t)d * stride);
+    compose_loupe(cap, capSize, capSize * 4, want, radius, stride, 2, antialias, 6);
+    compose_loupe_tiled(pool, cap, capSize, capSize * 4, got, radius, stride, 2, antialias, 6);
+    int same = memcmp(want, got, (size_t)d * stride) == 0;
+    if (!same) printf("  tiled compose differs: radius %d zoom %d, %d thread(s)\n", radius, zoom, pool->threads);
+    CHECK(same);
+    free(cap);
+    free(want);
+    free(got);
+}
+
+static void test_tiled(int threads) {
+    WorkerPool pool;
+    pool_init(&pool, threads);
+    test_tiled_matches(&pool, 16, 2, 1);
+    test_tiled_matches(&pool, 120, 8, 1);
+    test_tiled_matches(&pool, 300, 8, 0);
+    test_tiled_matches(&pool, 701, 5, 1);
+    test_tiled_matches(&pool, 1024, 8, 1);
+    test_tiled_matches(&pool, 1024, 1, 1);
+    pool_destroy(&pool);
+}
+
+// Pinned loupes: several loupes of one size, plus more than one batch holds.
+static void test_batch(int threads) {
+    WorkerPool pool;
+    pool_init(&pool, threads);
+    enum { LOUPES = POOL_MAX_LOUPES + 3 };
+    static const int radii[3] = { 120, 64, 600 };
+    LoupeJob jobs[LOUPES];
+    uint8_t* caps[LOUPES];
+    uint8_t* want[LOUPES];
+    uint8_t* got[LOUPES];
+    int ok = 1;
+    for (int i = 0; i < LOUPES; i++) {
+        int radius = radii[i % 3];
+        int d = radius * 2;
+        int capSize = (d / 8) | 1;
+        caps[i] = noise((size_t)capSize * capSize * 4, (uint32_t)(i + 7));
+        want[i] = (uint8_t*)malloc((size_t)d * d * 4);
+        got[i] = (uint8_t*)malloc((size_t)d * d * 4);
+        if (!caps[i] || !want[i] || !got[i]) {
+            ok = 0;
+            continue;
+        }
+        compose_loupe(caps[i], capSize, capSize * 4, want[i], radius, d * 4, 2, i & 1, 6);
+        jobs[i] = loupe_job(caps[i], capSize, capSize * 4, got[i], radius, d * 4, 2, i & 1, 6);
+    }
+    CHECK(ok);
+    if (ok) {
+        uint64_t batches = pool.batches;
+        compose_loupes_tiled(&pool, jobs, LOUPES);
+        CHECK(pool.batches == batches + 2);
+        for (int i = 0; i < LOUPES; i++) {
+            int d = radii[i % 3] * 2;
+            CHECK(memcmp(want[i], got[i], (size_t)d * d * 4) == 0);
+        }
+    }
+    for (int i = 0; i < LOUPES; i++) {
+        free(caps[i]);
+        free(want[i]);
+        free(got[i]);
+    }
+    pool_destroy(&pool);
+}
+
+typedef struct Coverage {
+    int width, height;
+    volatile uint8_t* hits;  // one per pixel
+    volatile long busy[POOL_MAX_SLOTS];
+    volatile long badSlot, badRect, calls;
+} Coverage;
+
+static void cover_tile(void* ctx, int slot, int x, int y, int w, int h) {
+    Coverage* c = (Coverage*)ctx;
+    __atomic_add_fetch(&c->calls, 1, __ATOMIC_RELAXED);
+    if (slot < 0 || slot >= POOL_MAX_SLOTS) {
+        __atomic_add_fetch(&c->badSlot, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    // Two participants in one slot at once would see the other's mark.
+    if (__atomic_add_fetch(&c->busy[slot], 1, __ATOMIC_ACQ_REL) != 1) {
+        __atomic_add_fetch(&c->badSlot, 1, __ATOMIC_RELAXED);
+    }
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > c->width || y + h > c->height) {
+        __atomic_add_fetch(&c->badRect, 1, __ATOMIC_RELAXED);
+    } else {
+        for (int j = y; j < y + h; j++) {
+            for (int i = x; i < x + w; i++) c->hits[(size_t)j * c->width + i]++;
+        }
+    }
+    __atomic_sub_fetch(&c->busy[slot], 1, __ATOMIC_ACQ_REL);
+}
+
+static void test_region(WorkerPool* pool, int width, int height, int tile) {
+    Coverage c;
+    memset((void*)&c, 0, sizeof(c));
+    c.width = width;
+    c.height = height;
+    size_t pixels = (size_t)width * height;
+    c.hits = (volatile uint8_t*)calloc(pixels ? pixels : 1, 1);
+    if (!c.hits) {
+        g_failures++;
+        return;
+    }
+    pool_run_tiles(pool, cover_tile, &c, width, height, tile);
+    size_t bad = 0;
+    for (size_t i = 0; i < pixels; i++) bad += c.hits[i] != 1;
+    long tiles = width > 0 && height > 0 ? (long)((width + tile - 1) / tile) * ((height + tile - 1) / tile) : 0;
+    if (bad || c.calls != tiles) {
+        printf("  tiles %dx%d/%d, %d thread(s): %zu pixels wrong, %ld calls\n", width, height, tile, pool->threads,
+               bad, c.calls);
+    }
+    CHECK(bad == 0 && c.calls == tiles);
+    CHECK(c.badSlot == 0 && c.badRect == 0);
+    free((void*)c.hits);
+}
+
+static void test_tiles(int threads) {
+    WorkerPool pool;
+    pool_init(&pool, threads);
+    CHECK(pool_slots(&pool) == threads + 1);
+    for (int i = 0; i < 50; i++) test_region(&pool, 1000, 700, 64);
+    test_region(&pool, 1024, 512, 128);
+    test_region(&pool, 37, 5, 16);
+    test_region(&pool, 100, 80, 500);  // one tile larger than the region
+    test_region(&pool, 3, 3, 1);
+    uint64_t tiles = pool.tiles;
+    test_region(&pool, 0, 100, 64);
+    test_region(&pool, 100, 0, 64);
+    CHECK(pool.tiles == tiles);
+    CHECK(pool.tiles == 50ull * 16 * 11 + 8 * 4 + 3 * 1 + 1 + 9);
+    if (threads == 0) CHECK(pool.steals == 0);
+    pool_destroy(&pool);
+}
+
+int main(void) {
+    test_every_task_once(0);
+    test_every_task_once(3);
+    test_tiled(0);
+    test_tiled(3);
+    test_batch(0);
+    test_batch(3);
+    test_tiles(0);
+    test_tiles(3);
+    return test_report("pool");
+}
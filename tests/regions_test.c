@@ -0,0 +1,131 @@
+// Minimal Color Picker - shared capture planning tests.
+// Build/run: make test
+//
+// region_plan() must keep every square inside the grab it is assigned to,
+// share a grab between nearby or overlapping squares, keep distant squares
+// in separate grabs, and fall back to one bounding box when the grabs would
+// not fit the buffer. region_view() must find each square's pixels in the
+// packed buffer.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../picker_regions.h"
+#include "test_util.h"
+
+static RegionRect square(int cx, int cy, int size) {
+    RegionRect r = { cx - size / 2, cy - size / 2, size, size };
+    return r;
+}
+
+static int contains(RegionRect outer, RegionRect inner) {
+    return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.w <= outer.x + outer.w &&
+           inner.y + inner.h <= outer.y + outer.h;
+}
+
+static void check_plan(const RegionPlan* plan, const RegionRect* squares, int n) {
+    size_t pixels = 0;
+    for (int g = 0; g < plan->count; g++) {
+        CHECK(plan->offset[g] == pixels);
+        pixels += (size_t)region_area(plan->grabs[g]);
+    }
+    CHECK(plan->pixels == pixels);
+    for (int i = 0; i < n; i++) {
+        CHECK(plan->grabOf[i] >= 0 && plan->grabOf[i] < plan->count);
+        CHECK(contains(plan->grabs[plan->grabOf[i]], squares[i]));
+    }
+}
+
+static void test_single(void) {
+    RegionRect s[1] = { square(100, 100, 31) };
+    RegionPlan plan;
+    region_plan(&plan, s, 1, REGION_GRAB_COST, 1 << 20);
+    check_plan(&plan, s, 1);
+    CHECK(plan.count == 1 && plan.pixels == 31 * 31);
+}
+
+static void test_near_squares_share(void) {
+    // Overlapping and adjacent squares cost less together than apart.
+    RegionRect s[3] = { square(100, 100, 31), square(110, 104, 31), square(140, 100, 31) };
+    RegionPlan plan;
+    region_plan(&plan, s, 3, REGION_GRAB_COST, 1 << 20);
+    check_plan(&plan, s, 3);
+    CHECK(plan.count == 1);
+    CHECK(plan.pixels < 3 * 31 * 31);
+}
+
+static void test_far_squares_split(void) {
+    // Opposite corners of a 1920x1080 screen, plus one near the first.
+    RegionRect s[3] = { square(40, 40, 31), square(1880, 1040, 31), square(60, 50, 31) };
+    RegionPlan plan;
+    region_plan(&plan, s, 3, REGION_GRAB_COST, 1920 * 1080);
+    check_plan(&plan, s, 3);
+    CHECK(plan.count == 2);
+    CHECK(plan.grabOf[0] == plan.grabOf[2]);
+    CHECK(plan.grabOf[0] != plan.grabOf[1]);
+    CHECK(plan.pixels < 4 * 31 * 31);
+}
+
+static void test_capacity_fallback(void) {
+    // Large squares that do not fit the buffer separately collapse into one
+    // bounding box.
+    RegionRect s[2] = { square(300, 300, 501), square(900, 300, 501) };
+    RegionPlan plan;
+    region_plan(&plan, s, 2, 0, 800 * 600);
+    check_plan(&plan, s, 2);
+    CHECK(plan.count == 1);
+    CHECK(plan.grabs[0].w == 1101 && plan.grabs[0].h == 501);
+}
+
+static void test_views(void) {
+    // Fill a fake screen where each pixel encodes its position, copy the
+    // grabs into a packed buffer the way the pickers do, and read back.
+    enum { W = 640, H = 480 };
+    uint32_t* screen = (uint32_t*)malloc((size_t)W * H * 4);
+    uint32_t* buf = (uint32_t*)malloc((size_t)W * H * 4);
+    if (!screen || !buf) {
+        g_failures++;
+        free(screen);
+        free(buf);
+        return;
+    }
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) screen[y * W + x] = (uint32_t)(y << 16 | x);
+    }
+    RegionRect s[5] = { square(20, 20, 31), square(30, 25, 31), square(600, 400, 31),
+                        square(320, 240, 61), square(330, 250, 17) };
+    RegionPlan plan;
+    region_plan(&plan, s, 5, REGION_GRAB_COST, W * H);
+    check_plan(&plan, s, 5);
+    CHECK(plan.count >= 2 && plan.count <= 3);
+    for (int g = 0; g < plan.count; g++) {
+        const RegionRect* r = &plan.grabs[g];
+        for (int y = 0; y < r->h; y++) {
+            for (int x = 0; x < r->w; x++) buf[plan.offset[g] + (size_t)y * r->w + x] = screen[(r->y + y) * W + r->x + x];
+        }
+    }
+    for (int i = 0; i < 5; i++) {
+        int stride;
+        const uint8_t* v = region_view(&plan, (const uint8_t*)buf, s, i, &stride);
+        int bad = 0;
+        for (int y = 0; y < s[i].h; y++) {
+            const uint32_t* row = (const uint32_t*)(v + (size_t)y * stride);
+            for (int x = 0; x < s[i].w; x++) bad += row[x] != (uint32_t)((s[i].y + y) << 16 | (s[i].x + x));
+        }
+        CHECK(bad == 0);
+    }
+    free(screen);
+    free(buf);
+}
+
+int main(void) {
+    test_single();
+    test_near_squares_share();
+    test_far_squares_split();
+    test_capacity_fallback();
+    test_views();
+    return test_report("regions");
+}
@@ -0,0 +1,207 @@
+// Minimal Color Picker - pixel ruler tests.
+// Build/run: make test
+//
+// A drawn button must give the exact distances from a point inside it to
+// each of its sides, and the tolerance must decide whether a slightly
+// different border stops the rays. On random frames, including sizes that
+// are not a multiple of the band or the tile, the ruler (SSE2 and portable,
+// whole-frame and from a separate row and band, with tiles or scanning the
+// band in place) must agree with a plain pixel-by-pixel walk. The overlay must stay inside the disc and put its
+// ticks on the edge pixels. An 8K frame is measured and its time printed.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../picker_ruler.h"
+#include "test_util.h"
+
+// Reference: walk each ray one pixel at a time.
+static RulerResult reference_ruler(const uint32_t* px, int w, int h, int x, int y, int tol) {
+    RulerResult r;
+    memset(&r, 0, sizeof(r));
+    uint32_t ref = px[(size_t)y * w + x];
+    r.colour = ref;
+    static const int dx[4] = { -1, 1, 0, 0 }, dy[4] = { 0, 0, -1, 1 };
+    int* dist[4] = { &r.left, &r.right, &r.up, &r.down };
+    for (int k = 0; k < 4; k++) {
+        int nx = x + dx[k], ny = y + dy[k];
+        while (nx >= 0 && ny >= 0 && nx < w && ny < h) {
+            if (ruler_differs(px[(size_t)ny * w + nx], ref, tol)) {
+                r.edges |= 1 << k;
+                break;
+            }
+            (*dist[k])++;
+            nx += dx[k];
+            ny += dy[k];
+        }
+    }
+    return r;
+}
+
+static int same_result(const RulerResult* a, const RulerResult* b) {
+    return a->left == b->left && a->right == b->right && a->up == b->up && a->down == b->down &&
+           a->edges == b->edges && a->colour == b->colour;
+}
+
+static void test_button(void) {
+    int w = 300, h = 200;
+    uint32_t* px = (uint32_t*)malloc((size_t)w * h * 4);
+    fill_rect(px, w, 0, 0, w, h, 0xFFFFFFFFu);
+    fill_rect(px, w, 40, 50, 240, 130, 0xFF3366CCu);   // the button
+    fill_rect(px, w, 40, 130, 240, 131, 0xFF3467CBu);  // a shadow one step off
+    RulerCache c;
+    memset(&c, 0, sizeof(c));
+    RulerResult r;
+    CHECK(ruler_measure(&c, (const uint8_t*)px, w, h, w * 4, 100, 70, 0, &r));
+    CHECK(r.left == 60 && r.right == 139 && r.up == 20 && r.down == 59);
+    CHECK(r.edges == (RULER_LEFT | RULER_RIGHT | RULER_UP | RULER_DOWN) && r.colour == 0xFF3366CCu);
+
+    // With a tolerance of one the shadow row joins.
+    CHECK(ruler_measure(&c, (const uint8_t*)px, w, h, w * 4, 100, 70, 1, &r));
+    CHECK(r.down == 60);
+
+    // Outside the button the rays run to the frame's sides where nothing stops them.
+    CHECK(ruler_measure(&c, (const uint8_t*)px, w, h, w * 4, 10, 10, 0, &r));
+    CHECK(r.left == 10 && r.up == 10 && r.right == w - 11 && r.down == h - 11 && r.edges == 0);
+    CHECK(ruler_measure(&c, (const uint8_t*)px, w, h, w * 4, 20, 100, 0, &r));
+    CHECK(r.right == 19 && r.edges == RULER_RIGHT);
+
+    // Outside the frame: nothing.
+    CHECK(ruler_measure(&c, (const uint8_t*)px, w, h, w * 4, w, 10, 0, &r) && r.left == 0 && r.edges == 0);
+    CHECK(c.measures == 4);
+    ruler_free(&c);
+    free(px);
+}
+
+static void test_random_frames(void) {
+    RulerCache c, g, s, n;
+    memset(&c, 0, sizeof(c));
+    memset(&g, 0, sizeof(g));
+    memset(&s, 0, sizeof(s));
+    memset(&n, 0, sizeof(n));
+    n.direct = 1;
+    for (int round = 0; round < 60; round++) {
+        int w = 1 + (int)(next_random() % 211), h = 1 + (int)(next_random() % 300);
+        uint32_t* px = (uint32_t*)malloc((size_t)w * h * 4);
+        // Few colours in rectangles make long runs and edges at any offset.
+        fill_rect(px, w, 0, 0, w, h, 0xFF000000u);
+        for (int k = 0; k < 20 + round; k++) {
+            int x0 = (int)(next_random() % w), y0 = (int)(next_random() % h);
+            int x1 = x0 + 1 + (int)(next_random() % 40), y1 = y0 + 1 + (int)(next_random() % 90);
+            uint32_t col = 0xFF000000u | (uint32_t)(next_random() % 3) * 0x101010u;
+            col += next_random() % 3;  // within a tolerance of 2 of its band
+            fill_rect(px, w, x0, y0, x1 < w ? x1 : w, y1 < h ? y1 : h, col);
+        }
+        for (int t = 0; t < 10; t++) {
+            int x = (int)(next_random() % w), y = (int)(next_random() % h);
+            int tol = (t % 2) * 2;
+            RulerResult want = reference_ruler(px, w, h, x, y, tol);
+            RulerResult a, b, d, e;
+            CHECK(ruler_measure(&c, (const uint8_t*)px, w, h, w * 4, x, y, tol, &a));
+            CHECK(same_result(&a, &want));
+            CHECK(ruler_measure_generic(&g, (const uint8_t*)px, w, h, w * 4, x, y, tol, &b));
+            CHECK(same_result(&b, &want));
+
+            // As the pickers grab it: the row and the band in buffers of their own.
+            int bx = ruler_band_x(x, w), bw = w < RULER_BAND ? w : RULER_BAND;
+            uint32_t* row = (uint32_t*)malloc((size_t)w * 4);
+            uint32_t* band = (uint32_t*)malloc((size_t)bw * h * 4);
+            memcpy(row, px + (size_t)y * w, (size_t)w * 4);
+            for (int yy = 0; yy < h; yy++) memcpy(band + (size_t)yy * bw, px + (size_t)yy * w + bx, (size_t)bw * 4);
+            CHECK(ruler_measure_cross(&s, row, w, (const uint8_t*)band, bw * 4, bw, h, x, x - bx, y, tol, &d));
+            CHECK(same_result(&d, &want));
+            CHECK(ruler_measure_cross(&n, row, w, (const uint8_t*)band, bw * 4, bw, h, x, x - bx, y, tol, &e));
+            CHECK(same_result(&e, &want));
+            free(band);
+            free(row);
+        }
+        free(px);
+    }
+    ruler_free(&c);
+    ruler_free(&g);
+    ruler_free(&s);
+    CHECK(ruler_bytes(&n) == 0);
+}
+
+static void test_overlay(void) {
+    int radius = 60, d = radius * 2, capSize = 15;  // zoom 8
+    uint32_t* loupe = (uint32_t*)malloc((size_t)d * d * 4);
+    uint32_t* cap = (uint32_t*)malloc((size_t)capSize * capSize * 4);
+    fill_rect(cap, capSize, 0, 0, capSize, capSize, 0xFF808080u);
+    compose_loupe((const uint8_t*)cap, capSize, capSize * 4, (uint8_t*)loupe, radius, d * 4, 2, 1, 6);
+    uint32_t* before = (uint32_t*)malloc((size_t)d * d * 4);
+    memcpy(before, loupe, (size_t)d * d * 4);
+
+    // Edges 3 px right and 2 px up of the cursor pixel (capture pixel 7).
+    RulerResult r;
+    memset(&r, 0, sizeof(r));
+    r.right = 3;
+    r.up = 2;
+    r.left = 40;  // beyond the loupe: the line stops at the border
+    r.down = 0;
+    r.edges = RULER_RIGHT | RULER_UP | RULER_DOWN;
+    ruler_draw_bgra(&r, (uint8_t*)loupe, radius, d * 4, capSize, 2, 2);
+
+    int outside = 0, changed = 0;
+    for (int i = 0; i < d * d; i++) {
+        if ((before[i] >> 24) != 0xFF && loupe[i] != before[i]) outside++;
+        if (loupe[i] != before[i]) changed++;
+    }
+    CHECK(outside == 0);
+    CHECK(changed > 0);
+    // Capture pixel k covers loupe columns [8k, 8k + 8): the last matching
+    // pixel right is 10, so the tick is on column 87; up it is row 40.
+    CHECK(loupe[(size_t)(radius - 4) * d + 87] == RULER_COLOUR);
+    CHECK(loupe[(size_t)(radius - 4) * d + 88] == before[(size_t)(radius - 4) * d + 88]);
+    CHECK(loupe[(size_t)40 * d + radius - 4] == RULER_COLOUR);
+    // The border ring stays white.
+    CHECK(loupe[(size_t)radius * d + 1] == before[(size_t)radius * d + 1]);
+    free(before);
+    free(cap);
+    free(loupe);
+}
+
+typedef struct FrameRays {
+    RulerCache c;
+    const uint32_t* px;
+    int w, h;
+    RulerResult r;
+    int ok;
+} FrameRays;
+
+static void run_rays(void* p) {
+    FrameRays* f = (FrameRays*)p;
+    f->ok = ruler_measure(&f->c, (const uint8_t*)f->px, f->w, f->h, f->w * 4, f->w / 2, f->h / 2, 0, &f->r);
+}
+
+static void test_8k_frame(void) {
+    int w = 7680, h = 4320;
+    uint32_t* px = (uint32_t*)malloc((size_t)w * h * 4);
+    fill_rect(px, w, 0, 0, w, h, 0xFF202428u);
+    static FrameRays f;
+    f.px = px;
+    f.w = w;
+    f.h = h;
+    double best = best_ms(run_rays, &f, 20);  // the warm-up call allocates
+    RulerResult r = f.r;
+    CHECK(f.ok);
+    CHECK(r.left == w / 2 && r.right == w / 2 - 1 && r.up == h / 2 && r.down == h / 2 - 1 && r.edges == 0);
+    CHECK(f.c.tiles == 21u * (uint64_t)((h + RULER_TILE_ROWS - 1) / RULER_TILE_ROWS));
+    printf("  solid %dx%d frame, rays to every side: %.3f ms (%s)\n", w, h, best, RULER_SSE2 ? "sse2" : "portable");
+    ruler_free(&f.c);
+    free(px);
+}
+
+int main(void) {
+    g_seed = 0x2A1E;
+    test_button();
+    test_random_frames();
+    test_overlay();
+    test_8k_frame();
+    return test_report("ruler");
+}
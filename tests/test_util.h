@@ -0,0 +1,74 @@
+// Minimal Color Picker - helpers shared by the unit tests (header-only, C99).
+//
+// CHECK() prints the failing condition and counts it; test_report() prints
+// the suite's verdict and gives main() its exit code.
+
+#ifndef PICKER_TEST_UTIL_H
+#define PICKER_TEST_UTIL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int g_failures;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);     \
+            g_failures++;                                                \
+        }                                                                \
+    } while (0)
+
+static inline int test_report(const char* suite) {
+    if (g_failures) {
+        printf("%s: %d check(s) failed\n", suite, g_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", suite);
+    return 0;
+}
+
+// xorshift32 over g_seed; a suite that wants its own sequence sets g_seed
+// before its first draw.
+static uint32_t g_seed = 0x2545F491u;
+
+static inline uint32_t next_random(void) {
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 17;
+    g_seed ^= g_seed << 5;
+    return g_seed;
+}
+
+// Files that time anything define _POSIX_C_SOURCE before any include, for
+// clock_gettime().
+static inline double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+typedef void (*TestFn)(void* ctx);
+
+// Times fn as the benchmarks do: one warm-up call (which may allocate), then
+// the best of `runs`.
+static inline double best_ms(TestFn fn, void* ctx, int runs) {
+    fn(ctx);
+    double best = 1e300;
+    for (int i = 0; i < runs; i++) {
+        double t0 = now_ms();
+        fn(ctx);
+        double ms = now_ms() - t0;
+        if (ms < best) best = ms;
+    }
+    return best;
+}
+
+// Fills [x0, x1) x [y0, y1) of a 32-bit image `stride` pixels wide with c.
+static inline void fill_rect(uint32_t* px, int stride, int x0, int y0, int x1, int y1, uint32_t c) {
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) px[(size_t)y * stride + x] = c;
+    }
+}
+
+#endif // PICKER_TEST_UTIL_H
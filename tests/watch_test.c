@@ -0,0 +1,268 @@
+// Minimal Color Picker - pixel watchpoint tests.
+// Build/run: make test
+//
+// Clustering must put a dense panel in one grab, a column of lights in one
+// grab and far-apart lights in grabs of their own, and every point must
+// find its own pixel in the packed buffer. The check (SSE2 and portable)
+// must report exactly the points that moved past the tolerance, once, with
+// the colours before and after. Ten thousand points are checked and the time
+// per tick printed, next to the regions they need.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../picker_watch.h"
+#include "test_util.h"
+
+#define SCREEN_W 3840
+#define SCREEN_H 2160
+
+static uint32_t* g_screen;
+
+static uint32_t screen_pixel(int x, int y) {
+    uint32_t h = (uint32_t)x * 0x9E3779B1u ^ (uint32_t)y * 0x85EBCA77u;
+    return 0xFF000000u | (h >> 8);
+}
+
+// What a picker does each tick: every region into the buffer.
+static uint8_t* grab(const WatchSet* ws) {
+    uint32_t* buf = (uint32_t*)malloc(ws->pixels * 4 + 4);
+    for (int r = 0; r < ws->regionCount; r++) {
+        const RegionRect* g = &ws->regions[r];
+        size_t stride = (size_t)(ws->stride ? ws->stride : g->w);
+        for (int y = 0; y < g->h; y++) {
+            memcpy(buf + ws->offset[r] + (size_t)y * stride, g_screen + (size_t)(g->y + y) * SCREEN_W + g->x,
+                   (size_t)g->w * 4);
+        }
+    }
+    return (uint8_t*)buf;
+}
+
+// Every point reads its own pixel, and the regions stay on the screen.
+static void check_indexes(const WatchSet* ws) {
+    uint32_t* buf = (uint32_t*)grab(ws);
+    int bad = 0;
+    for (int i = 0; i < ws->count; i++) {
+        if (buf[ws->index[i]] != g_screen[(size_t)ws->y[i] * SCREEN_W + ws->x[i]]) bad++;
+        if (i > 0 && ws->index[i] < ws->index[i - 1]) bad++;  // forwards through the buffer
+    }
+    CHECK(bad == 0);
+    for (int r = 0; r < ws->regionCount; r++) {
+        const RegionRect* g = &ws->regions[r];
+        CHECK(g->x >= 0 && g->y >= 0 && g->x + g->w <= SCREEN_W && g->y + g->h <= SCREEN_H);
+    }
+    free(buf);
+}
+
+static void test_clustering(void) {
+    static int xs[4000], ys[4000];
+    WatchSet ws;
+    memset(&ws, 0, sizeof(ws));
+
+    // A panel of 40 x 25 lights 12 px apart: one grab.
+    int n = 0;
+    for (int r = 0; r < 25; r++) {
+        for (int c = 0; c < 40; c++) {
+            xs[n] = 600 + c * 12;
+            ys[n] = 300 + r * 12;
+            n++;
+        }
+    }
+    CHECK(watch_plan(&ws, xs, ys, n, WATCH_CELL, REGION_GRAB_COST, 0));
+    CHECK(ws.count == n && ws.regionCount == 1);
+    CHECK(ws.pixels == (size_t)(39 * 12 + 1) * (24 * 12 + 1));
+    check_indexes(&ws);
+
+    // A column of 150 lights 10 px apart: one thin grab.
+    n = 0;
+    for (int r = 0; r < 150; r++) {
+        xs[n] = 2000;
+        ys[n] = 100 + r * 10;
+        n++;
+    }
+    CHECK(watch_plan(&ws, xs, ys, n, WATCH_CELL, REGION_GRAB_COST, 0));
+    CHECK(ws.regionCount == 1 && ws.pixels == 1491);
+    check_indexes(&ws);
+
+    // Four corners and the same point twice: a one-row grab across the
+    // screen is cheaper than a second request, a grab of the screen is not.
+    int cx[5] = { 5, SCREEN_W - 5, 5, SCREEN_W - 5, 5 }, cy[5] = { 5, 5, SCREEN_H - 5, SCREEN_H - 5, 5 };
+    CHECK(watch_plan(&ws, cx, cy, 5, WATCH_CELL, REGION_GRAB_COST, 0));
+    CHECK(ws.regionCount == 2 && ws.pixels == 2 * (SCREEN_W - 9));
+    int cx2[2] = { 5, 1000 }, cy2[2] = { 5, 1000 };
+    CHECK(watch_plan(&ws, cx2, cy2, 2, WATCH_CELL, REGION_GRAB_COST, 0));
+    CHECK(ws.regionCount == 2 && ws.pixels == 2);
+    check_indexes(&ws);
+
+    // Several dense panels among scattered lights.
+    n = 0;
+    for (int p = 0; p < 6; p++) {
+        int ox = (int)(next_random() % (SCREEN_W - 400)), oy = (int)(next_random() % (SCREEN_H - 300));
+        for (int k = 0; k < 400; k++) {
+            xs[n] = ox + (int)(next_random() % 400);
+            ys[n] = oy + (int)(next_random() % 300);
+            n++;
+        }
+    }
+    for (int k = 0; k < 200; k++) {
+        xs[n] = (int)(next_random() % SCREEN_W);
+        ys[n] = (int)(next_random() % SCREEN_H);
+        n++;
+    }
+    CHECK(watch_plan(&ws, xs, ys, n, WATCH_CELL, REGION_GRAB_COST, 0));
+    CHECK(ws.regionCount < n / 4);
+    check_indexes(&ws);
+    int packedRegions = ws.regionCount;
+
+    // Stacked at one stride, as a DIB holds them: the same regions.
+    CHECK(watch_plan(&ws, xs, ys, n, WATCH_CELL, REGION_GRAB_COST, 1));
+    CHECK(ws.regionCount == packedRegions && ws.stride > 0);
+    int widest = 0;
+    for (int r = 0; r < ws.regionCount; r++) {
+        if (ws.regions[r].w > widest) widest = ws.regions[r].w;
+        CHECK(ws.offset[r] % (size_t)ws.stride == 0);
+    }
+    CHECK(ws.stride == widest);
+    check_indexes(&ws);
+
+    CHECK(watch_plan(&ws, xs, ys, 0, WATCH_CELL, REGION_GRAB_COST, 0) && ws.regionCount == 0);
+    watch_free(&ws);
+}
+
+static void test_changes(void) {
+    enum { N = 1003 };  // not a multiple of four
+    static int xs[N], ys[N];
+    for (int i = 0; i < N; i++) {
+        xs[i] = (int)(next_random() % SCREEN_W);
+        ys[i] = (int)(next_random() % SCREEN_H);
+    }
+    WatchSet a, b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    CHECK(watch_plan(&a, xs, ys, N, WATCH_CELL, REGION_GRAB_COST, 0));
+    CHECK(watch_plan(&b, xs, ys, N, WATCH_CELL, REGION_GRAB_COST, 0));
+
+    uint8_t* buf = grab(&a);
+    CHECK(watch_check(&a, buf, 4) == 0);  // the baseline
+    CHECK(watch_check_generic(&b, buf, 4) == 0);
+    CHECK(watch_check(&a, buf, 4) == 0);
+    free(buf);
+
+    // Nudge some points within the tolerance, move others past it. The
+    // alpha byte is not a colour.
+    int moved = 0;
+    uint8_t hit[N];
+    memset(hit, 0, sizeof(hit));
+    for (int i = 0; i < a.count; i += 7) {
+        uint32_t* p = &g_screen[(size_t)a.y[i] * SCREEN_W + a.x[i]];
+        int ch = (int)(next_random() % 3) * 8;
+        int v = (int)((*p >> ch) & 0xFF);
+        int far = (i / 7) % 2;
+        int nv = far ? (v < 128 ? v + 5 : v - 5) : (v < 128 ? v + 4 : v - 4);
+        *p = (*p & ~(0xFFu << ch) & 0x00FFFFFFu) | ((uint32_t)nv << ch);
+        if (far) {
+            hit[i] = 1;
+            moved++;
+        }
+    }
+    buf = grab(&a);
+    int na = watch_check(&a, buf, 4);
+    int nb = watch_check_generic(&b, buf, 4);
+    CHECK(na == moved && nb == moved);
+    int wrong = 0;
+    for (int e = 0; e < na; e++) {
+        const WatchEvent* ev = &a.events[e];
+        if (!hit[ev->point]) wrong++;
+        if (ev->to != (g_screen[(size_t)a.y[ev->point] * SCREEN_W + a.x[ev->point]] | 0xFF000000u)) wrong++;
+        if (ev->from != screen_pixel(a.x[ev->point], a.y[ev->point])) wrong++;
+        if (e < nb && (b.events[e].point != ev->point || b.events[e].to != ev->to)) wrong++;
+    }
+    CHECK(wrong == 0);
+
+    // Reported once: the new colour is the reference now.
+    CHECK(watch_check(&a, buf, 4) == 0 && watch_check_generic(&b, buf, 4) == 0);
+    CHECK(a.changes == (uint64_t)moved);
+    free(buf);
+
+    char line[96];
+    watch_format_event(&a, &a.events[0], 100, 0, 12345.0, line, sizeof(line));
+    CHECK(strncmp(line, "change ", 7) == 0 && strstr(line, " -> #") && strstr(line, " t=12.345"));
+    watch_free(&a);
+    watch_free(&b);
+
+    for (int y = 0; y < SCREEN_H; y++) {
+        for (int x = 0; x < SCREEN_W; x++) g_screen[(size_t)y * SCREEN_W + x] = screen_pixel(x, y);
+    }
+}
+
+static void test_parse(void) {
+    int x = -1, y = -1;
+    CHECK(watch_parse_point("12,34\n", &x, &y) && x == 12 && y == 34);
+    CHECK(watch_parse_point("  7 , 9", &x, &y) && x == 7 && y == 9);
+    CHECK(watch_parse_point("100 200", &x, &y) && x == 100 && y == 200);
+    CHECK(!watch_parse_point("# status lights", &x, &y));
+    CHECK(!watch_parse_point("\n", &x, &y));
+    CHECK(!watch_parse_point("x,y", &x, &y));
+}
+
+typedef struct WatchRun {
+    WatchSet* ws;
+    uint8_t* buf;
+} WatchRun;
+
+static void run_check(void* p) {
+    WatchRun* r = (WatchRun*)p;
+    watch_check(r->ws, r->buf, 8);
+}
+
+static void run_check_generic(void* p) {
+    WatchRun* r = (WatchRun*)p;
+    watch_check_generic(r->ws, r->buf, 8);
+}
+
+static void test_timing(void) {
+    enum { N = 10000 };
+    static int xs[N], ys[N];
+    // Forty panels of 250 lights each, in five rows.
+    for (int i = 0; i < N; i++) {
+        int p = i / 250;
+        xs[i] = 40 + (p % 8) * 460 + (int)(next_random() % 200);
+        ys[i] = 40 + (p / 8) * 420 + (int)(next_random() % 120);
+    }
+    WatchSet ws;
+    memset(&ws, 0, sizeof(ws));
+    double t0 = now_ms();
+    CHECK(watch_plan(&ws, xs, ys, N, WATCH_CELL, REGION_GRAB_COST, 0));
+    double planMs = now_ms() - t0;
+    // The gaps between panels in a row copy less than a request costs, so
+    // each row of eight is one grab.
+    CHECK(ws.regionCount == 5);
+    WatchRun run = {&ws, grab(&ws)};
+    uint8_t* buf = run.buf;
+    double best = best_ms(run_check, &run, 50);
+    double bestGeneric = best_ms(run_check_generic, &run, 50);
+    CHECK(ws.changes == 0);
+    printf("  %d points in %d regions (%zu px), planned in %.2f ms: check %.4f ms (%s), %.4f ms portable\n", N,
+           ws.regionCount, ws.pixels, planMs, best, WATCH_SSE2 ? "sse2" : "portable", bestGeneric);
+    free(buf);
+    watch_free(&ws);
+}
+
+int main(void) {
+    g_seed = 0x3A7C;
+    g_screen = (uint32_t*)malloc((size_t)SCREEN_W * SCREEN_H * 4);
+    for (int y = 0; y < SCREEN_H; y++) {
+        for (int x = 0; x < SCREEN_W; x++) g_screen[(size_t)y * SCREEN_W + x] = screen_pixel(x, y);
+    }
+    test_clustering();
+    test_changes();
+    test_parse();
+    test_timing();
+    free(g_screen);
+    return test_report("watch");
+}
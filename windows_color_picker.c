@@ -1,37 +1,325 @@
 // Minimal Color Picker (Windows, single-file)
-// Build (MSVC): cl /O2 /W4 windows_color_picker.c user32.lib gdi32.lib
-// Run: windows_color_picker.exe
+// Build (MSVC): cl /O2 /W4 windows_color_picker.c user32.lib gdi32.lib psapi.lib
+// Run: windows_color_picker.exe [--trace trace.json] [--stats] [--mem-cap MB] [--no-park]
+//                                [--radius PX] [--zoom Z] [--threads N] [--pin X,Y ...]
+//                                [--flash-damage] [--scope N] [--fill-tolerance T]
+//                                [--ruler] [--ruler-tolerance T] [--two-point]
+//                                [--reference PNG] [--reference-origin X,Y]
+//                                [--reference-opacity P] [--amplify] [--amplify-range L]
+//      windows_color_picker.exe --watch POINTS [--watch-rate HZ] [--watch-tolerance T]
+//                                [--watch-command CMD] [--stats]
 // Behavior:
 // - Shows a circular magnifier near the cursor.
 // - Left click: copies center pixel color as #RRGGBB to clipboard and exits.
+// - M: measures the same-colour region under the cursor. The cursor's monitor
+//   is captured whole and flood-filled from the centre pixel through every
+//   4-connected pixel within --fill-tolerance T (per channel, default 0) of
+//   it (picker_fill.h); its size, origin, pixel area and centroid are printed
+//   and copied to the clipboard, and the picker keeps running.
+// - R (or --ruler to start with it): the pixel ruler. Rays run left, right,
+//   up and down from the cursor pixel to the first pixel differing from it by
+//   more than --ruler-tolerance T per channel (default 8), and the distances
+//   are drawn in the loupe. Each frame blits only the cursor's row and a band
+//   of 8 columns of its monitor, transposed tile by tile for the vertical
+//   rays (picker_ruler.h).
+// - T (or --two-point to start with it): two-point measurement. Left click
+//   and Enter mark points instead of picking; the second point prints the
+//   distance, offsets and angle from the first, copies that line to the
+//   clipboard, and the next click starts a new pair. Each point is taken from
+//   the capture square the loupe last showed (no new BitBlt) and snapped,
+//   along its row and its column, to an edge within 4 px at sub-pixel
+//   precision (picker_edge.h); its desktop position (| and - mark the snapped
+//   axes) and colour are printed.
+// - --reference PNG: onion-skin comparison with a design mock whose top-left
+//   pixel sits at desktop point --reference-origin X,Y (default 0,0). The
+//   loupe shows the mock blended over the screen at --reference-opacity P
+//   percent (default 50); O switches to the per-channel difference, then
+//   off, then back. The CIEDE2000 difference of the centre pixel is drawn
+//   under the marker. The PNG is decoded once (picker_png.h) into PNG.tiles,
+//   a tile cache next to it that later runs map as it is; each frame copies
+//   only the tiles under the capture square, and the blend or difference is
+//   fused into the loupe's scale pass with SSE2 (picker_onion.h,
+//   picker_filter.h). Where the mock is transparent, or the loupe is zoomed
+//   out, the screen shows alone.
+// - A (or --amplify to start with it): the difference amplifier. Each channel
+//   within --amplify-range L levels (default 8) of the centre pixel's is
+//   stretched over the full range around mid grey, so #FEFEFE beside #FFFFFF
+//   shows as two clearly different greys. The tables are rebuilt only when
+//   the centre colour changes, and the map is fused into the loupe's scale
+//   pass with SSE2 like the onion skin (picker_filter.h), which it replaces
+//   while on.
+// - --watch POINTS: headless watch mode, no loupe. POINTS lists desktop
+//   points, one "x,y" per line (# starts a comment). They are sampled
+//   --watch-rate HZ times a second (default 10), and each point whose colour
+//   moves more than --watch-tolerance T per channel (default 8) from the
+//   colour last reported for it prints "change X,Y #OLD -> #NEW t=SECONDS".
+//   With --watch-command CMD, the changes are also piped to CMD, started at
+//   the first change and kept running: it reads one line per change and no
+//   tick waits for it to exit. The points are clustered once into regions
+//   (picker_watch.h), each tick BitBlts only those and checks the points
+//   four at a time with SSE2, so the cost follows the regions, not the
+//   points. Ctrl+C ends it.
+// - --radius PX (16..1024, default 120) and --zoom Z (0.125..64, default 8) size
+//   the loupe. The mouse wheel zooms in and out in quarter octaves (the wheel
+//   is swallowed while picking). Below 1 the loupe zooms out: the capture is
+//   up to 8 times larger and the loupe samples a mip pyramid of it, reduced
+//   2x2 in linear light and updated only where tiles changed (picker_mip.h),
+//   blending the two nearest levels; picking still reads the exact pixel.
+//   Loupes larger than one cache-sized band are composed band by band on a
+//   worker pool (--threads N, default cores-1; 0 composes on the UI thread).
+// - Per-monitor DPI: --radius, the border, marker and window offset are in
+//   100% units and scaled by the DPI of the monitor under the cursor; the
+//   zoom is in physical pixels, so the capture is always 1:1 with the screen
+//   and the loupe is drawn at native resolution (picker_dpi.h).
+// - --pin X,Y (repeatable, up to 7): an extra loupe pinned at desktop point
+//   X,Y next to the cursor loupe. All loupes read one shared capture: their
+//   squares are grouped into as few BitBlts as pays off (picker_regions.h)
+//   and composed in one pool batch. Pins over unchanged pixels are not redrawn.
+// - Change detection: the cursor's capture square is hashed in 16x16 blocks
+//   every frame (picker_damage.h); idle parking compares those hashes. When
+//   only some blocks changed, only the loupe tiles magnified from them are
+//   recomposed and only their bounding rectangle is sent, through
+//   UpdateLayeredWindowIndirect's prcDirty; with nothing changed the window
+//   is at most moved. --flash-damage tints the loupe over blocks that changed,
+//   fading out over a quarter second, to show what the picker sees changing.
+// - --scope N: a waveform and vectorscope of the centre N x N of the loupe's
+//   capture square (0: all of it; zoom out to widen it), docked at the top
+//   right of the cursor's monitor. The scopes are binned tile by tile on the
+//   worker pool (picker_scope.h) and redrawn only when the capture changed.
+// - --trace: records frame stages and input hooks, writes Chrome trace JSON on exit.
+// - --stats: prints frame pacing, jank, quality-level and memory counters on exit.
+//   (Hardware counters are Linux-only; here they report as unavailable.)
+// - --mem-cap MB: keeps the working set under MB by shrinking trace history
+//   and the caches: fewer zoom-out levels, no ruler tiles, no desktop mirror
+//   for the pins, scope bins on one thread. Where even that leaves no room,
+//   the reference overlay, the scope or a region measurement is left out.
+// - Idle: with the cursor still and the pixels under it unchanged, the 16 ms
+//   timer is replaced by a 250 ms damage poll until input arrives or the
+//   pixels change. --no-park keeps ticking.
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <fcntl.h>
+#include <io.h>
 #include <stdint.h>
 #include <stdio.h>
-
-static const int kRadius = 120;          // circle radius in px
-static const int kDiameter = 240;        // 2*radius
-static const int kZoom = 8;              // magnification factor
+#include <stdlib.h>
+
+#include "picker_damage.h"
+#include "picker_downsample.h"
+#include "picker_dpi.h"
+#include "picker_edge.h"
+#include "picker_fill.h"
+#include "picker_filter.h"
+#include "picker_kernels.h"
+#include "picker_mem.h"
+#include "picker_mip.h"
+#include "picker_onion.h"
+#include "picker_pacer.h"
+#include "picker_park.h"
+#include "picker_perf.h"
+#include "picker_png.h"
+#include "picker_pool.h"
+#include "picker_regions.h"
+#include "picker_ruler.h"
+#include "picker_scope.h"
+#include "picker_trace.h"
+#include "picker_watch.h"
+
+// Sizes in px at 100% scale; loupe_geometry() scales them per monitor.
+static const int kDefaultRadius = 120;   // circle radius
+static const int kMaxRadius = 1024;      // 2048 px loupe, in physical px at any scale
+static const int kMinRadius = 16;
+static const int kDefaultZoom = 8;       // magnification factor
+static const int kMaxZoom = 64;
+static const int kMaxZoomOut = 8;        // --zoom 0.125 (1 << (MIP_MAX_LEVELS - 1))
 static const int kBorderWidth = 2;
+static const int kMarkerSize = 6;        // center marker square
 static const int kTickMs = 16;           // ~60fps
-static const int kOffsetX = 40;          // window offset from cursor
-static const int kOffsetY = 40;
+static const int kOffset = 40;           // window offset from cursor, right and down
+static const int kScopeMargin = 16;      // --scope panel inset from the monitor's corner
 
 static HINSTANCE g_hInstance;
 static HWND g_hwnd;
 static HHOOK g_mouseHook;
 static HHOOK g_keyboardHook;
 
+// Screen DC kept for the life of the process so steady-state frames make no
+// GetDC/ReleaseDC round trips (and no GDI object churn).
+static HDC g_screenDC;
+
+static LoupeStyle g_style;   // loupe sizes at 100%, fixed after argument parsing
+static LoupeGeometry g_geo;  // cursor loupe on the cursor's monitor, this frame
+static int g_radius;         // g_geo.radius, in physical pixels
+static int g_diameter;       // 2*radius
+static double g_zoom;        // loupe pixels per screen pixel; the wheel changes it
+static int g_mipLevels = 1;  // > 1: zoomed out, the loupe samples a mip pyramid
+
+// Effective DPI lookup (shcore.dll, Windows 8.1+), cached per monitor.
+typedef HRESULT (WINAPI *GetDpiForMonitorFn)(HMONITOR, int, UINT*, UINT*);
+static GetDpiForMonitorFn g_getDpiForMonitor;
+static HMONITOR g_dpiMonitor;
+static int g_dpi = DPI_BASE;
+
 static HDC g_memDC;
 static HBITMAP g_dib;
 static void* g_bits;
+static int g_loupeAlloc;     // the loupe DIB holds this square; a new monitor may need more
+static int g_loupeStride;
 
 static HDC g_capDC;
 static HBITMAP g_capBmp;
+static void* g_capBits;
 static int g_capSize;
+static int g_capAlloc;       // the capture DIB holds this square; g_capSize may be less
+static const uint8_t* g_capData;  // this frame's capture square
+static int g_capStride;
+static POINT g_capCursor;         // and the cursor position it is centred on
+static DamageMap g_damage;   // 16x16 block hashes of the capture square
+static int g_flashDamage;    // --flash-damage
+static int g_scopeRegion = -1;  // --scope N; -1 when off, 0 for the whole capture square
+static ScopeMap g_scope;
+static HWND g_scopeHwnd;
+static HDC g_scopeDC;
+static HBITMAP g_scopeBmp;
+static void* g_scopeBits;
+static HMONITOR g_scopeMonitor;  // monitor the panel is docked on, NULL before the first run
+static uint64_t g_scopeUpdate;   // g_damage.updates of the last run
+static size_t g_scopeBytes;
+static int g_fillTolerance;      // --fill-tolerance T
+static FillMap g_fill;
+static HDC g_fillDC;
+static HBITMAP g_fillBmp;        // the measured monitor, captured whole
+static void* g_fillBits;
+static int g_fillW, g_fillH;
+static int g_ruler;               // R or --ruler
+static int g_rulerTolerance = 8;  // --ruler-tolerance T
+static RulerCache g_rulerCache;
+static RulerResult g_rulerResult; // this frame's distances
+static HDC g_rulerRowDC, g_rulerBandDC;
+static HBITMAP g_rulerRowBmp;     // the cursor's row of its monitor
+static HBITMAP g_rulerBandBmp;    // RULER_BAND columns around the cursor, full height
+static void* g_rulerRowBits;
+static void* g_rulerBandBits;
+static int g_rulerW, g_rulerH;    // monitor size the DIBs were made for
+static int g_twoPoint;            // T or --two-point
+static int g_pointCount;          // points marked of the current pair
+static EdgePoint g_pointA;
+static const wchar_t* g_watchPath;     // --watch POINTS
+static const wchar_t* g_watchCommand;  // --watch-command CMD
+static double g_watchRate = 10.0;      // --watch-rate HZ
+static int g_watchTolerance = 8;       // --watch-tolerance T
+static WatchSet g_watch;               // points relative to the desktop's top left
+static volatile LONG g_watchQuit;
+static const wchar_t* g_refPath;       // --reference PNG
+static int g_refX, g_refY;             // --reference-origin X,Y: where the PNG's top-left pixel sits
+static int g_refOpacity = ONION_OPACITY;     // --reference-opacity P, as a weight of 128
+static int g_refMode = LOUPE_FILTER_BLEND;   // O cycles blend, difference, off
+static OnionRef g_ref;                 // the PNG's mapped tile cache
+static uint8_t* g_refSquare;           // the reference under this frame's capture square
+static int g_amplify;                  // A or --amplify
+static int g_amplifyRange = 8;         // --amplify-range L: levels either side of the centre
+static long g_amplifyFrames;
+static long g_amplifyBuilds;           // frames whose centre colour rebuilt the tables
+static LoupeFilter g_filter;           // this frame's; LOUPE_FILTER_NONE shows the screen as it is
+// What the loupe DIB and window hold, so the next frame can patch them
+// (loupe_can_patch()).
+static uint64_t g_drawnUpdate;  // g_damage.updates the DIB was composed from, 0 = none
+static int g_drawnCapSize, g_drawnDiameter, g_drawnLevels, g_drawnAntialias;
+static POINT g_presentedAt;     // window position of the last present
+static int g_presented;         // the window holds a whole loupe of the drawn size
+static int g_srcSize;        // loupe source size: g_capSize >> (g_mipLevels - 1)
+static MipPyramid g_mip;     // cursor loupe's pyramid
+static size_t g_mipBytes;
+static const uint8_t* g_srcData;  // this frame's loupe source
+static int g_srcStride;
+
+// Wheel zoom: latency from the wheel hook to the first frame presented at the
+// new zoom, and the pyramid's per-frame cost while zoomed out.
+static int g_wheelDelta;     // WHEEL_DELTA units not yet turned into notches
+static double g_wheelAtMs;   // first wheel notch not yet presented, 0 when none
+static long g_wheelSteps;
+static long g_wheelFrames;
+static double g_wheelTotalMs;
+static double g_wheelMaxMs;
+static long g_mipFrames;
+static double g_mipUpdateMs;
+static double g_mipSampleMs;
+
+#define MAX_PINS (REGION_MAX - 1)  // the cursor loupe takes the last slot
+
+// A loupe pinned at a fixed desktop point (--pin). Its capture square is a
+// view into the shared capture, not a BitBlt of its own.
+typedef struct PinnedLoupe {
+    POINT pt;                // pinned point, on the desktop
+    int dpi;                 // of the pin's monitor
+    LoupeGeometry geo;       // at that dpi and the current zoom
+    HWND hwnd;
+    HDC memDC;
+    HBITMAP dib;
+    void* bits;              // geo.diameter x geo.diameter loupe pixels
+    const uint8_t* capData;  // this frame's square inside g_sharedBits, or edge
+    int capStride;
+    uint8_t* edge;           // a square crossing the desktop edge, shifted into place
+    int edgeAlloc;           // edge holds a square this wide
+    uint64_t hash;           // of this frame's square
+    uint64_t drawnHash;      // of the square on screen now
+    int drawnAntialias;
+    double drawnZoom;
+    MipPyramid mip;          // zoomed out: pyramid of the square
+    int shown;
+    int dirty;               // composed this frame, needs presenting
+} PinnedLoupe;
+
+static PinnedLoupe g_pins[MAX_PINS];
+static int g_pinCount;
+// The shared capture mirrors the virtual desktop: each grab lands at its own
+// desktop position, so every loupe's square is a plain offset into it.
+static RECT g_desktop;
+static HDC g_sharedDC;
+static HBITMAP g_sharedBmp;
+static void* g_sharedBits;
+static int g_sharedSquares;  // --mem-cap left no room for the desktop mirror
+static int g_sharedSide;     // then it holds squares this wide, one under another
+static RegionPlan g_plan;
+static long g_sharedFrames;
+static long g_sharedGrabs;
+static long g_pinComposes;
+static long g_pinSkips;
+
+static const wchar_t* g_tracePath;
+static int g_stats;
+static FramePacer g_pacer;
+static IdleParker g_parker;
+static PerfCounters g_perf;
+static PerfSample g_perfStages[] = {
+    { .name = "scale" }, { .name = "mask" }, { .name = "blend" }, { .name = "compose" }, { .name = "reduce" },
+    { .name = "pick" },
+};
+enum { STAGE_SCALE, STAGE_MASK, STAGE_BLEND, STAGE_COMPOSE, STAGE_REDUCE, STAGE_PICK, STAGE_COUNT };
+static WorkerPool g_pool;
+static WorkerPool g_inlinePool;  // no workers, for compose_pool()
+
+#define WM_APP_UNPARK (WM_APP + 1)
+#define WM_APP_ZOOM (WM_APP + 2)
+#define WM_APP_MEASURE (WM_APP + 3)
+
+static void load_dpi_query(void) {
+    // Stays loaded for the life of the process.
+    HMODULE shcore = LoadLibraryW(L"shcore.dll");
+    if (!shcore) return;
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wcast-function-type"
+#endif
+    g_getDpiForMonitor = (GetDpiForMonitorFn)GetProcAddress(shcore, "GetDpiForMonitor");
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+}
 
 static void enable_dpi_awareness(void) {
+    load_dpi_query();
     // Prefer Per-Monitor V2 when available; fall back to legacy system DPI aware.
     HMODULE user32 = LoadLibraryW(L"user32.dll");
     if (user32) {
@@ -69,6 +357,24 @@ static void enable_dpi_awareness(void) {
     }
 }
 
+// Effective DPI of the monitor holding `pt`. Per-Monitor V2 keeps every
+// coordinate physical, so this only sizes the loupe; without shcore every
+// monitor reports the system DPI.
+static int monitor_dpi(POINT pt) {
+    HMONITOR mon = MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+    if (mon == g_dpiMonitor) return g_dpi;
+    UINT dx = 0, dy = 0;
+    int dpi = 0;
+    if (g_getDpiForMonitor && SUCCEEDED(g_getDpiForMonitor(mon, 0 /* MDT_EFFECTIVE_DPI */, &dx, &dy))) {
+        dpi = (int)dx;
+    } else {
+        dpi = GetDeviceCaps(g_screenDC, LOGPIXELSX);
+    }
+    g_dpiMonitor = mon;
+    g_dpi = dpi > 0 ? dpi : DPI_BASE;
+    return g_dpi;
+}
+
 static RECT clamp_to_monitor(POINT desiredTopLeft, int width, int height) {
     RECT r = { desiredTopLeft.x, desiredTopLeft.y, desiredTopLeft.x + width, desiredTopLeft.y + height };
 
@@ -120,20 +426,439 @@ static void ensure_console_output(void) {
     SetConsoleOutputCP(CP_UTF8);
 }
 
+// Top-down 32-bit DIB section, so the kernels can read and write its pixels.
+static HBITMAP create_dib(int w, int h, void** bits) {
+    BITMAPINFO bmi;
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h; // top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    return CreateDIBSection(g_screenDC, &bmi, DIB_RGB_COLORS, bits, NULL, 0);
+}
+
+// Says once per call site what --mem-cap turned down.
+static void mem_refused(int* told, const wchar_t* what) {
+    if (*told) return;
+    *told = 1;
+    fwprintf(stderr, L"--mem-cap: no room for %ls\n", what);
+}
+
+// Turns --scope off (no room for its bins under --mem-cap).
+static void scope_off(void) {
+    if (g_scopeHwnd) DestroyWindow(g_scopeHwnd);
+    g_scopeHwnd = NULL;
+    if (g_scopeBmp) { DeleteObject(g_scopeBmp); g_scopeBmp = NULL; }
+    if (g_scopeDC) { DeleteDC(g_scopeDC); g_scopeDC = NULL; }
+    g_scopeMonitor = NULL;
+    scope_free(&g_scope);
+    mem_set("scope", 0);
+    g_scopeBytes = 0;
+    g_scopeRegion = -1;
+}
+
+// Sizes the loupes for the monitor under `cur` and the current zoom, and
+// makes sure their buffers hold them. Buffers only grow.
+static void ensure_resources(POINT cur) {
+    if (!g_screenDC) g_screenDC = GetDC(NULL);
+    if (!g_memDC) {
+        g_memDC = CreateCompatibleDC(g_screenDC);
+        g_capDC = CreateCompatibleDC(g_screenDC);
+    }
+
+    // The capture never exceeds the desktop.
+    int deskMin = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    if (GetSystemMetrics(SM_CYVIRTUALSCREEN) < deskMin) deskMin = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+    g_geo = loupe_geometry(&g_style, g_zoom, monitor_dpi(cur), deskMin);
+    for (int i = 0; i < g_pinCount; i++) g_pins[i].geo = loupe_geometry(&g_style, g_zoom, g_pins[i].dpi, deskMin);
+    // The pyramids are a cache --mem-cap may turn down: then zoom out only as
+    // far as the levels it leaves room for.
+    while (g_geo.levels > 1) {
+        static int told;
+        size_t want = mip_bytes_for(g_geo.srcSize, g_geo.levels);
+        for (int i = 0; i < g_pinCount; i++) want += mip_bytes_for(g_pins[i].geo.srcSize, g_geo.levels);
+        if (want <= g_mipBytes || mem_allows(want - g_mipBytes)) break;
+        mem_refused(&told, L"every zoom-out level");
+        g_zoom = 1.0 / (1 << (g_geo.levels - 2));
+        g_geo = loupe_geometry(&g_style, g_zoom, monitor_dpi(cur), deskMin);
+        for (int i = 0; i < g_pinCount; i++) g_pins[i].geo = loupe_geometry(&g_style, g_zoom, g_pins[i].dpi, deskMin);
+    }
+    g_radius = g_geo.radius;
+    g_diameter = g_geo.diameter;
+
+    // Moving onto a denser monitor grows the loupe DIB; a smaller loupe
+    // draws into its top-left corner.
+    if (!g_dib || g_diameter > g_loupeAlloc) {
+        if (g_dib) DeleteObject(g_dib);
+        g_dib = create_dib(g_diameter, g_diameter, &g_bits);
+        SelectObject(g_memDC, g_dib);
+        g_loupeAlloc = g_diameter;
+        g_loupeStride = g_diameter * 4;
+        size_t bytes = (size_t)g_loupeAlloc * g_loupeAlloc * 4;
+        for (int i = 0; i < g_pinCount; i++) bytes += (size_t)g_pins[i].geo.diameter * g_pins[i].geo.diameter * 4;
+        mem_set("loupe", bytes);
+    }
+
+    int levels = g_geo.levels;
+    int desiredCapSize = g_geo.capSize;
+    if (levels > 1) {
+        int ok = mip_reserve(&g_mip, g_geo.srcSize, levels);
+        size_t bytes = g_mip.bytes;
+        for (int i = 0; i < g_pinCount; i++) {
+            ok = ok && mip_reserve(&g_pins[i].mip, g_pins[i].geo.srcSize, levels);
+            bytes += g_pins[i].mip.bytes;
+        }
+        if (!ok) {
+            fwprintf(stderr, L"Failed to allocate zoom-out buffers\n");
+            exit(1);
+        }
+        if (bytes != g_mipBytes) mem_set("mip", bytes);
+        g_mipBytes = bytes;
+    }
+    g_srcSize = g_geo.srcSize;
+    g_mipLevels = levels;
+
+    // The capture DIB only grows: a wheel notch to a smaller square blits
+    // into its top-left corner.
+    if (!g_capBmp || desiredCapSize > g_capAlloc) {
+        if (g_capBmp) {
+            DeleteObject(g_capBmp);
+            g_capBmp = NULL;
+        }
+        // A DIB section (not a compatible bitmap) so the kernels can read the
+        // captured pixels directly.
+        g_capBmp = create_dib(desiredCapSize, desiredCapSize, &g_capBits);
+        SelectObject(g_capDC, g_capBmp);
+        g_capAlloc = desiredCapSize;
+        mem_set("capture", (size_t)desiredCapSize * desiredCapSize * 4);
+        if (!damage_reserve(&g_damage, desiredCapSize, desiredCapSize)) {
+            fwprintf(stderr, L"Failed to allocate block hashes\n");
+            exit(1);
+        }
+        mem_set("damage", damage_bytes(&g_damage));
+        if (g_ref.tiles) {
+            // Tiles the loupe has passed over stay resident, so the whole
+            // view counts. Without room for it the loupe shows the live
+            // desktop alone.
+            static int told;
+            size_t view = onion_cache_size(g_ref.width, g_ref.height);
+            size_t bytes = (size_t)desiredCapSize * desiredCapSize * 4 + view, have = mem_get("reference");
+            free(g_refSquare);
+            g_refSquare = NULL;
+            if (bytes > have && !mem_allows(bytes - have)) {
+                mem_refused(&told, L"the reference");
+                UnmapViewOfFile(g_ref.tiles - ONION_HEADER);
+                memset(&g_ref, 0, sizeof(g_ref));
+                bytes = 0;
+            } else if (!(g_refSquare = (uint8_t*)malloc((size_t)desiredCapSize * desiredCapSize * 4))) {
+                fwprintf(stderr, L"Failed to allocate reference buffer\n");
+                exit(1);
+            }
+            mem_set("reference", bytes);
+        }
+    }
+    g_capSize = desiredCapSize;
+
+    if (g_scopeRegion >= 0) {
+        if (!g_scopeBmp) {
+            g_scopeDC = CreateCompatibleDC(g_screenDC);
+            g_scopeBmp = create_dib(SCOPE_PANEL_W, SCOPE_PANEL_H, &g_scopeBits);
+            SelectObject(g_scopeDC, g_scopeBmp);
+        }
+        // The pool starts after the first frame's resources; the partials
+        // grow once when it does. They are a cache --mem-cap may turn down:
+        // then the scope bins on this thread alone (scope_run()), and with no
+        // room even for that it is turned off.
+        static int narrowed, toldNarrowed, toldOff;
+        size_t panel = (size_t)SCOPE_PANEL_W * SCOPE_PANEL_H * 4;
+        int slots = pool_slots(&g_pool);
+        if (narrowed || slots < g_scope.slotCap) slots = g_scope.slotCap;
+        size_t want = (size_t)slots * sizeof(ScopeBins) + (size_t)g_capAlloc + panel;
+        if (want > g_scopeBytes && slots > 1 && !mem_allows(want - g_scopeBytes)) {
+            mem_refused(&toldNarrowed, L"scope bins per thread");
+            narrowed = 1;
+            slots = g_scope.slotCap > 1 ? g_scope.slotCap : 1;
+            want = (size_t)slots * sizeof(ScopeBins) + (size_t)g_capAlloc + panel;
+        }
+        if (want > g_scopeBytes && !mem_allows(want - g_scopeBytes)) {
+            mem_refused(&toldOff, L"the scope");
+            scope_off();
+        } else {
+            if (!scope_reserve(&g_scope, slots, g_capAlloc)) {
+                fwprintf(stderr, L"Failed to allocate scope bins\n");
+                exit(1);
+            }
+            size_t bytes = scope_bytes(&g_scope) + panel;
+            if (bytes != g_scopeBytes) mem_set("scope", bytes);
+            g_scopeBytes = bytes;
+        }
+    }
+
+    if (g_pinCount && !g_sharedDC) {
+        g_desktop.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+        g_desktop.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+        g_desktop.right = g_desktop.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+        g_desktop.bottom = g_desktop.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        int w = g_desktop.right - g_desktop.left;
+        int h = g_desktop.bottom - g_desktop.top;
+        // The desktop mirror is a cache --mem-cap may turn down: then it
+        // holds the squares one under another (capture_loupes()).
+        static int told;
+        if (!mem_allows((size_t)w * h * 4)) {
+            mem_refused(&told, L"a desktop mirror for the pins");
+            g_sharedSquares = 1;
+        }
+        g_sharedDC = CreateCompatibleDC(g_screenDC);
+        if (!g_sharedSquares) {
+            g_sharedBmp = create_dib(w, h, &g_sharedBits);
+            SelectObject(g_sharedDC, g_sharedBmp);
+            mem_set("shared capture", (size_t)w * h * 4);
+        }
+        // A pin's monitor, and so its loupe size, never changes.
+        size_t bytes = (size_t)g_loupeAlloc * g_loupeAlloc * 4;
+        for (int i = 0; i < g_pinCount; i++) {
+            PinnedLoupe* p = &g_pins[i];
+            p->memDC = CreateCompatibleDC(g_screenDC);
+            p->dib = create_dib(p->geo.diameter, p->geo.diameter, &p->bits);
+            SelectObject(p->memDC, p->dib);
+            bytes += (size_t)p->geo.diameter * p->geo.diameter * 4;
+        }
+        mem_set("loupe", bytes);
+    }
+    if (g_sharedSquares) {
+        int side = g_capAlloc;
+        for (int i = 0; i < g_pinCount; i++) {
+            if (g_pins[i].geo.capSize > side) side = g_pins[i].geo.capSize;
+        }
+        if (side > g_sharedSide) {
+            // Squares that add up to the desktop save nothing over a mirror.
+            int w = g_desktop.right - g_desktop.left, h = g_desktop.bottom - g_desktop.top;
+            if ((size_t)side * side * (g_pinCount + 1) >= (size_t)w * h) {
+                g_sharedSquares = 0;
+                side = 0;
+            }
+            if (g_sharedBmp) DeleteObject(g_sharedBmp);
+            g_sharedBmp = side ? create_dib(side, side * (g_pinCount + 1), &g_sharedBits)
+                               : create_dib(w, h, &g_sharedBits);
+            if (!g_sharedBmp) {
+                fwprintf(stderr, L"Failed to allocate capture buffer\n");
+                exit(1);
+            }
+            SelectObject(g_sharedDC, g_sharedBmp);
+            g_sharedSide = side;
+            mem_set("shared capture", side ? (size_t)side * side * (g_pinCount + 1) * 4 : (size_t)w * h * 4);
+        }
+    }
+    // The pinned point stays where it was asked for. Its square is copied at
+    // the nearest on-desktop origin, and one that crosses the edge is shifted
+    // into place in its own buffer (capture_loupes()).
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        if (p->pt.x < g_desktop.left) p->pt.x = g_desktop.left;
+        if (p->pt.y < g_desktop.top) p->pt.y = g_desktop.top;
+        if (p->pt.x > g_desktop.right - 1) p->pt.x = g_desktop.right - 1;
+        if (p->pt.y > g_desktop.bottom - 1) p->pt.y = g_desktop.bottom - 1;
+        int size = p->geo.capSize, half = size / 2;
+        int crosses = p->pt.x - half < g_desktop.left || p->pt.y - half < g_desktop.top ||
+                      p->pt.x + half >= g_desktop.right || p->pt.y + half >= g_desktop.bottom;
+        if (crosses && p->edgeAlloc < size) {
+            free(p->edge);
+            p->edge = (uint8_t*)malloc((size_t)size * size * 4);
+            if (!p->edge) {
+                fwprintf(stderr, L"Failed to allocate capture buffer\n");
+                exit(1);
+            }
+            p->edgeAlloc = size;
+            size_t bytes = 0;
+            for (int k = 0; k < g_pinCount; k++) bytes += (size_t)g_pins[k].edgeAlloc * g_pins[k].edgeAlloc * 4;
+            mem_set("pin edge", bytes);
+        }
+    }
+}
+
+// Copies the capture square centred on `cur` from the screen into g_capBits.
+static void capture_around(POINT cur) {
+    int half = g_capSize / 2;
+    BitBlt(g_capDC, 0, 0, g_capSize, g_capSize, g_screenDC, cur.x - half, cur.y - half, SRCCOPY);
+    GdiFlush(); // make sure the blit landed before reading the DIB bits
+    g_capData = (const uint8_t*)g_capBits;
+    g_capStride = g_capAlloc * 4;
+}
+
+// Origin of a `size`-wide span that starts at `o`, moved onto [lo, hi).
+static int clamp_origin(int o, int size, int lo, int hi) {
+    return o < lo ? lo : (o + size > hi ? hi - size : o);
+}
+
+static const uint8_t* shared_pixel(int x, int y) {
+    int w = g_desktop.right - g_desktop.left;
+    return (const uint8_t*)g_sharedBits + ((size_t)(y - g_desktop.top) * w + (size_t)(x - g_desktop.left)) * 4;
+}
+
+// Square k of this frame's capture_loupes() in g_sharedBits.
+static const uint8_t* shared_square(const RegionRect* squares, int k) {
+    if (g_sharedSquares) return (const uint8_t*)g_sharedBits + (size_t)k * g_sharedSide * g_sharedSide * 4;
+    return shared_pixel(squares[k].x, squares[k].y);
+}
+
+// With pinned loupes: one shared capture for the pins and, when its square
+// is on the desktop, the cursor loupe. Nearby squares share one BitBlt; each
+// loupe then reads its square straight out of g_sharedBits.
+static void capture_loupes(POINT cur) {
+    RegionRect squares[REGION_MAX];
+    int n = 0;
+    for (int i = 0; i < g_pinCount; i++) {
+        int size = g_pins[i].geo.capSize;
+        RegionRect r = { clamp_origin(g_pins[i].pt.x - size / 2, size, g_desktop.left, g_desktop.right),
+                         clamp_origin(g_pins[i].pt.y - size / 2, size, g_desktop.top, g_desktop.bottom), size, size };
+        squares[n++] = r;
+    }
+    int half = g_capSize / 2;
+    int cursorShared = cur.x - half >= g_desktop.left && cur.y - half >= g_desktop.top &&
+                       cur.x + half < g_desktop.right && cur.y + half < g_desktop.bottom;
+    if (cursorShared) {
+        RegionRect r = { cur.x - half, cur.y - half, g_capSize, g_capSize };
+        squares[n++] = r;
+    }
+
+    int grabs, stride;
+    if (g_sharedSquares) {
+        // A DIB has one stride, so without the mirror no grabs are merged:
+        // each square is copied into rows of its own.
+        for (int k = 0; k < n; k++) {
+            BitBlt(g_sharedDC, 0, k * g_sharedSide, squares[k].w, squares[k].h, g_screenDC, squares[k].x, squares[k].y,
+                   SRCCOPY);
+        }
+        grabs = n;
+        stride = g_sharedSide * 4;
+    } else {
+        // The mirror holds any plan, so no capacity fallback is needed.
+        region_plan(&g_plan, squares, n, REGION_GRAB_COST, INT64_MAX);
+        for (int g = 0; g < g_plan.count; g++) {
+            const RegionRect* r = &g_plan.grabs[g];
+            BitBlt(g_sharedDC, r->x - g_desktop.left, r->y - g_desktop.top, r->w, r->h, g_screenDC, r->x, r->y,
+                   SRCCOPY);
+        }
+        grabs = g_plan.count;
+        stride = (g_desktop.right - g_desktop.left) * 4;
+    }
+    GdiFlush();
+    g_sharedFrames++;
+    g_sharedGrabs += grabs;
+
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        int size = p->geo.capSize;
+        p->capData = shared_square(squares, i);
+        p->capStride = stride;
+        int dx = p->pt.x - size / 2 - squares[i].x, dy = p->pt.y - size / 2 - squares[i].y;
+        if (dx || dy) {
+            // Off the edge: copy the square out of the mirror and shift it
+            // into place; whatever falls off the desktop is black.
+            for (int y = 0; y < size; y++) {
+                memcpy(p->edge + (size_t)y * size * 4, p->capData + (size_t)y * stride, (size_t)size * 4);
+            }
+            shift_bgra(p->edge, size, size, size * 4, dx, dy);
+            p->capData = p->edge;
+            p->capStride = size * 4;
+        }
+        p->hash = hash_bgra(p->capData, size, size, p->capStride);
+    }
+    if (cursorShared) {
+        g_capData = shared_square(squares, n - 1);
+        g_capStride = stride;
+    } else {
+        capture_around(cur);
+    }
+}
+
+// Blits the cursor's row and its band of columns of the cursor's monitor and
+// measures the ruler's distances into g_rulerResult. Returns their hash: an
+// edge may move outside the capture square, and parking must notice. The
+// DIBs are made again only for a monitor of another size.
+static uint64_t measure_ruler(POINT cur) {
+    MONITORINFO mi;
+    mi.cbSize = sizeof(mi);
+    GetMonitorInfo(MonitorFromPoint(cur, MONITOR_DEFAULTTONEAREST), &mi);
+    int w = mi.rcMonitor.right - mi.rcMonitor.left, h = mi.rcMonitor.bottom - mi.rcMonitor.top;
+    int bw = w < RULER_BAND ? w : RULER_BAND;
+    if (w != g_rulerW || h != g_rulerH) {
+        if (!g_rulerRowDC) {
+            g_rulerRowDC = CreateCompatibleDC(g_screenDC);
+            g_rulerBandDC = CreateCompatibleDC(g_screenDC);
+        }
+        if (g_rulerRowBmp) DeleteObject(g_rulerRowBmp);
+        if (g_rulerBandBmp) DeleteObject(g_rulerBandBmp);
+        g_rulerRowBmp = create_dib(w, 1, &g_rulerRowBits);
+        g_rulerBandBmp = create_dib(bw, h, &g_rulerBandBits);
+        // The transposed tiles are a cache --mem-cap may turn down: then the
+        // vertical rays read the band in place.
+        static int told;
+        size_t tiles = ruler_bytes_for(h), have = ruler_bytes(&g_rulerCache);
+        if (!g_rulerCache.direct && tiles > have && !mem_allows(tiles - have)) {
+            mem_refused(&told, L"ruler tiles");
+            g_rulerCache.direct = 1;
+        }
+        if (!g_rulerRowBmp || !g_rulerBandBmp || (!g_rulerCache.direct && !ruler_reserve(&g_rulerCache, h))) {
+            fwprintf(stderr, L"Failed to create ruler bitmaps\n");
+            exit(1);
+        }
+        SelectObject(g_rulerRowDC, g_rulerRowBmp);
+        SelectObject(g_rulerBandDC, g_rulerBandBmp);
+        g_rulerW = w;
+        g_rulerH = h;
+        mem_set("ruler", ((size_t)w + (size_t)bw * h) * 4 + ruler_bytes(&g_rulerCache));
+    }
+    trace_begin("ruler");
+    int x = cur.x - mi.rcMonitor.left, y = cur.y - mi.rcMonitor.top;
+    int bx = ruler_band_x(x, w);
+    BitBlt(g_rulerRowDC, 0, 0, w, 1, g_screenDC, mi.rcMonitor.left, cur.y, SRCCOPY);
+    BitBlt(g_rulerBandDC, 0, 0, bw, h, g_screenDC, mi.rcMonitor.left + bx, mi.rcMonitor.top, SRCCOPY);
+    GdiFlush();
+    double t0 = pacer_now_ms();
+    ruler_measure_cross(&g_rulerCache, (const uint32_t*)g_rulerRowBits, w, (const uint8_t*)g_rulerBandBits, bw * 4,
+                        bw, h, x, x - bx, y, g_rulerTolerance, &g_rulerResult);
+    ruler_count_ms(&g_rulerCache, pacer_now_ms() - t0);
+    trace_end("ruler");
+    return ruler_hash(&g_rulerResult);
+}
+
+// Captures this frame's squares and returns a hash over all of them. The
+// cursor square's is the fold of its block hashes, which also flag the
+// blocks that changed since the last capture.
+static uint64_t capture_frame(POINT cur) {
+    uint64_t h = 0;
+    if (g_pinCount) {
+        capture_loupes(cur);
+        for (int i = 0; i < g_pinCount; i++) h = (h ^ g_pins[i].hash) * 0x100000001B3ull;
+    } else {
+        capture_around(cur);
+    }
+    g_capCursor = cur;
+    damage_update(&g_damage, g_capData, g_capSize, g_capSize, g_capStride);
+    if (g_ruler) h ^= measure_ruler(cur);
+    return h ^ g_damage.frameHash;
+}
+
 static void copy_color_and_quit(void) {
     POINT p;
     GetCursorPos(&p);
 
-    HDC screen = GetDC(NULL);
-    COLORREF c = GetPixel(screen, p.x, p.y);
-    ReleaseDC(NULL, screen);
-
-    int r = GetRValue(c);
-    int g = GetGValue(c);
-    int b = GetBValue(c);
+    // Re-capture at the current position (an arrow-key nudge may have moved
+    // the cursor since the last frame) and sample the centre pixel.
+    ensure_resources(p);
+    capture_around(p);
+    int center = g_capSize / 2;
+    perf_start(&g_perf);
+    uint32_t c = sample_average_bgra(g_capData, g_capSize, g_capSize, g_capStride, center, center, 0);
+    char hex[8];
+    format_hex_color(c, hex);
+    perf_stop(&g_perf, &g_perfStages[STAGE_PICK], 1.0);
 
     wchar_t buf[16];
-    swprintf(buf, 16, L"#%02X%02X%02X", r, g, b);
+    for (int i = 0; i < 8; i++) buf[i] = (wchar_t)hex[i];
     clipboard_set_text_utf16(buf);
 
     ensure_console_output();
@@ -143,164 +868,488 @@ static void copy_color_and_quit(void) {
     PostQuitMessage(0);
 }
 
+// Captures the cursor's monitor and reports the same-colour region around the
+// cursor. The monitor DIB is kept for the next measurement of that size.
+static void measure_region(void) {
+    POINT p;
+    GetCursorPos(&p);
+    HMONITOR mon = MonitorFromPoint(p, MONITOR_DEFAULTTONEAREST);
+    MONITORINFO mi;
+    mi.cbSize = sizeof(mi);
+    GetMonitorInfo(mon, &mi);
+    int w = mi.rcMonitor.right - mi.rcMonitor.left, h = mi.rcMonitor.bottom - mi.rcMonitor.top;
+    if (!g_fillDC) g_fillDC = CreateCompatibleDC(g_screenDC);
+    if (w != g_fillW || h != g_fillH) {
+        // The monitor DIB and the fill's visited map, a byte per pixel.
+        static int told;
+        size_t want = (size_t)w * h * 5, have = mem_get("fill");
+        if (want > have && !mem_allows(want - have)) {
+            mem_refused(&told, L"a whole-monitor capture; no region measured");
+            return;
+        }
+        if (g_fillBmp) DeleteObject(g_fillBmp);
+        g_fillBmp = create_dib(w, h, &g_fillBits);
+        g_fillW = g_fillBmp ? w : 0;
+        g_fillH = g_fillBmp ? h : 0;
+        if (!g_fillBmp) {
+            fwprintf(stderr, L"Failed to create measurement bitmap\n");
+            return;
+        }
+        SelectObject(g_fillDC, g_fillBmp);
+    }
+    trace_begin("measure");
+    BitBlt(g_fillDC, 0, 0, w, h, g_screenDC, mi.rcMonitor.left, mi.rcMonitor.top, SRCCOPY);
+    GdiFlush();
+    double t0 = pacer_now_ms();
+    FillResult r;
+    int ok = flood_fill_bgra(&g_fill, (const uint8_t*)g_fillBits, w, h, w * 4, p.x - mi.rcMonitor.left,
+                             p.y - mi.rcMonitor.top, g_fillTolerance, &r);
+    double ms = pacer_now_ms() - t0;
+    trace_end("measure");
+    if (!ok) {
+        fwprintf(stderr, L"Out of memory measuring the region\n");
+        return;
+    }
+    fill_count_ms(&g_fill, ms);
+    mem_set("fill", fill_bytes(&g_fill) + (size_t)w * h * 4);
+    // Report in desktop coordinates, like --pin takes them.
+    r.x0 += mi.rcMonitor.left;
+    r.x1 += mi.rcMonitor.left;
+    r.y0 += mi.rcMonitor.top;
+    r.y1 += mi.rcMonitor.top;
+    r.cx += mi.rcMonitor.left;
+    r.cy += mi.rcMonitor.top;
+    char line[160];
+    fill_format(&r, ms, line, sizeof(line));
+    wchar_t buf[160];
+    int i = 0;
+    for (; line[i] && i < 159; i++) buf[i] = (wchar_t)line[i];
+    buf[i] = 0;
+    clipboard_set_text_utf16(buf);
+    ensure_console_output();
+    wprintf(L"%ls\n", buf);
+    fflush(stdout);
+}
+
+// Marks a point of the two-point measurement where the loupe last showed
+// the cursor, snapped to nearby edges in that frame's capture square. The
+// second point of a pair prints the measurement, copies it to the clipboard
+// and starts a new pair.
+static void mark_point(void) {
+    if (!g_capData) return;  // no frame yet
+    int half = g_capSize / 2;
+    EdgePoint p = edge_snap_point(g_capData, g_capSize, g_capStride, half, half, g_capCursor.x - half,
+                                  g_capCursor.y - half, EDGE_REACH, EDGE_MIN_GRADIENT);
+    char point[64], line[192];
+    edge_format_point(&p, point, sizeof(point));
+    size_t clip = 0;  // where the line copied to the clipboard starts
+    if (g_pointCount == 0) {
+        g_pointA = p;
+        g_pointCount = 1;
+        snprintf(line, sizeof(line), "A %s", point);
+    } else {
+        int n = snprintf(line, sizeof(line), "B %s\n", point);
+        clip = (size_t)n;
+        edge_format_pair(&g_pointA, &p, line + clip, sizeof(line) - clip);
+        g_pointCount = 0;
+    }
+    wchar_t buf[192];
+    int i = 0;
+    for (; line[i] && i < 191; i++) buf[i] = (wchar_t)line[i];
+    buf[i] = 0;
+    if (clip) clipboard_set_text_utf16(buf + clip);
+    ensure_console_output();
+    wprintf(L"%ls\n", buf);
+    fflush(stdout);
+}
+
+// Wheel up zooms in a quarter octave per notch, wheel down zooms out. The
+// posted WM_APP_ZOOM draws at once; its present ends the latency measured
+// from here.
+static void zoom_by_wheel(int notches) {
+    trace_instant("wheel");
+    g_zoom = zoom_wheel_step(g_zoom, notches, 1.0 / kMaxZoomOut, (double)kMaxZoom);
+    g_wheelSteps += notches < 0 ? -notches : notches;
+    if (g_wheelAtMs == 0.0) g_wheelAtMs = pacer_now_ms();
+}
+
+// Hooks run on the UI thread but must return quickly; the redraw happens in
+// the posted message.
+static void unpark_on_input(void) {
+    if (park_wake(&g_parker, pacer_now_ms())) PostMessageW(g_hwnd, WM_APP_UNPARK, 0, 0);
+}
+
 static LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode == HC_ACTION) {
         const MSLLHOOKSTRUCT* ms = (const MSLLHOOKSTRUCT*)lParam;
-        (void)ms;
+        if (wParam == WM_MOUSEMOVE) unpark_on_input();
+        if (wParam == WM_MOUSEWHEEL) {
+            // High-resolution wheels report fractions of a notch.
+            g_wheelDelta += (short)HIWORD(ms->mouseData);
+            int notches = g_wheelDelta / WHEEL_DELTA;
+            g_wheelDelta -= notches * WHEEL_DELTA;
+            if (notches) {
+                zoom_by_wheel(notches);
+                PostMessageW(g_hwnd, WM_APP_ZOOM, 0, 0);
+            }
+            return 1; // the page under the loupe must not scroll
+        }
         if (wParam == WM_LBUTTONDOWN) {
-            copy_color_and_quit();
+            trace_begin("mouse_hook");
+            if (g_twoPoint) {
+                mark_point();
+            } else {
+                copy_color_and_quit();
+            }
+            trace_end("mouse_hook");
             return 1; // swallow to avoid double-click side effects
         }
     }
     return CallNextHookEx(g_mouseHook, nCode, wParam, lParam);
 }
 
+// Returns 1 when the key was handled and should be swallowed.
+static int handle_key_down(DWORD vkCode) {
+    int step = (GetAsyncKeyState(VK_SHIFT) & 0x8000) ? 5 : 1;
+    POINT p;
+
+    switch (vkCode) {
+        case VK_RETURN:
+            if (g_twoPoint) {
+                mark_point();
+            } else {
+                copy_color_and_quit();
+            }
+            return 1;
+        case VK_LEFT:
+            GetCursorPos(&p);
+            SetCursorPos(p.x - step, p.y);
+            return 1;
+        case VK_RIGHT:
+            GetCursorPos(&p);
+            SetCursorPos(p.x + step, p.y);
+            return 1;
+        case VK_UP:
+            GetCursorPos(&p);
+            SetCursorPos(p.x, p.y - step);
+            return 1;
+        case VK_DOWN:
+            GetCursorPos(&p);
+            SetCursorPos(p.x, p.y + step);
+            return 1;
+        case 'M':
+            // A monitor grab and a fill are too slow for the hook.
+            PostMessageW(g_hwnd, WM_APP_MEASURE, 0, 0);
+            return 1;
+        case 'R':
+            // The ruler draws over the loupe; the next frame composes it whole.
+            g_ruler = !g_ruler;
+            g_drawnUpdate = 0;
+            return 1;
+        case 'T':
+            g_twoPoint = !g_twoPoint;
+            g_pointCount = 0;
+            return 1;
+        case 'O':
+            if (!g_ref.tiles) return 0;
+            g_refMode = g_refMode == LOUPE_FILTER_BLEND ? LOUPE_FILTER_DIFF
+                      : g_refMode == LOUPE_FILTER_DIFF  ? LOUPE_FILTER_NONE
+                                                         : LOUPE_FILTER_BLEND;
+            g_drawnUpdate = 0;
+            return 1;
+        case 'A':
+            g_amplify = !g_amplify;
+            g_drawnUpdate = 0;
+            return 1;
+        case VK_ESCAPE:
+            PostQuitMessage(0);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 static LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode == HC_ACTION) {
         const KBDLLHOOKSTRUCT* ks = (const KBDLLHOOKSTRUCT*)lParam;
 
         if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
-            int step = (GetAsyncKeyState(VK_SHIFT) & 0x8000) ? 5 : 1;
-            POINT p;
-
-            switch (ks->vkCode) {
-                case VK_RETURN:
-                    copy_color_and_quit();
-                    return 1;
-                case VK_LEFT:
-                    GetCursorPos(&p);
-                    SetCursorPos(p.x - step, p.y);
-                    return 1;
-                case VK_RIGHT:
-                    GetCursorPos(&p);
-                    SetCursorPos(p.x + step, p.y);
-                    return 1;
-                case VK_UP:
-                    GetCursorPos(&p);
-                    SetCursorPos(p.x, p.y - step);
-                    return 1;
-                case VK_DOWN:
-                    GetCursorPos(&p);
-                    SetCursorPos(p.x, p.y + step);
-                    return 1;
-                case VK_ESCAPE:
-                    PostQuitMessage(0);
-                    return 1;
-                default:
-                    break;
-            }
+            unpark_on_input();
+            trace_begin("keyboard_hook");
+            int handled = handle_key_down(ks->vkCode);
+            trace_end("keyboard_hook");
+            if (handled) return 1;
         }
     }
     return CallNextHookEx(g_keyboardHook, nCode, wParam, lParam);
 }
 
-static void ensure_resources(void) {
-    if (!g_memDC) {
-        HDC screen = GetDC(NULL);
-        g_memDC = CreateCompatibleDC(screen);
-
-        BITMAPINFO bmi;
-        ZeroMemory(&bmi, sizeof(bmi));
-        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-        bmi.bmiHeader.biWidth = kDiameter;
-        bmi.bmiHeader.biHeight = -kDiameter; // top-down
-        bmi.bmiHeader.biPlanes = 1;
-        bmi.bmiHeader.biBitCount = 32;
-        bmi.bmiHeader.biCompression = BI_RGB;
-
-        g_dib = CreateDIBSection(screen, &bmi, DIB_RGB_COLORS, &g_bits, NULL, 0);
-        SelectObject(g_memDC, g_dib);
+// The loupe's source for a capture square: the square itself, or when zoomed
+// out a resample of the square's mip pyramid, brought up to date first.
+static const uint8_t* loupe_source(const LoupeGeometry* geo, const uint8_t* cap, int capStride, MipPyramid* mip,
+                                   int* stride) {
+    if (geo->levels == 1) {
+        *stride = capStride;
+        return cap;
+    }
+    double t0 = pacer_now_ms();
+    mip_update(mip, cap, capStride, geo->srcSize, geo->levels);
+    double t1 = pacer_now_ms();
+    const uint8_t* src = mip_sample(mip, 1.0 / g_zoom, geo->srcSize);
+    g_mipUpdateMs += t1 - t0;
+    g_mipSampleMs += pacer_now_ms() - t1;
+    *stride = geo->srcSize * 4;
+    return src;
+}
 
-        g_capDC = CreateCompatibleDC(screen);
+// Compose one loupe in four separate passes (the default size fits in cache
+// whole), so --trace and --stats can show each stage.
+static void draw_loupe_stages(void) {
+    // Magnify the capture into the DIB (every pixel is written, no clear needed)
+    trace_begin("scale");
+    perf_start(&g_perf);
+    scale_nearest_bgra(g_srcData, g_srcSize, g_srcSize, g_srcStride,
+                       (uint8_t*)g_bits, g_diameter, g_diameter, g_loupeStride);
+    perf_stop(&g_perf, &g_perfStages[STAGE_SCALE], (double)g_diameter * g_diameter);
+    trace_end("scale");
+
+    trace_begin("mask");
+    perf_start(&g_perf);
+    apply_circle_alpha_mask((uint8_t*)g_bits, g_radius, g_loupeStride);
+    perf_stop(&g_perf, &g_perfStages[STAGE_MASK], (double)g_diameter * g_diameter);
+    trace_end("mask");
+
+    // Circle border and center marker
+    trace_begin("border");
+    perf_start(&g_perf);
+    blend_circle_border((uint8_t*)g_bits, g_radius, g_loupeStride, g_geo.borderWidth, pacer_antialias(&g_pacer));
+    draw_center_marker((uint8_t*)g_bits, g_radius, g_loupeStride, g_geo.markerSize);
+    perf_stop(&g_perf, &g_perfStages[STAGE_BLEND], (double)g_diameter * g_diameter);
+    trace_end("border");
+}
+
+// The pool the compose stage runs on. The perf counters follow the calling
+// thread only, so while they are open compose stays on it and is counted
+// whole; --stats says so.
+static WorkerPool* compose_pool(void) {
+    return g_perf.available ? &g_inlinePool : &g_pool;
+}
 
-        ReleaseDC(NULL, screen);
+// Composes the cursor loupe (unless it was patched) and every pinned loupe
+// whose square or quality level changed since it was drawn, as one pool
+// batch. A pin over still content costs one hash per frame.
+static void compose_with_pins(int cursor) {
+    int aa = pacer_antialias(&g_pacer);
+    LoupeJob jobs[MAX_PINS + 1];
+    int n = 0;
+    double pixels = 0.0;
+    if (cursor) {
+        jobs[n++] = loupe_job(g_srcData, g_srcSize, g_srcStride, (uint8_t*)g_bits, g_radius, g_loupeStride,
+                              g_geo.borderWidth, aa, g_geo.markerSize);
+        jobs[0].filter = &g_filter;
+        pixels += (double)g_diameter * g_diameter;
+    }
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        p->dirty = !p->shown || p->hash != p->drawnHash || aa != p->drawnAntialias || g_zoom != p->drawnZoom;
+        if (!p->dirty) {
+            g_pinSkips++;
+            continue;
+        }
+        int srcStride;
+        const LoupeGeometry* geo = &p->geo;
+        const uint8_t* src = loupe_source(geo, p->capData, p->capStride, &p->mip, &srcStride);
+        jobs[n++] = loupe_job(src, geo->srcSize, srcStride, (uint8_t*)p->bits, geo->radius, geo->diameter * 4,
+                              geo->borderWidth, aa, geo->markerSize);
+        pixels += (double)geo->diameter * geo->diameter;
+        p->drawnHash = p->hash;
+        p->drawnAntialias = aa;
+        p->drawnZoom = g_zoom;
+        g_pinComposes++;
     }
 
-    // Use odd capture size so the cursor maps to the exact center pixel.
-    int desiredCapSize = kDiameter / kZoom;
-    if ((desiredCapSize % 2) == 0) desiredCapSize += 1;
+    if (!n) return;
+    trace_begin("compose");
+    perf_start(&g_perf);
+    compose_loupes_tiled(compose_pool(), jobs, n);
+    perf_stop(&g_perf, &g_perfStages[STAGE_COMPOSE], pixels);
+    trace_end("compose");
+}
 
-    if (!g_capBmp || g_capSize != desiredCapSize) {
-        if (g_capBmp) {
-            DeleteObject(g_capBmp);
-            g_capBmp = NULL;
+// The loupe DIB can be patched rather than composed: it was drawn from the
+// previous capture of a square the same size, at the same size and quality.
+// Zoomed out the loupe samples a pyramid rather than the capture, and the
+// flash diagnostic, the ruler, the onion skin's label and the amplifier
+// (whose map follows the centre pixel) change pixels of their own, so all
+// of them compose in full.
+static int loupe_can_patch(int aa) {
+    return g_drawnUpdate && g_drawnUpdate + 1 == g_damage.updates && g_drawnCapSize == g_capSize &&
+           g_drawnDiameter == g_diameter && g_drawnLevels == 1 && g_mipLevels == 1 && g_drawnAntialias == aa &&
+           !g_flashDamage && !g_ruler && g_filter.mode == LOUPE_FILTER_NONE;
+}
+
+// Pinned loupes sit next to their point like the cursor loupe does; only
+// the ones composed this frame are updated.
+static void present_pins(BLENDFUNCTION* bf) {
+    POINT ptSrc = { 0, 0 };
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        if (!p->dirty) continue;
+        SIZE sizeWnd = { p->geo.diameter, p->geo.diameter };
+        POINT desired = { p->pt.x + p->geo.offset, p->pt.y + p->geo.offset };
+        RECT wr = clamp_to_monitor(desired, p->geo.diameter, p->geo.diameter);
+        POINT ptDst = { wr.left, wr.top };
+        UpdateLayeredWindow(p->hwnd, g_screenDC, &ptDst, &sizeWnd, p->memDC, &ptSrc, 0, bf, ULW_ALPHA);
+        if (!p->shown) {
+            ShowWindow(p->hwnd, SW_SHOWNOACTIVATE);
+            p->shown = 1;
         }
-        HDC screen = GetDC(NULL);
-        g_capBmp = CreateCompatibleBitmap(screen, desiredCapSize, desiredCapSize);
-        SelectObject(g_capDC, g_capBmp);
-        ReleaseDC(NULL, screen);
-        g_capSize = desiredCapSize;
+        p->dirty = 0;
     }
 }
 
-static void apply_circle_alpha_mask(void) {
-    uint8_t* px = (uint8_t*)g_bits; // BGRA
-    int r2 = kRadius * kRadius;
-    int cx = kRadius;
-    int cy = kRadius;
+// Bins and draws the --scope panel and docks it on the cursor's monitor,
+// unless it already shows this capture (no block changed since the last run).
+static void draw_scope(POINT cur) {
+    HMONITOR mon = MonitorFromPoint(cur, MONITOR_DEFAULTTONEAREST);
+    int unchanged = g_damage.updates == g_scopeUpdate + 1 && !g_damage.changedCount;
+    g_scopeUpdate = g_damage.updates;
+    if (unchanged && mon == g_scopeMonitor) {
+        g_scope.skipped++;
+        return;
+    }
+    trace_begin("scope");
+    double t0 = pacer_now_ms();
+    int n;
+    const uint8_t* region = scope_region(g_capData, g_capSize, g_capStride, g_scopeRegion, &n);
+    scope_run(&g_scope, &g_pool, region, n, n, g_capStride);
+    scope_render_bgra(&g_scope, (uint8_t*)g_scopeBits, SCOPE_PANEL_W * 4);
+    scope_count_ms(&g_scope, pacer_now_ms() - t0);
+    trace_end("scope");
 
-    for (int y = 0; y < kDiameter; y++) {
-        for (int x = 0; x < kDiameter; x++) {
-            int dx = x - cx;
-            int dy = y - cy;
-            int d2 = dx*dx + dy*dy;
-            uint8_t* p = px + (y * kDiameter + x) * 4;
-            if (d2 <= r2) {
-                p[3] = 255;
-            } else {
-                p[0] = 0; p[1] = 0; p[2] = 0; p[3] = 0;
-            }
-        }
+    MONITORINFO mi;
+    mi.cbSize = sizeof(mi);
+    GetMonitorInfo(mon, &mi);
+    POINT ptDst = { mi.rcWork.right - SCOPE_PANEL_W - kScopeMargin, mi.rcWork.top + kScopeMargin };
+    POINT ptSrc = { 0, 0 };
+    SIZE sizeWnd = { SCOPE_PANEL_W, SCOPE_PANEL_H };
+    BLENDFUNCTION bf = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    UpdateLayeredWindow(g_scopeHwnd, g_screenDC, &ptDst, &sizeWnd, g_scopeDC, &ptSrc, 0, &bf, ULW_ALPHA);
+    if (!g_scopeMonitor) ShowWindow(g_scopeHwnd, SW_SHOWNOACTIVATE);
+    g_scopeMonitor = mon;
+}
+
+// Sets this frame's loupe filter: the difference amplifier around the
+// centre pixel, or the onion skin over the capture square centred on `cur`,
+// with the reference under it read from the mapped tiles. Zoomed out the
+// loupe samples a pyramid of the screen alone, and the onion skin is not
+// shown.
+static void select_filter(POINT cur) {
+    g_filter.mode = LOUPE_FILTER_NONE;
+    if (g_amplify) {
+        int half = g_capSize / 2;
+        g_amplifyBuilds += filter_amplify(&g_filter, pixel_row_const(g_capData, g_capStride, half)[half],
+                                          g_amplifyRange);
+        g_amplifyFrames++;
+        return;
     }
+    if (!g_ref.tiles || g_refMode == LOUPE_FILTER_NONE || g_mipLevels > 1) return;
+    int half = g_capSize / 2;
+    trace_begin("reference");
+    onion_fetch(&g_ref, cur.x - half - g_refX, cur.y - half - g_refY, g_capSize, g_refSquare, g_capSize * 4);
+    trace_end("reference");
+    g_filter.mode = g_refMode;
+    g_filter.ref = g_refSquare;
+    g_filter.refStride = g_capSize * 4;
+    g_filter.opacity = g_refOpacity;
 }
 
-static void draw_overlay_frame(void) {
-    ensure_resources();
+// Draws the CIEDE2000 difference between the centre pixel and the reference
+// under it, unless the reference is transparent there.
+static void draw_reference_delta(void) {
+    int half = g_capSize / 2;
+    uint32_t live = pixel_row_const(g_capData, g_capStride, half)[half];
+    uint32_t ref = pixel_row_const(g_refSquare, g_capSize * 4, half)[half];
+    if (!(ref >> 24)) return;
+    onion_draw_delta_e((uint8_t*)g_bits, g_radius, g_loupeStride, onion_delta_e(live, ref), g_geo.borderWidth,
+                       dpi_scale(2, g_geo.dpi));
+}
 
+static void draw_overlay_frame(void) {
+    trace_begin("frame");
     POINT cur;
     GetCursorPos(&cur);
+    ensure_resources(cur);
 
     // Capture source square around cursor
-    int capSize = g_capSize;
-    int half = capSize / 2;
-
-    HDC screen = GetDC(NULL);
-    BitBlt(g_capDC, 0, 0, capSize, capSize, screen, cur.x - half, cur.y - half, SRCCOPY);
-    ReleaseDC(NULL, screen);
-
-    // Clear memory buffer
-    memset(g_bits, 0, kDiameter * kDiameter * 4);
-
-    // Draw magnified capture into DIB
-    SetStretchBltMode(g_memDC, COLORONCOLOR);
-    StretchBlt(g_memDC, 0, 0, kDiameter, kDiameter, g_capDC, 0, 0, capSize, capSize, SRCCOPY);
-
-    // Apply circle alpha after StretchBlt (GDI doesn't set alpha)
-    apply_circle_alpha_mask();
-
-    // Draw circle border (will affect RGB, alpha already 255 in circle)
-    HPEN pen = CreatePen(PS_SOLID, kBorderWidth, RGB(255, 255, 255));
-    HGDIOBJ oldPen = SelectObject(g_memDC, pen);
-    HGDIOBJ oldBrush = SelectObject(g_memDC, GetStockObject(HOLLOW_BRUSH));
-
-    int inset = kBorderWidth / 2;
-    Ellipse(g_memDC, inset, inset, kDiameter - inset, kDiameter - inset);
-
-    // Draw center marker (small square)
-    int m = 6;
-    int cx = kRadius;
-    int cy = kRadius;
-    Rectangle(g_memDC, cx - m/2, cy - m/2, cx + m/2, cy + m/2);
-
-    SelectObject(g_memDC, oldBrush);
-    SelectObject(g_memDC, oldPen);
-    DeleteObject(pen);
+    trace_begin("capture");
+    uint64_t capHash = capture_frame(cur);
+    trace_end("capture");
+
+    if (g_mipLevels > 1) {
+        trace_begin("reduce");
+        perf_start(&g_perf);
+        g_srcData = loupe_source(&g_geo, g_capData, g_capStride, &g_mip, &g_srcStride);
+        perf_stop(&g_perf, &g_perfStages[STAGE_REDUCE], (double)g_capSize * g_capSize);
+        trace_end("reduce");
+        g_mipFrames++;
+    } else {
+        g_srcData = g_capData;
+        g_srcStride = g_capStride;
+    }
+    select_filter(cur);
+
+    // Only blocks of the capture that changed since the last frame: patch
+    // their tiles of the loupe and present the rectangle they span.
+    int aa = pacer_antialias(&g_pacer);
+    int patch = loupe_can_patch(aa);
+    int dirty[4] = { 0, 0, g_diameter, g_diameter };
+    size_t composed = (size_t)g_diameter * g_diameter;
+    if (patch) {
+        trace_begin("compose");
+        perf_start(&g_perf);
+        composed = damage_compose_loupe(&g_damage, g_srcData, g_srcStride, (uint8_t*)g_bits, g_radius,
+                                        g_loupeStride, g_geo.borderWidth, aa, g_geo.markerSize, dirty);
+        perf_stop(&g_perf, &g_perfStages[STAGE_COMPOSE], (double)composed);
+        trace_end("compose");
+    }
+    if (g_pinCount) {
+        compose_with_pins(!patch);
+    } else if (patch) {
+        // Patched above.
+    } else if (loupe_band_rows(g_loupeStride) < g_diameter || g_filter.mode != LOUPE_FILTER_NONE) {
+        // Giant loupe: all four passes band by band on the pool, so each band
+        // stays in cache and the bands run in parallel. The filters are
+        // fused into the scale pass, so they take this path at any size.
+        trace_begin("compose");
+        perf_start(&g_perf);
+        compose_loupe_filtered_tiled(compose_pool(), &g_filter, g_srcData, g_srcSize, g_srcStride, (uint8_t*)g_bits,
+                                     g_radius, g_loupeStride, g_geo.borderWidth, aa, g_geo.markerSize);
+        perf_stop(&g_perf, &g_perfStages[STAGE_COMPOSE], (double)g_diameter * g_diameter);
+        trace_end("compose");
+    } else {
+        draw_loupe_stages();
+    }
+    // Zoomed out, the blocks are mapped through the capture's size rather
+    // than the pyramid's sampling; close enough for a diagnostic.
+    if (g_flashDamage) damage_flash_bgra(&g_damage, (uint8_t*)g_bits, g_diameter, g_diameter, g_loupeStride);
+    if (g_ruler) {
+        ruler_draw_bgra(&g_rulerResult, (uint8_t*)g_bits, g_radius, g_loupeStride, g_capSize, g_geo.borderWidth,
+                        dpi_scale(2, g_geo.dpi));
+    }
+    if (g_filter.mode == LOUPE_FILTER_BLEND || g_filter.mode == LOUPE_FILTER_DIFF) draw_reference_delta();
+    if (g_scopeRegion >= 0) draw_scope(cur);
+    g_drawnUpdate = g_damage.updates;
+    g_drawnCapSize = g_capSize;
+    g_drawnDiameter = g_diameter;
+    g_drawnLevels = g_mipLevels;
+    g_drawnAntialias = aa;
 
     // Position window near cursor
-    POINT desired = { cur.x + kOffsetX, cur.y + kOffsetY };
-    RECT wr = clamp_to_monitor(desired, kDiameter, kDiameter);
+    POINT desired = { cur.x + g_geo.offset, cur.y + g_geo.offset };
+    RECT wr = clamp_to_monitor(desired, g_diameter, g_diameter);
 
-    SIZE sizeWnd = { kDiameter, kDiameter };
+    SIZE sizeWnd = { g_diameter, g_diameter };
     POINT ptSrc = { 0, 0 };
     POINT ptDst = { wr.left, wr.top };
 
@@ -310,9 +1359,73 @@ static void draw_overlay_frame(void) {
     bf.SourceConstantAlpha = 255;
     bf.AlphaFormat = AC_SRC_ALPHA;
 
-    HDC screenDC = GetDC(NULL);
-    UpdateLayeredWindow(g_hwnd, screenDC, &ptDst, &sizeWnd, g_memDC, &ptSrc, 0, &bf, ULW_ALPHA);
-    ReleaseDC(NULL, screenDC);
+    trace_begin("present");
+    // A layered window keeps its bitmap, so a patched frame sends only the
+    // dirty rectangle, and an unchanged one at most moves the window.
+    int moved = ptDst.x != g_presentedAt.x || ptDst.y != g_presentedAt.y;
+    size_t presented = 0;
+    if (!patch || !g_presented) {
+        UpdateLayeredWindow(g_hwnd, g_screenDC, &ptDst, &sizeWnd, g_memDC, &ptSrc, 0, &bf, ULW_ALPHA);
+        presented = (size_t)g_diameter * g_diameter;
+    } else if (dirty[0] < dirty[2]) {
+        RECT rc = { dirty[0], dirty[1], dirty[2], dirty[3] };
+        UPDATELAYEREDWINDOWINFO info = { 0 };
+        info.cbSize = sizeof(info);
+        info.hdcDst = g_screenDC;
+        info.pptDst = &ptDst;
+        info.psize = &sizeWnd;
+        info.hdcSrc = g_memDC;
+        info.pptSrc = &ptSrc;
+        info.pblend = &bf;
+        info.dwFlags = ULW_ALPHA;
+        info.prcDirty = &rc;
+        UpdateLayeredWindowIndirect(g_hwnd, &info);
+        presented = (size_t)(dirty[2] - dirty[0]) * (size_t)(dirty[3] - dirty[1]);
+    } else if (moved) {
+        SetWindowPos(g_hwnd, NULL, ptDst.x, ptDst.y, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE);
+    }
+    g_presentedAt = ptDst;
+    g_presented = 1;
+    damage_count_frame(&g_damage, patch, composed, presented);
+    present_pins(&bf);
+    trace_end("present");
+    if (g_wheelAtMs > 0.0) {
+        double ms = pacer_now_ms() - g_wheelAtMs;
+        g_wheelFrames++;
+        g_wheelTotalMs += ms;
+        if (ms > g_wheelMaxMs) g_wheelMaxMs = ms;
+        g_wheelAtMs = 0.0;
+    }
+    if (park_after_frame(&g_parker, cur.x, cur.y, capHash, pacer_now_ms())) {
+        trace_instant("park");
+        SetTimer(g_hwnd, 1, PARK_POLL_MS, NULL); // same id: replaces the fast tick
+    }
+    trace_end("frame");
+}
+
+static void render_frame(void) {
+    pacer_frame_begin(&g_pacer, pacer_now_ms());
+    draw_overlay_frame();
+    pacer_frame_end(&g_pacer, pacer_now_ms());
+}
+
+static void resume_ticking(void) {
+    trace_instant("unpark");
+    pacer_resume(&g_pacer);
+    SetTimer(g_hwnd, 1, kTickMs, NULL);
+    render_frame();
+}
+
+// Slow-timer check while parked: re-capture and compare.
+static int poll_for_damage(void) {
+    trace_begin("damage_poll");
+    POINT cur;
+    GetCursorPos(&cur);
+    ensure_resources(cur);
+    uint64_t h = capture_frame(cur);
+    int woke = park_poll(&g_parker, cur.x, cur.y, h, pacer_now_ms());
+    trace_end("damage_poll");
+    return woke;
 }
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -321,7 +1434,28 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             SetTimer(hwnd, 1, kTickMs, NULL);
             return 0;
         case WM_TIMER:
-            draw_overlay_frame();
+            if (g_parker.parked) {
+                if (poll_for_damage()) resume_ticking();
+                return 0;
+            }
+            trace_instant("tick");
+            if (pacer_tick(&g_pacer, pacer_now_ms())) render_frame();
+            return 0;
+        case WM_APP_UNPARK:
+            resume_ticking();
+            return 0;
+        case WM_APP_ZOOM:
+            // Several notches may have been coalesced into one earlier frame.
+            if (g_wheelAtMs == 0.0) return 0;
+            if (g_parker.parked) {
+                park_wake(&g_parker, pacer_now_ms());
+                resume_ticking();
+            } else {
+                render_frame();
+            }
+            return 0;
+        case WM_APP_MEASURE:
+            measure_region();
             return 0;
         case WM_DESTROY:
             KillTimer(hwnd, 1);
@@ -332,12 +1466,390 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
     }
 }
 
+static void write_trace_file(void) {
+    if (!g_tracePath) return;
+    FILE* fp = _wfopen(g_tracePath, L"w");
+    if (!fp) {
+        fwprintf(stderr, L"Failed to open trace file %ls\n", g_tracePath);
+        return;
+    }
+    trace_dump_json(fp);
+    fclose(fp);
+}
+
+static void report_stats(FILE* fp) {
+    mem_set("trace", trace_bytes());
+    pacer_report(&g_pacer, fp);
+    perf_report(&g_perf, g_perfStages, STAGE_COUNT, fp);
+    if (g_perf.available && g_pool.threads) {
+        fprintf(fp, "perf counters: compose ran on this thread, not on the %d pool workers\n", g_pool.threads);
+    }
+    pool_report(&g_pool, fp);
+    if (g_pinCount) {
+        fprintf(fp, "pins: %d pinned loupes, %.2f grabs per frame, %ld pin composes, %ld skipped unchanged\n",
+                g_pinCount, g_sharedFrames ? (double)g_sharedGrabs / (double)g_sharedFrames : 0.0, g_pinComposes,
+                g_pinSkips);
+    }
+    fprintf(fp, "zoom: %.3gx, %ld wheel steps, wheel to present %.2f ms avg, %.2f ms max\n", g_zoom, g_wheelSteps,
+            g_wheelFrames ? g_wheelTotalMs / (double)g_wheelFrames : 0.0, g_wheelMaxMs);
+    if (g_mipFrames) {
+        uint64_t reduced = g_mip.tilesReduced, clean = g_mip.tilesClean;
+        for (int i = 0; i < g_pinCount; i++) {
+            reduced += g_pins[i].mip.tilesReduced;
+            clean += g_pins[i].mip.tilesClean;
+        }
+        fprintf(fp, "mip: %ld zoomed-out frames, %.3f ms update + %.3f ms sample per frame, %llu tiles reduced, "
+                    "%llu unchanged\n",
+                g_mipFrames, g_mipUpdateMs / (double)g_mipFrames, g_mipSampleMs / (double)g_mipFrames,
+                (unsigned long long)reduced, (unsigned long long)clean);
+    }
+    damage_report(&g_damage, fp);
+    scope_report(&g_scope, fp);
+    fill_report(&g_fill, fp);
+    ruler_report(&g_rulerCache, fp);
+    if (g_amplifyFrames) {
+        fprintf(fp, "amplify: %ld frames, %ld table builds\n", g_amplifyFrames, g_amplifyBuilds);
+    }
+    park_report(&g_parker, fp, pacer_now_ms());
+    mem_report(fp);
+}
+
+static BOOL WINAPI watch_ctrl_handler(DWORD type) {
+    (void)type;
+    InterlockedExchange(&g_watchQuit, 1);
+    return TRUE;
+}
+
+// Reads --watch POINTS and plans their regions, stacked in one DIB. Points
+// are desktop coordinates; those off the desktop are skipped with a warning.
+static int load_watch_points(void) {
+    FILE* fp = _wfopen(g_watchPath, L"r");
+    if (!fp) {
+        fwprintf(stderr, L"Cannot open %ls\n", g_watchPath);
+        return 0;
+    }
+    int n = 0, cap = 0, lineNo = 0, ok = 1;
+    int *xs = NULL, *ys = NULL;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), fp)) {
+        int x, y;
+        lineNo++;
+        if (!watch_parse_point(line, &x, &y)) continue;
+        if (x < g_desktop.left || y < g_desktop.top || x >= g_desktop.right || y >= g_desktop.bottom) {
+            fwprintf(stderr, L"%ls:%d: %d,%d is off the desktop, skipped\n", g_watchPath, lineNo, x, y);
+            continue;
+        }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            int* nx = (int*)realloc(xs, (size_t)cap * sizeof(int));
+            if (nx) xs = nx;
+            int* ny = (int*)realloc(ys, (size_t)cap * sizeof(int));
+            if (ny) ys = ny;
+            ok = nx && ny;
+            if (!ok) break;
+        }
+        xs[n] = x - g_desktop.left;
+        ys[n] = y - g_desktop.top;
+        n++;
+    }
+    fclose(fp);
+    if (ok) ok = watch_plan(&g_watch, xs, ys, n, WATCH_CELL, REGION_GRAB_COST, 1);
+    free(xs);
+    free(ys);
+    if (!ok) fwprintf(stderr, L"Out of memory loading %ls\n", g_watchPath);
+    return ok;
+}
+
+// Headless watch mode: BitBlts the regions at --watch-rate and reports the
+// points that changed, until Ctrl+C.
+static int run_watch(void) {
+    g_desktop.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    g_desktop.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    g_desktop.right = g_desktop.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    g_desktop.bottom = g_desktop.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+    if (!load_watch_points()) return 1;
+    WatchSet* ws = &g_watch;
+    if (!ws->count) {
+        fwprintf(stderr, L"No points to watch in %ls\n", g_watchPath);
+        return 1;
+    }
+    void* bits = NULL;
+    HDC dc = CreateCompatibleDC(g_screenDC);
+    HBITMAP bmp = create_dib(ws->stride, (int)(ws->pixels / (size_t)ws->stride), &bits);
+    if (!dc || !bmp) {
+        fwprintf(stderr, L"Failed to create watch bitmap\n");
+        if (bmp) DeleteObject(bmp);
+        if (dc) DeleteDC(dc);
+        watch_free(ws);
+        return 1;
+    }
+    HGDIOBJ old = SelectObject(dc, bmp);
+    mem_set("watch", watch_bytes(ws) + ws->pixels * 4);
+    SetConsoleCtrlHandler(watch_ctrl_handler, TRUE);
+    ensure_console_output();
+    fwprintf(stderr, L"watching %d points in %d regions (%llu px per tick) at %g Hz\n", ws->count,
+             ws->regionCount, (unsigned long long)ws->pixels, g_watchRate);
+
+    double period = 1000.0 / g_watchRate;
+    double start = pacer_now_ms(), next = start;
+    FILE* cmd = NULL;  // --watch-command, started at the first change
+    while (!g_watchQuit) {
+        double t = pacer_now_ms();
+        if (t < next) {
+            Sleep((DWORD)(next - t) + 1);
+            continue;
+        }
+        next += period;
+        if (next <= t) next = t + period;
+
+        double t0 = pacer_now_ms();
+        for (int r = 0; r < ws->regionCount; r++) {
+            const RegionRect* g = &ws->regions[r];
+            BitBlt(dc, 0, (int)(ws->offset[r] / (size_t)ws->stride), g->w, g->h, g_screenDC,
+                   g->x + g_desktop.left, g->y + g_desktop.top, SRCCOPY);
+        }
+        GdiFlush();
+        double t1 = pacer_now_ms();
+        int n = watch_check(ws, (const uint8_t*)bits, g_watchTolerance);
+        watch_count_ms(ws, t1 - t0, pacer_now_ms() - t1);
+
+        for (int e = 0; e < n; e++) {
+            char line[96];
+            wchar_t buf[96];
+            watch_format_event(ws, &ws->events[e], g_desktop.left, g_desktop.top, t - start, line, sizeof(line));
+            int i = 0;
+            for (; line[i] && i < 95; i++) buf[i] = (wchar_t)line[i];
+            buf[i] = 0;
+            wprintf(L"%ls\n", buf);
+            if (g_watchCommand && !cmd) cmd = _wpopen(g_watchCommand, L"w");
+            if (cmd) fprintf(cmd, "%s\n", line);
+        }
+        if (n) fflush(stdout);
+        // A command that has exited is started again at the next change.
+        if (cmd && n && fflush(cmd) != 0) {
+            _pclose(cmd);
+            cmd = NULL;
+        }
+    }
+    if (cmd) _pclose(cmd);
+    if (g_stats) {
+        watch_report(ws, stderr);
+        mem_report(stderr);
+    }
+    SelectObject(dc, old);
+    DeleteObject(bmp);
+    DeleteDC(dc);
+    watch_free(ws);
+    return 0;
+}
+
+// Maps cache file `file` into g_ref if it holds the tiles of the PNG of this
+// size and modification time. The view lasts until exit.
+static int map_reference(HANDLE file, uint64_t pngSize, int64_t pngTime) {
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart < ONION_HEADER) return 0;
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return 0;
+    const uint8_t* map = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);  // the view keeps it open
+    if (!map) return 0;
+    if (!onion_attach(&g_ref, map, (size_t)size.QuadPart, pngSize, pngTime)) {
+        UnmapViewOfFile(map);
+        return 0;
+    }
+    return 1;
+}
+
+// Opens --reference: maps its tile cache, PNG.tiles next to the PNG, after
+// decoding the PNG into it when the cache is missing, damaged or older than
+// the PNG. The new cache is written to a temporary file beside it and moved
+// over the old one, which another picker may have mapped; a move also
+// replaces a symlink rather than writing through it. Where the cache cannot
+// be written, it is built in a temporary file for this run only.
+static int open_reference(void) {
+    WIN32_FILE_ATTRIBUTE_DATA fa;
+    if (!GetFileAttributesExW(g_refPath, GetFileExInfoStandard, &fa)) {
+        fwprintf(stderr, L"Cannot read reference %ls\n", g_refPath);
+        return 0;
+    }
+    uint64_t pngSize = (uint64_t)fa.nFileSizeHigh << 32 | fa.nFileSizeLow;
+    int64_t pngTime = (int64_t)((uint64_t)fa.ftLastWriteTime.dwHighDateTime << 32 | fa.ftLastWriteTime.dwLowDateTime);
+    // A path too long for ".tiles" gets no cache file: cut short, it could
+    // name the PNG itself, which the cache would then overwrite.
+    wchar_t cachePath[MAX_PATH + 8];
+    int n = swprintf(cachePath, sizeof(cachePath) / sizeof(cachePath[0]), L"%ls.tiles", g_refPath);
+    int cacheable = n > 0 && (size_t)n < sizeof(cachePath) / sizeof(cachePath[0]);
+    HANDLE file = cacheable ? CreateFileW(cachePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                          FILE_ATTRIBUTE_NORMAL, NULL)
+                            : INVALID_HANDLE_VALUE;
+    if (file != INVALID_HANDLE_VALUE) {
+        int ok = map_reference(file, pngSize, pngTime);
+        CloseHandle(file);
+        if (ok) return 1;
+    }
+
+    double t0 = pacer_now_ms();
+    FILE* fp = _wfopen(g_refPath, L"rb");
+    uint8_t* data = (uint8_t*)malloc(pngSize ? (size_t)pngSize : 1);
+    size_t got = fp && data ? fread(data, 1, (size_t)pngSize, fp) : 0;
+    if (fp) fclose(fp);
+    int w = 0, h = 0;
+    uint8_t* px = got == pngSize ? png_decode_bgra(data, (size_t)pngSize, &w, &h) : NULL;
+    free(data);
+    if (!px) {
+        fwprintf(stderr, L"Cannot decode reference %ls (want an 8 or 16-bit, non-interlaced PNG)\n", g_refPath);
+        return 0;
+    }
+    wchar_t tmpPath[MAX_PATH + 32];
+    HANDLE tmp = INVALID_HANDLE_VALUE;
+    FILE* out = NULL;
+    for (int attempt = 0; cacheable && attempt < 16 && tmp == INVALID_HANDLE_VALUE; attempt++) {
+        swprintf(tmpPath, sizeof(tmpPath) / sizeof(tmpPath[0]), L"%ls.%lu.%d.tmp", cachePath,
+                 GetCurrentProcessId(), attempt);
+        // DELETE and FILE_SHARE_DELETE let it be moved or deleted while open.
+        tmp = CreateFileW(tmpPath, GENERIC_READ | GENERIC_WRITE | DELETE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                          NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (tmp == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS) break;
+    }
+    if (tmp != INVALID_HANDLE_VALUE) {
+        int fd = _open_osfhandle((intptr_t)tmp, _O_RDWR | _O_BINARY);
+        if (fd < 0) {
+            CloseHandle(tmp);
+        } else if (!(out = _fdopen(fd, "w+b"))) {
+            _close(fd);
+        }
+        if (!out) {
+            DeleteFileW(tmpPath);
+            tmp = INVALID_HANDLE_VALUE;
+        }
+    }
+    if (!out) out = tmpfile();
+    int ok = out && onion_cache_write(out, px, w, h, pngSize, pngTime);
+    if (tmp != INVALID_HANDLE_VALUE && !(ok && MoveFileExW(tmpPath, cachePath, MOVEFILE_REPLACE_EXISTING))) {
+        // Not moved: gone once closed and unmapped. The next run rebuilds.
+        FILE_DISPOSITION_INFO del = { TRUE };
+        SetFileInformationByHandle(tmp, FileDispositionInfo, &del, sizeof(del));
+    }
+    ok = ok && map_reference((HANDLE)_get_osfhandle(_fileno(out)), pngSize, pngTime);
+    free(px);
+    if (out) fclose(out);
+    if (!ok) {
+        fwprintf(stderr, L"Cannot write the tile cache of %ls\n", g_refPath);
+        return 0;
+    }
+    if (g_stats) fwprintf(stderr, L"reference: %dx%d decoded and tiled in %.1f ms\n", w, h, pacer_now_ms() - t0);
+    return 1;
+}
+
 int wmain(int argc, wchar_t* argv[]) {
-    (void)argc; (void)argv;
+    int noPark = 0;
+    int threads = -1;
+    for (int i = 1; i < argc; i++) {
+        if (wcscmp(argv[i], L"--trace") == 0 && i + 1 < argc) {
+            g_tracePath = argv[++i];
+        } else if (wcscmp(argv[i], L"--stats") == 0) {
+            g_stats = 1;
+        } else if (wcscmp(argv[i], L"--mem-cap") == 0 && i + 1 < argc) {
+            mem_set_cap((size_t)(_wtof(argv[++i]) * 1048576.0));
+        } else if (wcscmp(argv[i], L"--no-park") == 0) {
+            noPark = 1;
+        } else if (wcscmp(argv[i], L"--radius") == 0 && i + 1 < argc) {
+            g_style.radius = _wtoi(argv[++i]);
+        } else if (wcscmp(argv[i], L"--zoom") == 0 && i + 1 < argc) {
+            g_zoom = _wtof(argv[++i]);
+        } else if (wcscmp(argv[i], L"--threads") == 0 && i + 1 < argc) {
+            threads = _wtoi(argv[++i]);
+        } else if (wcscmp(argv[i], L"--flash-damage") == 0) {
+            g_flashDamage = 1;
+        } else if (wcscmp(argv[i], L"--scope") == 0 && i + 1 < argc) {
+            g_scopeRegion = _wtoi(argv[++i]);
+            if (g_scopeRegion < 0) g_scopeRegion = 0;
+        } else if (wcscmp(argv[i], L"--fill-tolerance") == 0 && i + 1 < argc) {
+            g_fillTolerance = _wtoi(argv[++i]);
+            if (g_fillTolerance < 0) g_fillTolerance = 0;
+            if (g_fillTolerance > 255) g_fillTolerance = 255;
+        } else if (wcscmp(argv[i], L"--ruler") == 0) {
+            g_ruler = 1;
+        } else if (wcscmp(argv[i], L"--ruler-tolerance") == 0 && i + 1 < argc) {
+            g_rulerTolerance = _wtoi(argv[++i]);
+            if (g_rulerTolerance < 0) g_rulerTolerance = 0;
+            if (g_rulerTolerance > 255) g_rulerTolerance = 255;
+        } else if (wcscmp(argv[i], L"--two-point") == 0) {
+            g_twoPoint = 1;
+        } else if (wcscmp(argv[i], L"--watch") == 0 && i + 1 < argc) {
+            g_watchPath = argv[++i];
+        } else if (wcscmp(argv[i], L"--watch-rate") == 0 && i + 1 < argc) {
+            g_watchRate = _wtof(argv[++i]);
+            if (!(g_watchRate >= 0.1)) g_watchRate = 0.1;
+            if (g_watchRate > 1000.0) g_watchRate = 1000.0;
+        } else if (wcscmp(argv[i], L"--watch-tolerance") == 0 && i + 1 < argc) {
+            g_watchTolerance = _wtoi(argv[++i]);
+            if (g_watchTolerance < 0) g_watchTolerance = 0;
+            if (g_watchTolerance > 255) g_watchTolerance = 255;
+        } else if (wcscmp(argv[i], L"--watch-command") == 0 && i + 1 < argc) {
+            g_watchCommand = argv[++i];
+        } else if (wcscmp(argv[i], L"--reference") == 0 && i + 1 < argc) {
+            g_refPath = argv[++i];
+        } else if (wcscmp(argv[i], L"--reference-origin") == 0 && i + 1 < argc) {
+            if (swscanf(argv[++i], L"%d,%d", &g_refX, &g_refY) != 2) {
+                fwprintf(stderr, L"Ignoring --reference-origin %ls (want X,Y)\n", argv[i]);
+                g_refX = g_refY = 0;
+            }
+        } else if (wcscmp(argv[i], L"--reference-opacity") == 0 && i + 1 < argc) {
+            int percent = _wtoi(argv[++i]);
+            if (percent < 0) percent = 0;
+            if (percent > 100) percent = 100;
+            g_refOpacity = (percent * 128 + 50) / 100;
+        } else if (wcscmp(argv[i], L"--amplify") == 0) {
+            g_amplify = 1;
+        } else if (wcscmp(argv[i], L"--amplify-range") == 0 && i + 1 < argc) {
+            g_amplifyRange = _wtoi(argv[++i]);
+            if (g_amplifyRange < 1) g_amplifyRange = 1;
+            if (g_amplifyRange > 128) g_amplifyRange = 128;
+        } else if (wcscmp(argv[i], L"--pin") == 0 && i + 1 < argc) {
+            int x, y;
+            if (swscanf(argv[++i], L"%d,%d", &x, &y) == 2 && g_pinCount < MAX_PINS) {
+                g_pins[g_pinCount].pt.x = x;
+                g_pins[g_pinCount].pt.y = y;
+                g_pinCount++;
+            } else {
+                fwprintf(stderr, L"Ignoring --pin %ls (want X,Y, at most %d pins)\n", argv[i], MAX_PINS);
+            }
+        }
+    }
+    if (g_style.radius <= 0) g_style.radius = kDefaultRadius;
+    if (g_style.radius < kMinRadius) g_style.radius = kMinRadius;
+    if (g_style.radius > kMaxRadius) g_style.radius = kMaxRadius;
+    g_style.maxRadius = kMaxRadius;
+    g_style.borderWidth = kBorderWidth;
+    g_style.markerSize = kMarkerSize;
+    g_style.offset = kOffset;
+    if (g_zoom <= 0.0) g_zoom = kDefaultZoom;
+    if (g_zoom > kMaxZoom) g_zoom = kMaxZoom;
+    if (g_zoom < 1.0 / kMaxZoomOut) g_zoom = 1.0 / kMaxZoomOut;
+    srgb_tables();
+    if (g_refPath && !open_reference()) return 1;
+    pacer_init(&g_pacer, (double)kTickMs);
+    perf_counters_init(&g_perf);
+    if (g_stats) perf_counters_open(&g_perf);
+    park_init(&g_parker, !noPark);
+
     HINSTANCE hInstance = GetModuleHandleW(NULL);
     g_hInstance = hInstance;
 
     enable_dpi_awareness();
+    // Loupe sizes follow the DPI of each loupe's monitor, so they are known
+    // only once the process is DPI aware.
+    g_screenDC = GetDC(NULL);
+    if (g_watchPath) {
+        int status = run_watch();
+        ReleaseDC(NULL, g_screenDC);
+        return status;
+    }
+    for (int i = 0; i < g_pinCount; i++) g_pins[i].dpi = monitor_dpi(g_pins[i].pt);
+    POINT cur;
+    GetCursorPos(&cur);
+    ensure_resources(cur);
 
     const wchar_t* kClass = L"MinimalColorPickerOverlay";
     WNDCLASSEXW wc;
@@ -357,12 +1869,38 @@ int wmain(int argc, wchar_t* argv[]) {
         kClass,
         L"",
         style,
-        0, 0, kDiameter, kDiameter,
+        0, 0, g_diameter, g_diameter,
         NULL, NULL, hInstance, NULL
     );
 
     if (!g_hwnd) return 1;
 
+    // Pinned loupe and scope windows only display; their class has no
+    // handler of its own, so the frame timer stays on g_hwnd alone.
+    const wchar_t* kPinClass = L"MinimalColorPickerPin";
+    wc.lpfnWndProc = DefWindowProcW;
+    wc.lpszClassName = kPinClass;
+    if (g_pinCount || g_scopeRegion >= 0) RegisterClassExW(&wc);
+    for (int i = 0; i < g_pinCount; i++) {
+        int d = g_pins[i].geo.diameter;
+        g_pins[i].hwnd = CreateWindowExW(exStyle, kPinClass, L"", style, 0, 0, d, d, NULL, NULL, hInstance, NULL);
+        if (!g_pins[i].hwnd) return 1;
+    }
+    if (g_scopeRegion >= 0) {
+        g_scopeHwnd = CreateWindowExW(exStyle, kPinClass, L"", style, 0, 0, SCOPE_PANEL_W, SCOPE_PANEL_H, NULL, NULL,
+                                      hInstance, NULL);
+        if (!g_scopeHwnd) return 1;
+    }
+
+    // Size trace history last, from what the cap leaves once the window and
+    // frame buffers are resident.
+    if (g_tracePath) {
+        trace_enable(trace_events_for_bytes(mem_history_budget(TRACE_DEFAULT_EVENTS * sizeof(TraceEvent))));
+        trace_thread_name("ui");
+    }
+    pool_init(&g_pool, threads < 0 ? pool_default_threads() : threads);
+    pool_init(&g_inlinePool, 0);
+
     ShowWindow(g_hwnd, SW_SHOW);
     UpdateWindow(g_hwnd);
 
@@ -378,11 +1916,44 @@ int wmain(int argc, wchar_t* argv[]) {
     if (g_keyboardHook) UnhookWindowsHookEx(g_keyboardHook);
     if (g_mouseHook) UnhookWindowsHookEx(g_mouseHook);
 
+    pool_destroy(&g_pool);
+    pool_destroy(&g_inlinePool);
+    write_trace_file();
+    if (g_stats) report_stats(stderr);
+    perf_counters_close(&g_perf);
+
+    for (int i = 0; i < g_pinCount; i++) {
+        PinnedLoupe* p = &g_pins[i];
+        if (p->hwnd) DestroyWindow(p->hwnd);
+        if (p->dib) DeleteObject(p->dib);
+        if (p->memDC) DeleteDC(p->memDC);
+    }
+    for (int i = 0; i < g_pinCount; i++) {
+        mip_free(&g_pins[i].mip);
+        free(g_pins[i].edge);
+    }
+    mip_free(&g_mip);
+    damage_free(&g_damage);
+    scope_free(&g_scope);
+    fill_free(&g_fill);
+    if (g_fillBmp) { DeleteObject(g_fillBmp); g_fillBmp = NULL; }
+    if (g_fillDC) { DeleteDC(g_fillDC); g_fillDC = NULL; }
+    ruler_free(&g_rulerCache);
+    if (g_rulerRowBmp) { DeleteObject(g_rulerRowBmp); g_rulerRowBmp = NULL; }
+    if (g_rulerBandBmp) { DeleteObject(g_rulerBandBmp); g_rulerBandBmp = NULL; }
+    if (g_rulerRowDC) { DeleteDC(g_rulerRowDC); g_rulerRowDC = NULL; }
+    if (g_rulerBandDC) { DeleteDC(g_rulerBandDC); g_rulerBandDC = NULL; }
+    if (g_scopeHwnd) DestroyWindow(g_scopeHwnd);
+    if (g_scopeBmp) { DeleteObject(g_scopeBmp); g_scopeBmp = NULL; }
+    if (g_scopeDC) { DeleteDC(g_scopeDC); g_scopeDC = NULL; }
+    if (g_sharedBmp) { DeleteObject(g_sharedBmp); g_sharedBmp = NULL; }
+    if (g_sharedDC) { DeleteDC(g_sharedDC); g_sharedDC = NULL; }
     if (g_capBmp) { DeleteObject(g_capBmp); g_capBmp = NULL; }
     if (g_capDC) { DeleteDC(g_capDC); g_capDC = NULL; }
 
     if (g_dib) { DeleteObject(g_dib); g_dib = NULL; }
     if (g_memDC) { DeleteDC(g_memDC); g_memDC = NULL; }
+    if (g_screenDC) { ReleaseDC(NULL, g_screenDC); g_screenDC = NULL; }
 
     return 0;
 }